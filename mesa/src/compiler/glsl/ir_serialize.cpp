@@ -0,0 +1,1217 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file ir_serialize.cpp
+ * Serialization of the IR of a compiled (unlinked) shader.
+ *
+ * Types are written in full the first time they are seen and referred to by
+ * index afterwards.  Variables and function signatures are referred to by
+ * the index they were given when their declaration was written.  All the
+ * function prototypes of the shader are written before any function body,
+ * so calls can always be resolved while reading.  Prototypes of built-in
+ * functions aren't serialized; they are cloned again from the built-in
+ * function module.
+ */
+
+#include "ir.h"
+#include "blob.h"
+#include "glsl_symbol_table.h"
+#include "shader_cache.h"
+#include "main/imports.h"
+#include "main/mtypes.h"
+#include "util/hash_table.h"
+
+namespace {
+
+/* Node type tag used for NULL pointers. */
+#define IR_SERIALIZE_NULL ir_type_unset
+
+class ir_serializer {
+public:
+   ir_serializer(struct blob *blob)
+      : blob(blob), error(false)
+   {
+      mem_ctx = ralloc_context(NULL);
+      types = _mesa_hash_table_create(mem_ctx, _mesa_hash_pointer,
+                                      _mesa_key_pointer_equal);
+      variables = _mesa_hash_table_create(mem_ctx, _mesa_hash_pointer,
+                                          _mesa_key_pointer_equal);
+      signatures = _mesa_hash_table_create(mem_ctx, _mesa_hash_pointer,
+                                           _mesa_key_pointer_equal);
+   }
+
+   ~ir_serializer()
+   {
+      ralloc_free(mem_ctx);
+   }
+
+   bool write_ir(exec_list *ir);
+
+private:
+   void write_type(const glsl_type *type);
+   void write_index(struct hash_table *ht, const void *ptr);
+   void add_index(struct hash_table *ht, const void *ptr);
+   void write_list(exec_list *list);
+   void write_instruction(ir_instruction *ir);
+   void write_variable(ir_variable *var);
+   void write_constant(ir_constant *c);
+   void write_function(ir_function *f);
+
+   struct blob *blob;
+   void *mem_ctx;
+   struct hash_table *types;
+   struct hash_table *variables;
+   struct hash_table *signatures;
+   bool error;
+};
+
+class ir_deserializer {
+public:
+   ir_deserializer(struct blob_reader *blob, void *ir_mem_ctx)
+      : blob(blob), ir_mem_ctx(ir_mem_ctx), error(false)
+   {
+      mem_ctx = ralloc_context(NULL);
+      memset(&types, 0, sizeof(types));
+      memset(&variables, 0, sizeof(variables));
+      memset(&signatures, 0, sizeof(signatures));
+   }
+
+   ~ir_deserializer()
+   {
+      ralloc_free(mem_ctx);
+   }
+
+   bool read_ir(exec_list *ir);
+
+private:
+   struct ref_array {
+      void **data;
+      unsigned count;
+      unsigned size;
+   };
+
+   const glsl_type *read_type();
+   void *read_index(ref_array *refs);
+   unsigned add_ref(ref_array *refs, void *ptr);
+   void read_list(exec_list *list);
+   ir_instruction *read_instruction();
+   ir_rvalue *read_rvalue(bool required);
+   ir_dereference *read_dereference();
+   ir_variable *read_variable();
+   ir_constant *read_constant();
+   ir_function *read_function();
+   const char *read_string();
+
+   /** Whether reading failed, including running past the end of the blob. */
+   bool failed()
+   {
+      if (blob->overrun)
+         error = true;
+      return error;
+   }
+
+   struct blob_reader *blob;
+   void *ir_mem_ctx;
+   void *mem_ctx;
+   ref_array types;
+   ref_array variables;
+   ref_array signatures;
+   bool error;
+};
+
+} /* anonymous namespace */
+
+
+/**
+ * Types are identified by an index starting at 1; 0 means NULL.  The first
+ * reference to a type is followed by its definition.
+ */
+void
+ir_serializer::write_type(const glsl_type *type)
+{
+   if (type == NULL) {
+      blob_write_uint32(blob, 0);
+      return;
+   }
+
+   struct hash_entry *entry = _mesa_hash_table_search(types, type);
+   if (entry) {
+      blob_write_uint32(blob, (uintptr_t) entry->data);
+      return;
+   }
+
+   /* Register the type before writing any type it's made of, so that both
+    * sides number them in the same order.
+    */
+   uintptr_t index = types->entries + 1;
+   _mesa_hash_table_insert(types, type, (void *) index);
+   blob_write_uint32(blob, index);
+
+   blob_write_uint32(blob, type->base_type);
+
+   switch (type->base_type) {
+   case GLSL_TYPE_UINT:
+   case GLSL_TYPE_INT:
+   case GLSL_TYPE_FLOAT:
+   case GLSL_TYPE_DOUBLE:
+   case GLSL_TYPE_BOOL:
+      blob_write_uint32(blob, type->vector_elements);
+      blob_write_uint32(blob, type->matrix_columns);
+      break;
+   case GLSL_TYPE_SAMPLER:
+      blob_write_uint32(blob, type->sampler_dimensionality);
+      blob_write_uint32(blob, type->sampler_shadow);
+      blob_write_uint32(blob, type->sampler_array);
+      blob_write_uint32(blob, type->sampled_type);
+      break;
+   case GLSL_TYPE_IMAGE:
+      blob_write_uint32(blob, type->sampler_dimensionality);
+      blob_write_uint32(blob, type->sampler_array);
+      blob_write_uint32(blob, type->sampled_type);
+      break;
+   case GLSL_TYPE_ARRAY:
+      write_type(type->fields.array);
+      blob_write_uint32(blob, type->length);
+      break;
+   case GLSL_TYPE_STRUCT:
+   case GLSL_TYPE_INTERFACE:
+      blob_write_string(blob, type->name);
+      blob_write_uint32(blob, type->length);
+      blob_write_uint32(blob, type->interface_packing);
+      for (unsigned i = 0; i < type->length; i++) {
+         glsl_struct_field field = type->fields.structure[i];
+
+         write_type(field.type);
+         blob_write_string(blob, field.name);
+         field.type = NULL;
+         field.name = NULL;
+         blob_write_bytes(blob, &field, sizeof(field));
+      }
+      break;
+   case GLSL_TYPE_SUBROUTINE:
+      blob_write_string(blob, type->name);
+      break;
+   case GLSL_TYPE_ATOMIC_UINT:
+   case GLSL_TYPE_VOID:
+   case GLSL_TYPE_ERROR:
+      break;
+   case GLSL_TYPE_FUNCTION:
+      /* Function types are only used by the front-end. */
+      error = true;
+      break;
+   }
+}
+
+void
+ir_serializer::add_index(struct hash_table *ht, const void *ptr)
+{
+   uintptr_t index = ht->entries + 1;
+   _mesa_hash_table_insert(ht, ptr, (void *) index);
+}
+
+/**
+ * Write a reference to a variable or function signature, which must have
+ * been declared before.
+ */
+void
+ir_serializer::write_index(struct hash_table *ht, const void *ptr)
+{
+   if (ptr == NULL) {
+      blob_write_uint32(blob, 0);
+      return;
+   }
+
+   struct hash_entry *entry = _mesa_hash_table_search(ht, ptr);
+   if (entry == NULL) {
+      error = true;
+      blob_write_uint32(blob, 0);
+      return;
+   }
+
+   blob_write_uint32(blob, (uintptr_t) entry->data);
+}
+
+void
+ir_serializer::write_list(exec_list *list)
+{
+   blob_write_uint32(blob, list->length());
+   foreach_in_list(ir_instruction, ir, list)
+      write_instruction(ir);
+}
+
+void
+ir_serializer::write_variable(ir_variable *var)
+{
+   add_index(variables, var);
+
+   write_type(var->type);
+   blob_write_uint32(blob, var->is_name_ralloced() && var->name != NULL);
+   if (var->is_name_ralloced() && var->name != NULL)
+      blob_write_string(blob, var->name);
+   blob_write_bytes(blob, &var->data, sizeof(var->data));
+
+   write_type(var->get_interface_type());
+   if (var->is_interface_instance()) {
+      blob_write_bytes(blob, var->get_max_ifc_array_access(),
+                       var->get_interface_type()->length * sizeof(int));
+   } else {
+      blob_write_uint32(blob, var->get_num_state_slots());
+      blob_write_bytes(blob, var->get_state_slots(),
+                       var->get_num_state_slots() * sizeof(ir_state_slot));
+   }
+
+   blob_write_uint32(blob, var->constant_value != NULL);
+   if (var->constant_value)
+      write_constant(var->constant_value);
+   blob_write_uint32(blob, var->constant_initializer != NULL);
+   if (var->constant_initializer)
+      write_constant(var->constant_initializer);
+}
+
+void
+ir_serializer::write_constant(ir_constant *c)
+{
+   write_type(c->type);
+
+   if (c->type->is_array()) {
+      for (unsigned i = 0; i < c->type->length; i++)
+         write_constant(c->array_elements[i]);
+   } else if (c->type->is_record()) {
+      foreach_in_list(ir_constant, field, &c->components)
+         write_constant(field);
+   } else {
+      blob_write_bytes(blob, &c->value, sizeof(c->value));
+   }
+}
+
+/**
+ * Write a function and the prototypes of its signatures.  The bodies are
+ * written after all the top-level instructions.
+ */
+void
+ir_serializer::write_function(ir_function *f)
+{
+   blob_write_string(blob, f->name);
+   blob_write_uint32(blob, f->is_subroutine);
+   blob_write_uint32(blob, f->subroutine_index);
+   blob_write_uint32(blob, f->num_subroutine_types);
+   for (int i = 0; i < f->num_subroutine_types; i++)
+      write_type(f->subroutine_types[i]);
+
+   blob_write_uint32(blob, f->signatures.length());
+   foreach_in_list(ir_function_signature, sig, &f->signatures) {
+      add_index(signatures, sig);
+
+      blob_write_uint32(blob, sig->is_builtin());
+      write_type(sig->return_type);
+      blob_write_uint32(blob, sig->is_defined);
+      blob_write_uint32(blob, sig->is_intrinsic);
+
+      if (sig->is_builtin()) {
+         /* Only the parameter types are needed to find the built-in again,
+          * but the parameters still get an index.
+          */
+         blob_write_uint32(blob, sig->parameters.length());
+         foreach_in_list(ir_variable, param, &sig->parameters) {
+            add_index(variables, param);
+            write_type(param->type);
+         }
+      } else {
+         blob_write_uint32(blob, sig->parameters.length());
+         foreach_in_list(ir_variable, param, &sig->parameters)
+            write_variable(param);
+      }
+   }
+}
+
+void
+ir_serializer::write_instruction(ir_instruction *ir)
+{
+   if (ir == NULL) {
+      blob_write_uint32(blob, IR_SERIALIZE_NULL);
+      return;
+   }
+
+   blob_write_uint32(blob, ir->ir_type);
+
+   switch (ir->ir_type) {
+   case ir_type_dereference_array: {
+      ir_dereference_array *deref = (ir_dereference_array *) ir;
+      write_instruction(deref->array);
+      write_instruction(deref->array_index);
+      break;
+   }
+   case ir_type_dereference_record: {
+      ir_dereference_record *deref = (ir_dereference_record *) ir;
+      write_instruction(deref->record);
+      blob_write_string(blob, deref->field);
+      break;
+   }
+   case ir_type_dereference_variable:
+      write_index(variables, ((ir_dereference_variable *) ir)->var);
+      break;
+   case ir_type_constant:
+      write_constant((ir_constant *) ir);
+      break;
+   case ir_type_expression: {
+      ir_expression *expr = (ir_expression *) ir;
+      blob_write_uint32(blob, expr->operation);
+      write_type(expr->type);
+      blob_write_uint32(blob, expr->get_num_operands());
+      for (unsigned i = 0; i < expr->get_num_operands(); i++)
+         write_instruction(expr->operands[i]);
+      break;
+   }
+   case ir_type_swizzle: {
+      ir_swizzle *swiz = (ir_swizzle *) ir;
+      write_instruction(swiz->val);
+      blob_write_uint32(blob, swiz->mask.x);
+      blob_write_uint32(blob, swiz->mask.y);
+      blob_write_uint32(blob, swiz->mask.z);
+      blob_write_uint32(blob, swiz->mask.w);
+      blob_write_uint32(blob, swiz->mask.num_components);
+      break;
+   }
+   case ir_type_texture: {
+      ir_texture *tex = (ir_texture *) ir;
+      blob_write_uint32(blob, tex->op);
+      write_type(tex->type);
+      write_instruction(tex->sampler);
+      write_instruction(tex->coordinate);
+      write_instruction(tex->projector);
+      write_instruction(tex->shadow_comparitor);
+      write_instruction(tex->offset);
+      switch (tex->op) {
+      case ir_txb:
+         write_instruction(tex->lod_info.bias);
+         break;
+      case ir_txl:
+      case ir_txf:
+      case ir_txs:
+         write_instruction(tex->lod_info.lod);
+         break;
+      case ir_txf_ms:
+         write_instruction(tex->lod_info.sample_index);
+         break;
+      case ir_txd:
+         write_instruction(tex->lod_info.grad.dPdx);
+         write_instruction(tex->lod_info.grad.dPdy);
+         break;
+      case ir_tg4:
+         write_instruction(tex->lod_info.component);
+         break;
+      default:
+         break;
+      }
+      break;
+   }
+   case ir_type_variable:
+      write_variable((ir_variable *) ir);
+      break;
+   case ir_type_assignment: {
+      ir_assignment *assign = (ir_assignment *) ir;
+      write_instruction(assign->lhs);
+      write_instruction(assign->rhs);
+      write_instruction(assign->condition);
+      blob_write_uint32(blob, assign->write_mask);
+      break;
+   }
+   case ir_type_call: {
+      ir_call *call = (ir_call *) ir;
+      write_index(signatures, call->callee);
+      write_instruction(call->return_deref);
+      write_list(&call->actual_parameters);
+      write_index(variables, call->sub_var);
+      write_instruction(call->array_idx);
+      break;
+   }
+   case ir_type_function:
+      write_function((ir_function *) ir);
+      break;
+   case ir_type_if: {
+      ir_if *iif = (ir_if *) ir;
+      write_instruction(iif->condition);
+      write_list(&iif->then_instructions);
+      write_list(&iif->else_instructions);
+      break;
+   }
+   case ir_type_loop:
+      write_list(&((ir_loop *) ir)->body_instructions);
+      break;
+   case ir_type_loop_jump:
+      blob_write_uint32(blob, ((ir_loop_jump *) ir)->mode);
+      break;
+   case ir_type_return:
+      write_instruction(((ir_return *) ir)->value);
+      break;
+   case ir_type_discard:
+      write_instruction(((ir_discard *) ir)->condition);
+      break;
+   case ir_type_emit_vertex:
+      write_instruction(((ir_emit_vertex *) ir)->stream);
+      break;
+   case ir_type_end_primitive:
+      write_instruction(((ir_end_primitive *) ir)->stream);
+      break;
+   case ir_type_barrier:
+      break;
+   case ir_type_function_signature:
+   default:
+      /* Signatures are written with their function. */
+      error = true;
+      break;
+   }
+}
+
+bool
+ir_serializer::write_ir(exec_list *ir)
+{
+   write_list(ir);
+
+   foreach_in_list(ir_instruction, node, ir) {
+      ir_function *f = node->as_function();
+      if (f == NULL)
+         continue;
+
+      foreach_in_list(ir_function_signature, sig, &f->signatures) {
+         if (!sig->is_builtin() && sig->is_defined)
+            write_list(&sig->body);
+      }
+   }
+
+   return !error;
+}
+
+
+unsigned
+ir_deserializer::add_ref(ref_array *refs, void *ptr)
+{
+   if (refs->count == refs->size) {
+      unsigned size = refs->size ? refs->size * 2 : 64;
+      void **data = reralloc(mem_ctx, refs->data, void *, size);
+      if (data == NULL) {
+         error = true;
+         return 0;
+      }
+      refs->data = data;
+      refs->size = size;
+   }
+
+   refs->data[refs->count] = ptr;
+   return ++refs->count;
+}
+
+void *
+ir_deserializer::read_index(ref_array *refs)
+{
+   uint32_t index = blob_read_uint32(blob);
+
+   if (index == 0)
+      return NULL;
+
+   if (index > refs->count || refs->data[index - 1] == NULL) {
+      error = true;
+      return NULL;
+   }
+
+   return refs->data[index - 1];
+}
+
+const char *
+ir_deserializer::read_string()
+{
+   const char *str = blob_read_string(blob);
+
+   if (str == NULL) {
+      error = true;
+      return "";
+   }
+
+   return str;
+}
+
+const glsl_type *
+ir_deserializer::read_type()
+{
+   uint32_t index = blob_read_uint32(blob);
+
+   if (index == 0 || error)
+      return NULL;
+
+   if (index <= types.count)
+      return (const glsl_type *) types.data[index - 1];
+
+   if (index != types.count + 1) {
+      error = true;
+      return NULL;
+   }
+
+   /* Reserve the slot, the type is filled in once it's complete. */
+   add_ref(&types, NULL);
+
+   const glsl_type *type = NULL;
+   uint32_t base_type = blob_read_uint32(blob);
+
+   switch (base_type) {
+   case GLSL_TYPE_UINT:
+   case GLSL_TYPE_INT:
+   case GLSL_TYPE_FLOAT:
+   case GLSL_TYPE_DOUBLE:
+   case GLSL_TYPE_BOOL: {
+      uint32_t rows = blob_read_uint32(blob);
+      uint32_t columns = blob_read_uint32(blob);
+      type = glsl_type::get_instance(base_type, rows, columns);
+      break;
+   }
+   case GLSL_TYPE_SAMPLER: {
+      uint32_t dim = blob_read_uint32(blob);
+      uint32_t shadow = blob_read_uint32(blob);
+      uint32_t array = blob_read_uint32(blob);
+      uint32_t sampled_type = blob_read_uint32(blob);
+      type = glsl_type::get_sampler_instance((glsl_sampler_dim) dim, shadow,
+                                             array,
+                                             (glsl_base_type) sampled_type);
+      break;
+   }
+   case GLSL_TYPE_IMAGE: {
+      uint32_t dim = blob_read_uint32(blob);
+      uint32_t array = blob_read_uint32(blob);
+      uint32_t sampled_type = blob_read_uint32(blob);
+      type = glsl_type::get_image_instance((glsl_sampler_dim) dim, array,
+                                           (glsl_base_type) sampled_type);
+      break;
+   }
+   case GLSL_TYPE_ARRAY: {
+      const glsl_type *element = read_type();
+      uint32_t length = blob_read_uint32(blob);
+      if (element != NULL)
+         type = glsl_type::get_array_instance(element, length);
+      break;
+   }
+   case GLSL_TYPE_STRUCT:
+   case GLSL_TYPE_INTERFACE: {
+      const char *name = read_string();
+      uint32_t length = blob_read_uint32(blob);
+      uint32_t packing = blob_read_uint32(blob);
+
+      if (blob->overrun ||
+          length > (size_t) (blob->end - blob->current) / sizeof(glsl_struct_field)) {
+         error = true;
+         break;
+      }
+
+      glsl_struct_field *fields =
+         ralloc_array(mem_ctx, glsl_struct_field, length);
+      for (unsigned i = 0; i < length; i++) {
+         const glsl_type *field_type = read_type();
+         const char *field_name = read_string();
+
+         blob_copy_bytes(blob, (uint8_t *) &fields[i], sizeof(fields[i]));
+         fields[i].type = field_type;
+         fields[i].name = field_name;
+         if (field_type == NULL)
+            error = true;
+      }
+
+      if (error || blob->overrun)
+         break;
+
+      if (base_type == GLSL_TYPE_STRUCT)
+         type = glsl_type::get_record_instance(fields, length, name);
+      else
+         type = glsl_type::get_interface_instance(fields, length,
+                                                  (glsl_interface_packing) packing,
+                                                  name);
+      break;
+   }
+   case GLSL_TYPE_SUBROUTINE:
+      type = glsl_type::get_subroutine_instance(read_string());
+      break;
+   case GLSL_TYPE_ATOMIC_UINT:
+      type = glsl_type::atomic_uint_type;
+      break;
+   case GLSL_TYPE_VOID:
+      type = glsl_type::void_type;
+      break;
+   case GLSL_TYPE_ERROR:
+      type = glsl_type::error_type;
+      break;
+   default:
+      break;
+   }
+
+   if (type == NULL || blob->overrun) {
+      error = true;
+      return NULL;
+   }
+
+   types.data[index - 1] = (void *) type;
+   return type;
+}
+
+void
+ir_deserializer::read_list(exec_list *list)
+{
+   uint32_t count = blob_read_uint32(blob);
+
+   for (uint32_t i = 0; i < count && !error && !blob->overrun; i++) {
+      ir_instruction *ir = read_instruction();
+      if (ir == NULL) {
+         error = true;
+         return;
+      }
+      list->push_tail(ir);
+   }
+}
+
+ir_rvalue *
+ir_deserializer::read_rvalue(bool required)
+{
+   ir_instruction *ir = read_instruction();
+
+   if (ir == NULL) {
+      if (required)
+         error = true;
+      return NULL;
+   }
+
+   if (!ir->is_rvalue()) {
+      error = true;
+      return NULL;
+   }
+
+   return (ir_rvalue *) ir;
+}
+
+ir_dereference *
+ir_deserializer::read_dereference()
+{
+   ir_rvalue *rvalue = read_rvalue(true);
+
+   if (rvalue == NULL || !rvalue->is_dereference()) {
+      error = true;
+      return NULL;
+   }
+
+   return (ir_dereference *) rvalue;
+}
+
+ir_variable *
+ir_deserializer::read_variable()
+{
+   ir_variable::ir_variable_data data;
+
+   const glsl_type *type = read_type();
+   const char *name = blob_read_uint32(blob) ? read_string() : NULL;
+   blob_copy_bytes(blob, (uint8_t *) &data, sizeof(data));
+
+   if (type == NULL || blob->overrun || data.mode >= ir_var_mode_count ||
+       (name == NULL && data.mode != ir_var_temporary &&
+        data.mode != ir_var_function_in && data.mode != ir_var_function_out &&
+        data.mode != ir_var_function_inout)) {
+      error = true;
+      return NULL;
+   }
+
+   ir_variable *var =
+      new(ir_mem_ctx) ir_variable(type, name, (ir_variable_mode) data.mode);
+   var->data = data;
+
+   /* Register the variable before reading its initializers, which can't
+    * refer to it but keep the numbering in sync with the writer.
+    */
+   add_ref(&variables, var);
+
+   const glsl_type *interface_type = read_type();
+   if (interface_type != NULL)
+      var->init_interface_type(interface_type);
+
+   if (var->is_interface_instance()) {
+      blob_copy_bytes(blob, (uint8_t *) var->get_max_ifc_array_access(),
+                      interface_type->length * sizeof(int));
+   } else {
+      uint32_t num_slots = blob_read_uint32(blob);
+
+      if (num_slots > (size_t) (blob->end - blob->current) / sizeof(ir_state_slot)) {
+         error = true;
+         return NULL;
+      }
+
+      if (num_slots) {
+         ir_state_slot *slots = var->allocate_state_slots(num_slots);
+         if (slots == NULL) {
+            error = true;
+            return NULL;
+         }
+         blob_copy_bytes(blob, (uint8_t *) slots,
+                         num_slots * sizeof(ir_state_slot));
+      } else {
+         var->set_num_state_slots(0);
+      }
+   }
+
+   if (blob_read_uint32(blob))
+      var->constant_value = read_constant();
+   if (blob_read_uint32(blob))
+      var->constant_initializer = read_constant();
+
+   return var;
+}
+
+ir_constant *
+ir_deserializer::read_constant()
+{
+   const glsl_type *type = read_type();
+
+   if (type == NULL || error)
+      return NULL;
+
+   if (type->is_array() || type->is_record()) {
+      exec_list values;
+
+      for (unsigned i = 0; i < type->length; i++) {
+         ir_constant *value = read_constant();
+         if (value == NULL) {
+            error = true;
+            return NULL;
+         }
+         values.push_tail(value);
+      }
+
+      return new(ir_mem_ctx) ir_constant(type, &values);
+   }
+
+   if (!type->is_scalar() && !type->is_vector() && !type->is_matrix()) {
+      error = true;
+      return NULL;
+   }
+
+   ir_constant_data data;
+   blob_copy_bytes(blob, (uint8_t *) &data, sizeof(data));
+   return new(ir_mem_ctx) ir_constant(type, &data);
+}
+
+/**
+ * Find the built-in signature a prototype was cloned from.
+ */
+static ir_function_signature *
+find_builtin_signature(const char *name, const glsl_type *return_type,
+                       const glsl_type **param_types, unsigned num_params)
+{
+   _mesa_glsl_initialize_builtin_functions();
+
+   ir_function *f = _mesa_glsl_find_builtin_function_by_name(name);
+   if (f == NULL)
+      return NULL;
+
+   foreach_in_list(ir_function_signature, sig, &f->signatures) {
+      if (sig->return_type != return_type)
+         continue;
+
+      unsigned i = 0;
+      foreach_in_list(ir_variable, param, &sig->parameters) {
+         if (i == num_params || param->type != param_types[i])
+            break;
+         i++;
+      }
+
+      if (i == num_params && i == sig->parameters.length())
+         return sig;
+   }
+
+   return NULL;
+}
+
+ir_function *
+ir_deserializer::read_function()
+{
+   const char *name = read_string();
+   ir_function *f = new(ir_mem_ctx) ir_function(name);
+
+   f->is_subroutine = blob_read_uint32(blob);
+   f->subroutine_index = blob_read_uint32(blob);
+   f->num_subroutine_types = blob_read_uint32(blob);
+
+   if (f->num_subroutine_types < 0 ||
+       (size_t) f->num_subroutine_types > (size_t) (blob->end - blob->current)) {
+      error = true;
+      return NULL;
+   }
+
+   f->subroutine_types =
+      ralloc_array(f, const glsl_type *, f->num_subroutine_types);
+   for (int i = 0; i < f->num_subroutine_types; i++)
+      f->subroutine_types[i] = read_type();
+
+   uint32_t num_signatures = blob_read_uint32(blob);
+   for (uint32_t i = 0; i < num_signatures && !error && !blob->overrun; i++) {
+      ir_function_signature *sig;
+      bool is_builtin = blob_read_uint32(blob);
+      const glsl_type *return_type = read_type();
+      bool is_defined = blob_read_uint32(blob);
+      bool is_intrinsic = blob_read_uint32(blob);
+      uint32_t num_params = blob_read_uint32(blob);
+
+      if (return_type == NULL ||
+          num_params > (size_t) (blob->end - blob->current)) {
+         error = true;
+         return NULL;
+      }
+
+      if (is_builtin) {
+         const glsl_type **param_types =
+            ralloc_array(mem_ctx, const glsl_type *, num_params);
+
+         for (unsigned j = 0; j < num_params; j++)
+            param_types[j] = read_type();
+
+         ir_function_signature *builtin =
+            find_builtin_signature(name, return_type, param_types, num_params);
+         if (builtin == NULL) {
+            error = true;
+            return NULL;
+         }
+
+         sig = builtin->clone_prototype(f, NULL);
+         foreach_in_list(ir_variable, param, &sig->parameters)
+            add_ref(&variables, param);
+      } else {
+         sig = new(f) ir_function_signature(return_type);
+
+         for (unsigned j = 0; j < num_params; j++) {
+            ir_variable *param = read_variable();
+            if (param == NULL) {
+               error = true;
+               return NULL;
+            }
+            sig->parameters.push_tail(param);
+         }
+      }
+
+      sig->is_defined = is_defined;
+      sig->is_intrinsic = is_intrinsic;
+      f->add_signature(sig);
+      add_ref(&signatures, sig);
+   }
+
+   return f;
+}
+
+ir_instruction *
+ir_deserializer::read_instruction()
+{
+   uint32_t ir_type = blob_read_uint32(blob);
+
+   if (error || blob->overrun || ir_type == IR_SERIALIZE_NULL)
+      return NULL;
+
+   switch (ir_type) {
+   case ir_type_dereference_array: {
+      ir_rvalue *array = read_rvalue(true);
+      ir_rvalue *index = read_rvalue(true);
+      if (failed())
+         return NULL;
+      return new(ir_mem_ctx) ir_dereference_array(array, index);
+   }
+   case ir_type_dereference_record: {
+      ir_rvalue *record = read_rvalue(true);
+      const char *field = read_string();
+      if (failed() ||
+          (!record->type->is_record() && !record->type->is_interface()) ||
+          record->type->field_index(field) < 0) {
+         error = true;
+         return NULL;
+      }
+      return new(ir_mem_ctx) ir_dereference_record(record, field);
+   }
+   case ir_type_dereference_variable: {
+      ir_variable *var = (ir_variable *) read_index(&variables);
+      if (var == NULL) {
+         error = true;
+         return NULL;
+      }
+      return new(ir_mem_ctx) ir_dereference_variable(var);
+   }
+   case ir_type_constant:
+      return read_constant();
+   case ir_type_expression: {
+      ir_rvalue *operands[4] = { NULL, NULL, NULL, NULL };
+      uint32_t operation = blob_read_uint32(blob);
+      const glsl_type *type = read_type();
+      uint32_t num_operands = blob_read_uint32(blob);
+
+      if (operation > ir_last_opcode || type == NULL ||
+          num_operands != ir_expression::get_num_operands((ir_expression_operation) operation)) {
+         error = true;
+         return NULL;
+      }
+
+      for (unsigned i = 0; i < num_operands; i++)
+         operands[i] = read_rvalue(true);
+      if (failed())
+         return NULL;
+
+      return new(ir_mem_ctx) ir_expression(operation, type,
+                                           operands[0], operands[1],
+                                           operands[2], operands[3]);
+   }
+   case ir_type_swizzle: {
+      ir_rvalue *val = read_rvalue(true);
+      uint32_t x = blob_read_uint32(blob);
+      uint32_t y = blob_read_uint32(blob);
+      uint32_t z = blob_read_uint32(blob);
+      uint32_t w = blob_read_uint32(blob);
+      uint32_t count = blob_read_uint32(blob);
+      if (failed() || x > 3 || y > 3 || z > 3 || w > 3 ||
+          count < 1 || count > 4) {
+         error = true;
+         return NULL;
+      }
+      return new(ir_mem_ctx) ir_swizzle(val, x, y, z, w, count);
+   }
+   case ir_type_texture: {
+      uint32_t op = blob_read_uint32(blob);
+      const glsl_type *type = read_type();
+
+      if (op > ir_samples_identical || type == NULL) {
+         error = true;
+         return NULL;
+      }
+
+      ir_texture *tex = new(ir_mem_ctx) ir_texture((ir_texture_opcode) op);
+      ir_dereference *sampler = read_dereference();
+      tex->coordinate = read_rvalue(false);
+      tex->projector = read_rvalue(false);
+      tex->shadow_comparitor = read_rvalue(false);
+      tex->offset = read_rvalue(false);
+      switch (op) {
+      case ir_txb:
+         tex->lod_info.bias = read_rvalue(true);
+         break;
+      case ir_txl:
+      case ir_txf:
+      case ir_txs:
+         tex->lod_info.lod = read_rvalue(true);
+         break;
+      case ir_txf_ms:
+         tex->lod_info.sample_index = read_rvalue(true);
+         break;
+      case ir_txd:
+         tex->lod_info.grad.dPdx = read_rvalue(true);
+         tex->lod_info.grad.dPdy = read_rvalue(true);
+         break;
+      case ir_tg4:
+         tex->lod_info.component = read_rvalue(true);
+         break;
+      default:
+         break;
+      }
+      if (failed())
+         return NULL;
+
+      tex->set_sampler(sampler, type);
+      return tex;
+   }
+   case ir_type_variable:
+      return read_variable();
+   case ir_type_assignment: {
+      ir_dereference *lhs = read_dereference();
+      ir_rvalue *rhs = read_rvalue(true);
+      ir_rvalue *condition = read_rvalue(false);
+      uint32_t write_mask = blob_read_uint32(blob);
+      if (failed())
+         return NULL;
+      if ((lhs->type->is_scalar() || lhs->type->is_vector()) &&
+          _mesa_bitcount(write_mask & 0xf) != rhs->type->vector_elements) {
+         error = true;
+         return NULL;
+      }
+      return new(ir_mem_ctx) ir_assignment(lhs, rhs, condition, write_mask);
+   }
+   case ir_type_call: {
+      ir_function_signature *callee =
+         (ir_function_signature *) read_index(&signatures);
+      ir_rvalue *return_deref = read_rvalue(false);
+      exec_list actual_parameters;
+      read_list(&actual_parameters);
+      ir_variable *sub_var = (ir_variable *) read_index(&variables);
+      ir_rvalue *array_idx = read_rvalue(false);
+
+      ir_dereference_variable *ret =
+         return_deref ? return_deref->as_dereference_variable() : NULL;
+
+      if (failed() || callee == NULL || (return_deref != NULL && ret == NULL)) {
+         error = true;
+         return NULL;
+      }
+
+      if (sub_var) {
+         return new(ir_mem_ctx) ir_call(callee, ret, &actual_parameters,
+                                        sub_var, array_idx);
+      }
+      return new(ir_mem_ctx) ir_call(callee, ret, &actual_parameters);
+   }
+   case ir_type_function:
+      return read_function();
+   case ir_type_if: {
+      ir_rvalue *condition = read_rvalue(true);
+      if (failed())
+         return NULL;
+      ir_if *iif = new(ir_mem_ctx) ir_if(condition);
+      read_list(&iif->then_instructions);
+      read_list(&iif->else_instructions);
+      return iif;
+   }
+   case ir_type_loop: {
+      ir_loop *loop = new(ir_mem_ctx) ir_loop();
+      read_list(&loop->body_instructions);
+      return loop;
+   }
+   case ir_type_loop_jump: {
+      uint32_t mode = blob_read_uint32(blob);
+      if (mode != ir_loop_jump::jump_break &&
+          mode != ir_loop_jump::jump_continue) {
+         error = true;
+         return NULL;
+      }
+      return new(ir_mem_ctx) ir_loop_jump((ir_loop_jump::jump_mode) mode);
+   }
+   case ir_type_return:
+      return new(ir_mem_ctx) ir_return(read_rvalue(false));
+   case ir_type_discard:
+      return new(ir_mem_ctx) ir_discard(read_rvalue(false));
+   case ir_type_emit_vertex: {
+      ir_rvalue *stream = read_rvalue(true);
+      if (failed())
+         return NULL;
+      return new(ir_mem_ctx) ir_emit_vertex(stream);
+   }
+   case ir_type_end_primitive: {
+      ir_rvalue *stream = read_rvalue(true);
+      if (failed())
+         return NULL;
+      return new(ir_mem_ctx) ir_end_primitive(stream);
+   }
+   case ir_type_barrier:
+      return new(ir_mem_ctx) ir_barrier();
+   default:
+      error = true;
+      return NULL;
+   }
+}
+
+bool
+ir_deserializer::read_ir(exec_list *ir)
+{
+   read_list(ir);
+
+   foreach_in_list(ir_instruction, node, ir) {
+      ir_function *f = node->as_function();
+      if (f == NULL)
+         continue;
+
+      foreach_in_list(ir_function_signature, sig, &f->signatures) {
+         if (!sig->is_builtin() && sig->is_defined)
+            read_list(&sig->body);
+      }
+   }
+
+   return !error && !blob->overrun;
+}
+
+
+extern "C" bool
+_mesa_glsl_serialize_shader(struct blob *blob, struct gl_shader *shader)
+{
+   blob_write_uint32(blob, shader->Stage);
+   blob_write_uint32(blob, shader->CompileStatus);
+   blob_write_uint32(blob, shader->Version);
+   blob_write_uint32(blob, shader->IsES);
+   blob_write_string(blob, shader->InfoLog ? shader->InfoLog : "");
+   blob_write_bytes(blob, &shader->info, sizeof(shader->info));
+
+   blob_write_uint32(blob, shader->ir != NULL);
+   if (shader->ir) {
+      ir_serializer s(blob);
+      if (!s.write_ir(shader->ir))
+         return false;
+   }
+
+   return !blob->out_of_memory;
+}
+
+extern "C" bool
+_mesa_glsl_deserialize_shader(struct blob_reader *blob,
+                              struct gl_shader *shader)
+{
+   uint32_t stage = blob_read_uint32(blob);
+   GLboolean compile_status = blob_read_uint32(blob);
+   unsigned version = blob_read_uint32(blob);
+   bool is_es = blob_read_uint32(blob);
+   const char *info_log = blob_read_string(blob);
+
+   ralloc_free(shader->ir);
+   shader->ir = NULL;
+   shader->symbols = NULL;
+   shader->CompileStatus = GL_FALSE;
+
+   if (blob->overrun || info_log == NULL || stage != shader->Stage)
+      return false;
+
+   blob_copy_bytes(blob, (uint8_t *) &shader->info, sizeof(shader->info));
+
+   if (blob_read_uint32(blob)) {
+      shader->ir = new(shader) exec_list;
+
+      ir_deserializer d(blob, shader->ir);
+      if (!d.read_ir(shader->ir)) {
+         ralloc_free(shader->ir);
+         shader->ir = NULL;
+         return false;
+      }
+
+      /* Like after compiling, the symbol table only holds the variables and
+       * functions that are in the IR.
+       */
+      shader->symbols = new(shader->ir) glsl_symbol_table;
+      foreach_in_list(ir_instruction, ir, shader->ir) {
+         if (ir->ir_type == ir_type_function) {
+            shader->symbols->add_function((ir_function *) ir);
+         } else if (ir->ir_type == ir_type_variable) {
+            ir_variable *const var = (ir_variable *) ir;
+
+            if (var->data.mode != ir_var_temporary)
+               shader->symbols->add_variable(var);
+         }
+      }
+   }
+
+   ralloc_free(shader->InfoLog);
+   shader->InfoLog = ralloc_strdup(shader, info_log);
+   shader->CompileStatus = compile_status;
+   shader->Version = version;
+   shader->IsES = is_es;
+
+   return !blob->overrun;
+}
@@ -0,0 +1,459 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file shader_cache.cpp
+ * On-disk cache of compiled shaders, and GL_PROGRAM_BINARY_FORMAT_MESA
+ * program binaries.
+ *
+ * Both store the compiled IR of shaders (see ir_serialize.cpp).  Cache
+ * entries are keyed by a SHA-1 of the shader source and of everything else
+ * compiling depends on (\c _mesa_glsl_compute_context_sha1), so a hit skips
+ * preprocessing, parsing and the compile-time optimizations.  Program
+ * binaries hold the latter hash and are rejected when it doesn't match.
+ * Linking isn't cached: loading a program binary links the shaders it holds
+ * again.
+ *
+ * The cache lives in $MESA_GLSL_CACHE_DIR, or else in
+ * $XDG_CACHE_HOME/mesa/glsl or $HOME/.cache/mesa/glsl.  Its size is limited
+ * to $MESA_GLSL_CACHE_MAX_SIZE megabytes (256 by default), and it is turned
+ * off by setting MESA_GLSL_CACHE_DISABLE.
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utility>
+
+#if defined(HAVE_DLADDR)
+#include <dlfcn.h>
+#include <sys/stat.h>
+#endif
+
+#include "c11/threads.h"
+#include "main/core.h"
+#include "main/shaderobj.h"
+#include "program/hash_table.h"
+#include "util/debug.h"
+#include "util/disk_cache.h"
+#include "util/mesa-sha1.h"
+#include "util/ralloc.h"
+#include "blob.h"
+#include "shader_cache.h"
+
+/* Bump when the serialized format changes. */
+#define SHADER_CACHE_VERSION 1
+
+#define PROGRAM_BINARY_MAGIC 0x4d505247  /* "GRPM" */
+
+
+/**
+ * Hash something identifying the Mesa build, so that cache entries and
+ * program binaries from other builds are never used.
+ */
+static void
+hash_build_id(struct mesa_sha1 *sha1)
+{
+   static const char version[] = "GLSL shader cache " PACKAGE_VERSION;
+   const unsigned format = SHADER_CACHE_VERSION;
+
+   _mesa_sha1_update(sha1, version, sizeof(version));
+   _mesa_sha1_update(sha1, &format, sizeof(format));
+
+#if defined(HAVE_DLADDR)
+   /* The version alone doesn't tell development builds apart, so also use
+    * the timestamp and size of the library we're in.  Unlike __DATE__ and
+    * __TIME__, this keeps the build itself reproducible.
+    */
+   Dl_info info;
+   struct stat st;
+
+   if (dladdr((void *) hash_build_id, &info) && info.dli_fname &&
+       stat(info.dli_fname, &st) == 0) {
+      const int64_t id[2] = { (int64_t) st.st_mtime, (int64_t) st.st_size };
+      _mesa_sha1_update(sha1, id, sizeof(id));
+   }
+#endif
+}
+
+
+extern "C" void
+_mesa_glsl_compute_context_sha1(struct gl_context *ctx,
+                                unsigned char sha1[20])
+{
+   struct mesa_sha1 *sha = _mesa_sha1_init();
+   struct gl_extensions *extensions;
+   struct gl_constants *consts;
+
+   if (sha == NULL) {
+      memset(sha1, 0, 20);
+      return;
+   }
+
+   hash_build_id(sha);
+
+   _mesa_sha1_update(sha, &ctx->API, sizeof(ctx->API));
+   _mesa_sha1_update(sha, &ctx->Version, sizeof(ctx->Version));
+   _mesa_sha1_update(sha, &ctx->_Shader->Flags, sizeof(ctx->_Shader->Flags));
+
+   /* The limits, options and extensions are plain values, except for a few
+    * pointers which must be left out.
+    */
+   extensions = (struct gl_extensions *) malloc(sizeof(*extensions));
+   consts = (struct gl_constants *) malloc(sizeof(*consts));
+   if (extensions && consts) {
+      memcpy(extensions, &ctx->Extensions, sizeof(*extensions));
+      extensions->String = NULL;
+      _mesa_sha1_update(sha, extensions, sizeof(*extensions));
+
+      memcpy(consts, &ctx->Const, sizeof(*consts));
+      for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
+         consts->ShaderCompilerOptions[i].NirOptions = NULL;
+      _mesa_sha1_update(sha, consts, sizeof(*consts));
+   }
+   free(extensions);
+   free(consts);
+
+   _mesa_sha1_final(sha, sha1);
+}
+
+
+static struct disk_cache *cache;
+static once_flag cache_once_flag = ONCE_FLAG_INIT;
+
+static void
+create_cache(void)
+{
+   const char *max_size_str;
+   uint64_t max_size = 256;
+
+   if (env_var_as_boolean("MESA_GLSL_CACHE_DISABLE", false))
+      return;
+
+   max_size_str = getenv("MESA_GLSL_CACHE_MAX_SIZE");
+   if (max_size_str)
+      max_size = strtoull(max_size_str, NULL, 10);
+
+   cache = disk_cache_create(getenv("MESA_GLSL_CACHE_DIR"), "glsl",
+                             max_size << 20);
+}
+
+static struct disk_cache *
+get_cache(void)
+{
+   call_once(&cache_once_flag, create_cache);
+   return cache;
+}
+
+static void
+compute_shader_key(struct gl_context *ctx, struct gl_shader *shader,
+                   unsigned char key[DISK_CACHE_KEY_SIZE])
+{
+   unsigned char ctx_sha1[20];
+   struct mesa_sha1 *sha;
+
+   _mesa_glsl_compute_context_sha1(ctx, ctx_sha1);
+
+   sha = _mesa_sha1_init();
+   _mesa_sha1_update(sha, ctx_sha1, sizeof(ctx_sha1));
+   _mesa_sha1_update(sha, &shader->Stage, sizeof(shader->Stage));
+   _mesa_sha1_update(sha, shader->Source, strlen(shader->Source));
+   _mesa_sha1_final(sha, key);
+}
+
+extern "C" bool
+_mesa_glsl_shader_cache_load(struct gl_context *ctx, struct gl_shader *shader)
+{
+   struct disk_cache *cache = get_cache();
+   unsigned char key[DISK_CACHE_KEY_SIZE];
+   struct blob_reader blob;
+   size_t size;
+   uint8_t *data;
+   bool ok;
+
+   if (cache == NULL)
+      return false;
+
+   compute_shader_key(ctx, shader, key);
+
+   data = (uint8_t *) disk_cache_get(cache, key, &size);
+   if (data == NULL)
+      return false;
+
+   blob_reader_init(&blob, data, size);
+   ok = _mesa_glsl_deserialize_shader(&blob, shader) &&
+        blob.current == blob.end;
+   free(data);
+
+   return ok;
+}
+
+extern "C" void
+_mesa_glsl_shader_cache_store(struct gl_context *ctx, struct gl_shader *shader)
+{
+   struct disk_cache *cache = get_cache();
+   unsigned char key[DISK_CACHE_KEY_SIZE];
+   struct blob *blob;
+
+   /* Failed compiles aren't worth caching. */
+   if (cache == NULL || !shader->CompileStatus)
+      return;
+
+   blob = blob_create(NULL);
+   if (blob == NULL)
+      return;
+
+   if (_mesa_glsl_serialize_shader(blob, shader)) {
+      compute_shader_key(ctx, shader, key);
+      disk_cache_put(cache, key, blob->data, blob->size);
+   }
+
+   ralloc_free(blob);
+}
+
+
+struct write_bindings_closure {
+   struct blob *blob;
+   uint32_t count;
+};
+
+static void
+write_binding(const char *name, unsigned value, void *closure)
+{
+   struct write_bindings_closure *c = (struct write_bindings_closure *) closure;
+
+   blob_write_string(c->blob, name);
+   blob_write_uint32(c->blob, value);
+   c->count++;
+}
+
+static void
+write_bindings(struct blob *blob, struct string_to_uint_map *bindings)
+{
+   struct write_bindings_closure c = { blob, 0 };
+   size_t offset;
+
+   blob_write_uint32(blob, 0);
+   offset = blob->size - sizeof(uint32_t);
+   bindings->iterate(write_binding, &c);
+   blob_overwrite_uint32(blob, offset, c.count);
+}
+
+static bool
+read_bindings(struct blob_reader *blob, struct string_to_uint_map *bindings)
+{
+   uint32_t count = blob_read_uint32(blob);
+
+   for (uint32_t i = 0; i < count && !blob->overrun; i++) {
+      const char *name = blob_read_string(blob);
+      uint32_t value = blob_read_uint32(blob);
+
+      if (name == NULL || value == UINT_MAX)
+         return false;
+      bindings->put(value, name);
+   }
+
+   return !blob->overrun;
+}
+
+static bool
+is_shader_type(GLenum type)
+{
+   switch (type) {
+   case GL_VERTEX_SHADER:
+   case GL_FRAGMENT_SHADER:
+   case GL_GEOMETRY_SHADER:
+   case GL_TESS_CONTROL_SHADER:
+   case GL_TESS_EVALUATION_SHADER:
+   case GL_COMPUTE_SHADER:
+      return true;
+   default:
+      return false;
+   }
+}
+
+/**
+ * Program binaries are made of a header (magic number, context hash and a
+ * checksum of the rest) followed by the pre-link state of the program and
+ * its serialized shaders.
+ */
+extern "C" bool
+_mesa_glsl_serialize_program(struct gl_context *ctx, struct blob *blob,
+                             struct gl_shader_program *prog)
+{
+   unsigned char sha1[20];
+   size_t checksum_offset, start;
+
+   _mesa_glsl_compute_context_sha1(ctx, sha1);
+
+   blob_write_uint32(blob, PROGRAM_BINARY_MAGIC);
+   blob_write_bytes(blob, sha1, sizeof(sha1));
+   checksum_offset = blob->size;
+   blob_write_bytes(blob, sha1, sizeof(sha1));
+   start = blob->size;
+
+   blob_write_uint32(blob, prog->SeparateShader);
+   write_bindings(blob, prog->AttributeBindings);
+   write_bindings(blob, prog->FragDataBindings);
+   write_bindings(blob, prog->FragDataIndexBindings);
+
+   blob_write_uint32(blob, prog->TransformFeedback.BufferMode);
+   blob_write_uint32(blob, prog->TransformFeedback.NumVarying);
+   for (unsigned i = 0; i < prog->TransformFeedback.NumVarying; i++)
+      blob_write_string(blob, prog->TransformFeedback.VaryingNames[i]);
+
+   blob_write_uint32(blob, prog->NumShaders);
+   for (unsigned i = 0; i < prog->NumShaders; i++) {
+      struct gl_shader *sh = prog->Shaders[i];
+
+      if (!sh->CompileStatus || sh->ir == NULL)
+         return false;
+
+      blob_write_uint32(blob, sh->Type);
+      if (!_mesa_glsl_serialize_shader(blob, sh))
+         return false;
+   }
+
+   if (blob->out_of_memory)
+      return false;
+
+   _mesa_sha1_compute(blob->data + start, blob->size - start, sha1);
+   blob_overwrite_bytes(blob, checksum_offset, sha1, sizeof(sha1));
+
+   return true;
+}
+
+extern "C" bool
+_mesa_glsl_deserialize_program(struct gl_context *ctx,
+                               struct blob_reader *blob,
+                               struct gl_shader_program *prog,
+                               struct gl_shader ***shaders_out,
+                               unsigned *num_shaders_out)
+{
+   unsigned char ctx_sha1[20], sha1[20], checksum[20];
+   struct string_to_uint_map *bindings[3];
+   struct gl_shader **shaders = NULL;
+   char **varyings = NULL;
+   uint32_t num_varyings = 0, num_shaders = 0;
+   GLboolean separate;
+   GLenum buffer_mode;
+   bool ok = false;
+   unsigned i;
+
+   if (blob_read_uint32(blob) != PROGRAM_BINARY_MAGIC)
+      return false;
+
+   _mesa_glsl_compute_context_sha1(ctx, ctx_sha1);
+   blob_copy_bytes(blob, sha1, sizeof(sha1));
+   blob_copy_bytes(blob, checksum, sizeof(checksum));
+   if (blob->overrun || memcmp(sha1, ctx_sha1, sizeof(sha1)) != 0)
+      return false;
+
+   _mesa_sha1_compute(blob->current, blob->end - blob->current, sha1);
+   if (memcmp(sha1, checksum, sizeof(sha1)) != 0)
+      return false;
+
+   for (i = 0; i < ARRAY_SIZE(bindings); i++)
+      bindings[i] = new string_to_uint_map;
+
+   separate = blob_read_uint32(blob);
+   for (i = 0; i < ARRAY_SIZE(bindings); i++) {
+      if (!read_bindings(blob, bindings[i]))
+         goto out;
+   }
+
+   buffer_mode = blob_read_uint32(blob);
+   num_varyings = blob_read_uint32(blob);
+   if (blob->overrun || num_varyings > (size_t) (blob->end - blob->current))
+      goto out;
+
+   varyings = (char **) calloc(num_varyings, sizeof(char *));
+   for (i = 0; i < num_varyings; i++) {
+      const char *name = blob_read_string(blob);
+      if (name == NULL || varyings == NULL)
+         goto out;
+      varyings[i] = strdup(name);
+   }
+
+   num_shaders = blob_read_uint32(blob);
+   if (blob->overrun || num_shaders > (size_t) (blob->end - blob->current))
+      goto out;
+
+   shaders = rzalloc_array(NULL, struct gl_shader *, num_shaders);
+   for (i = 0; i < num_shaders; i++) {
+      GLenum type = blob_read_uint32(blob);
+
+      if (shaders == NULL || !is_shader_type(type))
+         goto out;
+
+      shaders[i] = _mesa_new_shader(0, _mesa_shader_enum_to_shader_stage(type));
+      if (shaders[i] == NULL)
+         goto out;
+      shaders[i]->Type = type;
+
+      if (!_mesa_glsl_deserialize_shader(blob, shaders[i]) ||
+          !shaders[i]->CompileStatus)
+         goto out;
+   }
+
+   if (blob->overrun || blob->current != blob->end)
+      goto out;
+
+   /* Everything was read, replace the pre-link state of the program. */
+   prog->SeparateShader = separate;
+   std::swap(prog->AttributeBindings, bindings[0]);
+   std::swap(prog->FragDataBindings, bindings[1]);
+   std::swap(prog->FragDataIndexBindings, bindings[2]);
+
+   for (i = 0; i < prog->TransformFeedback.NumVarying; i++)
+      free(prog->TransformFeedback.VaryingNames[i]);
+   free(prog->TransformFeedback.VaryingNames);
+   prog->TransformFeedback.VaryingNames = varyings;
+   prog->TransformFeedback.NumVarying = num_varyings;
+   prog->TransformFeedback.BufferMode = buffer_mode;
+   varyings = NULL;
+   num_varyings = 0;
+
+   *shaders_out = shaders;
+   *num_shaders_out = num_shaders;
+   shaders = NULL;
+   ok = true;
+
+out:
+   for (i = 0; i < ARRAY_SIZE(bindings); i++)
+      delete bindings[i];
+
+   if (varyings) {
+      for (i = 0; i < num_varyings; i++)
+         free(varyings[i]);
+      free(varyings);
+   }
+
+   if (shaders) {
+      for (i = 0; i < num_shaders; i++)
+         _mesa_reference_shader(ctx, &shaders[i], NULL);
+      ralloc_free(shaders);
+   }
+
+   return ok;
+}
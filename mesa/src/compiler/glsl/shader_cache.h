@@ -0,0 +1,112 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+#ifndef GLSL_SHADER_CACHE_H
+#define GLSL_SHADER_CACHE_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct blob;
+struct blob_reader;
+struct gl_context;
+struct gl_shader;
+struct gl_shader_program;
+
+/**
+ * Serialize the result of compiling \c shader (its IR, compile status, info
+ * log and layout qualifier state) into \c blob.
+ *
+ * \return false if the IR contains something that can't be serialized.
+ */
+extern bool
+_mesa_glsl_serialize_shader(struct blob *blob, struct gl_shader *shader);
+
+/**
+ * Restore a shader serialized by \c _mesa_glsl_serialize_shader, replacing
+ * the current compile result of \c shader, which must be of the same stage.
+ *
+ * \return false if the data is malformed, in which case \c shader is left
+ * uncompiled.
+ */
+extern bool
+_mesa_glsl_deserialize_shader(struct blob_reader *blob,
+                              struct gl_shader *shader);
+
+/**
+ * Compute a hash of everything besides the source that affects the result
+ * of compiling a shader in \c ctx: the Mesa build, the API and the driver's
+ * limits, options and extensions.
+ */
+extern void
+_mesa_glsl_compute_context_sha1(struct gl_context *ctx,
+                                unsigned char sha1[20]);
+
+/**
+ * Look \c shader up in the on-disk shader cache and, if found, restore the
+ * cached compile result.
+ *
+ * \return true on a cache hit.
+ */
+extern bool
+_mesa_glsl_shader_cache_load(struct gl_context *ctx, struct gl_shader *shader);
+
+/**
+ * Add the result of compiling \c shader to the on-disk shader cache.
+ */
+extern void
+_mesa_glsl_shader_cache_store(struct gl_context *ctx, struct gl_shader *shader);
+
+/**
+ * Serialize the state \c prog is linked from (the compiled attached shaders
+ * plus the pre-link bindings) as a GL_PROGRAM_BINARY_FORMAT_MESA binary.
+ */
+extern bool
+_mesa_glsl_serialize_program(struct gl_context *ctx, struct blob *blob,
+                             struct gl_shader_program *prog);
+
+/**
+ * Restore the pre-link state of \c prog from a binary written by
+ * \c _mesa_glsl_serialize_program, and create the shaders it is to be linked
+ * from.  The returned array is ralloc'ed and its shaders hold one reference
+ * each.
+ *
+ * \return false if the binary is malformed or was produced by a different
+ * Mesa build or context configuration.
+ */
+extern bool
+_mesa_glsl_deserialize_program(struct gl_context *ctx,
+                               struct blob_reader *blob,
+                               struct gl_shader_program *prog,
+                               struct gl_shader ***shaders,
+                               unsigned *num_shaders);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* GLSL_SHADER_CACHE_H */
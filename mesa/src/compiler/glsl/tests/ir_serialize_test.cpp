@@ -0,0 +1,345 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string>
+#include "main/compiler.h"
+#include "main/mtypes.h"
+#include "main/macros.h"
+#include "util/ralloc.h"
+#include "program/prog_instruction.h"
+#include "ir.h"
+#include "ir_hierarchical_visitor.h"
+#include "blob.h"
+#include "shader_cache.h"
+#include "standalone_scaffolding.h"
+
+/**
+ * \file ir_serialize_test.cpp
+ *
+ * Round-trip shaders through _mesa_glsl_serialize_shader and
+ * _mesa_glsl_deserialize_shader.
+ */
+
+class ir_serialize : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   ir_variable *add_variable(const glsl_type *type, const char *name,
+                             ir_variable_mode mode);
+   void build_all_ir_types();
+   bool round_trip();
+
+   void *mem_ctx;
+   struct gl_shader *shader;
+   struct gl_shader *copy;
+};
+
+void
+ir_serialize::SetUp()
+{
+   this->mem_ctx = ralloc_context(NULL);
+
+   this->shader = _mesa_new_shader(0, MESA_SHADER_VERTEX);
+   this->shader->ir = new(this->shader) exec_list;
+   this->shader->CompileStatus = GL_TRUE;
+   this->shader->Version = 150;
+
+   this->copy = _mesa_new_shader(0, MESA_SHADER_VERTEX);
+}
+
+void
+ir_serialize::TearDown()
+{
+   ralloc_free(this->copy);
+   this->copy = NULL;
+   ralloc_free(this->shader);
+   this->shader = NULL;
+   ralloc_free(this->mem_ctx);
+   this->mem_ctx = NULL;
+}
+
+ir_variable *
+ir_serialize::add_variable(const glsl_type *type, const char *name,
+                           ir_variable_mode mode)
+{
+   ir_variable *var = new(shader->ir) ir_variable(type, name, mode);
+   shader->ir->push_tail(var);
+   return var;
+}
+
+/**
+ * Build a shader that uses every kind of IR node.  Each variable has its own
+ * name, so that printing the IR doesn't make up names.
+ */
+void
+ir_serialize::build_all_ir_types()
+{
+   void *ctx = shader->ir;
+
+   const glsl_struct_field fields[] = {
+      glsl_struct_field(glsl_type::vec4_type, "a"),
+      glsl_struct_field(glsl_type::int_type, "b"),
+   };
+   const glsl_type *record =
+      glsl_type::get_record_instance(fields, ARRAY_SIZE(fields), "S");
+   const glsl_type *array = glsl_type::get_array_instance(record, 3);
+
+   ir_variable *s = add_variable(array, "s", ir_var_uniform);
+   ir_variable *tex = add_variable(glsl_type::sampler2D_type, "tex",
+                                   ir_var_uniform);
+   ir_variable *in = add_variable(glsl_type::vec2_type, "in_coord",
+                                  ir_var_shader_in);
+   ir_variable *out = add_variable(glsl_type::vec4_type, "out_color",
+                                   ir_var_shader_out);
+   out->data.location = VARYING_SLOT_VAR0;
+   out->data.explicit_location = true;
+
+   ir_variable *k = add_variable(glsl_type::float_type, "k", ir_var_auto);
+   k->data.read_only = true;
+   k->constant_value = new(ctx) ir_constant(0.5f);
+   k->constant_initializer = new(ctx) ir_constant(0.5f);
+
+   /* float f(float p) { return p; } */
+   ir_function *f = new(ctx) ir_function("f");
+   ir_function_signature *f_sig =
+      new(ctx) ir_function_signature(glsl_type::float_type);
+   ir_variable *p = new(ctx) ir_variable(glsl_type::float_type, "p",
+                                         ir_var_function_in);
+   f_sig->parameters.push_tail(p);
+   f_sig->body.push_tail(new(ctx) ir_return(new(ctx)
+                                            ir_dereference_variable(p)));
+   f_sig->is_defined = true;
+   f->add_signature(f_sig);
+   shader->ir->push_tail(f);
+
+   ir_function *main_f = new(ctx) ir_function("main");
+   ir_function_signature *main_sig =
+      new(ctx) ir_function_signature(glsl_type::void_type);
+   main_sig->is_defined = true;
+   main_f->add_signature(main_sig);
+   shader->ir->push_tail(main_f);
+   exec_list *body = &main_sig->body;
+
+   ir_variable *color = new(ctx) ir_variable(glsl_type::vec4_type, "color",
+                                             ir_var_auto);
+   ir_variable *r = new(ctx) ir_variable(glsl_type::float_type, "r",
+                                         ir_var_auto);
+   body->push_tail(color);
+   body->push_tail(r);
+
+   /* color = texture(tex, in_coord) + s[1].a; */
+   ir_texture *sample = new(ctx) ir_texture(ir_tex);
+   sample->set_sampler(new(ctx) ir_dereference_variable(tex),
+                       glsl_type::vec4_type);
+   sample->coordinate = new(ctx) ir_dereference_variable(in);
+
+   ir_dereference_array *element =
+      new(ctx) ir_dereference_array(s, new(ctx) ir_constant(1));
+   ir_dereference_record *field =
+      new(ctx) ir_dereference_record(element, "a");
+
+   body->push_tail(
+      new(ctx) ir_assignment(new(ctx) ir_dereference_variable(color),
+                             new(ctx) ir_expression(ir_binop_add,
+                                                    glsl_type::vec4_type,
+                                                    sample, field)));
+
+   /* color.x = textureLod(tex, in_coord, k).y; */
+   ir_texture *lod = new(ctx) ir_texture(ir_txl);
+   lod->set_sampler(new(ctx) ir_dereference_variable(tex),
+                    glsl_type::vec4_type);
+   lod->coordinate = new(ctx) ir_dereference_variable(in);
+   lod->lod_info.lod = new(ctx) ir_dereference_variable(k);
+
+   body->push_tail(
+      new(ctx) ir_assignment(new(ctx) ir_dereference_variable(color),
+                             new(ctx) ir_swizzle(lod, 1, 0, 0, 0, 1),
+                             NULL, WRITEMASK_X));
+
+   /* r = f(color.w); */
+   exec_list params;
+   params.push_tail(new(ctx) ir_swizzle(new(ctx)
+                                        ir_dereference_variable(color),
+                                        3, 0, 0, 0, 1));
+   body->push_tail(new(ctx) ir_call(f_sig,
+                                    new(ctx) ir_dereference_variable(r),
+                                    &params));
+
+   /* if (r < 0.0) discard; else out_color = color; */
+   ir_if *iif =
+      new(ctx) ir_if(new(ctx) ir_expression(ir_binop_less,
+                                            new(ctx) ir_dereference_variable(r),
+                                            new(ctx) ir_constant(0.0f)));
+   iif->then_instructions.push_tail(new(ctx) ir_discard());
+   iif->else_instructions.push_tail(
+      new(ctx) ir_assignment(new(ctx) ir_dereference_variable(out),
+                             new(ctx) ir_dereference_variable(color)));
+   body->push_tail(iif);
+
+   /* loop { if (r < 1.0) break; continue; } */
+   ir_loop *loop = new(ctx) ir_loop();
+   ir_if *exit =
+      new(ctx) ir_if(new(ctx) ir_expression(ir_binop_less,
+                                            new(ctx) ir_dereference_variable(r),
+                                            new(ctx) ir_constant(1.0f)));
+   exit->then_instructions.push_tail(
+      new(ctx) ir_loop_jump(ir_loop_jump::jump_break));
+   loop->body_instructions.push_tail(exit);
+   loop->body_instructions.push_tail(
+      new(ctx) ir_loop_jump(ir_loop_jump::jump_continue));
+   body->push_tail(loop);
+
+   body->push_tail(new(ctx) ir_emit_vertex(new(ctx) ir_constant(0)));
+   body->push_tail(new(ctx) ir_end_primitive(new(ctx) ir_constant(0)));
+   body->push_tail(new(ctx) ir_barrier());
+   body->push_tail(new(ctx) ir_return());
+}
+
+/**
+ * Serialize the shader and read it back into the copy.
+ */
+bool
+ir_serialize::round_trip()
+{
+   struct blob *blob = blob_create(mem_ctx);
+   struct blob_reader reader;
+
+   if (!_mesa_glsl_serialize_shader(blob, shader))
+      return false;
+
+   blob_reader_init(&reader, blob->data, blob->size);
+   return _mesa_glsl_deserialize_shader(&reader, copy) &&
+          reader.current == reader.end;
+}
+
+static std::string
+print_ir(exec_list *ir)
+{
+   std::string result;
+   char buf[256];
+   size_t len;
+   FILE *f = tmpfile();
+
+   if (f == NULL)
+      return result;
+
+   _mesa_print_ir(f, ir, NULL);
+
+   rewind(f);
+   while ((len = fread(buf, 1, sizeof(buf), f)) != 0)
+      result.append(buf, len);
+   fclose(f);
+
+   return result;
+}
+
+static void
+record_ir_type(ir_instruction *ir, void *data)
+{
+   bool *seen = (bool *) data;
+   seen[ir->ir_type] = true;
+}
+
+TEST_F(ir_serialize, every_ir_type)
+{
+   build_all_ir_types();
+
+   ASSERT_TRUE(round_trip());
+   ASSERT_TRUE(copy->ir != NULL);
+
+   bool seen[ir_type_max] = { false };
+   foreach_in_list(ir_instruction, ir, copy->ir)
+      visit_tree(ir, record_ir_type, seen);
+
+   for (unsigned i = 0; i < ir_type_max; i++)
+      EXPECT_TRUE(seen[i]) << "ir_type " << i << " not round-tripped";
+
+   std::string printed = print_ir(shader->ir);
+   EXPECT_FALSE(printed.empty());
+   EXPECT_EQ(printed, print_ir(copy->ir));
+}
+
+TEST_F(ir_serialize, shader_state)
+{
+   shader->info.TransformFeedback.BufferStride[0] = 16;
+   shader->InfoLog = ralloc_strdup(shader, "warning");
+
+   ASSERT_TRUE(round_trip());
+
+   EXPECT_EQ(GL_TRUE, copy->CompileStatus);
+   EXPECT_EQ(150u, copy->Version);
+   EXPECT_EQ(16u, copy->info.TransformFeedback.BufferStride[0]);
+   EXPECT_STREQ("warning", copy->InfoLog);
+   EXPECT_TRUE(copy->ir != NULL);
+   EXPECT_TRUE(copy->ir->is_empty());
+}
+
+TEST_F(ir_serialize, variable_data)
+{
+   build_all_ir_types();
+
+   ASSERT_TRUE(round_trip());
+
+   ir_variable *out = NULL;
+   ir_variable *k = NULL;
+   foreach_in_list(ir_instruction, ir, copy->ir) {
+      ir_variable *var = ir->as_variable();
+      if (var == NULL)
+         continue;
+      if (strcmp(var->name, "out_color") == 0)
+         out = var;
+      else if (strcmp(var->name, "k") == 0)
+         k = var;
+   }
+
+   ASSERT_TRUE(out != NULL);
+   EXPECT_EQ(ir_var_shader_out, out->data.mode);
+   EXPECT_EQ(VARYING_SLOT_VAR0, out->data.location);
+   EXPECT_TRUE(out->data.explicit_location);
+
+   ASSERT_TRUE(k != NULL);
+   ASSERT_TRUE(k->constant_value != NULL);
+   EXPECT_EQ(0.5f, k->constant_value->value.f[0]);
+   ASSERT_TRUE(k->constant_initializer != NULL);
+   EXPECT_EQ(0.5f, k->constant_initializer->value.f[0]);
+}
+
+TEST_F(ir_serialize, truncated)
+{
+   build_all_ir_types();
+
+   struct blob *blob = blob_create(mem_ctx);
+   ASSERT_TRUE(_mesa_glsl_serialize_shader(blob, shader));
+
+   /* Every proper prefix of the blob has to be rejected. */
+   for (size_t size = 0; size < blob->size; size++) {
+      struct blob_reader reader;
+
+      blob_reader_init(&reader, blob->data, size);
+      EXPECT_FALSE(_mesa_glsl_deserialize_shader(&reader, copy))
+         << "accepted " << size << " of " << blob->size << " bytes";
+      EXPECT_TRUE(copy->ir == NULL);
+   }
+}
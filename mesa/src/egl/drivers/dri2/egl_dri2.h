@@ -265,6 +265,9 @@ struct dri2_egl_surface
    int                    dy;
    struct wl_callback    *throttle_callback;
    int			  format;
+   /* for swrast: damage passed to the swap currently in progress */
+   const EGLint          *swrast_damage_rects;
+   EGLint                 swrast_n_damage_rects;
 #endif
 
 #ifdef HAVE_DRM_PLATFORM
@@ -282,6 +285,9 @@ struct dri2_egl_surface
       /* for swrast */
       void *data;
       int data_size;
+      /* for swrast: x0, y0, x1, y1 of the area that lags behind the last
+       * presented frame */
+      int stale[4];
 #endif
 #ifdef HAVE_DRM_PLATFORM
       struct gbm_bo       *bo;
@@ -1463,6 +1463,11 @@ swrast_update_buffers(struct dri2_egl_surface *dri2_surf)
                                 dri2_dpy->wl_queue);
              wl_buffer_add_listener(dri2_surf->back->wl_buffer,
                                     &wl_buffer_listener, dri2_surf);
+             /* a fresh buffer has none of the presented content yet */
+             dri2_surf->back->stale[0] = 0;
+             dri2_surf->back->stale[1] = 0;
+             dri2_surf->back->stale[2] = dri2_surf->base.Width;
+             dri2_surf->back->stale[3] = dri2_surf->base.Height;
              break;
          }
       }
@@ -1509,8 +1514,97 @@ dri2_wl_swrast_get_backbuffer_data(struct dri2_egl_surface *dri2_surf)
    return dri2_surf->back->data;
 }
 
+static EGLBoolean
+swrast_box_is_empty(const int *box)
+{
+   return box[0] >= box[2] || box[1] >= box[3];
+}
+
+static void
+swrast_box_union(int *box, const int *other)
+{
+   if (swrast_box_is_empty(other))
+      return;
+
+   if (swrast_box_is_empty(box)) {
+      memcpy(box, other, 4 * sizeof(int));
+      return;
+   }
+
+   box[0] = MIN2(box[0], other[0]);
+   box[1] = MIN2(box[1], other[1]);
+   box[2] = MAX2(box[2], other[2]);
+   box[3] = MAX2(box[3], other[3]);
+}
+
+static void
+swrast_box_intersect(int *box, const int *other)
+{
+   box[0] = MAX2(box[0], other[0]);
+   box[1] = MAX2(box[1], other[1]);
+   box[2] = MIN2(box[2], other[2]);
+   box[3] = MIN2(box[3], other[3]);
+}
+
+static EGLBoolean
+swrast_box_contains(const int *box, const int *other)
+{
+   return swrast_box_is_empty(other) ||
+          (box[0] <= other[0] && box[1] <= other[1] &&
+           box[2] >= other[2] && box[3] >= other[3]);
+}
+
+/**
+ * Copy the pixels covered by box from src, whose first pixel sits at
+ * (src_x, src_y) in surface coordinates, to the same place in dst.
+ */
+static void
+swrast_copy_box(char *dst, int dst_stride,
+                const char *src, int src_stride, int src_x, int src_y,
+                int cpp, const int *box)
+{
+   int copy_width = (box[2] - box[0]) * cpp;
+   int y;
+
+   if (swrast_box_is_empty(box))
+      return;
+
+   dst += box[1] * dst_stride + box[0] * cpp;
+   src += (box[1] - src_y) * src_stride + (box[0] - src_x) * cpp;
+
+   for (y = box[1]; y < box[3]; y++) {
+      memcpy(dst, src, copy_width);
+      src += src_stride;
+      dst += dst_stride;
+   }
+}
+
+/**
+ * Bounding box, in top-down surface coordinates, of the damage passed to
+ * eglSwapBuffersWithDamage() for the swap in progress.
+ */
+static void
+swrast_get_damage_box(struct dri2_egl_surface *dri2_surf, int *box)
+{
+   int i;
+
+   box[0] = box[1] = box[2] = box[3] = 0;
+
+   for (i = 0; i < dri2_surf->swrast_n_damage_rects; i++) {
+      const EGLint *rect = &dri2_surf->swrast_damage_rects[i * 4];
+      int rect_box[4];
+
+      rect_box[0] = rect[0];
+      rect_box[1] = dri2_surf->base.Height - rect[1] - rect[3];
+      rect_box[2] = rect[0] + rect[2];
+      rect_box[3] = dri2_surf->base.Height - rect[1];
+      swrast_box_union(box, rect_box);
+   }
+}
+
 static void
-dri2_wl_swrast_commit_backbuffer(struct dri2_egl_surface *dri2_surf)
+dri2_wl_swrast_commit_backbuffer(struct dri2_egl_surface *dri2_surf,
+                                 const int *damage)
 {
    struct dri2_egl_display *dri2_dpy = dri2_egl_display(dri2_surf->base.Resource.Display);
 
@@ -1536,8 +1630,18 @@ dri2_wl_swrast_commit_backbuffer(struct dri2_egl_surface *dri2_surf)
    dri2_surf->dx = 0;
    dri2_surf->dy = 0;
 
-   wl_surface_damage(dri2_surf->wl_win->surface,
-                     0, 0, INT32_MAX, INT32_MAX);
+   if (!swrast_box_is_empty(damage)) {
+      const EGLint rect[4] = {
+         damage[0], dri2_surf->base.Height - damage[3],
+         damage[2] - damage[0], damage[3] - damage[1]
+      };
+
+      /* See dri2_wl_swap_buffers_with_damage() for why there is no
+       * wl_surface_damage() of just the rectangle. */
+      if (!try_damage_buffer(dri2_surf, rect, 1))
+         wl_surface_damage(dri2_surf->wl_win->surface,
+                           0, 0, INT32_MAX, INT32_MAX);
+   }
    wl_surface_commit(dri2_surf->wl_win->surface);
 
    /* If we're not waiting for a frame callback then we'll at least throttle
@@ -1606,45 +1710,69 @@ dri2_wl_swrast_get_image(__DRIdrawable * read,
    }
 }
 
+/**
+ * Only the part of the shm back buffer that differs from the frame being
+ * presented is written: what changed in this swap, plus whatever the back
+ * buffer missed while other buffers were on screen.  With
+ * eglSwapBuffersWithDamage() and buffer age this keeps the per-frame copy
+ * proportional to the damage instead of the surface size.
+ */
 static void
 dri2_wl_swrast_put_image2(__DRIdrawable * draw, int op,
                          int x, int y, int w, int h, int stride,
                          char *data, void *loaderPrivate)
 {
    struct dri2_egl_surface *dri2_surf = loaderPrivate;
-   int copy_width = dri2_wl_swrast_get_stride_for_format(dri2_surf->format, w);
+   int cpp = dri2_wl_swrast_get_stride_for_format(dri2_surf->format, 1);
    int dst_stride = dri2_wl_swrast_get_stride_for_format(dri2_surf->format, dri2_surf->base.Width);
-   int x_offset = dri2_wl_swrast_get_stride_for_format(dri2_surf->format, x);
-   char *src, *dst;
+   int src_box[4], update[4], copy[4];
+   char *dst, *front;
+   int i;
 
-   assert(copy_width <= stride);
+   assert(cpp * w <= stride);
 
-   (void) swrast_update_buffers(dri2_surf);
+   if (swrast_update_buffers(dri2_surf) < 0)
+      return;
    dst = dri2_wl_swrast_get_backbuffer_data(dri2_surf);
 
-   /* partial copy, copy old content */
-   if (copy_width < dst_stride)
-      dri2_wl_swrast_get_image(draw, 0, 0,
-                               dri2_surf->base.Width, dri2_surf->base.Height,
-                               dst, loaderPrivate);
+   /* drivers expect we do these checks (and some rely on it) */
+   src_box[0] = x;
+   src_box[1] = y;
+   src_box[2] = MIN2(x + w, dri2_surf->base.Width);
+   src_box[3] = MIN2(y + h, dri2_surf->base.Height);
 
-   dst += x_offset;
-   dst += y * dst_stride;
+   /* the application promised nothing outside the damage changed */
+   memcpy(update, src_box, sizeof(update));
+   if (dri2_surf->swrast_n_damage_rects > 0) {
+      int damage[4];
 
-   src = data;
+      swrast_get_damage_box(dri2_surf, damage);
+      swrast_box_intersect(update, damage);
+   }
 
-   /* drivers expect we do these checks (and some rely on it) */
-   if (copy_width > dst_stride-x_offset)
-      copy_width = dst_stride-x_offset;
-   if (h > dri2_surf->base.Height-y)
-      h = dri2_surf->base.Height-y;
+   memcpy(copy, dri2_surf->back->stale, sizeof(copy));
+   swrast_box_union(copy, update);
 
-   for (; h>0; h--) {
-      memcpy(dst, src, copy_width);
-      src += stride;
-      dst += dst_stride;
+   if (swrast_box_contains(src_box, copy)) {
+      swrast_copy_box(dst, dst_stride, data, stride, x, y, cpp, copy);
+   } else {
+      /* partial copy, bring the stale area up to date from the front */
+      front = dri2_wl_swrast_get_frontbuffer_data(dri2_surf);
+      if (front && front != dst)
+         swrast_copy_box(dst, dst_stride, front, dst_stride, 0, 0, cpp,
+                         dri2_surf->back->stale);
+      swrast_copy_box(dst, dst_stride, data, stride, x, y, cpp, update);
+   }
+
+   /* every other buffer now lags behind by this update */
+   memset(dri2_surf->back->stale, 0, sizeof(dri2_surf->back->stale));
+   for (i = 0; i < ARRAY_SIZE(dri2_surf->color_buffers); i++) {
+      if (&dri2_surf->color_buffers[i] != dri2_surf->back &&
+          dri2_surf->color_buffers[i].data)
+         swrast_box_union(dri2_surf->color_buffers[i].stale, update);
    }
-   dri2_wl_swrast_commit_backbuffer(dri2_surf);
+
+   dri2_wl_swrast_commit_backbuffer(dri2_surf, update);
 }
 
 static void
@@ -1722,15 +1850,50 @@ dri2_wl_swrast_create_window_surface(_EGLDriver *drv, _EGLDisplay *disp,
 }
 
 static EGLBoolean
-dri2_wl_swrast_swap_buffers(_EGLDriver *drv, _EGLDisplay *disp, _EGLSurface *draw)
+dri2_wl_swrast_swap_buffers_with_damage(_EGLDriver *drv,
+                                        _EGLDisplay *disp,
+                                        _EGLSurface *draw,
+                                        const EGLint *rects,
+                                        EGLint n_rects)
 {
    struct dri2_egl_display *dri2_dpy = dri2_egl_display(disp);
    struct dri2_egl_surface *dri2_surf = dri2_egl_surface(draw);
 
+   /* the driver presents synchronously through putImage, which picks the
+    * damage up from the surface */
+   dri2_surf->swrast_damage_rects = rects;
+   dri2_surf->swrast_n_damage_rects = n_rects;
+
    dri2_dpy->core->swapBuffers(dri2_surf->dri_drawable);
+
+   dri2_surf->swrast_damage_rects = NULL;
+   dri2_surf->swrast_n_damage_rects = 0;
    return EGL_TRUE;
 }
 
+static EGLBoolean
+dri2_wl_swrast_swap_buffers(_EGLDriver *drv, _EGLDisplay *disp, _EGLSurface *draw)
+{
+   return dri2_wl_swrast_swap_buffers_with_damage(drv, disp, draw, NULL, 0);
+}
+
+static EGLint
+dri2_wl_swrast_query_buffer_age(_EGLDriver *drv,
+                                _EGLDisplay *disp, _EGLSurface *surface)
+{
+   struct dri2_egl_surface *dri2_surf = dri2_egl_surface(surface);
+
+   if (swrast_update_buffers(dri2_surf) < 0) {
+      _eglError(EGL_BAD_ALLOC, "dri2_query_buffer_age");
+      return 0;
+   }
+
+   /* The driver renders into a back buffer of its own that it keeps across
+    * swaps and only reallocates on resize, which is also when we drop the
+    * front.  The shm buffers are kept in sync by putImage. */
+   return dri2_surf->current ? 1 : 0;
+}
+
 static void
 shm_handle_format(void *data, struct wl_shm *shm, uint32_t format)
 {
@@ -1780,11 +1943,11 @@ static struct dri2_egl_display_vtbl dri2_wl_swrast_display_vtbl = {
    .create_image = dri2_fallback_create_image_khr,
    .swap_interval = dri2_wl_swap_interval,
    .swap_buffers = dri2_wl_swrast_swap_buffers,
-   .swap_buffers_with_damage = dri2_fallback_swap_buffers_with_damage,
+   .swap_buffers_with_damage = dri2_wl_swrast_swap_buffers_with_damage,
    .swap_buffers_region = dri2_fallback_swap_buffers_region,
    .post_sub_buffer = dri2_fallback_post_sub_buffer,
    .copy_buffers = dri2_fallback_copy_buffers,
-   .query_buffer_age = dri2_fallback_query_buffer_age,
+   .query_buffer_age = dri2_wl_swrast_query_buffer_age,
    .create_wayland_buffer_from_image = dri2_fallback_create_wayland_buffer_from_image,
    .get_sync_values = dri2_fallback_get_sync_values,
    .get_dri_drawable = dri2_surface_get_dri_drawable,
@@ -1855,6 +2018,9 @@ dri2_initialize_wayland_swrast(_EGLDriver *drv, _EGLDisplay *disp)
 
    dri2_wl_setup_swap_interval(dri2_dpy);
 
+   disp->Extensions.EXT_buffer_age = EGL_TRUE;
+   disp->Extensions.EXT_swap_buffers_with_damage = EGL_TRUE;
+
    types = EGL_WINDOW_BIT;
    for (i = 0; dri2_dpy->driver_configs[i]; i++) {
       config = dri2_dpy->driver_configs[i];
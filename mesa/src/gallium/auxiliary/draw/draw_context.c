@@ -255,6 +255,25 @@ void draw_set_zs_format(struct draw_context *draw, enum pipe_format format)
 }
 
 
+/**
+ * Let the LLVM middle end shade large vertex runs on the threads of queue,
+ * in addition to the calling thread.  Intended for drivers which already
+ * spread rasterization over several cores (llvmpipe) and would otherwise
+ * leave them idle while the application thread runs the vertex shader.
+ * Only the vertex shader (fetch, shading, clip test and viewport
+ * transform) is split; everything downstream still runs on the calling
+ * thread, so primitive order is preserved.
+ *
+ * The queue belongs to the driver, which may share it between contexts,
+ * and must outlive the draw context.
+ */
+void draw_set_vs_queue(struct draw_context *draw, struct util_queue *queue)
+{
+   if (draw->llvm)
+      draw->vs.queue = queue;
+}
+
+
 static bool
 draw_is_vs_window_space(struct draw_context *draw)
 {
@@ -32,6 +32,9 @@
 #include "util/u_prim.h"
 
 #include "tgsi/tgsi_parse.h"
+#if HAVE_LLVM
+#include "nir/nir_to_tgsi_info.h"
+#endif
 
 #include "draw_fs.h"
 #include "draw_private.h"
@@ -47,7 +50,13 @@ draw_create_fragment_shader(struct draw_context *draw,
    dfs = CALLOC_STRUCT(draw_fragment_shader);
    if (dfs) {
       dfs->base = *shader;
-      tgsi_scan_shader(shader->tokens, &dfs->info);
+#if HAVE_LLVM
+      /* llvmpipe takes NIR fragment shaders under LP_NIR */
+      if (shader->type == PIPE_SHADER_IR_NIR)
+         nir_tgsi_scan_shader(shader->ir.nir, &dfs->info);
+      else
+#endif
+         tgsi_scan_shader(shader->tokens, &dfs->info);
    }
 
    return dfs;
@@ -45,6 +45,11 @@
 #include "tgsi/tgsi_transform.h"
 #include "tgsi/tgsi_dump.h"
 
+#if HAVE_LLVM
+#include "compiler/nir/nir.h"
+#include "nir/nir_draw_helpers.h"
+#endif
+
 #include "draw_context.h"
 #include "draw_private.h"
 #include "draw_pipe.h"
@@ -328,7 +333,28 @@ generate_aaline_fs(struct aaline_stage *aaline)
    const struct pipe_shader_state *orig_fs = &aaline->fs->state;
    struct pipe_shader_state aaline_fs;
    struct aa_transform_context transform;
-   const uint newLen = tgsi_num_tokens(orig_fs->tokens) + NUM_NEW_TOKENS;
+   uint newLen;
+
+#if HAVE_LLVM
+   if (orig_fs->type == PIPE_SHADER_IR_NIR) {
+      /* the driver takes ownership of the NIR it is given */
+      aaline_fs = *orig_fs; /* copy to init */
+      aaline_fs.ir.nir = nir_shader_clone(NULL, orig_fs->ir.nir);
+      if (aaline_fs.ir.nir == NULL)
+         return FALSE;
+
+      nir_lower_aaline_fs(aaline_fs.ir.nir, &aaline->fs->sampler_unit,
+                          &aaline->fs->generic_attrib);
+
+      aaline->fs->aaline_fs = aaline->driver_create_fs_state(pipe, &aaline_fs);
+      return aaline->fs->aaline_fs != NULL;
+   }
+#endif
+
+   if (orig_fs->type != PIPE_SHADER_IR_TGSI)
+      return FALSE;
+
+   newLen = tgsi_num_tokens(orig_fs->tokens) + NUM_NEW_TOKENS;
 
    aaline_fs = *orig_fs; /* copy to init */
    aaline_fs.tokens = tgsi_alloc_tokens(newLen);
@@ -836,7 +862,16 @@ aaline_create_fs_state(struct pipe_context *pipe,
    if (!aafs)
       return NULL;
 
-   aafs->state.tokens = tgsi_dup_tokens(fs->tokens);
+   /* only TGSI and NIR can be rewritten, other shaders are drawn without
+    * AA.  The driver takes ownership of NIR, so keep a copy of it.
+    */
+   aafs->state.type = fs->type;
+   if (fs->type == PIPE_SHADER_IR_TGSI)
+      aafs->state.tokens = tgsi_dup_tokens(fs->tokens);
+#if HAVE_LLVM
+   else if (fs->type == PIPE_SHADER_IR_NIR)
+      aafs->state.ir.nir = nir_shader_clone(NULL, fs->ir.nir);
+#endif
 
    /* pass-through */
    aafs->driver_fs = aaline->driver_create_fs_state(pipe, fs);
@@ -881,6 +916,10 @@ aaline_delete_fs_state(struct pipe_context *pipe, void *fs)
    }
 
    FREE((void*)aafs->state.tokens);
+#if HAVE_LLVM
+   if (aafs->state.type == PIPE_SHADER_IR_NIR)
+      ralloc_free(aafs->state.ir.nir);
+#endif
    FREE(aafs);
 }
 
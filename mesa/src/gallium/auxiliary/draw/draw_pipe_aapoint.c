@@ -45,6 +45,11 @@
 #include "tgsi/tgsi_transform.h"
 #include "tgsi/tgsi_dump.h"
 
+#if HAVE_LLVM
+#include "compiler/nir/nir.h"
+#include "nir/nir_draw_helpers.h"
+#endif
+
 #include "util/u_math.h"
 #include "util/u_memory.h"
 
@@ -360,8 +365,29 @@ generate_aapoint_fs(struct aapoint_stage *aapoint)
    const struct pipe_shader_state *orig_fs = &aapoint->fs->state;
    struct pipe_shader_state aapoint_fs;
    struct aa_transform_context transform;
-   const uint newLen = tgsi_num_tokens(orig_fs->tokens) + NUM_NEW_TOKENS;
    struct pipe_context *pipe = aapoint->stage.draw->pipe;
+   uint newLen;
+
+#if HAVE_LLVM
+   if (orig_fs->type == PIPE_SHADER_IR_NIR) {
+      /* the driver takes ownership of the NIR it is given */
+      aapoint_fs = *orig_fs; /* copy to init */
+      aapoint_fs.ir.nir = nir_shader_clone(NULL, orig_fs->ir.nir);
+      if (aapoint_fs.ir.nir == NULL)
+         return FALSE;
+
+      nir_lower_aapoint_fs(aapoint_fs.ir.nir, &aapoint->fs->generic_attrib);
+
+      aapoint->fs->aapoint_fs
+         = aapoint->driver_create_fs_state(pipe, &aapoint_fs);
+      return aapoint->fs->aapoint_fs != NULL;
+   }
+#endif
+
+   if (orig_fs->type != PIPE_SHADER_IR_TGSI)
+      return FALSE;
+
+   newLen = tgsi_num_tokens(orig_fs->tokens) + NUM_NEW_TOKENS;
 
    aapoint_fs = *orig_fs; /* copy to init */
    aapoint_fs.tokens = tgsi_alloc_tokens(newLen);
@@ -558,7 +584,11 @@ aapoint_first_point(struct draw_stage *stage, struct prim_header *header)
    /*
     * Bind (generate) our fragprog.
     */
-   bind_aapoint_fragment_shader(aapoint);
+   if (!bind_aapoint_fragment_shader(aapoint)) {
+      stage->point = draw_pipe_passthrough_point;
+      stage->point(stage, header);
+      return;
+   }
 
    draw_aapoint_prepare_outputs(draw, draw->pipeline.aapoint);
 
@@ -710,7 +740,16 @@ aapoint_create_fs_state(struct pipe_context *pipe,
    if (!aafs)
       return NULL;
 
-   aafs->state.tokens = tgsi_dup_tokens(fs->tokens);
+   /* only TGSI and NIR can be rewritten, other shaders are drawn without
+    * AA.  The driver takes ownership of NIR, so keep a copy of it.
+    */
+   aafs->state.type = fs->type;
+   if (fs->type == PIPE_SHADER_IR_TGSI)
+      aafs->state.tokens = tgsi_dup_tokens(fs->tokens);
+#if HAVE_LLVM
+   else if (fs->type == PIPE_SHADER_IR_NIR)
+      aafs->state.ir.nir = nir_shader_clone(NULL, fs->ir.nir);
+#endif
 
    /* pass-through */
    aafs->driver_fs = aapoint->driver_create_fs_state(pipe, fs);
@@ -745,6 +784,10 @@ aapoint_delete_fs_state(struct pipe_context *pipe, void *fs)
       aapoint->driver_delete_fs_state(pipe, aafs->aapoint_fs);
 
    FREE((void*)aafs->state.tokens);
+#if HAVE_LLVM
+   if (aafs->state.type == PIPE_SHADER_IR_NIR)
+      ralloc_free(aafs->state.ir.nir);
+#endif
 
    FREE(aafs);
 }
@@ -48,6 +48,11 @@
 
 #include "tgsi/tgsi_transform.h"
 
+#if HAVE_LLVM
+#include "compiler/nir/nir.h"
+#include "nir/nir_draw_helpers.h"
+#endif
+
 #include "draw_context.h"
 #include "draw_pipe.h"
 
@@ -129,6 +134,28 @@ generate_pstip_fs(struct pstip_stage *pstip)
    struct pipe_shader_state pstip_fs;
    enum tgsi_file_type wincoord_file;
 
+#if HAVE_LLVM
+   if (orig_fs->type == PIPE_SHADER_IR_NIR) {
+      /* The driver takes ownership of the NIR it is given.  NIR shaders
+       * only come from llvmpipe, which has the window position as an
+       * input rather than a system value.
+       */
+      pstip_fs = *orig_fs; /* copy to init */
+      pstip_fs.ir.nir = nir_shader_clone(NULL, orig_fs->ir.nir);
+      if (pstip_fs.ir.nir == NULL)
+         return FALSE;
+
+      nir_lower_pstipple_fs(pstip_fs.ir.nir, &pstip->fs->sampler_unit);
+      assert(pstip->fs->sampler_unit < PIPE_MAX_SAMPLERS);
+
+      pstip->fs->pstip_fs = pstip->driver_create_fs_state(pipe, &pstip_fs);
+      return pstip->fs->pstip_fs != NULL;
+   }
+#endif
+
+   if (orig_fs->type != PIPE_SHADER_IR_TGSI)
+      return FALSE;
+
    wincoord_file = screen->get_param(screen, PIPE_CAP_TGSI_FS_POSITION_IS_SYSVAL) ?
                    TGSI_FILE_SYSTEM_VALUE : TGSI_FILE_INPUT;
 
@@ -334,7 +361,16 @@ pstip_create_fs_state(struct pipe_context *pipe,
    struct pstip_fragment_shader *pstipfs = CALLOC_STRUCT(pstip_fragment_shader);
 
    if (pstipfs) {
-      pstipfs->state.tokens = tgsi_dup_tokens(fs->tokens);
+      /* only TGSI and NIR can be rewritten, other shaders are drawn
+       * unstippled.  The driver takes ownership of NIR, so keep a copy.
+       */
+      pstipfs->state.type = fs->type;
+      if (fs->type == PIPE_SHADER_IR_TGSI)
+         pstipfs->state.tokens = tgsi_dup_tokens(fs->tokens);
+#if HAVE_LLVM
+      else if (fs->type == PIPE_SHADER_IR_NIR)
+         pstipfs->state.ir.nir = nir_shader_clone(NULL, fs->ir.nir);
+#endif
 
       /* pass-through */
       pstipfs->driver_fs = pstip->driver_create_fs_state(pstip->pipe, fs);
@@ -369,6 +405,10 @@ pstip_delete_fs_state(struct pipe_context *pipe, void *fs)
       pstip->driver_delete_fs_state(pstip->pipe, pstipfs->pstip_fs);
 
    FREE((void*)pstipfs->state.tokens);
+#if HAVE_LLVM
+   if (pstipfs->state.type == PIPE_SHADER_IR_NIR)
+      ralloc_free(pstipfs->state.ir.nir);
+#endif
    FREE(pstipfs);
 }
 
@@ -45,6 +45,7 @@
 #include "pipe/p_defines.h"
 
 #include "tgsi/tgsi_scan.h"
+#include "util/u_queue.h"
 
 #ifdef HAVE_LLVM
 struct gallivm_state;
@@ -59,6 +60,12 @@ struct gallivm_state;
  */
 #define DRAW_MAX_FETCH_IDX 0xffffffff
 
+/**
+ * Maximum number of worker threads one vertex run is split over, see
+ * draw_set_vs_queue().
+ */
+#define DRAW_MAX_VS_THREADS 16
+
 struct pipe_context;
 struct draw_vertex_shader;
 struct draw_context;
@@ -277,6 +284,9 @@ struct draw_context
       struct translate_cache *fetch_cache;
       struct translate *emit;
       struct translate_cache *emit_cache;
+
+      /** Worker threads used to split large JIT vertex shader runs */
+      struct util_queue *queue;
    } vs;
 
    /** Geometry shader state */
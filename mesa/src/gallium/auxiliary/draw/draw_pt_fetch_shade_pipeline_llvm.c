@@ -39,6 +39,32 @@
 #include "gallivm/lp_bld_init.h"
 
 
+/**
+ * Vertex runs shorter than this are never split across threads; the
+ * queueing overhead would outweigh the shading work.  Chunks are kept a
+ * multiple of LLVM_VS_CHUNK_ALIGN so that every chunk but the last covers
+ * whole SoA vectors and the JIT code never writes into a neighbour's
+ * output.
+ */
+#define LLVM_VS_MIN_CHUNK   256
+#define LLVM_VS_CHUNK_ALIGN 16
+
+
+struct llvm_middle_end;
+
+/** A slice of a vertex run shaded on a worker thread */
+struct llvm_vs_job {
+   struct llvm_middle_end *fpme;
+   const struct draw_fetch_info *fetch_info;
+   struct vertex_header *verts;
+   unsigned offset;
+   unsigned count;
+   unsigned fpstate;
+   unsigned clipped;
+   struct util_queue_fence fence;
+};
+
+
 struct llvm_middle_end {
    struct draw_pt_middle_end base;
    struct draw_context *draw;
@@ -56,6 +82,8 @@ struct llvm_middle_end {
 
    struct draw_llvm *llvm;
    struct draw_llvm_variant *current_variant;
+
+   struct llvm_vs_job jobs[DRAW_MAX_VS_THREADS];
 };
 
 
@@ -336,6 +364,107 @@ emit(struct pt_emit *emit,
 }
 
 
+/**
+ * Run the JIT vertex shader on vertices [offset, offset + count) of the
+ * fetch, writing them to verts (which points at vertex 'offset').
+ */
+static unsigned
+llvm_pipeline_vs_range(struct llvm_middle_end *fpme,
+                       const struct draw_fetch_info *fetch_info,
+                       struct vertex_header *verts,
+                       unsigned offset,
+                       unsigned count)
+{
+   struct draw_context *draw = fpme->draw;
+
+   if (fetch_info->linear)
+      return fpme->current_variant->jit_func( &fpme->llvm->jit_context,
+                                       verts,
+                                       draw->pt.user.vbuffer,
+                                       fetch_info->start + offset,
+                                       count,
+                                       fpme->vertex_size,
+                                       draw->pt.vertex_buffer,
+                                       draw->instance_id,
+                                       draw->start_index,
+                                       draw->start_instance);
+   else
+      return fpme->current_variant->jit_func_elts( &fpme->llvm->jit_context,
+                                            verts,
+                                            draw->pt.user.vbuffer,
+                                            fetch_info->elts + offset,
+                                            draw->pt.user.eltMax,
+                                            count,
+                                            fpme->vertex_size,
+                                            draw->pt.vertex_buffer,
+                                            draw->instance_id,
+                                            draw->pt.user.eltBias,
+                                            draw->start_instance);
+}
+
+
+static void
+llvm_pipeline_vs_job(void *data, int thread_index)
+{
+   struct llvm_vs_job *job = (struct llvm_vs_job *)data;
+   unsigned fpstate = util_fpstate_get();
+
+   /* match the denorm mode draw_vbo() set up on the calling thread */
+   util_fpstate_set(job->fpstate);
+   job->clipped = llvm_pipeline_vs_range(job->fpme, job->fetch_info,
+                                         job->verts, job->offset,
+                                         job->count);
+   util_fpstate_set(fpstate);
+}
+
+
+/**
+ * Fetch and shade all vertices of the run, splitting large runs across
+ * the draw module's worker threads.  The calling thread shades the first
+ * chunk itself.  Returns non-zero if any vertex needs clipping.
+ */
+static unsigned
+llvm_pipeline_vs(struct llvm_middle_end *fpme,
+                 const struct draw_fetch_info *fetch_info,
+                 struct vertex_header *verts)
+{
+   struct util_queue *queue = fpme->draw->vs.queue;
+   unsigned count = fetch_info->count;
+   unsigned num_chunks, chunk, offset, clipped, i;
+
+   if (!queue || count < 2 * LLVM_VS_MIN_CHUNK)
+      return llvm_pipeline_vs_range(fpme, fetch_info, verts, 0, count);
+
+   num_chunks = MIN2(MIN2(queue->num_threads, DRAW_MAX_VS_THREADS) + 1,
+                     count / LLVM_VS_MIN_CHUNK);
+   chunk = align(DIV_ROUND_UP(count, num_chunks), LLVM_VS_CHUNK_ALIGN);
+   num_chunks = DIV_ROUND_UP(count, chunk);
+
+   for (i = 1; i < num_chunks; i++) {
+      struct llvm_vs_job *job = &fpme->jobs[i - 1];
+
+      offset = i * chunk;
+      job->fpme = fpme;
+      job->fetch_info = fetch_info;
+      job->offset = offset;
+      job->count = MIN2(chunk, count - offset);
+      job->verts = (struct vertex_header *)
+         ((char *)verts + offset * fpme->vertex_size);
+      job->fpstate = util_fpstate_get();
+      util_queue_add_job(queue, job, &job->fence, llvm_pipeline_vs_job, NULL);
+   }
+
+   clipped = llvm_pipeline_vs_range(fpme, fetch_info, verts, 0, chunk);
+
+   for (i = 1; i < num_chunks; i++) {
+      util_queue_job_wait(&fpme->jobs[i - 1].fence);
+      clipped |= fpme->jobs[i - 1].clipped;
+   }
+
+   return clipped;
+}
+
+
 static void
 llvm_pipeline_generic(struct draw_pt_middle_end *middle,
                       const struct draw_fetch_info *fetch_info,
@@ -373,29 +502,7 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
       draw->statistics.vs_invocations += fetch_info->count;
    }
 
-   if (fetch_info->linear)
-      clipped = fpme->current_variant->jit_func( &fpme->llvm->jit_context,
-                                       llvm_vert_info.verts,
-                                       draw->pt.user.vbuffer,
-                                       fetch_info->start,
-                                       fetch_info->count,
-                                       fpme->vertex_size,
-                                       draw->pt.vertex_buffer,
-                                       draw->instance_id,
-                                       draw->start_index,
-                                       draw->start_instance);
-   else
-      clipped = fpme->current_variant->jit_func_elts( &fpme->llvm->jit_context,
-                                            llvm_vert_info.verts,
-                                            draw->pt.user.vbuffer,
-                                            fetch_info->elts,
-                                            draw->pt.user.eltMax,
-                                            fetch_info->count,
-                                            fpme->vertex_size,
-                                            draw->pt.vertex_buffer,
-                                            draw->instance_id,
-                                            draw->pt.user.eltBias,
-                                            draw->start_instance);
+   clipped = llvm_pipeline_vs(fpme, fetch_info, llvm_vert_info.verts);
 
    /* Finished with fetch and vs:
     */
@@ -585,6 +692,10 @@ static void
 llvm_middle_end_destroy(struct draw_pt_middle_end *middle)
 {
    struct llvm_middle_end *fpme = llvm_middle_end(middle);
+   unsigned i;
+
+   for (i = 0; i < ARRAY_SIZE(fpme->jobs); i++)
+      util_queue_fence_destroy(&fpme->jobs[i].fence);
 
    if (fpme->fetch)
       draw_pt_fetch_destroy( fpme->fetch );
@@ -606,6 +717,7 @@ struct draw_pt_middle_end *
 draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
 {
    struct llvm_middle_end *fpme = 0;
+   unsigned i;
 
    if (!draw->llvm)
       return NULL;
@@ -614,6 +726,9 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
    if (!fpme)
       goto fail;
 
+   for (i = 0; i < ARRAY_SIZE(fpme->jobs); i++)
+      util_queue_fence_init(&fpme->jobs[i].fence);
+
    fpme->base.prepare         = llvm_middle_end_prepare;
    fpme->base.bind_parameters = llvm_middle_end_bind_parameters;
    fpme->base.run             = llvm_middle_end_run;
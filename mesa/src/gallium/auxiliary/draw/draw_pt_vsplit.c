@@ -23,6 +23,7 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include "util/u_debug.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 
@@ -31,11 +32,18 @@
 #include "draw/draw_pt.h"
 
 #define SEGMENT_SIZE 1024
-#define MAP_SIZE     256
+#define MAP_SIZE     (2 * SEGMENT_SIZE)
+
+/* List primitives are split by the number of fetches, so a segment may
+ * draw more elements than it fetches */
+#define DRAW_ELTS_SIZE (4 * SEGMENT_SIZE)
 
 /* The largest possible index withing an index buffer */
 #define MAX_ELT_IDX 0xffffffff
 
+DEBUG_GET_ONCE_NUM_OPTION(draw_vsplit_segment, "DRAW_VSPLIT_SEGMENT", SEGMENT_SIZE)
+DEBUG_GET_ONCE_BOOL_OPTION(draw_vsplit_stats, "DRAW_VSPLIT_STATS", FALSE)
+
 struct vsplit_frontend {
    struct draw_pt_front_end base;
    struct draw_context *draw;
@@ -47,9 +55,12 @@ struct vsplit_frontend {
    unsigned max_vertices;
    ushort segment_size;
 
+   /* the most elements a segment may draw */
+   unsigned max_draw_elts;
+
    /* buffers for splitting */
    unsigned fetch_elts[SEGMENT_SIZE];
-   ushort draw_elts[SEGMENT_SIZE];
+   ushort draw_elts[DRAW_ELTS_SIZE];
    ushort identity_draw_elts[SEGMENT_SIZE];
 
    struct {
@@ -61,13 +72,23 @@ struct vsplit_frontend {
       ushort num_fetch_elts;
       ushort num_draw_elts;
    } cache;
+
+   /* DRAW_VSPLIT_STATS: vertices shaded against unique vertices drawn */
+   struct {
+      void (*run)(struct draw_pt_front_end *, unsigned start, unsigned count);
+      uint64_t draws;
+      uint64_t elts;
+      uint64_t shaded;
+      uint64_t unique;
+      unsigned *sorted;
+      unsigned sorted_size;
+   } stats;
 };
 
 
 static void
 vsplit_clear_cache(struct vsplit_frontend *vsplit)
 {
-   memset(vsplit->cache.fetches, 0xff, sizeof(vsplit->cache.fetches));
    vsplit->cache.has_max_fetch = FALSE;
    vsplit->cache.num_fetch_elts = 0;
    vsplit->cache.num_draw_elts = 0;
@@ -76,9 +97,21 @@ vsplit_clear_cache(struct vsplit_frontend *vsplit)
 static void
 vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned flags)
 {
+   unsigned i;
+
    vsplit->middle->run(vsplit->middle,
          vsplit->fetch_elts, vsplit->cache.num_fetch_elts,
          vsplit->draw_elts, vsplit->cache.num_draw_elts, flags);
+
+   vsplit->stats.shaded += vsplit->cache.num_fetch_elts;
+
+   /* Every map entry in use belongs to one of the fetch elements, so
+    * emptying just those is much cheaper than clearing the whole map.
+    * fetch_elts is also used by the linear paths, so do it now while the
+    * elements are still there.
+    */
+   for (i = 0; i < vsplit->cache.num_fetch_elts; i++)
+      vsplit->cache.fetches[vsplit->fetch_elts[i] % MAP_SIZE] = ~0u;
 }
 
 /**
@@ -92,11 +125,15 @@ vsplit_add_cache(struct vsplit_frontend *vsplit, unsigned fetch, unsigned ofbias
    hash = fetch % MAP_SIZE;
 
    /* If the value isn't in the cache or it's an overflow due to the
-    * element bias */
-   if (vsplit->cache.fetches[hash] != fetch || ofbias) {
+    * element bias.  Empty entries hold DRAW_MAX_FETCH_IDX, so that index
+    * always misses until it has been added. */
+   if (vsplit->cache.fetches[hash] != fetch || ofbias ||
+       (fetch == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch)) {
       /* update cache */
       vsplit->cache.fetches[hash] = fetch;
       vsplit->cache.draws[hash] = vsplit->cache.num_fetch_elts;
+      if (fetch == DRAW_MAX_FETCH_IDX)
+         vsplit->cache.has_max_fetch = TRUE;
 
       /* add fetch */
       assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
@@ -198,16 +235,7 @@ vsplit_add_cache_uint(struct vsplit_frontend *vsplit, const uint *elts,
                       unsigned start, unsigned fetch, int elt_bias)
 {
    struct draw_context *draw = vsplit->draw;
-   unsigned raw_elem_idx = start + fetch + elt_bias;
    VSPLIT_CREATE_IDX(elts, start, fetch, elt_bias);
-
-   /* special care for DRAW_MAX_FETCH_IDX */
-   if (raw_elem_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = fetch % MAP_SIZE;
-      vsplit->cache.fetches[hash] = raw_elem_idx - 1; /* force update */
-      vsplit->cache.has_max_fetch = TRUE;
-   }
-
    vsplit_add_cache(vsplit, elt_idx, ofbias);
 }
 
@@ -231,6 +259,67 @@ vsplit_add_cache_uint(struct vsplit_frontend *vsplit, const uint *elts,
 #include "draw_pt_vsplit_tmp.h"
 
 
+static int
+vsplit_compare_elts(const void *a, const void *b)
+{
+   const unsigned ea = *(const unsigned *) a, eb = *(const unsigned *) b;
+
+   return ea < eb ? -1 : ea > eb;
+}
+
+
+/**
+ * Count the distinct vertices of an indexed draw, and the vertices shaded
+ * to draw it, for DRAW_VSPLIT_STATS.
+ */
+static void
+vsplit_run_stats(struct draw_pt_front_end *frontend,
+                 unsigned start, unsigned count)
+{
+   struct vsplit_frontend *vsplit = (struct vsplit_frontend *) frontend;
+   struct draw_context *draw = vsplit->draw;
+   const void *elts = draw->pt.user.elts;
+   unsigned i, unique = 0;
+
+   vsplit->stats.run(frontend, start, count);
+
+   if (vsplit->stats.sorted_size < count) {
+      FREE(vsplit->stats.sorted);
+      vsplit->stats.sorted = MALLOC(count * sizeof(unsigned));
+      vsplit->stats.sorted_size = vsplit->stats.sorted ? count : 0;
+      if (!vsplit->stats.sorted)
+         return;
+   }
+
+   for (i = 0; i < count; i++) {
+      unsigned idx = start + i;
+
+      switch (draw->pt.user.eltSize) {
+      case 1:
+         idx = DRAW_GET_IDX((const ubyte *) elts, idx);
+         break;
+      case 2:
+         idx = DRAW_GET_IDX((const ushort *) elts, idx);
+         break;
+      default:
+         idx = DRAW_GET_IDX((const uint *) elts, idx);
+         break;
+      }
+      vsplit->stats.sorted[i] = idx;
+   }
+
+   qsort(vsplit->stats.sorted, count, sizeof(unsigned), vsplit_compare_elts);
+   for (i = 0; i < count; i++) {
+      if (i == 0 || vsplit->stats.sorted[i] != vsplit->stats.sorted[i - 1])
+         unique++;
+   }
+
+   vsplit->stats.draws++;
+   vsplit->stats.elts += count;
+   vsplit->stats.unique += unique;
+}
+
+
 static void vsplit_prepare(struct draw_pt_front_end *frontend,
                            unsigned in_prim,
                            struct draw_pt_middle_end *middle,
@@ -259,10 +348,19 @@ static void vsplit_prepare(struct draw_pt_front_end *frontend,
    /* split only */
    vsplit->prim = in_prim;
 
+   if (debug_get_option_draw_vsplit_stats() && vsplit->draw->pt.user.eltSize) {
+      vsplit->stats.run = vsplit->base.run;
+      vsplit->base.run = vsplit_run_stats;
+   }
+
    vsplit->middle = middle;
    middle->prepare(middle, vsplit->prim, opt, &vsplit->max_vertices);
 
-   vsplit->segment_size = MIN2(SEGMENT_SIZE, vsplit->max_vertices);
+   /* max_vertices reflects the size of the shaded vertices, so segments of
+    * wide vertices are shorter */
+   vsplit->segment_size = MIN3(SEGMENT_SIZE, vsplit->max_vertices,
+                               (unsigned) MAX2(debug_get_option_draw_vsplit_segment(), 64));
+   vsplit->max_draw_elts = MIN2(DRAW_ELTS_SIZE, vsplit->max_vertices);
 }
 
 
@@ -279,6 +377,20 @@ static void vsplit_flush(struct draw_pt_front_end *frontend, unsigned flags)
 
 static void vsplit_destroy(struct draw_pt_front_end *frontend)
 {
+   struct vsplit_frontend *vsplit = (struct vsplit_frontend *) frontend;
+
+   /* not debug_printf, which is a no-op in release builds */
+   if (vsplit->stats.draws) {
+      _debug_printf("vsplit: %llu indexed draws, %llu elements, "
+                    "%llu vertices shaded, %llu unique, %.3f shaded/unique\n",
+                    (unsigned long long) vsplit->stats.draws,
+                    (unsigned long long) vsplit->stats.elts,
+                    (unsigned long long) vsplit->stats.shaded,
+                    (unsigned long long) vsplit->stats.unique,
+                    (double) vsplit->stats.shaded / vsplit->stats.unique);
+   }
+
+   FREE(vsplit->stats.sorted);
    FREE(frontend);
 }
 
@@ -300,5 +412,8 @@ struct draw_pt_front_end *draw_pt_vsplit(struct draw_context *draw)
    for (i = 0; i < SEGMENT_SIZE; i++)
       vsplit->identity_draw_elts[i] = i;
 
+   /* empty cache entries */
+   memset(vsplit->cache.fetches, 0xff, sizeof(vsplit->cache.fetches));
+
    return &vsplit->base;
 }
@@ -118,11 +118,58 @@ CONCAT(vsplit_primitive_, ELT_TYPE)(struct vsplit_frontend *vsplit,
       draw_elts = vsplit->draw_elts;
    }
 
+   vsplit->stats.shaded += fetch_count;
+
    return vsplit->middle->run_linear_elts(vsplit->middle,
                                           fetch_start, fetch_count,
                                           draw_elts, icount, 0x0);
 }
 
+/**
+ * Split a list primitive by the number of vertices fetched rather than by
+ * the number of elements.  Whole primitives are added to the cache until
+ * either buffer is full, so a segment covers several times more elements
+ * and fewer shared vertices end up shaded once on each side of a split.
+ */
+static boolean
+CONCAT(vsplit_list_, ELT_TYPE)(struct vsplit_frontend *vsplit,
+                               unsigned istart, unsigned icount)
+{
+   struct draw_context *draw = vsplit->draw;
+   const ELT_TYPE *ib = (const ELT_TYPE *) draw->pt.user.elts;
+   const int ibias = draw->pt.user.eltBias;
+   unsigned flags = 0x0;
+   unsigned first, incr, i, j;
+
+   /* only lists, whose primitives share no vertices by construction */
+   draw_pt_split_prim(vsplit->prim, &first, &incr);
+   if (first != incr)
+      return FALSE;
+
+   /* a single segment does as well */
+   if (icount <= vsplit->segment_size ||
+       vsplit->max_draw_elts <= vsplit->segment_size)
+      return FALSE;
+
+   vsplit_clear_cache(vsplit);
+
+   for (i = 0; i < icount; i += incr) {
+      if (vsplit->cache.num_fetch_elts + incr > vsplit->segment_size ||
+          vsplit->cache.num_draw_elts + incr > vsplit->max_draw_elts) {
+         vsplit_flush_cache(vsplit, flags | DRAW_SPLIT_AFTER);
+         vsplit_clear_cache(vsplit);
+         flags = DRAW_SPLIT_BEFORE;
+      }
+
+      for (j = 0; j < incr; j++)
+         ADD_CACHE(vsplit, ib, istart, i + j, ibias);
+   }
+
+   vsplit_flush_cache(vsplit, flags);
+
+   return TRUE;
+}
+
 /**
  * Use the cache to prepare the fetch and draw elements, and flush.
  *
@@ -228,7 +275,8 @@ CONCAT(vsplit_segment_fan_, ELT_TYPE)(struct vsplit_frontend *vsplit,
    const unsigned max_count_fan = vsplit->segment_size;
 
 #define PRIMITIVE(istart, icount)   \
-   CONCAT(vsplit_primitive_, ELT_TYPE)(vsplit, istart, icount)
+   (CONCAT(vsplit_primitive_, ELT_TYPE)(vsplit, istart, icount) || \
+    CONCAT(vsplit_list_, ELT_TYPE)(vsplit, istart, icount))
 
 #else /* ELT_TYPE */
 
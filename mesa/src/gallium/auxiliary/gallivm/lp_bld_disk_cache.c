@@ -0,0 +1,101 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * On-disk cache of JIT'ed machine code, on top of util/disk_cache.
+ *
+ * The cache lives in $GALLIVM_CACHE_DIR, or else in
+ * $XDG_CACHE_HOME/mesa/gallivm or $HOME/.cache/mesa/gallivm.  Its size is
+ * limited to $GALLIVM_CACHE_SIZE megabytes (256 by default); zero disables
+ * it.
+ */
+
+
+#include "util/disk_cache.h"
+#include "util/u_debug.h"
+#include "os/os_misc.h"
+#include "os/os_thread.h"
+
+#include "lp_bld_disk_cache.h"
+
+
+static struct disk_cache *cache;
+static boolean cache_initialized = FALSE;
+
+pipe_static_mutex(cache_mutex);
+
+
+static struct disk_cache *
+get_cache(void)
+{
+   struct disk_cache *result;
+
+   pipe_mutex_lock(cache_mutex);
+   if (!cache_initialized) {
+      uint64_t max_size =
+         (uint64_t) debug_get_num_option("GALLIVM_CACHE_SIZE", 256) << 20;
+
+      cache = disk_cache_create(os_get_option("GALLIVM_CACHE_DIR"),
+                                "gallivm", max_size);
+      cache_initialized = TRUE;
+   }
+   result = cache;
+   pipe_mutex_unlock(cache_mutex);
+
+   return result;
+}
+
+
+boolean
+lp_disk_cache_enabled(void)
+{
+   return get_cache() != NULL;
+}
+
+
+/**
+ * Look up an entry.
+ * \return  a malloc'ed copy of the entry's data, or NULL if not cached.
+ */
+void *
+lp_disk_cache_load(const unsigned char key[LP_DISK_CACHE_KEY_SIZE],
+                   size_t *size)
+{
+   return disk_cache_get(get_cache(), key, size);
+}
+
+
+/**
+ * Add an entry.  Failures are silently ignored.
+ */
+void
+lp_disk_cache_store(const unsigned char key[LP_DISK_CACHE_KEY_SIZE],
+                    const void *data, size_t size)
+{
+   disk_cache_put(get_cache(), key, data, size);
+}
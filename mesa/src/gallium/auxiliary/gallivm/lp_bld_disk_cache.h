@@ -0,0 +1,66 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * On-disk cache of JIT'ed machine code, shared by all processes of a user.
+ */
+
+#ifndef LP_BLD_DISK_CACHE_H
+#define LP_BLD_DISK_CACHE_H
+
+
+#include "pipe/p_compiler.h"
+#include "util/disk_cache.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define LP_DISK_CACHE_KEY_SIZE DISK_CACHE_KEY_SIZE
+
+
+boolean
+lp_disk_cache_enabled(void);
+
+void *
+lp_disk_cache_load(const unsigned char key[LP_DISK_CACHE_KEY_SIZE],
+                   size_t *size);
+
+void
+lp_disk_cache_store(const unsigned char key[LP_DISK_CACHE_KEY_SIZE],
+                    const void *data, size_t size);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* !LP_BLD_DISK_CACHE_H */
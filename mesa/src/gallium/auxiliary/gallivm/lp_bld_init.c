@@ -188,6 +188,9 @@ gallivm_free_ir(struct gallivm_state *gallivm)
       LLVMDisposeModule(gallivm->module);
    }
 
+   /* The object cache must outlive the engine */
+   lp_object_cache_destroy(gallivm->cache);
+
    FREE(gallivm->module_name);
 
    if (!USE_MCJIT) {
@@ -210,6 +213,7 @@ gallivm_free_ir(struct gallivm_state *gallivm)
    gallivm->passmgr = NULL;
    gallivm->context = NULL;
    gallivm->builder = NULL;
+   gallivm->cache = NULL;
 }
 
 
@@ -228,25 +232,31 @@ gallivm_free_code(struct gallivm_state *gallivm)
 }
 
 
+static enum LLVM_CodeGenOpt_Level
+get_opt_level(const struct gallivm_state *gallivm)
+{
+   if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) || gallivm->fast_compile) {
+      return None;
+   }
+   else {
+      return Default;
+   }
+}
+
+
 static boolean
 init_gallivm_engine(struct gallivm_state *gallivm)
 {
    if (1) {
-      enum LLVM_CodeGenOpt_Level optlevel;
+      enum LLVM_CodeGenOpt_Level optlevel = get_opt_level(gallivm);
       char *error = NULL;
       int ret;
 
-      if (gallivm_debug & GALLIVM_DEBUG_NO_OPT) {
-         optlevel = None;
-      }
-      else {
-         optlevel = Default;
-      }
-
       ret = lp_build_create_jit_compiler_for_module(&gallivm->engine,
                                                     &gallivm->code,
                                                     gallivm->module,
                                                     gallivm->memorymgr,
+                                                    gallivm->cache,
                                                     (unsigned) optlevel,
                                                     USE_MCJIT,
                                                     &error);
@@ -419,6 +429,7 @@ lp_build_init(void)
       util_cpu_caps.has_sse4_2 = 0;
       util_cpu_caps.has_avx = 0;
       util_cpu_caps.has_avx2 = 0;
+      util_cpu_caps.has_avx512f = 0;
       util_cpu_caps.has_f16c = 0;
       util_cpu_caps.has_fma = 0;
    }
@@ -444,6 +455,15 @@ lp_build_init(void)
    lp_native_vector_width = debug_get_num_option("LP_NATIVE_VECTOR_WIDTH",
                                                  lp_native_vector_width);
 
+   /* 512-bit vectors (16 floats, so that a whole 4x4 fragment block fits in
+    * a vector) are opt-in via LP_NATIVE_VECTOR_WIDTH=512 for now, and only
+    * honoured where AVX-512 can actually be used.
+    */
+   if (lp_native_vector_width > 256 &&
+       !(util_cpu_caps.has_avx512f && HAVE_LLVM >= 0x0309)) {
+      lp_native_vector_width = util_cpu_caps.has_avx ? 256 : 128;
+   }
+
    if (lp_native_vector_width <= 128) {
       /* Hide AVX support, as often LLVM AVX intrinsics are only guarded by
        * "util_cpu_caps.has_avx" predicate, and lack the
@@ -454,9 +474,16 @@ lp_build_init(void)
        */
       util_cpu_caps.has_avx = 0;
       util_cpu_caps.has_avx2 = 0;
+      util_cpu_caps.has_avx512f = 0;
       util_cpu_caps.has_f16c = 0;
       util_cpu_caps.has_fma = 0;
    }
+   else if (lp_native_vector_width <= 256) {
+      /* Likewise for AVX-512, which would otherwise let LLVM pick 512-bit
+       * instructions on its own.
+       */
+      util_cpu_caps.has_avx512f = 0;
+   }
 
 #ifdef PIPE_ARCH_PPC_64
    /* Set the NJ bit in VSCR to 0 so denormalized values are handled as
@@ -564,9 +591,19 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    if (gallivm_debug & GALLIVM_DEBUG_PERF)
       time_begin = os_time_get();
 
+   /*
+    * Look the module up in the on-disk cache.  On a hit the machine code is
+    * loaded from there, so there is no point in optimizing the IR.
+    */
+   if (USE_MCJIT) {
+      gallivm->cache = lp_object_cache_create(gallivm->module,
+                                              (unsigned) get_opt_level(gallivm));
+   }
+
    /* Run optimization passes */
    LLVMInitializeFunctionPassManager(gallivm->passmgr);
-   func = LLVMGetFirstFunction(gallivm->module);
+   func = lp_object_cache_is_hit(gallivm->cache) || gallivm->fast_compile ?
+          NULL : LLVMGetFirstFunction(gallivm->module);
    while (func) {
       if (0) {
          debug_printf("optimizing func %s...\n", LLVMGetValueName(func));
@@ -664,3 +701,14 @@ gallivm_jit_function(struct gallivm_state *gallivm,
 
    return jit_func;
 }
+
+
+/**
+ * Return the size in bytes of the machine code and data generated for the
+ * module.  Call this after all the functions have been JIT'ed.
+ */
+size_t
+gallivm_code_size(const struct gallivm_state *gallivm)
+{
+   return lp_generated_code_size(gallivm->code);
+}
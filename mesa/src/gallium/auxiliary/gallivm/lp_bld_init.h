@@ -50,6 +50,8 @@ struct gallivm_state
    LLVMBuilderRef builder;
    LLVMMCJITMemoryManagerRef memorymgr;
    struct lp_generated_code *code;
+   struct lp_object_cache *cache;
+   boolean fast_compile;  /**< trade code quality for compile time */
    unsigned compiled;
 };
 
@@ -78,6 +80,9 @@ func_pointer
 gallivm_jit_function(struct gallivm_state *gallivm,
                      LLVMValueRef func);
 
+size_t
+gallivm_code_size(const struct gallivm_state *gallivm);
+
 #ifdef __cplusplus
 }
 #endif
@@ -79,9 +79,17 @@
 
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/Support/DynamicLibrary.h>
+#include <llvm/ADT/StringExtras.h>
 #include <llvm/Support/CBindingWrapping.h>
 
 #include <llvm/Config/llvm-config.h>
+#if HAVE_LLVM >= 0x0306
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/Support/raw_ostream.h>
+#endif
 #if LLVM_USE_INTEL_JITEVENTS
 #include <llvm/ExecutionEngine/JITEventListener.h>
 #endif
@@ -96,8 +104,19 @@
 #include "pipe/p_config.h"
 #include "util/u_debug.h"
 #include "util/u_cpu_detect.h"
+#include "util/u_memory.h"
+#include "util/mesa-sha1.h"
 
 #include "lp_bld_misc.h"
+#include "lp_bld_disk_cache.h"
+
+#if defined(HAVE_DLADDR)
+#include <dlfcn.h>
+#include <sys/stat.h>
+#endif
+
+#include <set>
+#include <vector>
 
 namespace {
 
@@ -389,9 +408,11 @@ class ShaderMemoryManager : public DelegatingJITMemoryManager {
       typedef std::vector<void *> Vec;
       Vec FunctionBody, ExceptionTable;
       BaseMemoryManager *TheMM;
+      size_t Size;
 
       GeneratedCode(BaseMemoryManager *MM) {
          TheMM = MM;
+         Size = 0;
       }
 
       ~GeneratedCode() {
@@ -441,6 +462,48 @@ class ShaderMemoryManager : public DelegatingJITMemoryManager {
          delete (GeneratedCode *) code;
       }
 
+      static size_t getGeneratedCodeSize(const struct lp_generated_code *code) {
+         return ((const GeneratedCode *) code)->Size;
+      }
+
+      /*
+       * Keep track of how much memory the sections of this module take.
+       */
+#if HAVE_LLVM >= 0x0304
+      virtual uint8_t *allocateCodeSection(uintptr_t Size,
+                                           unsigned Alignment,
+                                           unsigned SectionID,
+                                           llvm::StringRef SectionName) {
+         code->Size += Size;
+         return DelegatingJITMemoryManager::allocateCodeSection(Size, Alignment,
+                                                                SectionID,
+                                                                SectionName);
+      }
+#else
+      virtual uint8_t *allocateCodeSection(uintptr_t Size,
+                                           unsigned Alignment,
+                                           unsigned SectionID) {
+         code->Size += Size;
+         return DelegatingJITMemoryManager::allocateCodeSection(Size, Alignment,
+                                                                SectionID);
+      }
+#endif
+      virtual uint8_t *allocateDataSection(uintptr_t Size,
+                                           unsigned Alignment,
+                                           unsigned SectionID,
+#if HAVE_LLVM >= 0x0304
+                                           llvm::StringRef SectionName,
+#endif
+                                           bool IsReadOnly) {
+         code->Size += Size;
+         return DelegatingJITMemoryManager::allocateDataSection(Size, Alignment,
+                                                                SectionID,
+#if HAVE_LLVM >= 0x0304
+                                                                SectionName,
+#endif
+                                                                IsReadOnly);
+      }
+
 #if HAVE_LLVM < 0x0304
       virtual void deallocateExceptionTable(void *ET) {
          // remember for later deallocation
@@ -455,6 +518,335 @@ class ShaderMemoryManager : public DelegatingJITMemoryManager {
 };
 
 
+/*
+ * MCJIT object cache backed by the on-disk cache.  There is one per module:
+ * it is keyed by a hash of the module's unoptimized IR, so that on a hit
+ * both the optimization passes and code generation can be skipped.
+ */
+#if HAVE_LLVM >= 0x0306 && defined(HAVE_SHA1)
+class ShaderObjectCache : public llvm::ObjectCache {
+
+   unsigned char Key[LP_DISK_CACHE_KEY_SIZE];
+   void *Data;
+   size_t Size;
+
+   public:
+
+      ShaderObjectCache(const unsigned char *key) {
+         memcpy(Key, key, sizeof Key);
+         Size = 0;
+         Data = lp_disk_cache_load(Key, &Size);
+      }
+
+      virtual ~ShaderObjectCache() {
+         free(Data);
+      }
+
+      bool hit() const {
+         return Data != NULL;
+      }
+
+      virtual void notifyObjectCompiled(const llvm::Module *M,
+                                        llvm::MemoryBufferRef Obj) {
+         if (!Data) {
+            lp_disk_cache_store(Key, Obj.getBufferStart(),
+                                Obj.getBufferSize());
+         }
+      }
+
+      virtual std::unique_ptr<llvm::MemoryBuffer>
+      getObject(const llvm::Module *M) {
+         if (!Data) {
+            return nullptr;
+         }
+         return llvm::MemoryBuffer::getMemBufferCopy(
+            llvm::StringRef((const char *) Data, Size));
+      }
+};
+#endif
+
+
+#if HAVE_LLVM >= 0x0306 && defined(HAVE_SHA1)
+/*
+ * Names like fs%u_variant%u come from per-process counters, so the same
+ * shader gets different names in different runs.  Rename the functions the
+ * module defines after their position and the name without digits.  The
+ * cached object code is looked up by these names, so they stay that way.
+ */
+static void
+normalize_function_names(llvm::Module *M)
+{
+   unsigned index = 0;
+
+   for (llvm::Module::iterator F = M->begin(); F != M->end(); ++F) {
+      if (F->isDeclaration()) {
+         continue;
+      }
+
+      std::string Name;
+      llvm::StringRef Old = F->getName();
+      for (size_t i = 0; i < Old.size(); i++) {
+         if (Old[i] < '0' || Old[i] > '9') {
+            Name += Old[i];
+         }
+      }
+      F->setName(Name + "_" + llvm::Twine(index++));
+   }
+}
+
+
+/*
+ * Hash the printed IR, leaving out the module name and source file name,
+ * which are per-process too.
+ */
+static void
+hash_module_ir(const llvm::Module *M, struct mesa_sha1 *ctx)
+{
+   std::string IR;
+   llvm::raw_string_ostream OS(IR);
+
+   M->print(OS, NULL);
+   OS.flush();
+
+   llvm::StringRef Rest(IR);
+   while (!Rest.empty()) {
+      std::pair<llvm::StringRef, llvm::StringRef> Line = Rest.split('\n');
+      if (!Line.first.startswith("; ModuleID") &&
+          !Line.first.startswith("source_filename")) {
+         _mesa_sha1_update(ctx, Line.first.data(), Line.first.size());
+         _mesa_sha1_update(ctx, "\n", 1);
+      }
+      Rest = Line.second;
+   }
+}
+
+
+/*
+ * Find the pointers lp_build_const_int_pointer() baked into the IR, i.e.
+ * inttoptr constant expressions of integers, wherever they are nested.
+ */
+static void
+find_pointers(llvm::Constant *C,
+              std::vector<llvm::ConstantExpr *> &Pointers,
+              std::set<llvm::Constant *> &Visited)
+{
+   if (llvm::isa<llvm::GlobalValue>(C) || !Visited.insert(C).second) {
+      return;
+   }
+
+   llvm::ConstantExpr *CE = llvm::dyn_cast<llvm::ConstantExpr>(C);
+   if (CE && CE->getOpcode() == llvm::Instruction::IntToPtr &&
+       llvm::isa<llvm::ConstantInt>(CE->getOperand(0))) {
+      /* Small values are flags or sentinels rather than addresses */
+      if (llvm::cast<llvm::ConstantInt>(CE->getOperand(0))->getZExtValue() >=
+          0x10000) {
+         Pointers.push_back(CE);
+      }
+      return;
+   }
+
+   for (unsigned i = 0; i < C->getNumOperands(); i++) {
+      llvm::Constant *Op = llvm::dyn_cast<llvm::Constant>(C->getOperand(i));
+      if (Op) {
+         find_pointers(Op, Pointers, Visited);
+      }
+   }
+}
+
+
+/*
+ * The addresses of helper functions and tables change from run to run
+ * (ASLR), so they can neither go into the key nor into cached code.
+ * Replace each of them with an external symbol named after the library it
+ * points into and the offset there, which the JIT resolves to the address
+ * of this process, and hash the identity of those libraries instead.
+ * Returns false if some pointer can't be named that way, in which case
+ * the module must not be cached.
+ */
+static bool
+relocate_pointers(llvm::Module *M, struct mesa_sha1 *ctx)
+{
+   std::vector<llvm::ConstantExpr *> Pointers;
+   std::set<llvm::Constant *> Visited;
+
+   for (llvm::Module::iterator F = M->begin(); F != M->end(); ++F) {
+      for (llvm::Function::iterator BB = F->begin(); BB != F->end(); ++BB) {
+         for (llvm::BasicBlock::iterator I = BB->begin(); I != BB->end(); ++I) {
+            for (unsigned i = 0; i < I->getNumOperands(); i++) {
+               llvm::Constant *C =
+                  llvm::dyn_cast<llvm::Constant>(I->getOperand(i));
+               if (C) {
+                  find_pointers(C, Pointers, Visited);
+               }
+            }
+         }
+      }
+   }
+
+   if (Pointers.empty()) {
+      return true;
+   }
+
+#if defined(HAVE_DLADDR)
+   std::set<std::string> Libraries;
+   llvm::Type *Int8Ty = llvm::Type::getInt8Ty(M->getContext());
+
+   for (size_t i = 0; i < Pointers.size(); i++) {
+      llvm::ConstantExpr *CE = Pointers[i];
+      uint64_t Address =
+         llvm::cast<llvm::ConstantInt>(CE->getOperand(0))->getZExtValue();
+      void *Ptr = (void *)(uintptr_t)Address;
+      Dl_info Info;
+
+      if (!dladdr(Ptr, &Info) || !Info.dli_fname || !Info.dli_fbase) {
+         return false;
+      }
+
+      std::string Library(Info.dli_fname);
+      if (Libraries.insert(Library).second) {
+         struct stat st;
+
+         if (stat(Info.dli_fname, &st) != 0) {
+            return false;
+         }
+         _mesa_sha1_update(ctx, Library.data(), Library.size() + 1);
+         _mesa_sha1_update(ctx, &st.st_mtime, sizeof st.st_mtime);
+         _mesa_sha1_update(ctx, &st.st_size, sizeof st.st_size);
+      }
+
+      std::string Name = "lp_ptr." + Library + "+0x" +
+         llvm::utohexstr(Address - (uintptr_t)Info.dli_fbase);
+
+      llvm::GlobalVariable *GV = M->getNamedGlobal(Name);
+      if (!GV) {
+         GV = new llvm::GlobalVariable(*M, Int8Ty, true,
+                                       llvm::GlobalValue::ExternalLinkage,
+                                       NULL, Name);
+      }
+      llvm::sys::DynamicLibrary::AddSymbol(Name, Ptr);
+
+      CE->replaceAllUsesWith(llvm::ConstantExpr::getBitCast(GV, CE->getType()));
+   }
+
+   return true;
+#else
+   return false;
+#endif
+}
+
+
+/*
+ * Hash the instruction set extensions only; the rest of util_cpu_caps,
+ * like the number of CPUs, doesn't affect the generated code.
+ */
+static void
+hash_cpu_features(struct mesa_sha1 *ctx)
+{
+   const unsigned char Features[] = {
+      (unsigned char) util_cpu_caps.has_mmx,
+      (unsigned char) util_cpu_caps.has_mmx2,
+      (unsigned char) util_cpu_caps.has_sse,
+      (unsigned char) util_cpu_caps.has_sse2,
+      (unsigned char) util_cpu_caps.has_sse3,
+      (unsigned char) util_cpu_caps.has_ssse3,
+      (unsigned char) util_cpu_caps.has_sse4_1,
+      (unsigned char) util_cpu_caps.has_sse4_2,
+      (unsigned char) util_cpu_caps.has_popcnt,
+      (unsigned char) util_cpu_caps.has_avx,
+      (unsigned char) util_cpu_caps.has_avx2,
+      (unsigned char) util_cpu_caps.has_avx512f,
+      (unsigned char) util_cpu_caps.has_f16c,
+      (unsigned char) util_cpu_caps.has_fma,
+      (unsigned char) util_cpu_caps.has_3dnow,
+      (unsigned char) util_cpu_caps.has_3dnow_ext,
+      (unsigned char) util_cpu_caps.has_xop,
+      (unsigned char) util_cpu_caps.has_altivec,
+   };
+
+   _mesa_sha1_update(ctx, Features, sizeof Features);
+}
+#endif
+
+
+/**
+ * Create the object cache for a module, before it gets optimized.
+ * The key covers everything that affects the generated code: the IR, the
+ * LLVM version, the host CPU and features, and the optimization level.
+ * The functions of the module are renamed so that the key doesn't depend
+ * on the order shaders were created in, and pointers into Mesa are
+ * replaced by symbols, see relocate_pointers().
+ * Returns NULL if the disk cache is disabled or unavailable, or if the
+ * module can't be cached.
+ */
+extern "C"
+struct lp_object_cache *
+lp_object_cache_create(LLVMModuleRef M, unsigned OptLevel)
+{
+#if HAVE_LLVM >= 0x0306 && defined(HAVE_SHA1)
+   unsigned char key[LP_DISK_CACHE_KEY_SIZE];
+   struct mesa_sha1 *ctx;
+
+   if (!lp_disk_cache_enabled()) {
+      return NULL;
+   }
+
+   ctx = _mesa_sha1_init();
+   if (!ctx) {
+      return NULL;
+   }
+
+   normalize_function_names(llvm::unwrap(M));
+
+   if (!relocate_pointers(llvm::unwrap(M), ctx)) {
+      _mesa_sha1_final(ctx, key);
+      return NULL;
+   }
+
+   llvm::StringRef CPU = llvm::sys::getHostCPUName();
+
+   hash_module_ir(llvm::unwrap(M), ctx);
+   _mesa_sha1_update(ctx, LLVM_VERSION_STRING, strlen(LLVM_VERSION_STRING));
+   _mesa_sha1_update(ctx, CPU.data(), CPU.size());
+   hash_cpu_features(ctx);
+   _mesa_sha1_update(ctx, &OptLevel, sizeof OptLevel);
+   _mesa_sha1_final(ctx, key);
+
+   return (struct lp_object_cache *) new ShaderObjectCache(key);
+#else
+   return NULL;
+#endif
+}
+
+
+/**
+ * Whether the module's code was found in the cache.
+ */
+extern "C"
+int
+lp_object_cache_is_hit(const struct lp_object_cache *cache)
+{
+#if HAVE_LLVM >= 0x0306 && defined(HAVE_SHA1)
+   return cache && ((const ShaderObjectCache *) cache)->hit();
+#else
+   return 0;
+#endif
+}
+
+
+/**
+ * Destroy the object cache.  Must be done after the execution engine which
+ * uses it is disposed of.
+ */
+extern "C"
+void
+lp_object_cache_destroy(struct lp_object_cache *cache)
+{
+#if HAVE_LLVM >= 0x0306 && defined(HAVE_SHA1)
+   delete (ShaderObjectCache *) cache;
+#endif
+}
+
+
 /**
  * Same as LLVMCreateJITCompilerForModule, but:
  * - allows using MCJIT and enabling AVX feature where available.
@@ -471,6 +863,7 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
                                         lp_generated_code **OutCode,
                                         LLVMModuleRef M,
                                         LLVMMCJITMemoryManagerRef CMM,
+                                        struct lp_object_cache *Cache,
                                         unsigned OptLevel,
                                         int useMCJIT,
                                         char **OutError)
@@ -580,11 +973,11 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
       MAttrs.push_back("-fma");
    }
    MAttrs.push_back(util_cpu_caps.has_avx2 ? "+avx2" : "-avx2");
-   /* disable avx512 and all subvariants */
+   /* only use avx512f, and disable all other avx512 subvariants */
 #if HAVE_LLVM >= 0x0304
    MAttrs.push_back("-avx512cd");
    MAttrs.push_back("-avx512er");
-   MAttrs.push_back("-avx512f");
+   MAttrs.push_back(util_cpu_caps.has_avx512f ? "+avx512f" : "-avx512f");
    MAttrs.push_back("-avx512pf");
 #endif
 #if HAVE_LLVM >= 0x0305
@@ -660,6 +1053,11 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
    JIT->RegisterJITEventListener(JEL);
 #endif
    if (JIT) {
+#if HAVE_LLVM >= 0x0306 && defined(HAVE_SHA1)
+      if (Cache) {
+         JIT->setObjectCache((ShaderObjectCache *) Cache);
+      }
+#endif
       *OutJIT = wrap(JIT);
       return 0;
    }
@@ -678,6 +1076,17 @@ lp_free_generated_code(struct lp_generated_code *code)
    ShaderMemoryManager::freeGeneratedCode(code);
 }
 
+/**
+ * Return the number of bytes of code and data sections emitted so far for
+ * the module.  Only meaningful once the module's code has been generated.
+ */
+extern "C"
+size_t
+lp_generated_code_size(const struct lp_generated_code *code)
+{
+   return code ? ShaderMemoryManager::getGeneratedCodeSize(code) : 0;
+}
+
 extern "C"
 LLVMMCJITMemoryManagerRef
 lp_get_default_memory_manager()
@@ -41,6 +41,7 @@ extern "C" {
 
 
 struct lp_generated_code;
+struct lp_object_cache;
 
 extern void
 gallivm_init_llvm_targets(void);
@@ -60,6 +61,7 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
                                         struct lp_generated_code **OutCode,
                                         LLVMModuleRef M,
                                         LLVMMCJITMemoryManagerRef MM,
+                                        struct lp_object_cache *cache,
                                         unsigned OptLevel,
                                         int useMCJIT,
                                         char **OutError);
@@ -67,6 +69,18 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
 extern void
 lp_free_generated_code(struct lp_generated_code *code);
 
+extern size_t
+lp_generated_code_size(const struct lp_generated_code *code);
+
+extern struct lp_object_cache *
+lp_object_cache_create(LLVMModuleRef M, unsigned OptLevel);
+
+extern int
+lp_object_cache_is_hit(const struct lp_object_cache *cache);
+
+extern void
+lp_object_cache_destroy(struct lp_object_cache *cache);
+
 extern LLVMMCJITMemoryManagerRef
 lp_get_default_memory_manager();
 
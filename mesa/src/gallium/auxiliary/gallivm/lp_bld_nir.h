@@ -0,0 +1,105 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * NIR to LLVM IR translation.
+ */
+
+#ifndef LP_BLD_NIR_H
+#define LP_BLD_NIR_H
+
+#include "gallivm/lp_bld.h"
+#include "gallivm/lp_bld_type.h"
+#include "pipe/p_compiler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct nir_shader;
+struct nir_shader_compiler_options;
+struct tgsi_token;
+struct tgsi_shader_info;
+struct lp_build_mask_context;
+struct lp_build_sampler_soa;
+
+
+/**
+ * The options NIR handed to lp_build_nir_prepare() should be built with.
+ */
+const struct nir_shader_compiler_options *
+lp_build_nir_compiler_options(void);
+
+
+/**
+ * Translate a TGSI shader to NIR and run the optimization passes on it.
+ * Returns NULL if the shader uses anything lp_build_nir_soa() can't
+ * handle, in which case the caller should stick to lp_build_tgsi_soa().
+ * The result is freed with ralloc_free().
+ */
+struct nir_shader *
+lp_build_nir_from_tgsi(const struct tgsi_token *tokens,
+                       const struct tgsi_shader_info *info);
+
+
+/**
+ * Lower and optimize a NIR shader into the form lp_build_nir_soa()
+ * expects: scalar ALU operations, SSA values except for phi webs and
+ * arrays, which live in registers.  Returns FALSE if the result can't be
+ * translated.
+ */
+boolean
+lp_build_nir_prepare(struct nir_shader *shader);
+
+
+/**
+ * Emit the code of a fragment shader prepared by lp_build_nir_prepare().
+ * The arguments have the same meaning as for lp_build_tgsi_soa(); \p info
+ * gives the input and output layout: the scan of the TGSI the shader was
+ * made from, or nir_tgsi_scan_shader()'s of NIR from the state tracker.
+ */
+void
+lp_build_nir_soa(struct gallivm_state *gallivm,
+                 struct nir_shader *shader,
+                 struct lp_type type,
+                 struct lp_build_mask_context *mask,
+                 LLVMValueRef consts_ptr,
+                 LLVMValueRef const_sizes_ptr,
+                 const LLVMValueRef (*inputs)[4],
+                 LLVMValueRef (*outputs)[4],
+                 LLVMValueRef context_ptr,
+                 LLVMValueRef thread_data_ptr,
+                 struct lp_build_sampler_soa *sampler,
+                 const struct tgsi_shader_info *info);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LP_BLD_NIR_H */
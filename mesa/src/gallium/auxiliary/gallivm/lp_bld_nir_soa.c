@@ -0,0 +1,1802 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * NIR to LLVM IR translation -- SoA.
+ *
+ * The execution model is the one of lp_bld_tgsi_soa.c: every SIMD lane
+ * runs all the code, with control flow turned into the lp_exec_mask, and
+ * textures go through the same lp_build_sampler_soa interface.  What
+ * differs is the representation of values.  The TGSI path keeps every
+ * temporary in an alloca and leaves it to LLVM to find out which
+ * loads and stores can go; here SSA values are plain LLVM values and only
+ * the registers NIR itself couldn't get rid of (phi webs, arrays) live in
+ * memory.  Having the SSA form also lets us see that a texture lod is the
+ * same for all pixels when it only depends on constants.
+ *
+ * Only fragment shaders are handled, after lp_build_nir_prepare().
+ */
+
+#include "pipe/p_shader_tokens.h"
+#include "util/u_debug.h"
+#include "util/u_memory.h"
+#include "util/ralloc.h"
+#include "tgsi/tgsi_scan.h"
+#include "compiler/nir/nir.h"
+#include "nir/tgsi_to_nir.h"
+#include "lp_bld_nir.h"
+#include "lp_bld_tgsi.h"
+#include "lp_bld_type.h"
+#include "lp_bld_const.h"
+#include "lp_bld_arit.h"
+#include "lp_bld_bitarit.h"
+#include "lp_bld_init.h"
+#include "lp_bld_logic.h"
+#include "lp_bld_swizzle.h"
+#include "lp_bld_flow.h"
+#include "lp_bld_quad.h"
+#include "lp_bld_limits.h"
+#include "lp_bld_debug.h"
+#include "lp_bld_sample.h"
+#include "lp_bld_struct.h"
+
+
+/*
+ * How deep to look through ALU instructions when checking whether a
+ * value is the same for all pixels.
+ */
+#define LP_NIR_UNIFORM_DEPTH 8
+
+
+struct lp_build_nir_soa_context
+{
+   struct gallivm_state *gallivm;
+
+   struct lp_build_context base;       /**< float vectors */
+   struct lp_build_context int_bld;
+   struct lp_build_context uint_bld;
+
+   struct lp_build_mask_context *mask;
+   struct lp_exec_mask exec_mask;
+
+   nir_function_impl *impl;
+   const struct tgsi_shader_info *info;
+
+   LLVMValueRef consts_ptr;
+   LLVMValueRef const_sizes_ptr;
+   LLVMValueRef consts[LP_MAX_TGSI_CONST_BUFFERS];
+   LLVMValueRef consts_sizes[LP_MAX_TGSI_CONST_BUFFERS];
+
+   const LLVMValueRef (*inputs)[TGSI_NUM_CHANNELS];
+   LLVMValueRef (*outputs)[TGSI_NUM_CHANNELS];
+
+   LLVMValueRef context_ptr;
+   LLVMValueRef thread_data_ptr;
+   struct lp_build_sampler_soa *sampler;
+
+   /** TGSI input index of the front face, or -1 */
+   int face_input;
+
+   /**
+    * Values of the SSA definitions, indexed by nir_ssa_def::index, as
+    * float vectors whatever their NIR type.
+    */
+   LLVMValueRef (*ssa_defs)[TGSI_NUM_CHANNELS];
+
+   /**
+    * Allocas for the SSA definitions made inside a loop and used after
+    * it.  Lanes leave a loop in different iterations, so such a value
+    * must be merged with the execution mask like a register.
+    */
+   LLVMValueRef (*ssa_vars)[TGSI_NUM_CHANNELS];
+
+   /**
+    * Allocas for the registers, indexed by nir_register::index, with
+    * num_components entries per array element.
+    */
+   LLVMValueRef **regs;
+};
+
+
+/*
+ * Checking whether a shader can be translated.
+ */
+
+static boolean
+alu_op_supported(nir_op op)
+{
+   switch (op) {
+   case nir_op_fmov:
+   case nir_op_imov:
+   case nir_op_fneg:
+   case nir_op_ineg:
+   case nir_op_inot:
+   case nir_op_fsign:
+   case nir_op_isign:
+   case nir_op_fabs:
+   case nir_op_iabs:
+   case nir_op_fsat:
+   case nir_op_frcp:
+   case nir_op_frsq:
+   case nir_op_fsqrt:
+   case nir_op_fexp2:
+   case nir_op_flog2:
+   case nir_op_f2i:
+   case nir_op_f2u:
+   case nir_op_i2f:
+   case nir_op_u2f:
+   case nir_op_f2b:
+   case nir_op_i2b:
+   case nir_op_b2f:
+   case nir_op_b2i:
+   case nir_op_ftrunc:
+   case nir_op_fceil:
+   case nir_op_ffloor:
+   case nir_op_ffract:
+   case nir_op_fround_even:
+   case nir_op_fsin:
+   case nir_op_fcos:
+   case nir_op_fddx:
+   case nir_op_fddy:
+   case nir_op_fddx_fine:
+   case nir_op_fddy_fine:
+   case nir_op_fddx_coarse:
+   case nir_op_fddy_coarse:
+   case nir_op_fadd:
+   case nir_op_iadd:
+   case nir_op_fsub:
+   case nir_op_isub:
+   case nir_op_fmul:
+   case nir_op_imul:
+   case nir_op_fdiv:
+   case nir_op_idiv:
+   case nir_op_udiv:
+   case nir_op_umod:
+   case nir_op_flt:
+   case nir_op_fge:
+   case nir_op_feq:
+   case nir_op_fne:
+   case nir_op_ilt:
+   case nir_op_ige:
+   case nir_op_ieq:
+   case nir_op_ine:
+   case nir_op_ult:
+   case nir_op_uge:
+   case nir_op_slt:
+   case nir_op_sge:
+   case nir_op_seq:
+   case nir_op_sne:
+   case nir_op_ishl:
+   case nir_op_ishr:
+   case nir_op_ushr:
+   case nir_op_iand:
+   case nir_op_ior:
+   case nir_op_ixor:
+   case nir_op_fmin:
+   case nir_op_fmax:
+   case nir_op_imin:
+   case nir_op_imax:
+   case nir_op_umin:
+   case nir_op_umax:
+   case nir_op_fpow:
+   case nir_op_ffma:
+   case nir_op_fcsel:
+   case nir_op_bcsel:
+   case nir_op_vec2:
+   case nir_op_vec3:
+   case nir_op_vec4:
+      return TRUE;
+   default:
+      return FALSE;
+   }
+}
+
+
+static bool
+src_supported(nir_src *src, void *state)
+{
+   if (src->is_ssa)
+      return src->ssa->bit_size == 32;
+   return !src->reg.indirect && !src->reg.reg->is_global;
+}
+
+
+static bool
+dest_supported(nir_dest *dest, void *state)
+{
+   if (dest->is_ssa)
+      return dest->ssa.bit_size == 32;
+   return !dest->reg.indirect && !dest->reg.reg->is_global;
+}
+
+
+static boolean
+intrinsic_supported(const nir_intrinsic_instr *instr)
+{
+   switch (instr->intrinsic) {
+   case nir_intrinsic_load_input:
+      return nir_src_as_const_value(instr->src[0]) != NULL;
+   case nir_intrinsic_store_output:
+      return nir_src_as_const_value(instr->src[1]) != NULL;
+   case nir_intrinsic_load_ubo:
+      /* the block must be known, the offset may vary */
+      return nir_src_as_const_value(instr->src[0]) != NULL;
+   case nir_intrinsic_load_uniform:
+   case nir_intrinsic_load_front_face:
+   case nir_intrinsic_discard:
+   case nir_intrinsic_discard_if:
+      return TRUE;
+   default:
+      return FALSE;
+   }
+}
+
+
+static boolean
+tex_supported(const nir_tex_instr *instr)
+{
+   unsigned i;
+
+   if (instr->texture || instr->sampler)
+      return FALSE;
+
+   switch (instr->op) {
+   case nir_texop_tex:
+   case nir_texop_txb:
+   case nir_texop_txl:
+   case nir_texop_txd:
+      break;
+   default:
+      return FALSE;
+   }
+
+   switch (instr->sampler_dim) {
+   case GLSL_SAMPLER_DIM_1D:
+   case GLSL_SAMPLER_DIM_2D:
+   case GLSL_SAMPLER_DIM_RECT:
+   case GLSL_SAMPLER_DIM_3D:
+      break;
+   case GLSL_SAMPLER_DIM_CUBE:
+      /* TGSI passes the lod of these in a second register, which
+       * tgsi_to_nir doesn't look at.
+       */
+      if ((instr->is_array || instr->is_shadow) &&
+          (instr->op == nir_texop_txb || instr->op == nir_texop_txl))
+         return FALSE;
+      break;
+   default:
+      return FALSE;
+   }
+
+   for (i = 0; i < instr->num_srcs; i++) {
+      switch (instr->src[i].src_type) {
+      case nir_tex_src_coord:
+      case nir_tex_src_comparitor:
+      case nir_tex_src_offset:
+      case nir_tex_src_bias:
+      case nir_tex_src_lod:
+      case nir_tex_src_ddx:
+      case nir_tex_src_ddy:
+         break;
+      default:
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+
+static boolean
+instr_supported(nir_instr *instr)
+{
+   if (!nir_foreach_src(instr, src_supported, NULL) ||
+       !nir_foreach_dest(instr, dest_supported, NULL))
+      return FALSE;
+
+   switch (instr->type) {
+   case nir_instr_type_alu:
+      return alu_op_supported(nir_instr_as_alu(instr)->op);
+   case nir_instr_type_intrinsic:
+      return intrinsic_supported(nir_instr_as_intrinsic(instr));
+   case nir_instr_type_tex:
+      return tex_supported(nir_instr_as_tex(instr));
+   case nir_instr_type_load_const:
+      return nir_instr_as_load_const(instr)->def.bit_size == 32;
+   case nir_instr_type_ssa_undef:
+      return TRUE;
+   case nir_instr_type_jump:
+      return nir_instr_as_jump(instr)->type != nir_jump_return;
+   default:
+      return FALSE;
+   }
+}
+
+
+static boolean
+shader_supported(nir_shader *shader)
+{
+   nir_function_impl *impl;
+
+   if (shader->stage != MESA_SHADER_FRAGMENT ||
+       exec_list_length(&shader->functions) != 1 ||
+       !exec_list_is_empty(&shader->registers))
+      return FALSE;
+
+   impl = nir_shader_get_entrypoint(shader);
+
+   foreach_list_typed(nir_register, reg, node, &impl->registers) {
+      if (reg->bit_size != 32 || reg->num_components > 4)
+         return FALSE;
+   }
+
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block) {
+         if (!instr_supported(instr))
+            return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+
+boolean
+lp_build_nir_prepare(struct nir_shader *s)
+{
+   static const nir_lower_tex_options tex_options = {
+      .lower_txp = ~0,
+   };
+   bool progress;
+
+   NIR_PASS_V(s, nir_opt_global_to_local);
+   NIR_PASS_V(s, nir_convert_to_ssa);
+   NIR_PASS_V(s, nir_lower_tex, &tex_options);
+   NIR_PASS_V(s, nir_lower_load_const_to_scalar);
+
+   do {
+      progress = false;
+
+      NIR_PASS_V(s, nir_lower_vars_to_ssa);
+      NIR_PASS_V(s, nir_lower_alu_to_scalar);
+      NIR_PASS_V(s, nir_lower_phis_to_scalar);
+
+      NIR_PASS(progress, s, nir_copy_prop);
+      NIR_PASS(progress, s, nir_opt_remove_phis);
+      NIR_PASS(progress, s, nir_opt_dce);
+      NIR_PASS(progress, s, nir_opt_dead_cf);
+      NIR_PASS(progress, s, nir_opt_cse);
+      NIR_PASS(progress, s, nir_opt_peephole_select);
+      NIR_PASS(progress, s, nir_opt_algebraic);
+      NIR_PASS(progress, s, nir_opt_constant_folding);
+      NIR_PASS(progress, s, nir_opt_undef);
+   } while (progress);
+
+   /* Whatever is left of the temporary arrays becomes registers. */
+   NIR_PASS_V(s, nir_lower_locals_to_regs);
+   NIR_PASS_V(s, nir_remove_dead_variables, nir_var_local);
+   NIR_PASS_V(s, nir_convert_from_ssa, true);
+   NIR_PASS_V(s, nir_opt_dce);
+   nir_sweep(s);
+
+   if (!shader_supported(s))
+      return FALSE;
+
+   /*
+    * Index once here: variants may be compiled on several threads at a
+    * time, and lp_build_nir_soa() must not touch the shader.
+    */
+   nir_index_local_regs(nir_shader_get_entrypoint(s));
+   nir_index_ssa_defs(nir_shader_get_entrypoint(s));
+
+   return TRUE;
+}
+
+
+/*
+ * TGSI which tgsi_to_nir translates to something lp_build_nir_soa can
+ * deal with.  tgsi_to_nir aborts on anything it doesn't know, so this
+ * must be checked before calling it.
+ */
+
+static boolean
+tgsi_opcode_supported(unsigned opcode)
+{
+   switch (opcode) {
+   case TGSI_OPCODE_ARL:
+   case TGSI_OPCODE_MOV:
+   case TGSI_OPCODE_LIT:
+   case TGSI_OPCODE_RCP:
+   case TGSI_OPCODE_RSQ:
+   case TGSI_OPCODE_EXP:
+   case TGSI_OPCODE_LOG:
+   case TGSI_OPCODE_MUL:
+   case TGSI_OPCODE_ADD:
+   case TGSI_OPCODE_DP3:
+   case TGSI_OPCODE_DP4:
+   case TGSI_OPCODE_DST:
+   case TGSI_OPCODE_MIN:
+   case TGSI_OPCODE_MAX:
+   case TGSI_OPCODE_SLT:
+   case TGSI_OPCODE_SGE:
+   case TGSI_OPCODE_MAD:
+   case TGSI_OPCODE_SUB:
+   case TGSI_OPCODE_LRP:
+   case TGSI_OPCODE_SQRT:
+   case TGSI_OPCODE_DP2A:
+   case TGSI_OPCODE_FRC:
+   case TGSI_OPCODE_CLAMP:
+   case TGSI_OPCODE_FLR:
+   case TGSI_OPCODE_ROUND:
+   case TGSI_OPCODE_EX2:
+   case TGSI_OPCODE_LG2:
+   case TGSI_OPCODE_POW:
+   case TGSI_OPCODE_XPD:
+   case TGSI_OPCODE_ABS:
+   case TGSI_OPCODE_DPH:
+   case TGSI_OPCODE_COS:
+   case TGSI_OPCODE_DDX:
+   case TGSI_OPCODE_DDY:
+   case TGSI_OPCODE_KILL:
+   case TGSI_OPCODE_SEQ:
+   case TGSI_OPCODE_SGT:
+   case TGSI_OPCODE_SIN:
+   case TGSI_OPCODE_SLE:
+   case TGSI_OPCODE_SNE:
+   case TGSI_OPCODE_TEX:
+   case TGSI_OPCODE_TXD:
+   case TGSI_OPCODE_TXP:
+   case TGSI_OPCODE_ARR:
+   case TGSI_OPCODE_CMP:
+   case TGSI_OPCODE_SCS:
+   case TGSI_OPCODE_TXB:
+   case TGSI_OPCODE_DIV:
+   case TGSI_OPCODE_DP2:
+   case TGSI_OPCODE_TXL:
+   case TGSI_OPCODE_BRK:
+   case TGSI_OPCODE_IF:
+   case TGSI_OPCODE_UIF:
+   case TGSI_OPCODE_ELSE:
+   case TGSI_OPCODE_ENDIF:
+   case TGSI_OPCODE_DDX_FINE:
+   case TGSI_OPCODE_DDY_FINE:
+   case TGSI_OPCODE_CEIL:
+   case TGSI_OPCODE_I2F:
+   case TGSI_OPCODE_NOT:
+   case TGSI_OPCODE_TRUNC:
+   case TGSI_OPCODE_SHL:
+   case TGSI_OPCODE_AND:
+   case TGSI_OPCODE_OR:
+   case TGSI_OPCODE_XOR:
+   case TGSI_OPCODE_SSG:
+   case TGSI_OPCODE_KILL_IF:
+   case TGSI_OPCODE_END:
+   case TGSI_OPCODE_NOP:
+   case TGSI_OPCODE_BGNLOOP:
+   case TGSI_OPCODE_ENDLOOP:
+   case TGSI_OPCODE_CONT:
+   case TGSI_OPCODE_F2I:
+   case TGSI_OPCODE_FSEQ:
+   case TGSI_OPCODE_FSGE:
+   case TGSI_OPCODE_FSLT:
+   case TGSI_OPCODE_FSNE:
+   case TGSI_OPCODE_IDIV:
+   case TGSI_OPCODE_IMAX:
+   case TGSI_OPCODE_IMIN:
+   case TGSI_OPCODE_INEG:
+   case TGSI_OPCODE_ISGE:
+   case TGSI_OPCODE_ISHR:
+   case TGSI_OPCODE_ISLT:
+   case TGSI_OPCODE_F2U:
+   case TGSI_OPCODE_U2F:
+   case TGSI_OPCODE_UADD:
+   case TGSI_OPCODE_UDIV:
+   case TGSI_OPCODE_UMAD:
+   case TGSI_OPCODE_UMAX:
+   case TGSI_OPCODE_UMIN:
+   case TGSI_OPCODE_UMOD:
+   case TGSI_OPCODE_UMUL:
+   case TGSI_OPCODE_USEQ:
+   case TGSI_OPCODE_USGE:
+   case TGSI_OPCODE_USHR:
+   case TGSI_OPCODE_USLT:
+   case TGSI_OPCODE_USNE:
+   case TGSI_OPCODE_UCMP:
+   case TGSI_OPCODE_UARL:
+   case TGSI_OPCODE_IABS:
+   case TGSI_OPCODE_ISSG:
+      return TRUE;
+   default:
+      return FALSE;
+   }
+}
+
+
+static boolean
+tgsi_supported(const struct tgsi_shader_info *info)
+{
+   unsigned i;
+
+   if (info->processor != PIPE_SHADER_FRAGMENT)
+      return FALSE;
+
+   for (i = 0; i < TGSI_FILE_COUNT; i++) {
+      switch (i) {
+      case TGSI_FILE_CONSTANT:
+      case TGSI_FILE_INPUT:
+      case TGSI_FILE_OUTPUT:
+      case TGSI_FILE_TEMPORARY:
+      case TGSI_FILE_SAMPLER:
+      case TGSI_FILE_ADDRESS:
+      case TGSI_FILE_IMMEDIATE:
+      case TGSI_FILE_SAMPLER_VIEW:
+         break;
+      default:
+         if (info->file_count[i])
+            return FALSE;
+      }
+   }
+
+   for (i = 0; i < TGSI_OPCODE_LAST; i++) {
+      if (info->opcode_count[i] && !tgsi_opcode_supported(i))
+         return FALSE;
+   }
+
+   for (i = 0; i < info->num_inputs; i++) {
+      switch (info->input_semantic_name[i]) {
+      case TGSI_SEMANTIC_POSITION:
+      case TGSI_SEMANTIC_COLOR:
+      case TGSI_SEMANTIC_BCOLOR:
+      case TGSI_SEMANTIC_FOG:
+      case TGSI_SEMANTIC_GENERIC:
+      case TGSI_SEMANTIC_FACE:
+      case TGSI_SEMANTIC_PRIMID:
+      case TGSI_SEMANTIC_CLIPDIST:
+      case TGSI_SEMANTIC_TEXCOORD:
+      case TGSI_SEMANTIC_PCOORD:
+      case TGSI_SEMANTIC_VIEWPORT_INDEX:
+      case TGSI_SEMANTIC_LAYER:
+         break;
+      default:
+         return FALSE;
+      }
+   }
+
+   for (i = 0; i < info->num_outputs; i++) {
+      if (info->output_semantic_name[i] != TGSI_SEMANTIC_COLOR &&
+          info->output_semantic_name[i] != TGSI_SEMANTIC_POSITION)
+         return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+static const nir_shader_compiler_options lp_nir_options = {
+   .lower_flrp32 = true,
+   .lower_fmod32 = true,
+   .lower_bitfield_extract = true,
+   .lower_bitfield_insert = true,
+   .lower_uadd_carry = true,
+   .lower_usub_borrow = true,
+   .lower_pack_unorm_2x16 = true,
+   .lower_pack_snorm_2x16 = true,
+   .lower_pack_unorm_4x8 = true,
+   .lower_pack_snorm_4x8 = true,
+   .lower_unpack_unorm_2x16 = true,
+   .lower_unpack_snorm_2x16 = true,
+   .lower_unpack_unorm_4x8 = true,
+   .lower_unpack_snorm_4x8 = true,
+   .lower_extract_byte = true,
+   .lower_extract_word = true,
+   .native_integers = true,
+};
+
+
+const struct nir_shader_compiler_options *
+lp_build_nir_compiler_options(void)
+{
+   return &lp_nir_options;
+}
+
+
+struct nir_shader *
+lp_build_nir_from_tgsi(const struct tgsi_token *tokens,
+                       const struct tgsi_shader_info *info)
+{
+   struct nir_shader *s;
+
+   if (!tgsi_supported(info))
+      return NULL;
+
+   s = tgsi_to_nir(tokens, &lp_nir_options);
+   if (!s)
+      return NULL;
+
+   if (!lp_build_nir_prepare(s)) {
+      ralloc_free(s);
+      return NULL;
+   }
+
+   return s;
+}
+
+
+/*
+ * Values.
+ */
+
+static LLVMValueRef
+to_int(struct lp_build_nir_soa_context *bld, LLVMValueRef val)
+{
+   return LLVMBuildBitCast(bld->gallivm->builder, val,
+                           bld->int_bld.vec_type, "");
+}
+
+
+static LLVMValueRef
+to_float(struct lp_build_nir_soa_context *bld, LLVMValueRef val)
+{
+   return LLVMBuildBitCast(bld->gallivm->builder, val,
+                           bld->base.vec_type, "");
+}
+
+
+static LLVMValueRef *
+reg_chan_ptr(struct lp_build_nir_soa_context *bld,
+             const nir_register *reg, unsigned base_offset, unsigned chan)
+{
+   assert(chan < reg->num_components);
+   return &bld->regs[reg->index][base_offset * reg->num_components + chan];
+}
+
+
+/** Fetch channel \p chan of \p src, as a float vector. */
+static LLVMValueRef
+get_src(struct lp_build_nir_soa_context *bld, nir_src src, unsigned chan)
+{
+   LLVMBuilderRef builder = bld->gallivm->builder;
+
+   if (src.is_ssa) {
+      LLVMValueRef var = bld->ssa_vars[src.ssa->index][chan];
+
+      if (var)
+         return LLVMBuildLoad(builder, var, "");
+
+      assert(bld->ssa_defs[src.ssa->index][chan]);
+      return bld->ssa_defs[src.ssa->index][chan];
+   }
+
+   return LLVMBuildLoad(builder,
+                        *reg_chan_ptr(bld, src.reg.reg,
+                                      src.reg.base_offset, chan), "");
+}
+
+
+/** Set channel \p chan of \p dest to the float vector \p val. */
+static void
+assign_dest(struct lp_build_nir_soa_context *bld, nir_dest *dest,
+            unsigned chan, LLVMValueRef val)
+{
+   assert(LLVMTypeOf(val) == bld->base.vec_type);
+
+   if (dest->is_ssa) {
+      LLVMValueRef var = bld->ssa_vars[dest->ssa.index][chan];
+
+      bld->ssa_defs[dest->ssa.index][chan] = val;
+      if (var)
+         lp_exec_mask_store(&bld->exec_mask, &bld->base, NULL, val, var);
+      return;
+   }
+
+   lp_exec_mask_store(&bld->exec_mask, &bld->base, NULL, val,
+                      *reg_chan_ptr(bld, dest->reg.reg,
+                                    dest->reg.base_offset, chan));
+}
+
+
+static unsigned
+dest_num_components(const nir_dest *dest)
+{
+   return dest->is_ssa ? dest->ssa.num_components :
+                         dest->reg.reg->num_components;
+}
+
+
+/**
+ * Whether \p def has the same value for all pixels, that is, it only
+ * depends on constants and uniforms.
+ */
+static boolean
+ssa_is_uniform(const nir_ssa_def *def, unsigned depth)
+{
+   nir_instr *instr = def->parent_instr;
+
+   switch (instr->type) {
+   case nir_instr_type_load_const:
+      return TRUE;
+
+   case nir_instr_type_intrinsic: {
+      nir_intrinsic_instr *intr = nir_instr_as_intrinsic(instr);
+
+      switch (intr->intrinsic) {
+      case nir_intrinsic_load_uniform:
+         return nir_src_as_const_value(intr->src[0]) != NULL;
+      case nir_intrinsic_load_ubo:
+         return nir_src_as_const_value(intr->src[1]) != NULL;
+      default:
+         return FALSE;
+      }
+   }
+
+   case nir_instr_type_alu: {
+      nir_alu_instr *alu = nir_instr_as_alu(instr);
+      unsigned i;
+
+      if (depth == 0)
+         return FALSE;
+
+      switch (alu->op) {
+      case nir_op_fddx:
+      case nir_op_fddy:
+      case nir_op_fddx_fine:
+      case nir_op_fddy_fine:
+      case nir_op_fddx_coarse:
+      case nir_op_fddy_coarse:
+         /* zero for uniform operands, but not worth the trouble */
+         return FALSE;
+      default:
+         break;
+      }
+
+      for (i = 0; i < nir_op_infos[alu->op].num_inputs; i++) {
+         if (!alu->src[i].src.is_ssa ||
+             !ssa_is_uniform(alu->src[i].src.ssa, depth - 1))
+            return FALSE;
+      }
+      return TRUE;
+   }
+
+   default:
+      return FALSE;
+   }
+}
+
+
+/*
+ * ALU instructions.
+ */
+
+static LLVMValueRef
+get_alu_src(struct lp_build_nir_soa_context *bld,
+            const nir_alu_instr *instr, unsigned src, unsigned chan)
+{
+   const nir_alu_src *alu_src = &instr->src[src];
+   nir_alu_type type =
+      nir_alu_type_get_base_type(nir_op_infos[instr->op].input_types[src]);
+   LLVMValueRef val = get_src(bld, alu_src->src, alu_src->swizzle[chan]);
+
+   if (type == nir_type_float) {
+      if (alu_src->abs)
+         val = lp_build_abs(&bld->base, val);
+      if (alu_src->negate)
+         val = lp_build_negate(&bld->base, val);
+   }
+   else {
+      val = to_int(bld, val);
+      if (alu_src->abs)
+         val = lp_build_abs(&bld->int_bld, val);
+      if (alu_src->negate)
+         val = lp_build_negate(&bld->int_bld, val);
+   }
+
+   return val;
+}
+
+
+/**
+ * Integer division by zero must not trap; the results are the ones of
+ * the TGSI path.
+ */
+static LLVMValueRef
+emit_div(struct lp_build_nir_soa_context *bld, nir_op op,
+         LLVMValueRef a, LLVMValueRef b)
+{
+   LLVMBuilderRef builder = bld->gallivm->builder;
+   struct lp_build_context *uint_bld = &bld->uint_bld;
+   LLVMValueRef div_mask = lp_build_cmp(uint_bld, PIPE_FUNC_EQUAL,
+                                        b, uint_bld->zero);
+   LLVMValueRef divisor = LLVMBuildOr(builder, div_mask, b, "");
+   LLVMValueRef result;
+
+   switch (op) {
+   case nir_op_idiv:
+      result = lp_build_div(&bld->int_bld, a, divisor);
+      return LLVMBuildAnd(builder, LLVMBuildNot(builder, div_mask, ""),
+                          result, "");
+   case nir_op_udiv:
+      result = lp_build_div(uint_bld, a, divisor);
+      return LLVMBuildOr(builder, div_mask, result, "");
+   case nir_op_umod:
+   default:
+      result = lp_build_mod(uint_bld, a, divisor);
+      return LLVMBuildOr(builder, div_mask, result, "");
+   }
+}
+
+
+static LLVMValueRef
+emit_shift(struct lp_build_nir_soa_context *bld, nir_op op,
+           LLVMValueRef a, LLVMValueRef b)
+{
+   struct lp_build_context *uint_bld = &bld->uint_bld;
+   LLVMValueRef mask = lp_build_const_int_vec(bld->gallivm, uint_bld->type,
+                                              uint_bld->type.width - 1);
+
+   b = lp_build_and(uint_bld, b, mask);
+
+   switch (op) {
+   case nir_op_ishl:
+      return lp_build_shl(uint_bld, a, b);
+   case nir_op_ishr:
+      return lp_build_shr(&bld->int_bld, a, b);
+   case nir_op_ushr:
+   default:
+      return lp_build_shr(uint_bld, a, b);
+   }
+}
+
+
+static LLVMValueRef
+emit_alu_chan(struct lp_build_nir_soa_context *bld, nir_op op,
+              LLVMValueRef *src)
+{
+   LLVMBuilderRef builder = bld->gallivm->builder;
+   struct lp_build_context *base = &bld->base;
+   struct lp_build_context *int_bld = &bld->int_bld;
+   struct lp_build_context *uint_bld = &bld->uint_bld;
+
+   switch (op) {
+   case nir_op_fmov:
+   case nir_op_imov:
+      return src[0];
+   case nir_op_fneg:
+      return lp_build_negate(base, src[0]);
+   case nir_op_ineg:
+      return lp_build_negate(int_bld, src[0]);
+   case nir_op_inot:
+      return lp_build_not(int_bld, src[0]);
+   case nir_op_fsign:
+      return lp_build_sgn(base, src[0]);
+   case nir_op_isign:
+      return lp_build_sgn(int_bld, src[0]);
+   case nir_op_fabs:
+      return lp_build_abs(base, src[0]);
+   case nir_op_iabs:
+      return lp_build_abs(int_bld, src[0]);
+   case nir_op_fsat:
+      return lp_build_clamp_zero_one_nanzero(base, src[0]);
+   case nir_op_frcp:
+      return lp_build_rcp(base, src[0]);
+   case nir_op_frsq:
+      return lp_build_rsqrt(base, src[0]);
+   case nir_op_fsqrt:
+      return lp_build_sqrt(base, src[0]);
+   case nir_op_fexp2:
+      return lp_build_exp2(base, src[0]);
+   case nir_op_flog2:
+      return lp_build_log2_safe(base, src[0]);
+   case nir_op_f2i:
+      return lp_build_itrunc(base, src[0]);
+   case nir_op_f2u:
+      return LLVMBuildFPToUI(builder, src[0], uint_bld->vec_type, "");
+   case nir_op_i2f:
+      return lp_build_int_to_float(base, src[0]);
+   case nir_op_u2f:
+      return LLVMBuildUIToFP(builder, src[0], base->vec_type, "");
+   case nir_op_f2b:
+      return lp_build_cmp(base, PIPE_FUNC_NOTEQUAL, src[0], base->zero);
+   case nir_op_i2b:
+      return lp_build_cmp(int_bld, PIPE_FUNC_NOTEQUAL, src[0], int_bld->zero);
+   case nir_op_b2f:
+      return lp_build_select(base, src[0], base->one, base->zero);
+   case nir_op_b2i:
+      return lp_build_and(int_bld, src[0], int_bld->one);
+   case nir_op_ftrunc:
+      return lp_build_trunc(base, src[0]);
+   case nir_op_fceil:
+      return lp_build_ceil(base, src[0]);
+   case nir_op_ffloor:
+      return lp_build_floor(base, src[0]);
+   case nir_op_ffract:
+      return lp_build_fract(base, src[0]);
+   case nir_op_fround_even:
+      return lp_build_round(base, src[0]);
+   case nir_op_fsin:
+      return lp_build_sin(base, src[0]);
+   case nir_op_fcos:
+      return lp_build_cos(base, src[0]);
+   case nir_op_fddx:
+   case nir_op_fddx_fine:
+   case nir_op_fddx_coarse:
+      return lp_build_ddx(base, src[0]);
+   case nir_op_fddy:
+   case nir_op_fddy_fine:
+   case nir_op_fddy_coarse:
+      return lp_build_ddy(base, src[0]);
+
+   case nir_op_fadd:
+      return lp_build_add(base, src[0], src[1]);
+   case nir_op_iadd:
+      return lp_build_add(int_bld, src[0], src[1]);
+   case nir_op_fsub:
+      return lp_build_sub(base, src[0], src[1]);
+   case nir_op_isub:
+      return lp_build_sub(int_bld, src[0], src[1]);
+   case nir_op_fmul:
+      return lp_build_mul(base, src[0], src[1]);
+   case nir_op_imul:
+      return lp_build_mul(int_bld, src[0], src[1]);
+   case nir_op_fdiv:
+      return lp_build_div(base, src[0], src[1]);
+   case nir_op_idiv:
+   case nir_op_udiv:
+   case nir_op_umod:
+      return emit_div(bld, op, src[0], src[1]);
+
+   case nir_op_flt:
+      return lp_build_cmp_ordered(base, PIPE_FUNC_LESS, src[0], src[1]);
+   case nir_op_fge:
+      return lp_build_cmp_ordered(base, PIPE_FUNC_GEQUAL, src[0], src[1]);
+   case nir_op_feq:
+      return lp_build_cmp_ordered(base, PIPE_FUNC_EQUAL, src[0], src[1]);
+   case nir_op_fne:
+      return lp_build_cmp(base, PIPE_FUNC_NOTEQUAL, src[0], src[1]);
+   case nir_op_ilt:
+      return lp_build_cmp(int_bld, PIPE_FUNC_LESS, src[0], src[1]);
+   case nir_op_ige:
+      return lp_build_cmp(int_bld, PIPE_FUNC_GEQUAL, src[0], src[1]);
+   case nir_op_ieq:
+      return lp_build_cmp(int_bld, PIPE_FUNC_EQUAL, src[0], src[1]);
+   case nir_op_ine:
+      return lp_build_cmp(int_bld, PIPE_FUNC_NOTEQUAL, src[0], src[1]);
+   case nir_op_ult:
+      return lp_build_cmp(uint_bld, PIPE_FUNC_LESS, src[0], src[1]);
+   case nir_op_uge:
+      return lp_build_cmp(uint_bld, PIPE_FUNC_GEQUAL, src[0], src[1]);
+   case nir_op_slt:
+      return lp_build_select(base,
+                             lp_build_cmp_ordered(base, PIPE_FUNC_LESS,
+                                                  src[0], src[1]),
+                             base->one, base->zero);
+   case nir_op_sge:
+      return lp_build_select(base,
+                             lp_build_cmp_ordered(base, PIPE_FUNC_GEQUAL,
+                                                  src[0], src[1]),
+                             base->one, base->zero);
+   case nir_op_seq:
+      return lp_build_select(base,
+                             lp_build_cmp_ordered(base, PIPE_FUNC_EQUAL,
+                                                  src[0], src[1]),
+                             base->one, base->zero);
+   case nir_op_sne:
+      return lp_build_select(base,
+                             lp_build_cmp(base, PIPE_FUNC_NOTEQUAL,
+                                          src[0], src[1]),
+                             base->one, base->zero);
+
+   case nir_op_ishl:
+   case nir_op_ishr:
+   case nir_op_ushr:
+      return emit_shift(bld, op, src[0], src[1]);
+   case nir_op_iand:
+      return lp_build_and(int_bld, src[0], src[1]);
+   case nir_op_ior:
+      return lp_build_or(int_bld, src[0], src[1]);
+   case nir_op_ixor:
+      return lp_build_xor(int_bld, src[0], src[1]);
+
+   case nir_op_fmin:
+      return lp_build_min_ext(base, src[0], src[1],
+                              GALLIVM_NAN_RETURN_OTHER);
+   case nir_op_fmax:
+      return lp_build_max_ext(base, src[0], src[1],
+                              GALLIVM_NAN_RETURN_OTHER);
+   case nir_op_imin:
+      return lp_build_min(int_bld, src[0], src[1]);
+   case nir_op_imax:
+      return lp_build_max(int_bld, src[0], src[1]);
+   case nir_op_umin:
+      return lp_build_min(uint_bld, src[0], src[1]);
+   case nir_op_umax:
+      return lp_build_max(uint_bld, src[0], src[1]);
+   case nir_op_fpow:
+      return lp_build_pow(base, src[0], src[1]);
+
+   case nir_op_ffma:
+      return lp_build_mad(base, src[0], src[1], src[2]);
+   case nir_op_fcsel:
+      return lp_build_select(base,
+                             lp_build_cmp(base, PIPE_FUNC_NOTEQUAL,
+                                          src[0], base->zero),
+                             src[1], src[2]);
+   case nir_op_bcsel:
+      return lp_build_select(int_bld, src[0], src[1], src[2]);
+
+   default:
+      assert(0);
+      return base->undef;
+   }
+}
+
+
+static void
+visit_alu(struct lp_build_nir_soa_context *bld, nir_alu_instr *instr)
+{
+   const nir_op_info *info = &nir_op_infos[instr->op];
+   unsigned num_components = dest_num_components(&instr->dest.dest);
+   unsigned chan, i;
+
+   for (chan = 0; chan < num_components; chan++) {
+      LLVMValueRef src[4];
+      LLVMValueRef res;
+
+      if (!instr->dest.dest.is_ssa &&
+          !(instr->dest.write_mask & (1 << chan)))
+         continue;
+
+      if (info->output_size) {
+         /* vecN */
+         assert(chan < info->num_inputs);
+         res = get_src(bld, instr->src[chan].src,
+                       instr->src[chan].swizzle[0]);
+         if (instr->src[chan].abs)
+            res = lp_build_abs(&bld->base, res);
+         if (instr->src[chan].negate)
+            res = lp_build_negate(&bld->base, res);
+      }
+      else {
+         for (i = 0; i < info->num_inputs; i++)
+            src[i] = get_alu_src(bld, instr, i, chan);
+
+         res = emit_alu_chan(bld, instr->op, src);
+
+         if (nir_alu_type_get_base_type(info->output_type) == nir_type_float) {
+            if (instr->dest.saturate)
+               res = lp_build_clamp_zero_one_nanzero(&bld->base, res);
+         }
+         else {
+            res = to_float(bld, res);
+         }
+      }
+
+      assign_dest(bld, &instr->dest.dest, chan, res);
+   }
+}
+
+
+/*
+ * Intrinsics.
+ */
+
+/**
+ * Load \p num_components dwords starting at \p index from constant
+ * buffer \p buf.  \p index is a constant, or an integer vector for
+ * varying offsets; out of bounds fetches of the latter return zero.
+ */
+static void
+emit_load_const(struct lp_build_nir_soa_context *bld, unsigned buf,
+                LLVMValueRef index, unsigned num_components,
+                LLVMValueRef *res)
+{
+   struct gallivm_state *gallivm = bld->gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld->uint_bld;
+   LLVMValueRef consts_ptr = bld->consts[buf];
+   unsigned chan, i;
+
+   if (LLVMGetTypeKind(LLVMTypeOf(index)) == LLVMIntegerTypeKind) {
+      unsigned first = LLVMConstIntGetZExtValue(index);
+
+      for (chan = 0; chan < num_components; chan++) {
+         LLVMValueRef idx = lp_build_const_int32(gallivm, first + chan);
+         LLVMValueRef scalar_ptr = LLVMBuildGEP(builder, consts_ptr,
+                                                &idx, 1, "");
+         LLVMValueRef scalar = LLVMBuildLoad(builder, scalar_ptr, "");
+
+         res[chan] = lp_build_broadcast_scalar(&bld->base, scalar);
+      }
+      return;
+   }
+
+   for (chan = 0; chan < num_components; chan++) {
+      LLVMValueRef chan_index =
+         lp_build_add(uint_bld, index,
+                      lp_build_const_int_vec(gallivm, uint_bld->type, chan));
+      LLVMValueRef num_consts =
+         lp_build_broadcast_scalar(uint_bld, bld->consts_sizes[buf]);
+      /* the buffer sizes are in vec4 units */
+      LLVMValueRef overflow_mask =
+         lp_build_compare(gallivm, uint_bld->type, PIPE_FUNC_GEQUAL,
+                          lp_build_shr_imm(uint_bld, chan_index, 2),
+                          num_consts);
+      LLVMValueRef val = bld->base.undef;
+
+      chan_index = lp_build_select(uint_bld, overflow_mask,
+                                   uint_bld->zero, chan_index);
+
+      for (i = 0; i < bld->base.type.length; i++) {
+         LLVMValueRef ii = lp_build_const_int32(gallivm, i);
+         LLVMValueRef idx = LLVMBuildExtractElement(builder, chan_index,
+                                                    ii, "");
+         LLVMValueRef scalar_ptr = LLVMBuildGEP(builder, consts_ptr,
+                                                &idx, 1, "gather_ptr");
+
+         val = LLVMBuildInsertElement(builder, val,
+                                      LLVMBuildLoad(builder, scalar_ptr, ""),
+                                      ii, "");
+      }
+
+      res[chan] = lp_build_select(&bld->base, overflow_mask,
+                                  bld->base.zero, val);
+   }
+}
+
+
+/**
+ * The dword index \p offset * \p scale + \p base, as a constant if the
+ * offset is known or else an integer vector.
+ */
+static LLVMValueRef
+get_const_index(struct lp_build_nir_soa_context *bld, nir_src offset,
+                unsigned base, unsigned shift)
+{
+   nir_const_value *const_offset = nir_src_as_const_value(offset);
+   LLVMValueRef index;
+
+   if (const_offset) {
+      return lp_build_const_int32(bld->gallivm,
+                                  base + (const_offset->u32[0] << shift >> 2));
+   }
+
+   index = to_int(bld, get_src(bld, offset, 0));
+   if (shift > 2)
+      index = lp_build_shl_imm(&bld->uint_bld, index, shift - 2);
+   else if (shift < 2)
+      index = lp_build_shr_imm(&bld->uint_bld, index, 2 - shift);
+
+   return lp_build_add(&bld->uint_bld, index,
+                       lp_build_const_int_vec(bld->gallivm,
+                                              bld->uint_bld.type, base));
+}
+
+
+/**
+ * Whether nothing but output stores follow \p instr, in which case there
+ * is no point in branching over the rest of the shader.
+ */
+static boolean
+near_end_of_shader(nir_instr *instr)
+{
+   nir_block *block = instr->block;
+   nir_instr *next;
+
+   if (block->cf_node.parent->type != nir_cf_node_function ||
+       nir_cf_node_next(&block->cf_node))
+      return FALSE;
+
+   for (next = nir_instr_next(instr); next; next = nir_instr_next(next)) {
+      if (next->type != nir_instr_type_intrinsic ||
+          nir_instr_as_intrinsic(next)->intrinsic !=
+          nir_intrinsic_store_output)
+         return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+static void
+emit_discard(struct lp_build_nir_soa_context *bld, nir_instr *instr,
+             LLVMValueRef cond)
+{
+   LLVMBuilderRef builder = bld->gallivm->builder;
+   LLVMValueRef mask;
+
+   /* lanes which discard get a zero in the mask */
+   if (cond)
+      mask = LLVMBuildNot(builder, cond, "");
+   else
+      mask = LLVMConstNull(bld->int_bld.vec_type);
+
+   if (bld->exec_mask.has_mask) {
+      LLVMValueRef invmask =
+         LLVMBuildNot(builder, bld->exec_mask.exec_mask, "kilp");
+      mask = LLVMBuildOr(builder, mask, invmask, "");
+   }
+
+   lp_build_mask_update(bld->mask, mask);
+   if (!near_end_of_shader(instr))
+      lp_build_mask_check(bld->mask);
+}
+
+
+static void
+emit_front_face(struct lp_build_nir_soa_context *bld, nir_dest *dest)
+{
+   /* llvmpipe passes +1.0 for front facing, -1.0 for back facing */
+   if (bld->face_input < 0 || !bld->inputs[bld->face_input][0]) {
+      assign_dest(bld, dest, 0, bld->base.undef);
+      return;
+   }
+   assign_dest(bld, dest, 0,
+               to_float(bld, lp_build_cmp(&bld->base, PIPE_FUNC_GREATER,
+                                          bld->inputs[bld->face_input][0],
+                                          bld->base.zero)));
+}
+
+
+static void
+visit_intrinsic(struct lp_build_nir_soa_context *bld,
+                nir_intrinsic_instr *instr)
+{
+   LLVMValueRef res[4];
+   unsigned chan;
+
+   switch (instr->intrinsic) {
+   case nir_intrinsic_load_input: {
+      unsigned index = nir_intrinsic_base(instr) +
+                       nir_src_as_const_value(instr->src[0])->u32[0];
+      unsigned component = nir_intrinsic_component(instr);
+
+      /* gl_FrontFacing is a boolean input in NIR from GLSL */
+      if (bld->info->input_semantic_name[index] == TGSI_SEMANTIC_FACE) {
+         emit_front_face(bld, &instr->dest);
+         break;
+      }
+
+      for (chan = 0; chan < instr->num_components; chan++) {
+         LLVMValueRef val = bld->inputs[index][component + chan];
+         assign_dest(bld, &instr->dest, chan, val ? val : bld->base.undef);
+      }
+      break;
+   }
+
+   case nir_intrinsic_load_uniform:
+      emit_load_const(bld, 0,
+                      get_const_index(bld, instr->src[0],
+                                      nir_intrinsic_base(instr) * 4, 4),
+                      instr->num_components, res);
+      for (chan = 0; chan < instr->num_components; chan++)
+         assign_dest(bld, &instr->dest, chan, res[chan]);
+      break;
+
+   case nir_intrinsic_load_ubo: {
+      /* UBOs follow the default constant buffer */
+      unsigned buf = nir_src_as_const_value(instr->src[0])->u32[0] + 1;
+
+      if (buf >= LP_MAX_TGSI_CONST_BUFFERS || !bld->consts[buf]) {
+         for (chan = 0; chan < instr->num_components; chan++)
+            assign_dest(bld, &instr->dest, chan, bld->base.zero);
+         break;
+      }
+
+      emit_load_const(bld, buf, get_const_index(bld, instr->src[1], 0, 0),
+                      instr->num_components, res);
+      for (chan = 0; chan < instr->num_components; chan++)
+         assign_dest(bld, &instr->dest, chan, res[chan]);
+      break;
+   }
+
+   case nir_intrinsic_store_output: {
+      unsigned index = nir_intrinsic_base(instr) +
+                       nir_src_as_const_value(instr->src[1])->u32[0];
+      unsigned component = nir_intrinsic_component(instr);
+      unsigned write_mask = nir_intrinsic_write_mask(instr);
+
+      /* the depth is a single float in NIR, POSITION.z in TGSI */
+      if (bld->info->output_semantic_name[index] == TGSI_SEMANTIC_POSITION)
+         component = 2;
+
+      for (chan = 0; chan < instr->num_components; chan++) {
+         if (!(write_mask & (1 << chan)))
+            continue;
+         lp_exec_mask_store(&bld->exec_mask, &bld->base, NULL,
+                            get_src(bld, instr->src[0], chan),
+                            bld->outputs[index][component + chan]);
+      }
+      break;
+   }
+
+   case nir_intrinsic_load_front_face:
+      emit_front_face(bld, &instr->dest);
+      break;
+
+   case nir_intrinsic_discard:
+      emit_discard(bld, &instr->instr, NULL);
+      break;
+
+   case nir_intrinsic_discard_if:
+      emit_discard(bld, &instr->instr,
+                   to_int(bld, get_src(bld, instr->src[0], 0)));
+      break;
+
+   default:
+      assert(0);
+      break;
+   }
+}
+
+
+/*
+ * Textures.
+ */
+
+static void
+visit_tex(struct lp_build_nir_soa_context *bld, nir_tex_instr *instr)
+{
+   struct gallivm_state *gallivm = bld->gallivm;
+   LLVMValueRef coords[5];
+   LLVMValueRef offsets[3] = { NULL };
+   LLVMValueRef texel[4];
+   LLVMValueRef lod = NULL;
+   struct lp_derivatives derivs;
+   struct lp_sampler_params params;
+   enum lp_sampler_lod_property lod_property = LP_SAMPLER_LOD_SCALAR;
+   unsigned sample_key = LP_SAMPLER_OP_TEXTURE << LP_SAMPLER_OP_TYPE_SHIFT;
+   unsigned num_coords, num_offsets, chan, i;
+
+   memset(&params, 0, sizeof(params));
+
+   if (!bld->sampler) {
+      _debug_printf("warning: found texture instruction but no sampler generator supplied\n");
+      for (chan = 0; chan < dest_num_components(&instr->dest); chan++)
+         assign_dest(bld, &instr->dest, chan, bld->base.undef);
+      return;
+   }
+
+   switch (instr->sampler_dim) {
+   case GLSL_SAMPLER_DIM_1D:
+      num_coords = 1;
+      num_offsets = 1;
+      break;
+   case GLSL_SAMPLER_DIM_2D:
+   case GLSL_SAMPLER_DIM_RECT:
+      num_coords = 2;
+      num_offsets = 2;
+      break;
+   case GLSL_SAMPLER_DIM_CUBE:
+      num_coords = 3;
+      num_offsets = 2;
+      break;
+   case GLSL_SAMPLER_DIM_3D:
+   default:
+      num_coords = 3;
+      num_offsets = 3;
+      break;
+   }
+
+   for (i = 0; i < 5; i++)
+      coords[i] = bld->base.undef;
+
+   for (i = 0; i < instr->num_srcs; i++) {
+      nir_src src = instr->src[i].src;
+      unsigned dim;
+
+      switch (instr->src[i].src_type) {
+      case nir_tex_src_coord:
+         for (dim = 0; dim < num_coords; dim++)
+            coords[dim] = get_src(bld, src, dim);
+         /* the layer goes in the third slot, except for cube arrays */
+         if (instr->is_array) {
+            coords[instr->sampler_dim == GLSL_SAMPLER_DIM_CUBE ? 3 : 2] =
+               get_src(bld, src, num_coords);
+         }
+         break;
+      case nir_tex_src_comparitor:
+         sample_key |= LP_SAMPLER_SHADOW;
+         coords[4] = get_src(bld, src, 0);
+         break;
+      case nir_tex_src_offset:
+         sample_key |= LP_SAMPLER_OFFSETS;
+         for (dim = 0; dim < num_offsets; dim++)
+            offsets[dim] = to_int(bld, get_src(bld, src, dim));
+         break;
+      case nir_tex_src_bias:
+      case nir_tex_src_lod:
+         sample_key |= (instr->src[i].src_type == nir_tex_src_bias ?
+                        LP_SAMPLER_LOD_BIAS : LP_SAMPLER_LOD_EXPLICIT) <<
+                       LP_SAMPLER_LOD_CONTROL_SHIFT;
+         lod = get_src(bld, src, 0);
+         /*
+          * The TGSI path can only tell this for constant registers; in
+          * SSA form any lod computed from constants and uniforms
+          * qualifies.
+          */
+         if (src.is_ssa && ssa_is_uniform(src.ssa, LP_NIR_UNIFORM_DEPTH))
+            lod_property = LP_SAMPLER_LOD_SCALAR;
+         else if (gallivm_debug & GALLIVM_DEBUG_NO_QUAD_LOD)
+            lod_property = LP_SAMPLER_LOD_PER_ELEMENT;
+         else
+            lod_property = LP_SAMPLER_LOD_PER_QUAD;
+         break;
+      case nir_tex_src_ddx:
+         for (dim = 0; dim < num_coords; dim++)
+            derivs.ddx[dim] = get_src(bld, src, dim);
+         break;
+      case nir_tex_src_ddy:
+         for (dim = 0; dim < num_coords; dim++)
+            derivs.ddy[dim] = get_src(bld, src, dim);
+         break;
+      default:
+         assert(0);
+         break;
+      }
+   }
+
+   if (instr->op == nir_texop_txd) {
+      sample_key |= LP_SAMPLER_LOD_DERIVATIVES << LP_SAMPLER_LOD_CONTROL_SHIFT;
+      params.derivs = &derivs;
+      if (gallivm_debug & GALLIVM_DEBUG_NO_QUAD_LOD)
+         lod_property = LP_SAMPLER_LOD_PER_ELEMENT;
+      else
+         lod_property = LP_SAMPLER_LOD_PER_QUAD;
+   }
+   sample_key |= lod_property << LP_SAMPLER_LOD_PROPERTY_SHIFT;
+
+   params.type = bld->base.type;
+   params.sample_key = sample_key;
+   params.texture_index = instr->texture_index;
+   params.sampler_index = instr->sampler_index;
+   params.context_ptr = bld->context_ptr;
+   params.thread_data_ptr = bld->thread_data_ptr;
+   params.coords = coords;
+   params.offsets = offsets;
+   params.lod = lod;
+   params.texel = texel;
+
+   bld->sampler->emit_tex_sample(bld->sampler, gallivm, &params);
+
+   for (chan = 0; chan < dest_num_components(&instr->dest); chan++) {
+      LLVMValueRef val = texel[chan];
+
+      if (LLVMTypeOf(val) != bld->base.vec_type)
+         val = to_float(bld, val);
+      assign_dest(bld, &instr->dest, chan, val);
+   }
+}
+
+
+/*
+ * Control flow.
+ */
+
+static void
+visit_load_const(struct lp_build_nir_soa_context *bld,
+                 nir_load_const_instr *instr)
+{
+   unsigned chan;
+
+   /* built from the bits, integer constants needn't be valid floats */
+   for (chan = 0; chan < instr->def.num_components; chan++) {
+      LLVMValueRef val =
+         lp_build_const_int_vec(bld->gallivm, bld->int_bld.type,
+                                instr->value.i32[chan]);
+
+      bld->ssa_defs[instr->def.index][chan] =
+         LLVMConstBitCast(val, bld->base.vec_type);
+   }
+}
+
+
+static void
+visit_ssa_undef(struct lp_build_nir_soa_context *bld,
+                nir_ssa_undef_instr *instr)
+{
+   unsigned chan;
+
+   for (chan = 0; chan < instr->def.num_components; chan++)
+      bld->ssa_defs[instr->def.index][chan] = bld->base.undef;
+}
+
+
+static void
+visit_jump(struct lp_build_nir_soa_context *bld, nir_jump_instr *instr)
+{
+   switch (instr->type) {
+   case nir_jump_break:
+      lp_exec_break(&bld->exec_mask, NULL);
+      break;
+   case nir_jump_continue:
+      lp_exec_continue(&bld->exec_mask);
+      break;
+   default:
+      assert(0);
+      break;
+   }
+}
+
+
+static void
+visit_block(struct lp_build_nir_soa_context *bld, nir_block *block)
+{
+   nir_foreach_instr(instr, block) {
+      switch (instr->type) {
+      case nir_instr_type_alu:
+         visit_alu(bld, nir_instr_as_alu(instr));
+         break;
+      case nir_instr_type_intrinsic:
+         visit_intrinsic(bld, nir_instr_as_intrinsic(instr));
+         break;
+      case nir_instr_type_tex:
+         visit_tex(bld, nir_instr_as_tex(instr));
+         break;
+      case nir_instr_type_load_const:
+         visit_load_const(bld, nir_instr_as_load_const(instr));
+         break;
+      case nir_instr_type_ssa_undef:
+         visit_ssa_undef(bld, nir_instr_as_ssa_undef(instr));
+         break;
+      case nir_instr_type_jump:
+         visit_jump(bld, nir_instr_as_jump(instr));
+         break;
+      default:
+         assert(0);
+         break;
+      }
+   }
+}
+
+
+static void
+visit_cf_list(struct lp_build_nir_soa_context *bld, struct exec_list *list);
+
+
+static boolean
+cf_list_is_empty(struct exec_list *list)
+{
+   nir_cf_node *node = exec_node_data(nir_cf_node,
+                                      exec_list_get_head(list), node);
+
+   return exec_list_length(list) == 1 &&
+          node->type == nir_cf_node_block &&
+          exec_list_is_empty(&nir_cf_node_as_block(node)->instr_list);
+}
+
+
+static void
+visit_if(struct lp_build_nir_soa_context *bld, nir_if *if_stmt)
+{
+   LLVMValueRef cond = to_int(bld, get_src(bld, if_stmt->condition, 0));
+
+   lp_exec_mask_cond_push(&bld->exec_mask, cond);
+   visit_cf_list(bld, &if_stmt->then_list);
+
+   if (!cf_list_is_empty(&if_stmt->else_list)) {
+      lp_exec_mask_cond_invert(&bld->exec_mask);
+      visit_cf_list(bld, &if_stmt->else_list);
+   }
+
+   lp_exec_mask_cond_pop(&bld->exec_mask);
+}
+
+
+static void
+visit_loop(struct lp_build_nir_soa_context *bld, nir_loop *loop)
+{
+   lp_exec_bgnloop(&bld->exec_mask);
+   visit_cf_list(bld, &loop->body);
+   lp_exec_endloop(bld->gallivm, &bld->exec_mask);
+}
+
+
+static void
+visit_cf_list(struct lp_build_nir_soa_context *bld, struct exec_list *list)
+{
+   foreach_list_typed(nir_cf_node, node, node, list) {
+      switch (node->type) {
+      case nir_cf_node_block:
+         visit_block(bld, nir_cf_node_as_block(node));
+         break;
+      case nir_cf_node_if:
+         visit_if(bld, nir_cf_node_as_if(node));
+         break;
+      case nir_cf_node_loop:
+         visit_loop(bld, nir_cf_node_as_loop(node));
+         break;
+      default:
+         assert(0);
+         break;
+      }
+   }
+}
+
+
+/*
+ * Setup.
+ */
+
+static nir_loop *
+innermost_loop(nir_cf_node *node)
+{
+   for (; node; node = node->parent) {
+      if (node->type == nir_cf_node_loop)
+         return nir_cf_node_as_loop(node);
+   }
+   return NULL;
+}
+
+
+static boolean
+cf_node_is_inside(nir_cf_node *node, nir_loop *loop)
+{
+   for (; node; node = node->parent) {
+      if (node == &loop->cf_node)
+         return TRUE;
+   }
+   return FALSE;
+}
+
+
+/**
+ * Allocate a variable for \p def if it's used outside the loop it is
+ * defined in.
+ */
+static bool
+alloc_ssa_var(nir_ssa_def *def, void *state)
+{
+   struct lp_build_nir_soa_context *bld = state;
+   nir_loop *loop = innermost_loop(&def->parent_instr->block->cf_node);
+   boolean escapes = FALSE;
+   unsigned chan;
+
+   if (!loop)
+      return true;
+
+   nir_foreach_use(use, def) {
+      if (!cf_node_is_inside(&use->parent_instr->block->cf_node, loop))
+         escapes = TRUE;
+   }
+   nir_foreach_if_use(use, def) {
+      if (!cf_node_is_inside(&use->parent_if->cf_node, loop))
+         escapes = TRUE;
+   }
+
+   if (escapes) {
+      for (chan = 0; chan < def->num_components; chan++) {
+         bld->ssa_vars[def->index][chan] =
+            lp_build_alloca(bld->gallivm, bld->base.vec_type, "");
+      }
+   }
+
+   return true;
+}
+
+
+static void
+emit_prologue(struct lp_build_nir_soa_context *bld)
+{
+   struct gallivm_state *gallivm = bld->gallivm;
+   const struct tgsi_shader_info *info = bld->info;
+   nir_function_impl *impl = bld->impl;
+   unsigned i, chan;
+
+   for (i = 0; i < LP_MAX_TGSI_CONST_BUFFERS; i++) {
+      LLVMValueRef index;
+
+      if (i >= PIPE_MAX_CONSTANT_BUFFERS || info->const_file_max[i] < 0)
+         continue;
+
+      index = lp_build_const_int32(gallivm, i);
+      bld->consts[i] = lp_build_array_get(gallivm, bld->consts_ptr, index);
+      bld->consts_sizes[i] =
+         lp_build_array_get(gallivm, bld->const_sizes_ptr, index);
+   }
+
+   bld->face_input = -1;
+   for (i = 0; i < info->num_inputs; i++) {
+      if (info->input_semantic_name[i] == TGSI_SEMANTIC_FACE)
+         bld->face_input = i;
+   }
+
+   for (i = 0; i < info->num_outputs; i++) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         bld->outputs[i][chan] =
+            lp_build_alloca(gallivm, bld->base.vec_type, "output");
+      }
+   }
+
+   bld->regs = CALLOC(MAX2(impl->reg_alloc, 1), sizeof(*bld->regs));
+   foreach_list_typed(nir_register, reg, node, &impl->registers) {
+      unsigned size = MAX2(reg->num_array_elems, 1) * reg->num_components;
+
+      bld->regs[reg->index] = CALLOC(size, sizeof(LLVMValueRef));
+      for (i = 0; i < size; i++) {
+         bld->regs[reg->index][i] =
+            lp_build_alloca(gallivm, bld->base.vec_type, "reg");
+      }
+   }
+
+   bld->ssa_defs = CALLOC(MAX2(impl->ssa_alloc, 1), sizeof(*bld->ssa_defs));
+   bld->ssa_vars = CALLOC(MAX2(impl->ssa_alloc, 1), sizeof(*bld->ssa_vars));
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block)
+         nir_foreach_ssa_def(instr, alloc_ssa_var, bld);
+   }
+}
+
+
+void
+lp_build_nir_soa(struct gallivm_state *gallivm,
+                 struct nir_shader *shader,
+                 struct lp_type type,
+                 struct lp_build_mask_context *mask,
+                 LLVMValueRef consts_ptr,
+                 LLVMValueRef const_sizes_ptr,
+                 const LLVMValueRef (*inputs)[TGSI_NUM_CHANNELS],
+                 LLVMValueRef (*outputs)[TGSI_NUM_CHANNELS],
+                 LLVMValueRef context_ptr,
+                 LLVMValueRef thread_data_ptr,
+                 struct lp_build_sampler_soa *sampler,
+                 const struct tgsi_shader_info *info)
+{
+   struct lp_build_nir_soa_context bld;
+   nir_function_impl *impl = nir_shader_get_entrypoint(shader);
+   unsigned i;
+
+   assert(type.length <= LP_MAX_VECTOR_LENGTH);
+
+   memset(&bld, 0, sizeof bld);
+   bld.gallivm = gallivm;
+   lp_build_context_init(&bld.base, gallivm, type);
+   lp_build_context_init(&bld.int_bld, gallivm, lp_int_type(type));
+   lp_build_context_init(&bld.uint_bld, gallivm, lp_uint_type(type));
+   bld.mask = mask;
+   bld.impl = impl;
+   bld.info = info;
+   bld.consts_ptr = consts_ptr;
+   bld.const_sizes_ptr = const_sizes_ptr;
+   bld.inputs = inputs;
+   bld.outputs = outputs;
+   bld.context_ptr = context_ptr;
+   bld.thread_data_ptr = thread_data_ptr;
+   bld.sampler = sampler;
+
+   lp_exec_mask_init(&bld.exec_mask, &bld.int_bld);
+
+   emit_prologue(&bld);
+   visit_cf_list(&bld, &impl->body);
+
+   lp_exec_mask_fini(&bld.exec_mask);
+
+   for (i = 0; i < impl->reg_alloc; i++)
+      FREE(bld.regs[i]);
+   FREE(bld.regs);
+   FREE(bld.ssa_defs);
+   FREE(bld.ssa_vars);
+}
@@ -2069,3 +2069,62 @@ lp_build_sample_offset(struct lp_build_context *bld,
 
    *out_offset = offset;
 }
+
+
+/**
+ * Compute the offset of a texel in a tiled texture.
+ *
+ * Same as lp_build_sample_offset() but for textures laid out in
+ * LP_SAMPLER_TILE_SIZE square tiles, in which case y_stride is the number
+ * of bytes between successive rows of tiles rather than rows of texels.
+ * Only formats with 1x1 pixel blocks can be tiled.
+ */
+void
+lp_build_sample_tiled_offset(struct lp_build_context *bld,
+                             const struct util_format_description *format_desc,
+                             LLVMValueRef x,
+                             LLVMValueRef y,
+                             LLVMValueRef z,
+                             LLVMValueRef y_stride,
+                             LLVMValueRef z_stride,
+                             LLVMValueRef *out_offset,
+                             LLVMValueRef *out_i,
+                             LLVMValueRef *out_j)
+{
+   const unsigned tile_shift = util_logbase2(LP_SAMPLER_TILE_SIZE);
+   LLVMValueRef tile_mask;
+   LLVMValueRef x_stride;
+   LLVMValueRef tile_x, tile_y, sub_x, sub_y;
+   LLVMValueRef index;
+   LLVMValueRef offset;
+
+   assert(format_desc->block.width == 1);
+   assert(format_desc->block.height == 1);
+   assert(y && y_stride);
+
+   tile_mask = lp_build_const_int_vec(bld->gallivm, bld->type,
+                                      LP_SAMPLER_TILE_SIZE - 1);
+   x_stride = lp_build_const_vec(bld->gallivm, bld->type,
+                                 format_desc->block.bits/8);
+
+   tile_x = lp_build_shr_imm(bld, x, tile_shift);
+   sub_x = lp_build_and(bld, x, tile_mask);
+   tile_y = lp_build_shr_imm(bld, y, tile_shift);
+   sub_y = lp_build_and(bld, y, tile_mask);
+
+   /* texel index within the row of tiles */
+   index = lp_build_shl_imm(bld, tile_x, 2 * tile_shift);
+   index = lp_build_add(bld, index, lp_build_shl_imm(bld, sub_y, tile_shift));
+   index = lp_build_add(bld, index, sub_x);
+
+   offset = lp_build_mul(bld, index, x_stride);
+   offset = lp_build_add(bld, offset, lp_build_mul(bld, tile_y, y_stride));
+
+   if (z && z_stride) {
+      offset = lp_build_add(bld, offset, lp_build_mul(bld, z, z_stride));
+   }
+
+   *out_offset = offset;
+   *out_i = bld->zero;
+   *out_j = bld->zero;
+}
@@ -142,9 +142,25 @@ struct lp_static_texture_state
    unsigned pot_height:1;
    unsigned pot_depth:1;
    unsigned level_zero_only:1;
+   unsigned tiled:1;         /**< stored in LP_SAMPLER_TILE_SIZE tiles? */
 };
 
 
+/**
+ * Width and height, in texels, of the tiles making up a tiled texture.
+ *
+ * Tiled textures store each row of tiles contiguously, and each tile as
+ * LP_SAMPLER_TILE_SIZE x LP_SAMPLER_TILE_SIZE texels in row-major order,
+ * so that texel (x, y) lives at
+ *
+ *    (y / 4) * row_stride + ((x / 4) * 16 + (y % 4) * 4 + (x % 4)) * bpp
+ *
+ * This keeps a bilinear footprint within one or two cache lines
+ * regardless of the direction the texture is walked in.
+ */
+#define LP_SAMPLER_TILE_SIZE 4
+
+
 /**
  * Sampler static state.
  *
@@ -595,6 +611,19 @@ lp_build_sample_offset(struct lp_build_context *bld,
                        LLVMValueRef *out_j);
 
 
+void
+lp_build_sample_tiled_offset(struct lp_build_context *bld,
+                             const struct util_format_description *format_desc,
+                             LLVMValueRef x,
+                             LLVMValueRef y,
+                             LLVMValueRef z,
+                             LLVMValueRef y_stride,
+                             LLVMValueRef z_stride,
+                             LLVMValueRef *out_offset,
+                             LLVMValueRef *out_i,
+                             LLVMValueRef *out_j);
+
+
 void
 lp_build_sample_soa(const struct lp_static_texture_state *static_texture_state,
                     const struct lp_static_sampler_state *static_sampler_state,
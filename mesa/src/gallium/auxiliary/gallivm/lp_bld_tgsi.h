@@ -67,6 +67,7 @@ struct lp_build_mask_context;
 struct gallivm_state;
 struct lp_derivatives;
 struct lp_build_tgsi_gs_iface;
+struct lp_build_tgsi_cs_iface;
 
 
 enum lp_build_tex_modifier {
@@ -170,6 +171,12 @@ struct lp_bld_tgsi_system_values {
    LLVMValueRef prim_id;
    LLVMValueRef basevertex;
    LLVMValueRef invocation_id;
+
+   /* Compute shaders: thread_id is a per-lane vector, the others scalars. */
+   LLVMValueRef thread_id[3];
+   LLVMValueRef block_id[3];
+   LLVMValueRef grid_size[3];
+   LLVMValueRef block_size[3];
 };
 
 
@@ -230,7 +237,8 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface);
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_cs_iface *cs_iface);
 
 
 void
@@ -306,6 +314,27 @@ struct lp_exec_mask {
    int function_stack_size;
 };
 
+/*
+ * Execution mask handling, shared with the NIR translation.  The switch
+ * variant of lp_exec_break needs the TGSI context to look ahead; loop
+ * breaks accept a NULL bld_base.
+ */
+void lp_exec_mask_init(struct lp_exec_mask *mask, struct lp_build_context *bld);
+void lp_exec_mask_fini(struct lp_exec_mask *mask);
+void lp_exec_mask_cond_push(struct lp_exec_mask *mask, LLVMValueRef val);
+void lp_exec_mask_cond_invert(struct lp_exec_mask *mask);
+void lp_exec_mask_cond_pop(struct lp_exec_mask *mask);
+void lp_exec_bgnloop(struct lp_exec_mask *mask);
+void lp_exec_break(struct lp_exec_mask *mask,
+                   struct lp_build_tgsi_context *bld_base);
+void lp_exec_continue(struct lp_exec_mask *mask);
+void lp_exec_endloop(struct gallivm_state *gallivm, struct lp_exec_mask *mask);
+void lp_exec_mask_store(struct lp_exec_mask *mask,
+                        struct lp_build_context *bld_store,
+                        LLVMValueRef pred,
+                        LLVMValueRef val,
+                        LLVMValueRef dst_ptr);
+
 struct lp_build_tgsi_inst_list
 {
    struct tgsi_full_instruction *instructions;
@@ -425,6 +454,28 @@ struct lp_build_tgsi_gs_iface
                        LLVMValueRef emitted_prims_vec);
 };
 
+/**
+ * Memory access interface for compute shaders.
+ *
+ * Buffers and shared memory are both presented as a byte pointer plus a
+ * size in bytes; accesses outside of [0, size) are discarded on store and
+ * return zero on load.
+ */
+struct lp_build_tgsi_cs_iface
+{
+   void (*fetch_buffer)(const struct lp_build_tgsi_cs_iface *cs_iface,
+                        struct lp_build_tgsi_context * bld_base,
+                        unsigned unit,
+                        LLVMValueRef *base_ptr,
+                        LLVMValueRef *size);
+   void (*fetch_shared)(const struct lp_build_tgsi_cs_iface *cs_iface,
+                        struct lp_build_tgsi_context * bld_base,
+                        LLVMValueRef *base_ptr,
+                        LLVMValueRef *size);
+   void (*emit_barrier)(const struct lp_build_tgsi_cs_iface *cs_iface,
+                        struct lp_build_tgsi_context * bld_base);
+};
+
 struct lp_build_tgsi_soa_context
 {
    struct lp_build_tgsi_context bld_base;
@@ -438,6 +489,8 @@ struct lp_build_tgsi_soa_context
    LLVMValueRef emitted_vertices_vec_ptr;
    LLVMValueRef max_output_vertices_vec;
 
+   const struct lp_build_tgsi_cs_iface *cs_iface;
+
    LLVMValueRef consts_ptr;
    LLVMValueRef const_sizes_ptr;
    LLVMValueRef consts[LP_MAX_TGSI_CONST_BUFFERS];
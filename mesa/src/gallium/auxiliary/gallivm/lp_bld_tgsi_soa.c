@@ -40,6 +40,7 @@
 #include "pipe/p_shader_tokens.h"
 #include "util/u_debug.h"
 #include "util/u_math.h"
+#include "util/u_atomic.h"
 #include "util/u_memory.h"
 #include "tgsi/tgsi_dump.h"
 #include "tgsi/tgsi_exec.h"
@@ -195,7 +196,7 @@ lp_exec_mask_function_init(struct lp_exec_mask *mask, int function_idx)
       ctx->loop_limiter);
 }
 
-static void lp_exec_mask_init(struct lp_exec_mask *mask, struct lp_build_context *bld)
+void lp_exec_mask_init(struct lp_exec_mask *mask, struct lp_build_context *bld)
 {
    mask->bld = bld;
    mask->has_mask = FALSE;
@@ -213,7 +214,7 @@ static void lp_exec_mask_init(struct lp_exec_mask *mask, struct lp_build_context
    lp_exec_mask_function_init(mask, 0);
 }
 
-static void
+void
 lp_exec_mask_fini(struct lp_exec_mask *mask)
 {
    FREE(mask->function_stack);
@@ -263,8 +264,8 @@ static void lp_exec_mask_update(struct lp_exec_mask *mask)
                      has_ret_mask);
 }
 
-static void lp_exec_mask_cond_push(struct lp_exec_mask *mask,
-                                   LLVMValueRef val)
+void lp_exec_mask_cond_push(struct lp_exec_mask *mask,
+                            LLVMValueRef val)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    struct function_ctx *ctx = func_ctx(mask);
@@ -285,7 +286,7 @@ static void lp_exec_mask_cond_push(struct lp_exec_mask *mask,
    lp_exec_mask_update(mask);
 }
 
-static void lp_exec_mask_cond_invert(struct lp_exec_mask *mask)
+void lp_exec_mask_cond_invert(struct lp_exec_mask *mask)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    struct function_ctx *ctx = func_ctx(mask);
@@ -308,7 +309,7 @@ static void lp_exec_mask_cond_invert(struct lp_exec_mask *mask)
    lp_exec_mask_update(mask);
 }
 
-static void lp_exec_mask_cond_pop(struct lp_exec_mask *mask)
+void lp_exec_mask_cond_pop(struct lp_exec_mask *mask)
 {
    struct function_ctx *ctx = func_ctx(mask);
    assert(ctx->cond_stack_size);
@@ -319,7 +320,7 @@ static void lp_exec_mask_cond_pop(struct lp_exec_mask *mask)
    lp_exec_mask_update(mask);
 }
 
-static void lp_exec_bgnloop(struct lp_exec_mask *mask)
+void lp_exec_bgnloop(struct lp_exec_mask *mask)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    struct function_ctx *ctx = func_ctx(mask);
@@ -352,8 +353,8 @@ static void lp_exec_bgnloop(struct lp_exec_mask *mask)
    lp_exec_mask_update(mask);
 }
 
-static void lp_exec_break(struct lp_exec_mask *mask,
-                          struct lp_build_tgsi_context * bld_base)
+void lp_exec_break(struct lp_exec_mask *mask,
+                   struct lp_build_tgsi_context * bld_base)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    struct function_ctx *ctx = func_ctx(mask);
@@ -426,7 +427,7 @@ static void lp_exec_break_condition(struct lp_exec_mask *mask,
    lp_exec_mask_update(mask);
 }
 
-static void lp_exec_continue(struct lp_exec_mask *mask)
+void lp_exec_continue(struct lp_exec_mask *mask)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    LLVMValueRef exec_mask = LLVMBuildNot(builder,
@@ -441,8 +442,8 @@ static void lp_exec_continue(struct lp_exec_mask *mask)
 }
 
 
-static void lp_exec_endloop(struct gallivm_state *gallivm,
-                            struct lp_exec_mask *mask)
+void lp_exec_endloop(struct gallivm_state *gallivm,
+                     struct lp_exec_mask *mask)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    struct function_ctx *ctx = func_ctx(mask);
@@ -751,11 +752,11 @@ static void lp_exec_default(struct lp_exec_mask *mask,
  * should be stored into the address
  * (0 means don't store this bit, 1 means do store).
  */
-static void lp_exec_mask_store(struct lp_exec_mask *mask,
-                               struct lp_build_context *bld_store,
-                               LLVMValueRef pred,
-                               LLVMValueRef val,
-                               LLVMValueRef dst_ptr)
+void lp_exec_mask_store(struct lp_exec_mask *mask,
+                        struct lp_build_context *bld_store,
+                        LLVMValueRef pred,
+                        LLVMValueRef val,
+                        LLVMValueRef dst_ptr)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
 
@@ -1672,6 +1673,33 @@ emit_fetch_system_value(
       atype = TGSI_TYPE_UNSIGNED;
       break;
 
+   case TGSI_SEMANTIC_THREAD_ID:
+      res = swizzle < 3 ? bld->system_values.thread_id[swizzle] :
+                          bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_BLOCK_ID:
+   case TGSI_SEMANTIC_GRID_SIZE:
+   case TGSI_SEMANTIC_BLOCK_SIZE:
+   {
+      const LLVMValueRef *vals;
+      if (info->system_value_semantic_name[reg->Register.Index] ==
+          TGSI_SEMANTIC_BLOCK_ID)
+         vals = bld->system_values.block_id;
+      else if (info->system_value_semantic_name[reg->Register.Index] ==
+               TGSI_SEMANTIC_GRID_SIZE)
+         vals = bld->system_values.grid_size;
+      else
+         vals = bld->system_values.block_size;
+      if (swizzle < 3)
+         res = lp_build_broadcast_scalar(&bld_base->uint_bld, vals[swizzle]);
+      else
+         res = bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+   }
+
    default:
       assert(!"unexpected semantic in emit_fetch_system_value");
       res = bld_base->base.zero;
@@ -3533,6 +3561,367 @@ end_primitive(
    }
 }
 
+/**
+ * Return the base pointer (i8 *) and size in bytes of the buffer or shared
+ * memory accessed by a LOAD, STORE, ATOM* or RESQ instruction.
+ */
+static void
+get_memory_resource(struct lp_build_tgsi_soa_context * bld,
+                    unsigned file,
+                    unsigned index,
+                    LLVMValueRef *base_ptr,
+                    LLVMValueRef *size)
+{
+   const struct lp_build_tgsi_cs_iface *cs_iface = bld->cs_iface;
+
+   assert(cs_iface);
+
+   if (file == TGSI_FILE_MEMORY) {
+      cs_iface->fetch_shared(cs_iface, &bld->bld_base, base_ptr, size);
+   } else {
+      assert(file == TGSI_FILE_BUFFER);
+      cs_iface->fetch_buffer(cs_iface, &bld->bld_base, index, base_ptr, size);
+   }
+}
+
+/**
+ * Mask of the lanes whose 4 byte access at 'offset' lies entirely within
+ * a resource of 'size' bytes.
+ */
+static LLVMValueRef
+memory_in_bounds(struct lp_build_tgsi_soa_context * bld,
+                 LLVMValueRef offset,
+                 LLVMValueRef size)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   LLVMValueRef size_vec = lp_build_broadcast_scalar(uint_bld, size);
+   LLVMValueRef lt_size, fits;
+
+   /* offset < size && size - offset >= 4, which can't wrap around */
+   lt_size = lp_build_cmp(uint_bld, PIPE_FUNC_LESS, offset, size_vec);
+   fits = lp_build_cmp(uint_bld, PIPE_FUNC_GEQUAL,
+                       lp_build_sub(uint_bld, size_vec, offset),
+                       lp_build_const_int_vec(gallivm, uint_bld->type, 4));
+
+   return LLVMBuildAnd(gallivm->builder, lt_size, fits, "");
+}
+
+static LLVMValueRef
+memory_elem_ptr(struct gallivm_state *gallivm,
+                LLVMValueRef base_ptr,
+                LLVMValueRef offset)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef i32_ptr_type =
+      LLVMPointerType(LLVMInt32TypeInContext(gallivm->context), 0);
+   LLVMValueRef ptr;
+
+   ptr = LLVMBuildGEP(builder, base_ptr, &offset, 1, "");
+   return LLVMBuildBitCast(builder, ptr, i32_ptr_type, "");
+}
+
+/**
+ * Begin a block executed only when lane 'i' of 'cond' is set.
+ */
+static void
+memory_lane_if(struct lp_build_if_state *ifthen,
+               struct lp_build_tgsi_soa_context * bld,
+               LLVMValueRef cond,
+               unsigned i)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef lane;
+
+   lane = LLVMBuildExtractElement(builder, cond,
+                                  lp_build_const_int32(gallivm, i), "");
+   lane = LLVMBuildICmp(builder, LLVMIntNE, lane,
+                        lp_build_const_int32(gallivm, 0), "");
+   lp_build_if(ifthen, gallivm, lane);
+}
+
+static LLVMValueRef
+fetch_uint(struct lp_build_tgsi_context * bld_base,
+           const struct tgsi_full_instruction *inst,
+           unsigned src_op,
+           unsigned chan)
+{
+   LLVMValueRef val = lp_build_emit_fetch(bld_base, inst, src_op, chan);
+
+   return LLVMBuildBitCast(bld_base->base.gallivm->builder, val,
+                           bld_base->uint_bld.vec_type, "");
+}
+
+static void
+load_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   LLVMValueRef base_ptr, size, offset;
+   unsigned chan;
+
+   get_memory_resource(bld, inst->Src[0].Register.File,
+                       inst->Src[0].Register.Index, &base_ptr, &size);
+   offset = fetch_uint(bld_base, inst, 1, TGSI_CHAN_X);
+
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      LLVMValueRef chan_offset, in_bounds, res;
+
+      chan_offset = lp_build_add(uint_bld, offset,
+                                 lp_build_const_int_vec(gallivm, uint_bld->type,
+                                                        chan * 4));
+      in_bounds = memory_in_bounds(bld, chan_offset, size);
+
+      /*
+       * Out of bounds lanes fetch from offset zero, which is always
+       * readable, and are then replaced by zero.
+       */
+      chan_offset = lp_build_select(uint_bld, in_bounds, chan_offset,
+                                    uint_bld->zero);
+      res = lp_build_gather(gallivm, uint_bld->type.length, 32, 32, FALSE,
+                            base_ptr, chan_offset, FALSE);
+      emit_data->output[chan] = lp_build_select(uint_bld, in_bounds, res,
+                                                uint_bld->zero);
+   }
+}
+
+static void
+store_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   LLVMValueRef base_ptr, size, offset, exec_mask;
+   unsigned chan, i;
+
+   get_memory_resource(bld, inst->Dst[0].Register.File,
+                       inst->Dst[0].Register.Index, &base_ptr, &size);
+   offset = fetch_uint(bld_base, inst, 0, TGSI_CHAN_X);
+   exec_mask = mask_vec(bld_base);
+
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      LLVMValueRef value, chan_offset, cond;
+
+      value = fetch_uint(bld_base, inst, 1, chan);
+      chan_offset = lp_build_add(uint_bld, offset,
+                                 lp_build_const_int_vec(gallivm, uint_bld->type,
+                                                        chan * 4));
+      cond = LLVMBuildAnd(builder, exec_mask,
+                          memory_in_bounds(bld, chan_offset, size), "");
+
+      /* Scatter, one lane at a time */
+      for (i = 0; i < uint_bld->type.length; i++) {
+         LLVMValueRef index = lp_build_const_int32(gallivm, i);
+         struct lp_build_if_state ifthen;
+         LLVMValueRef ptr;
+
+         memory_lane_if(&ifthen, bld, cond, i);
+         ptr = memory_elem_ptr(gallivm, base_ptr,
+                               LLVMBuildExtractElement(builder, chan_offset,
+                                                       index, ""));
+         LLVMBuildStore(builder,
+                        LLVMBuildExtractElement(builder, value, index, ""),
+                        ptr);
+         lp_build_endif(&ifthen);
+      }
+   }
+}
+
+#if HAVE_LLVM < 0x0309
+static uint32_t
+lp_atomic_cmpxchg(uint32_t *ptr, uint32_t cmp, uint32_t val)
+{
+   return p_atomic_cmpxchg(ptr, cmp, val);
+}
+#endif
+
+static LLVMValueRef
+emit_atomic_cmpxchg(struct gallivm_state *gallivm,
+                    LLVMValueRef ptr,
+                    LLVMValueRef cmp,
+                    LLVMValueRef val)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+#if HAVE_LLVM >= 0x0309
+   LLVMValueRef res;
+
+   res = LLVMBuildAtomicCmpXchg(builder, ptr, cmp, val,
+                                LLVMAtomicOrderingSequentiallyConsistent,
+                                LLVMAtomicOrderingSequentiallyConsistent,
+                                FALSE);
+   return LLVMBuildExtractValue(builder, res, 0, "");
+#else
+   /* No cmpxchg in the C API, go through a helper. */
+   LLVMTypeRef i32_type = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef arg_types[3];
+   LLVMValueRef args[3];
+   LLVMValueRef func;
+
+   arg_types[0] = LLVMPointerType(i32_type, 0);
+   arg_types[1] = i32_type;
+   arg_types[2] = i32_type;
+   func = lp_build_const_func_pointer(gallivm,
+                                      func_to_pointer((func_pointer)lp_atomic_cmpxchg),
+                                      i32_type, arg_types, 3,
+                                      "lp_atomic_cmpxchg");
+   args[0] = ptr;
+   args[1] = cmp;
+   args[2] = val;
+   return LLVMBuildCall(builder, func, args, 3, "");
+#endif
+}
+
+static void
+atomic_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   unsigned opcode = inst->Instruction.Opcode;
+   LLVMValueRef base_ptr, size, offset, value, value2 = NULL;
+   LLVMValueRef cond, res_ptr, res;
+   LLVMAtomicRMWBinOp op = LLVMAtomicRMWBinOpAdd;
+   unsigned chan, i;
+
+   switch (opcode) {
+   case TGSI_OPCODE_ATOMUADD:
+      op = LLVMAtomicRMWBinOpAdd;
+      break;
+   case TGSI_OPCODE_ATOMXCHG:
+      op = LLVMAtomicRMWBinOpXchg;
+      break;
+   case TGSI_OPCODE_ATOMAND:
+      op = LLVMAtomicRMWBinOpAnd;
+      break;
+   case TGSI_OPCODE_ATOMOR:
+      op = LLVMAtomicRMWBinOpOr;
+      break;
+   case TGSI_OPCODE_ATOMXOR:
+      op = LLVMAtomicRMWBinOpXor;
+      break;
+   case TGSI_OPCODE_ATOMUMIN:
+      op = LLVMAtomicRMWBinOpUMin;
+      break;
+   case TGSI_OPCODE_ATOMUMAX:
+      op = LLVMAtomicRMWBinOpUMax;
+      break;
+   case TGSI_OPCODE_ATOMIMIN:
+      op = LLVMAtomicRMWBinOpMin;
+      break;
+   case TGSI_OPCODE_ATOMIMAX:
+      op = LLVMAtomicRMWBinOpMax;
+      break;
+   case TGSI_OPCODE_ATOMCAS:
+      break;
+   default:
+      assert(0);
+      return;
+   }
+
+   get_memory_resource(bld, inst->Src[0].Register.File,
+                       inst->Src[0].Register.Index, &base_ptr, &size);
+   offset = fetch_uint(bld_base, inst, 1, TGSI_CHAN_X);
+   value = fetch_uint(bld_base, inst, 2, TGSI_CHAN_X);
+   if (opcode == TGSI_OPCODE_ATOMCAS)
+      value2 = fetch_uint(bld_base, inst, 3, TGSI_CHAN_X);
+
+   cond = LLVMBuildAnd(builder, mask_vec(bld_base),
+                       memory_in_bounds(bld, offset, size), "");
+
+   res_ptr = lp_build_alloca(gallivm, uint_bld->vec_type, "atomic_res");
+
+   for (i = 0; i < uint_bld->type.length; i++) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, i);
+      struct lp_build_if_state ifthen;
+      LLVMValueRef ptr, val, old;
+
+      memory_lane_if(&ifthen, bld, cond, i);
+      ptr = memory_elem_ptr(gallivm, base_ptr,
+                            LLVMBuildExtractElement(builder, offset,
+                                                    index, ""));
+      val = LLVMBuildExtractElement(builder, value, index, "");
+      if (opcode == TGSI_OPCODE_ATOMCAS) {
+         old = emit_atomic_cmpxchg(gallivm, ptr, val,
+                                   LLVMBuildExtractElement(builder, value2,
+                                                           index, ""));
+      } else {
+         old = LLVMBuildAtomicRMW(builder, op, ptr, val,
+                                  LLVMAtomicOrderingSequentiallyConsistent,
+                                  FALSE);
+      }
+      res = LLVMBuildLoad(builder, res_ptr, "");
+      res = LLVMBuildInsertElement(builder, res, old, index, "");
+      LLVMBuildStore(builder, res, res_ptr);
+      lp_build_endif(&ifthen);
+   }
+
+   res = LLVMBuildLoad(builder, res_ptr, "");
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      emit_data->output[chan] = res;
+   }
+}
+
+static void
+resq_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   LLVMValueRef base_ptr, size;
+   unsigned chan;
+
+   get_memory_resource(bld, inst->Src[0].Register.File,
+                       inst->Src[0].Register.Index, &base_ptr, &size);
+
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      emit_data->output[chan] =
+         lp_build_broadcast_scalar(&bld_base->uint_bld, size);
+   }
+}
+
+static void
+barrier_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+
+   assert(bld->cs_iface);
+   bld->cs_iface->emit_barrier(bld->cs_iface, bld_base);
+}
+
+static void
+membar_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   /*
+    * All invocations of a block run on one thread and every atomic is
+    * sequentially consistent, so program order already gives the
+    * required visibility.
+    */
+}
+
 static void
 cal_emit(
    const struct lp_build_tgsi_action * action,
@@ -3878,7 +4267,8 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface)
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_cs_iface *cs_iface)
 {
    struct lp_build_tgsi_soa_context bld;
 
@@ -4019,6 +4409,25 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                                 max_output_vertices);
    }
 
+   if (cs_iface) {
+      bld.cs_iface = cs_iface;
+      bld.bld_base.op_actions[TGSI_OPCODE_LOAD].emit = load_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_STORE].emit = store_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_RESQ].emit = resq_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUADD].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMXCHG].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMCAS].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMAND].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMOR].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMXOR].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUMIN].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUMAX].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMIMIN].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMIMAX].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_BARRIER].emit = barrier_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_MEMBAR].emit = membar_emit;
+   }
+
    lp_exec_mask_init(&bld.exec_mask, &bld.bld_base.int_bld);
 
    bld.system_values = *system_values;
@@ -0,0 +1,351 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * NIR versions of the fragment shader rewrites of the draw module's AA
+ * line, AA point and polygon stipple stages, for the NIR fragment shaders
+ * llvmpipe takes under LP_NIR.  They do what the TGSI transforms in
+ * draw_pipe_aaline.c, draw_pipe_aapoint.c and util/u_pstipple.c do.
+ *
+ * As with nir_tgsi_scan_shader(), the NIR must have gone through
+ * nir_lower_io, with the driver locations of the inputs and outputs used
+ * as TGSI register indices.
+ */
+
+#include "compiler/nir/nir.h"
+#include "compiler/nir/nir_builder.h"
+#include "pipe/p_shader_tokens.h"
+#include "pipe/p_state.h"
+#include "tgsi/tgsi_scan.h"
+#include "util/u_math.h"
+
+#include "nir_draw_helpers.h"
+#include "nir_to_tgsi_info.h"
+
+/**
+ * Find the highest GENERIC input index, or -1 if there is none.
+ */
+static int
+max_generic(const struct tgsi_shader_info *info)
+{
+   int max = -1;
+   unsigned i;
+
+   for (i = 0; i < info->num_inputs; i++) {
+      if (info->input_semantic_name[i] == TGSI_SEMANTIC_GENERIC)
+         max = MAX2(max, (int)info->input_semantic_index[i]);
+   }
+
+   return max;
+}
+
+/**
+ * Find a sampler unit the shader doesn't use.  Sampler arrays are only
+ * known by their first unit and size, so take the one above the highest
+ * unit used rather than a hole.
+ */
+static unsigned
+free_sampler(const struct tgsi_shader_info *info)
+{
+   int sampler = MAX2(info->file_max[TGSI_FILE_SAMPLER],
+                      info->file_max[TGSI_FILE_SAMPLER_VIEW]) + 1;
+
+   return MIN2(sampler, PIPE_MAX_SAMPLERS - 1);
+}
+
+/**
+ * Find the COLOR[0] output, or -1 if the shader doesn't write color.
+ */
+static int
+color_output(const struct tgsi_shader_info *info)
+{
+   unsigned i;
+
+   for (i = 0; i < info->num_outputs; i++) {
+      if (info->output_semantic_name[i] == TGSI_SEMANTIC_COLOR &&
+          info->output_semantic_index[i] == 0)
+         return i;
+   }
+
+   return -1;
+}
+
+static nir_ssa_def *
+load_input(nir_builder *b, unsigned driver_location)
+{
+   nir_intrinsic_instr *load;
+
+   load = nir_intrinsic_instr_create(b->shader, nir_intrinsic_load_input);
+   load->num_components = 4;
+   nir_intrinsic_set_base(load, driver_location);
+   nir_intrinsic_set_component(load, 0);
+   load->src[0] = nir_src_for_ssa(nir_imm_int(b, 0));
+
+   nir_ssa_dest_init(&load->instr, &load->dest, 4, 32, NULL);
+   nir_builder_instr_insert(b, &load->instr);
+
+   return &load->dest.ssa;
+}
+
+/**
+ * Add a vec4 input after the existing ones.
+ */
+static nir_variable *
+add_input(nir_shader *shader, const struct tgsi_shader_info *info,
+          int location, const char *name)
+{
+   nir_variable *var;
+
+   var = nir_variable_create(shader, nir_var_shader_in, glsl_vec4_type(),
+                             name);
+   var->data.location = location;
+   var->data.driver_location = info->num_inputs;
+   var->data.interpolation = INTERP_MODE_NOPERSPECTIVE;
+
+   shader->num_inputs = MAX2(shader->num_inputs, info->num_inputs + 1);
+
+   return var;
+}
+
+/**
+ * Add a GENERIC input above the ones the shader reads, for the texture
+ * coordinates the stage emits, and load it.
+ */
+static nir_ssa_def *
+load_generic(nir_builder *b, const struct tgsi_shader_info *info,
+             int *generic_attrib)
+{
+   nir_variable *var;
+
+   *generic_attrib = max_generic(info) + 1;
+   var = add_input(b->shader, info, VARYING_SLOT_VAR0 + *generic_attrib,
+                   "aa_texcoord");
+
+   return load_input(b, var->data.driver_location);
+}
+
+static nir_ssa_def *
+sample_2d(nir_builder *b, nir_ssa_def *coord, unsigned sampler)
+{
+   nir_tex_instr *tex;
+
+   tex = nir_tex_instr_create(b->shader, 1);
+   tex->op = nir_texop_tex;
+   tex->sampler_dim = GLSL_SAMPLER_DIM_2D;
+   tex->coord_components = 2;
+   tex->sampler_index = sampler;
+   tex->texture_index = sampler;
+   tex->dest_type = nir_type_float;
+   tex->src[0].src_type = nir_tex_src_coord;
+   tex->src[0].src = nir_src_for_ssa(nir_channels(b, coord, 0x3));
+
+   nir_ssa_dest_init(&tex->instr, &tex->dest, 4, 32, NULL);
+   nir_builder_instr_insert(b, &tex->instr);
+
+   return &tex->dest.ssa;
+}
+
+static void
+discard_if(nir_builder *b, nir_ssa_def *cond)
+{
+   nir_intrinsic_instr *discard;
+
+   discard = nir_intrinsic_instr_create(b->shader, nir_intrinsic_discard_if);
+   discard->src[0] = nir_src_for_ssa(cond);
+   nir_builder_instr_insert(b, &discard->instr);
+
+   b->shader->info.fs.uses_discard = true;
+}
+
+/**
+ * Multiply the alpha of every store to the color output by coverage,
+ * which has to be computed at the top of the entry point.
+ */
+static void
+modulate_alpha(nir_builder *b, nir_function_impl *impl,
+               const struct tgsi_shader_info *info, nir_ssa_def *coverage)
+{
+   int color = color_output(info);
+
+   if (color < 0)
+      return;
+
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block) {
+         nir_intrinsic_instr *intr;
+         nir_const_value *offset;
+         nir_ssa_def *value, *comps[4];
+         unsigned alpha, i;
+
+         if (instr->type != nir_instr_type_intrinsic)
+            continue;
+
+         intr = nir_instr_as_intrinsic(instr);
+         if (intr->intrinsic != nir_intrinsic_store_output)
+            continue;
+
+         offset = nir_src_as_const_value(intr->src[1]);
+         if (!offset || nir_intrinsic_base(intr) + offset->u32[0] != color)
+            continue;
+
+         if (nir_intrinsic_component(intr) > 3)
+            continue;
+         alpha = 3 - nir_intrinsic_component(intr);
+         if (alpha >= intr->num_components ||
+             !(nir_intrinsic_write_mask(intr) & (1 << alpha)))
+            continue;
+
+         b->cursor = nir_before_instr(instr);
+
+         value = nir_ssa_for_src(b, intr->src[0], intr->num_components);
+         for (i = 0; i < intr->num_components; i++)
+            comps[i] = nir_channel(b, value, i);
+         comps[alpha] = nir_fmul(b, comps[alpha], coverage);
+
+         nir_instr_rewrite_src(instr, &intr->src[0],
+                               nir_src_for_ssa(nir_vec(b, comps,
+                                                       intr->num_components)));
+      }
+   }
+}
+
+/**
+ * AA lines: sample the alpha of the line's coverage texture with the
+ * texture coordinates the stage emits in a new GENERIC input, and
+ * multiply the color alpha by it.
+ */
+void
+nir_lower_aaline_fs(struct nir_shader *shader, unsigned *sampler_unit,
+                    int *generic_attrib)
+{
+   nir_function_impl *impl = nir_shader_get_entrypoint(shader);
+   struct tgsi_shader_info info;
+   nir_ssa_def *texcoord, *tex;
+   nir_builder b;
+
+   assert(shader->stage == MESA_SHADER_FRAGMENT);
+
+   nir_tgsi_scan_shader(shader, &info);
+   *sampler_unit = free_sampler(&info);
+
+   nir_builder_init(&b, impl);
+   b.cursor = nir_before_cf_list(&impl->body);
+
+   texcoord = load_generic(&b, &info, generic_attrib);
+   tex = sample_2d(&b, texcoord, *sampler_unit);
+
+   modulate_alpha(&b, impl, &info, nir_channel(&b, tex, 3));
+
+   nir_metadata_preserve(impl, nir_metadata_block_index |
+                               nir_metadata_dominance);
+}
+
+/**
+ * AA points: the stage emits (x, y, k, 1) in a new GENERIC input, where
+ * (x, y) is the position in the point relative to its center and radius.
+ * Kill fragments outside the point, and multiply the color alpha by
+ * (1 - d) / (1 - k) beyond the inner radius k, with d = x^2 + y^2.
+ */
+void
+nir_lower_aapoint_fs(struct nir_shader *shader, int *generic_attrib)
+{
+   nir_function_impl *impl = nir_shader_get_entrypoint(shader);
+   struct tgsi_shader_info info;
+   nir_ssa_def *texcoord, *x, *y, *k, *one, *d, *m, *coverage;
+   nir_builder b;
+
+   assert(shader->stage == MESA_SHADER_FRAGMENT);
+
+   nir_tgsi_scan_shader(shader, &info);
+
+   nir_builder_init(&b, impl);
+   b.cursor = nir_before_cf_list(&impl->body);
+
+   texcoord = load_generic(&b, &info, generic_attrib);
+   x = nir_channel(&b, texcoord, 0);
+   y = nir_channel(&b, texcoord, 1);
+   k = nir_channel(&b, texcoord, 2);
+   one = nir_channel(&b, texcoord, 3);
+
+   d = nir_fadd(&b, nir_fmul(&b, x, x), nir_fmul(&b, y, y));
+   discard_if(&b, nir_flt(&b, one, d));
+
+   m = nir_frcp(&b, nir_fsub(&b, one, k));
+   coverage = nir_fmul(&b, nir_fsub(&b, one, d), m);
+   coverage = nir_bcsel(&b, nir_fge(&b, k, d), one, coverage);
+
+   modulate_alpha(&b, impl, &info, coverage);
+
+   nir_metadata_preserve(impl, nir_metadata_block_index |
+                               nir_metadata_dominance);
+}
+
+/**
+ * Polygon stipple: sample the stipple texture at the window position
+ * divided by the 32x32 pattern size, and kill the fragment where the
+ * texel is set.  The position is taken from the POSITION input, which
+ * is added if the shader doesn't read it.
+ */
+void
+nir_lower_pstipple_fs(struct nir_shader *shader, unsigned *sampler_unit)
+{
+   nir_function_impl *impl = nir_shader_get_entrypoint(shader);
+   struct tgsi_shader_info info;
+   nir_ssa_def *wincoord, *coord, *tex;
+   int position = -1;
+   nir_builder b;
+   unsigned i;
+
+   assert(shader->stage == MESA_SHADER_FRAGMENT);
+
+   nir_tgsi_scan_shader(shader, &info);
+   *sampler_unit = free_sampler(&info);
+
+   for (i = 0; i < info.num_inputs; i++) {
+      if (info.input_semantic_name[i] == TGSI_SEMANTIC_POSITION) {
+         position = i;
+         break;
+      }
+   }
+
+   if (position < 0) {
+      nir_variable *var = add_input(shader, &info, VARYING_SLOT_POS,
+                                    "gl_FragCoord");
+      var->data.origin_upper_left = true;
+      position = var->data.driver_location;
+   }
+
+   nir_builder_init(&b, impl);
+   b.cursor = nir_before_cf_list(&impl->body);
+
+   wincoord = load_input(&b, position);
+   coord = nir_fmul(&b, wincoord,
+                    nir_imm_vec4(&b, 1.0 / 32.0, 1.0 / 32.0, 1.0, 1.0));
+   tex = sample_2d(&b, coord, *sampler_unit);
+
+   discard_if(&b, nir_flt(&b, nir_imm_float(&b, 0.0),
+                          nir_channel(&b, tex, 3)));
+
+   nir_metadata_preserve(impl, nir_metadata_block_index |
+                               nir_metadata_dominance);
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef NIR_DRAW_HELPERS_H
+#define NIR_DRAW_HELPERS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct nir_shader;
+
+void
+nir_lower_aaline_fs(struct nir_shader *shader, unsigned *sampler_unit,
+                    int *generic_attrib);
+
+void
+nir_lower_aapoint_fs(struct nir_shader *shader, int *generic_attrib);
+
+void
+nir_lower_pstipple_fs(struct nir_shader *shader, unsigned *sampler_unit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NIR_DRAW_HELPERS_H */
@@ -0,0 +1,323 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Fill in a tgsi_shader_info for a NIR fragment shader, as handed to
+ * create_fs_state() by st/mesa, for the drivers and modules which take
+ * the input and output layout of a shader from there (llvmpipe, draw).
+ *
+ * The NIR must have gone through nir_lower_io, with the driver locations
+ * of the inputs and outputs used as TGSI register indices.
+ */
+
+#include "compiler/nir/nir.h"
+#include "pipe/p_shader_tokens.h"
+#include "tgsi/tgsi_scan.h"
+#include "util/u_math.h"
+
+#include "tgsi_to_nir.h"
+#include "nir_to_tgsi_info.h"
+
+static void
+input_semantic(gl_varying_slot slot,
+               unsigned *semantic_name, unsigned *semantic_index)
+{
+   /* st/mesa moves TEXn and VARn to GENERIC for drivers without
+    * PIPE_CAP_TGSI_TEXCOORD but leaves PNTC alone, which is GENERIC 8 in
+    * the TGSI it would have generated.
+    */
+   if (slot == VARYING_SLOT_PNTC) {
+      *semantic_name = TGSI_SEMANTIC_GENERIC;
+      *semantic_index = 8;
+      return;
+   }
+
+   varying_slot_to_tgsi_semantic(slot, semantic_name, semantic_index);
+}
+
+static unsigned
+input_interpolate(const nir_variable *var, unsigned semantic_name)
+{
+   switch (var->data.interpolation) {
+   case INTERP_MODE_FLAT:
+      return TGSI_INTERPOLATE_CONSTANT;
+   case INTERP_MODE_NOPERSPECTIVE:
+      return TGSI_INTERPOLATE_LINEAR;
+   case INTERP_MODE_SMOOTH:
+      return TGSI_INTERPOLATE_PERSPECTIVE;
+   default:
+      break;
+   }
+
+   switch (semantic_name) {
+   case TGSI_SEMANTIC_POSITION:
+      return TGSI_INTERPOLATE_LINEAR;
+   case TGSI_SEMANTIC_COLOR:
+      return TGSI_INTERPOLATE_COLOR;
+   case TGSI_SEMANTIC_FACE:
+   case TGSI_SEMANTIC_PRIMID:
+   case TGSI_SEMANTIC_LAYER:
+   case TGSI_SEMANTIC_VIEWPORT_INDEX:
+      return TGSI_INTERPOLATE_CONSTANT;
+   default:
+      return TGSI_INTERPOLATE_PERSPECTIVE;
+   }
+}
+
+static void
+scan_inputs(const struct nir_shader *nir, struct tgsi_shader_info *info)
+{
+   nir_foreach_variable(var, &nir->inputs) {
+      unsigned slots = glsl_count_attribute_slots(var->type, false);
+      unsigned i;
+
+      for (i = 0; i < slots; i++) {
+         unsigned index = var->data.driver_location + i;
+         unsigned semantic_name, semantic_index;
+
+         if (index >= PIPE_MAX_SHADER_INPUTS)
+            continue;
+
+         input_semantic(var->data.location + i,
+                        &semantic_name, &semantic_index);
+
+         info->input_semantic_name[index] = semantic_name;
+         info->input_semantic_index[index] = semantic_index;
+         info->input_interpolate[index] =
+            input_interpolate(var, semantic_name);
+         if (var->data.sample)
+            info->input_interpolate_loc[index] = TGSI_INTERPOLATE_LOC_SAMPLE;
+         else if (var->data.centroid)
+            info->input_interpolate_loc[index] = TGSI_INTERPOLATE_LOC_CENTROID;
+         else
+            info->input_interpolate_loc[index] = TGSI_INTERPOLATE_LOC_CENTER;
+
+         info->num_inputs = MAX2(info->num_inputs, index + 1);
+         if (index < 32)
+            info->file_mask[TGSI_FILE_INPUT] |= 1u << index;
+
+         switch (semantic_name) {
+         case TGSI_SEMANTIC_POSITION:
+            info->reads_position = TRUE;
+            info->properties[TGSI_PROPERTY_FS_COORD_ORIGIN] =
+               var->data.origin_upper_left ?
+               TGSI_FS_COORD_ORIGIN_UPPER_LEFT :
+               TGSI_FS_COORD_ORIGIN_LOWER_LEFT;
+            info->properties[TGSI_PROPERTY_FS_COORD_PIXEL_CENTER] =
+               var->data.pixel_center_integer ?
+               TGSI_FS_COORD_PIXEL_CENTER_INTEGER :
+               TGSI_FS_COORD_PIXEL_CENTER_HALF_INTEGER;
+            break;
+         case TGSI_SEMANTIC_FACE:
+            info->uses_frontface = TRUE;
+            break;
+         case TGSI_SEMANTIC_PRIMID:
+            info->uses_primid = TRUE;
+            break;
+         }
+      }
+   }
+
+   info->file_count[TGSI_FILE_INPUT] = info->num_inputs;
+   info->file_max[TGSI_FILE_INPUT] = (int)info->num_inputs - 1;
+}
+
+static void
+scan_outputs(const struct nir_shader *nir, struct tgsi_shader_info *info)
+{
+   nir_foreach_variable(var, &nir->outputs) {
+      unsigned slots = glsl_count_attribute_slots(var->type, false);
+      unsigned i;
+
+      for (i = 0; i < slots; i++) {
+         unsigned index = var->data.driver_location + i;
+         int location = var->data.location + i;
+         unsigned semantic_name, semantic_index = 0;
+
+         if (index >= PIPE_MAX_SHADER_OUTPUTS)
+            continue;
+
+         switch (location) {
+         case FRAG_RESULT_DEPTH:
+            semantic_name = TGSI_SEMANTIC_POSITION;
+            info->writes_z = TRUE;
+            break;
+         case FRAG_RESULT_STENCIL:
+            semantic_name = TGSI_SEMANTIC_STENCIL;
+            info->writes_stencil = TRUE;
+            break;
+         case FRAG_RESULT_SAMPLE_MASK:
+            semantic_name = TGSI_SEMANTIC_SAMPLEMASK;
+            info->writes_samplemask = TRUE;
+            break;
+         case FRAG_RESULT_COLOR:
+            semantic_name = TGSI_SEMANTIC_COLOR;
+            info->properties[TGSI_PROPERTY_FS_COLOR0_WRITES_ALL_CBUFS] = 1;
+            break;
+         default:
+            assert(location >= FRAG_RESULT_DATA0);
+            semantic_name = TGSI_SEMANTIC_COLOR;
+            /* the second source of dual source blending is COLOR[1] */
+            semantic_index = location - FRAG_RESULT_DATA0 + var->data.index;
+            break;
+         }
+
+         info->output_semantic_name[index] = semantic_name;
+         info->output_semantic_index[index] = semantic_index;
+         info->num_outputs = MAX2(info->num_outputs, index + 1);
+         if (index < 32)
+            info->file_mask[TGSI_FILE_OUTPUT] |= 1u << index;
+      }
+   }
+
+   info->file_count[TGSI_FILE_OUTPUT] = info->num_outputs;
+   info->file_max[TGSI_FILE_OUTPUT] = (int)info->num_outputs - 1;
+}
+
+static void
+scan_tex(const nir_tex_instr *instr, struct tgsi_shader_info *info)
+{
+   unsigned sampler = instr->sampler_index;
+   unsigned texture = instr->texture_index;
+
+   info->num_memory_instructions++;
+
+   if (sampler < 32) {
+      info->file_mask[TGSI_FILE_SAMPLER] |= 1u << sampler;
+      info->samplers_declared |= 1u << sampler;
+   }
+   info->file_max[TGSI_FILE_SAMPLER] =
+      MAX2(info->file_max[TGSI_FILE_SAMPLER], (int)sampler);
+
+   if (texture < 32)
+      info->file_mask[TGSI_FILE_SAMPLER_VIEW] |= 1u << texture;
+   info->file_max[TGSI_FILE_SAMPLER_VIEW] =
+      MAX2(info->file_max[TGSI_FILE_SAMPLER_VIEW],
+           (int)(texture + MAX2(instr->texture_array_size, 1) - 1));
+}
+
+static void
+scan_intrinsic(nir_intrinsic_instr *instr,
+               struct tgsi_shader_info *info)
+{
+   nir_const_value *offset;
+   unsigned i;
+
+   switch (instr->intrinsic) {
+   case nir_intrinsic_load_input:
+      offset = nir_src_as_const_value(instr->src[0]);
+      if (offset) {
+         unsigned index = nir_intrinsic_base(instr) + offset->u32[0];
+         unsigned mask = ((1 << instr->num_components) - 1) <<
+                         nir_intrinsic_component(instr);
+
+         if (index < PIPE_MAX_SHADER_INPUTS)
+            info->input_usage_mask[index] |= mask;
+      } else {
+         for (i = 0; i < PIPE_MAX_SHADER_INPUTS; i++)
+            info->input_usage_mask[i] = TGSI_WRITEMASK_XYZW;
+      }
+      break;
+
+   case nir_intrinsic_load_uniform:
+      offset = nir_src_as_const_value(instr->src[0]);
+      info->const_file_max[0] =
+         MAX2(info->const_file_max[0],
+              (int)nir_intrinsic_base(instr) + (offset ? offset->u32[0] : 0));
+      break;
+
+   case nir_intrinsic_load_ubo:
+      /* UBO n is bound to constant buffer n + 1 */
+      offset = nir_src_as_const_value(instr->src[0]);
+      for (i = 1; i < PIPE_MAX_CONSTANT_BUFFERS; i++) {
+         if (!offset || offset->u32[0] + 1 == i)
+            info->const_file_max[i] = MAX2(info->const_file_max[i], 0);
+      }
+      break;
+
+   case nir_intrinsic_load_front_face:
+      info->uses_frontface = TRUE;
+      break;
+
+   case nir_intrinsic_discard:
+   case nir_intrinsic_discard_if:
+      info->uses_kill = TRUE;
+      break;
+
+   default:
+      break;
+   }
+}
+
+void
+nir_tgsi_scan_shader(const struct nir_shader *nir,
+                     struct tgsi_shader_info *info)
+{
+   unsigned i;
+
+   assert(nir->stage == MESA_SHADER_FRAGMENT);
+
+   memset(info, 0, sizeof *info);
+   for (i = 0; i < TGSI_FILE_COUNT; i++)
+      info->file_max[i] = -1;
+   for (i = 0; i < ARRAY_SIZE(info->const_file_max); i++)
+      info->const_file_max[i] = -1;
+
+   info->processor = PIPE_SHADER_FRAGMENT;
+
+   /* There are no tokens, but num_tokens <= 1 is taken to mean an empty
+    * shader in places.
+    */
+   info->num_tokens = 2;
+
+   scan_inputs(nir, info);
+   scan_outputs(nir, info);
+
+   if (nir->num_uniforms)
+      info->const_file_max[0] = nir->num_uniforms - 1;
+
+   nir_foreach_function(function, nir) {
+      if (!function->impl)
+         continue;
+
+      nir_foreach_block(block, function->impl) {
+         nir_foreach_instr(instr, block) {
+            info->num_instructions++;
+
+            if (instr->type == nir_instr_type_tex)
+               scan_tex(nir_instr_as_tex(instr), info);
+            else if (instr->type == nir_instr_type_intrinsic)
+               scan_intrinsic(nir_instr_as_intrinsic(instr), info);
+         }
+      }
+   }
+
+   for (i = 0; i < info->num_inputs; i++) {
+      if (info->input_semantic_name[i] == TGSI_SEMANTIC_COLOR &&
+          info->input_semantic_index[i] < 2)
+         info->colors_read |= info->input_usage_mask[i] <<
+                              (info->input_semantic_index[i] * 4);
+   }
+
+   info->file_max[TGSI_FILE_CONSTANT] = info->const_file_max[0];
+}
@@ -84,6 +84,42 @@ struct tgsi_double_vector {
    union tgsi_double_channel zw;
 };
 
+/**
+ * Most operands address a register directly, so which channel of which
+ * register they access is known before the shader runs.  Those are
+ * decoded once, when the shader is bound, and the interpreter then skips
+ * building index vectors, looking up swizzles and switching on the
+ * register file for every channel of every quad.  Operands which need
+ * run-time addressing are left undecoded and take the general path.
+ */
+struct tgsi_exec_src_operand
+{
+   /** TGSI_FILE_NULL if not decoded */
+   unsigned File;
+
+   /** Channel read for each of x, y, z, w, after swizzling */
+   const union tgsi_exec_channel *Chan[TGSI_NUM_CHANNELS];
+
+   /**
+    * TGSI_FILE_CONSTANT: constant buffers are rebound between runs, so
+    * keep the buffer and the element of each channel instead.
+    */
+   unsigned ConstBuf;
+   int ConstPos[TGSI_NUM_CHANNELS];
+};
+
+struct tgsi_exec_dst_operand
+{
+   /** Channel written for each of x, y, z, w, NULL if not decoded */
+   union tgsi_exec_channel *Chan[TGSI_NUM_CHANNELS];
+};
+
+struct tgsi_exec_operands
+{
+   struct tgsi_exec_src_operand Src[TGSI_FULL_MAX_SRC_REGISTERS];
+   struct tgsi_exec_dst_operand Dst[TGSI_FULL_MAX_DST_REGISTERS];
+};
+
 static void
 micro_abs(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
@@ -845,6 +881,171 @@ tgsi_check_soa_dependencies(const struct tgsi_full_instruction *inst)
 }
 
 
+static void
+decode_src_operand(const struct tgsi_exec_machine *mach,
+                   const struct tgsi_full_src_register *reg,
+                   struct tgsi_exec_src_operand *op)
+{
+   const int index = reg->Register.Index;
+   int index2D = 0;
+   uint chan;
+
+   op->File = TGSI_FILE_NULL;
+
+   if (reg->Register.Indirect)
+      return;
+
+   if (reg->Register.Dimension) {
+      if (reg->Dimension.Indirect)
+         return;
+      index2D = reg->Dimension.Index;
+   }
+
+   if (index < 0 || index2D < 0)
+      return;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      const uint swizzle = tgsi_util_get_full_src_register_swizzle(reg, chan);
+
+      switch (reg->Register.File) {
+      case TGSI_FILE_CONSTANT:
+         if (index2D >= PIPE_MAX_CONSTANT_BUFFERS)
+            return;
+         op->ConstBuf = index2D;
+         op->ConstPos[chan] = index * 4 + swizzle;
+         break;
+
+      case TGSI_FILE_INPUT:
+         if (!mach->Inputs || index >= TGSI_EXEC_MAX_INPUT_ATTRIBS ||
+             index2D >= (mach->ShaderType == PIPE_SHADER_GEOMETRY ?
+                         TGSI_MAX_PRIM_VERTICES : 1))
+            return;
+         op->Chan[chan] = &mach->Inputs[index2D * TGSI_EXEC_MAX_INPUT_ATTRIBS +
+                                        index].xyzw[swizzle];
+         break;
+
+      case TGSI_FILE_SYSTEM_VALUE:
+         if (index2D || index >= TGSI_MAX_MISC_INPUTS)
+            return;
+         op->Chan[chan] = &mach->SystemValue[index].xyzw[swizzle];
+         break;
+
+      case TGSI_FILE_TEMPORARY:
+         if (index2D || index >= TGSI_EXEC_NUM_TEMPS)
+            return;
+         op->Chan[chan] = &mach->Temps[index].xyzw[swizzle];
+         break;
+
+      case TGSI_FILE_IMMEDIATE:
+         if (index2D || index >= (int) mach->ImmLimit)
+            return;
+         op->Chan[chan] = &mach->ImmChannels[index * 4 + swizzle];
+         break;
+
+      case TGSI_FILE_OUTPUT:
+         if (!mach->Outputs || index2D || index >= PIPE_MAX_SHADER_OUTPUTS)
+            return;
+         op->Chan[chan] = &mach->Outputs[index].xyzw[swizzle];
+         break;
+
+      default:
+         return;
+      }
+   }
+
+   op->File = reg->Register.File;
+}
+
+static void
+decode_dst_operand(struct tgsi_exec_machine *mach,
+                   const struct tgsi_full_instruction *inst,
+                   const struct tgsi_full_dst_register *reg,
+                   struct tgsi_exec_dst_operand *op)
+{
+   const int index = reg->Register.Index;
+   uint chan;
+
+   /* Output stores are offset at run time by the geometry shader's vertex
+    * counter, so only temporaries are decoded.
+    */
+   if (reg->Register.File != TGSI_FILE_TEMPORARY ||
+       reg->Register.Indirect ||
+       reg->Register.Dimension ||
+       inst->Instruction.Predicate ||
+       index < 0 || index >= TGSI_EXEC_NUM_TEMPS)
+      return;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+      op->Chan[chan] = &mach->Temps[index].xyzw[chan];
+}
+
+DEBUG_GET_ONCE_BOOL_OPTION(tgsi_exec_decode, "TGSI_EXEC_DECODE", TRUE)
+
+/**
+ * Decode the operands of every instruction of the bound shader.  Leaves
+ * mach->Operands NULL, so that everything goes through the general path,
+ * when disabled with TGSI_EXEC_DECODE=0 or out of memory.
+ */
+static void
+decode_operands(struct tgsi_exec_machine *mach)
+{
+   uint i, j;
+
+   if (!debug_get_option_tgsi_exec_decode())
+      return;
+
+   if (mach->ImmLimit) {
+      mach->ImmChannels = align_malloc(mach->ImmLimit * TGSI_NUM_CHANNELS *
+                                       sizeof(union tgsi_exec_channel), 16);
+      if (!mach->ImmChannels)
+         return;
+
+      for (i = 0; i < mach->ImmLimit; i++) {
+         for (j = 0; j < TGSI_NUM_CHANNELS; j++) {
+            union tgsi_exec_channel *chan = &mach->ImmChannels[i * 4 + j];
+
+            chan->f[0] =
+            chan->f[1] =
+            chan->f[2] =
+            chan->f[3] = mach->Imms[i][j];
+         }
+      }
+   }
+
+   if (!mach->NumInstructions)
+      return;
+
+   mach->Operands = CALLOC(mach->NumInstructions,
+                           sizeof(struct tgsi_exec_operands));
+   if (!mach->Operands)
+      return;
+
+   for (i = 0; i < mach->NumInstructions; i++) {
+      const struct tgsi_full_instruction *inst = &mach->Instructions[i];
+      struct tgsi_exec_operands *ops = &mach->Operands[i];
+
+      for (j = 0; j < inst->Instruction.NumSrcRegs; j++)
+         decode_src_operand(mach, &inst->Src[j], &ops->Src[j]);
+
+      for (j = 0; j < inst->Instruction.NumDstRegs; j++)
+         decode_dst_operand(mach, inst, &inst->Dst[j], &ops->Dst[j]);
+   }
+}
+
+static void
+free_operands(struct tgsi_exec_machine *mach)
+{
+   FREE(mach->Operands);
+   mach->Operands = NULL;
+
+   align_free(mach->ImmChannels);
+   mach->ImmChannels = NULL;
+
+   mach->CurrentInst = NULL;
+   mach->CurrentOperands = NULL;
+}
+
+
 /**
  * Initialize machine state by expanding tokens to full instructions,
  * allocating temporary storage, setting up constants, etc.
@@ -877,6 +1078,8 @@ tgsi_exec_machine_bind_shader(
    mach->Image = image;
    mach->Buffer = buffer;
 
+   free_operands(mach);
+
    if (!tokens) {
       /* unbind and free all */
       FREE(mach->Declarations);
@@ -1033,6 +1236,8 @@ tgsi_exec_machine_bind_shader(
    FREE(mach->Instructions);
    mach->Instructions = instructions;
    mach->NumInstructions = numInstructions;
+
+   decode_operands(mach);
 }
 
 
@@ -1096,6 +1301,7 @@ void
 tgsi_exec_machine_destroy(struct tgsi_exec_machine *mach)
 {
    if (mach) {
+      free_operands(mach);
       FREE(mach->Instructions);
       FREE(mach->Declarations);
 
@@ -1346,6 +1552,26 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
    }
 }
 
+/**
+ * Return the decoded form of source \p reg of the current instruction, or
+ * NULL if it has to be fetched the long way.
+ */
+static inline const struct tgsi_exec_src_operand *
+get_src_operand(const struct tgsi_exec_machine *mach,
+                const struct tgsi_full_src_register *reg)
+{
+   const struct tgsi_exec_src_operand *op;
+
+   if (!mach->CurrentOperands)
+      return NULL;
+
+   assert(reg >= mach->CurrentInst->Src &&
+          reg < mach->CurrentInst->Src + TGSI_FULL_MAX_SRC_REGISTERS);
+
+   op = &mach->CurrentOperands->Src[reg - mach->CurrentInst->Src];
+   return op->File != TGSI_FILE_NULL ? op : NULL;
+}
+
 static void
 fetch_source_d(const struct tgsi_exec_machine *mach,
                union tgsi_exec_channel *chan,
@@ -1353,10 +1579,34 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
                const uint chan_index,
                enum tgsi_exec_datatype src_datatype)
 {
+   const struct tgsi_exec_src_operand *op = get_src_operand(mach, reg);
    union tgsi_exec_channel index;
    union tgsi_exec_channel index2D;
    uint swizzle;
 
+   if (op) {
+      if (op->File == TGSI_FILE_CONSTANT) {
+         const uint *buf = (const uint *) mach->Consts[op->ConstBuf];
+         const int pos = op->ConstPos[chan_index];
+         uint value = 0;
+
+         assert(buf);
+
+         /* const buffer bounds check */
+         if (pos < (int) mach->ConstsSize[op->ConstBuf])
+            value = buf[pos];
+
+         chan->u[0] =
+         chan->u[1] =
+         chan->u[2] =
+         chan->u[3] = value;
+      }
+      else {
+         *chan = *op->Chan[chan_index];
+      }
+      return;
+   }
+
    /* We start with a direct index into a register file.
     *
     *    file[1],
@@ -1741,6 +1991,26 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
    return dst;
 }
 
+/**
+ * Return the register channel written by channel \p chan_index of
+ * destination \p reg of the current instruction, or NULL if it has to be
+ * looked up the long way.
+ */
+static inline union tgsi_exec_channel *
+get_dst_channel(const struct tgsi_exec_machine *mach,
+                const struct tgsi_full_dst_register *reg,
+                const struct tgsi_full_instruction *inst,
+                uint chan_index)
+{
+   if (!mach->CurrentOperands)
+      return NULL;
+
+   assert(inst == mach->CurrentInst);
+   assert(reg >= inst->Dst && reg < inst->Dst + TGSI_FULL_MAX_DST_REGISTERS);
+
+   return mach->CurrentOperands->Dst[reg - inst->Dst].Chan[chan_index];
+}
+
 static void
 store_dest_double(struct tgsi_exec_machine *mach,
                  const union tgsi_exec_channel *chan,
@@ -1753,8 +2023,10 @@ store_dest_double(struct tgsi_exec_machine *mach,
    const uint execmask = mach->ExecMask;
    int i;
 
-   dst = store_dest_dstret(mach, chan, reg, inst, chan_index,
-			   dst_datatype);
+   dst = get_dst_channel(mach, reg, inst, chan_index);
+   if (!dst)
+      dst = store_dest_dstret(mach, chan, reg, inst, chan_index,
+                              dst_datatype);
    if (!dst)
       return;
 
@@ -1776,12 +2048,19 @@ store_dest(struct tgsi_exec_machine *mach,
    const uint execmask = mach->ExecMask;
    int i;
 
-   dst = store_dest_dstret(mach, chan, reg, inst, chan_index,
-                    dst_datatype);
+   dst = get_dst_channel(mach, reg, inst, chan_index);
+   if (!dst)
+      dst = store_dest_dstret(mach, chan, reg, inst, chan_index,
+                              dst_datatype);
    if (!dst)
       return;
 
    if (!inst->Instruction.Saturate) {
+      if (execmask == 0xf) {
+         /* all four lanes */
+         *dst = *chan;
+         return;
+      }
       for (i = 0; i < TGSI_QUAD_SIZE; i++)
          if (execmask & (1 << i))
             dst->i[i] = chan->i[i];
@@ -4838,6 +5117,10 @@ exec_instruction(
 {
    union tgsi_exec_channel r[10];
 
+   mach->CurrentInst = inst;
+   mach->CurrentOperands = mach->Operands ?
+      &mach->Operands[inst - mach->Instructions] : NULL;
+
    (*pc)++;
 
    switch (inst->Instruction.Opcode) {
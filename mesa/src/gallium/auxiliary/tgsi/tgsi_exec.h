@@ -337,6 +337,10 @@ enum tgsi_break_type {
 #define TGSI_EXEC_MAX_BREAK_STACK (TGSI_EXEC_MAX_LOOP_NESTING + TGSI_EXEC_MAX_SWITCH_NESTING)
 
 
+/** Operands of an instruction, decoded when the shader is bound */
+struct tgsi_exec_operands;
+
+
 /**
  * Run-time virtual machine state for executing TGSI shader.
  */
@@ -438,6 +442,15 @@ struct tgsi_exec_machine
    struct tgsi_full_instruction *Instructions;
    uint NumInstructions;
 
+   /** Decoded operands of each instruction, NULL if disabled */
+   struct tgsi_exec_operands *Operands;
+   /** Immediates replicated across the quad, for decoded operands */
+   union tgsi_exec_channel *ImmChannels;
+
+   /** The instruction being executed and its decoded operands */
+   const struct tgsi_full_instruction *CurrentInst;
+   const struct tgsi_exec_operands *CurrentOperands;
+
    struct tgsi_full_declaration *Declarations;
    uint NumDeclarations;
 
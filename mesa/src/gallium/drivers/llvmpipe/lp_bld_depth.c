@@ -511,6 +511,17 @@ lp_build_occlusion_count(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * Element of a row-major 2x4 or 4x4 block of values which goes into
+ * element i of a vector of 2x2 quads (and vice versa).
+ */
+static inline unsigned
+lp_depth_quad_swizzle(unsigned i)
+{
+   return (i&1) + (i&2) * 2 + (i&4) / 2 + (i&8);
+}
+
+
 /**
  * Load depth/stencil values.
  * The stored values are linear, swizzle them.
@@ -537,19 +548,20 @@ lp_build_depth_stencil_load_swizzled(struct gallivm_state *gallivm,
 {
    LLVMBuilderRef builder = gallivm->builder;
    LLVMValueRef shuffles[LP_MAX_VECTOR_LENGTH / 4];
-   LLVMValueRef zs_dst1, zs_dst2;
+   LLVMValueRef zs_dst[4];
    LLVMValueRef zs_dst_ptr;
-   LLVMValueRef depth_offset1, depth_offset2;
+   LLVMValueRef depth_offset1;
    LLVMTypeRef load_ptr_type;
    unsigned depth_bytes = format_desc->block.bits / 8;
    struct lp_type zs_type = lp_depth_type(format_desc, z_src_type.length);
    struct lp_type zs_load_type = zs_type;
+   unsigned num_rows = z_src_type.length == 16 ? 4 : 2;
+   unsigned i;
 
-   zs_load_type.length = zs_load_type.length / 2;
+   zs_load_type.length = zs_load_type.length / num_rows;
    load_ptr_type = LLVMPointerType(lp_build_vec_type(gallivm, zs_load_type), 0);
 
    if (z_src_type.length == 4) {
-      unsigned i;
       LLVMValueRef looplsb = LLVMBuildAnd(builder, loop_counter,
                                           lp_build_const_int32(gallivm, 1), "");
       LLVMValueRef loopmsb = LLVMBuildAnd(builder, loop_counter,
@@ -565,37 +577,57 @@ lp_build_depth_stencil_load_swizzled(struct gallivm_state *gallivm,
          shuffles[i] = lp_build_const_int32(gallivm, i);
       }
    }
-   else {
-      unsigned i;
+   else if (z_src_type.length == 8) {
       LLVMValueRef loopx2 = LLVMBuildShl(builder, loop_counter,
                                          lp_build_const_int32(gallivm, 1), "");
-      assert(z_src_type.length == 8);
       depth_offset1 = LLVMBuildMul(builder, loopx2, depth_stride, "");
       /*
        * We load 2x4 values, and need to swizzle them (order
        * 0,1,4,5,2,3,6,7) - not so hot with avx unfortunately.
        */
       for (i = 0; i < 8; i++) {
-         shuffles[i] = lp_build_const_int32(gallivm, (i&1) + (i&2) * 2 + (i&4) / 2);
+         shuffles[i] = lp_build_const_int32(gallivm, lp_depth_quad_swizzle(i));
+      }
+   }
+   else {
+      /*
+       * The whole 4x4 block at once, loaded as 4 rows.  Same swizzle as
+       * above, with the quads of rows 2 and 3 following those of rows 0
+       * and 1.
+       */
+      assert(z_src_type.length == 16);
+      depth_offset1 = lp_build_const_int32(gallivm, 0);
+      for (i = 0; i < 16; i++) {
+         shuffles[i] = lp_build_const_int32(gallivm, lp_depth_quad_swizzle(i));
       }
    }
-
-   depth_offset2 = LLVMBuildAdd(builder, depth_offset1, depth_stride, "");
 
    /* Load current z/stencil values from z/stencil buffer */
-   zs_dst_ptr = LLVMBuildGEP(builder, depth_ptr, &depth_offset1, 1, "");
-   zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, load_ptr_type, "");
-   zs_dst1 = LLVMBuildLoad(builder, zs_dst_ptr, "");
-   if (is_1d) {
-      zs_dst2 = lp_build_undef(gallivm, zs_load_type);
-   }
-   else {
-      zs_dst_ptr = LLVMBuildGEP(builder, depth_ptr, &depth_offset2, 1, "");
+   for (i = 0; i < num_rows; i++) {
+      LLVMValueRef depth_offset = depth_offset1;
+
+      if (is_1d && i > 0) {
+         zs_dst[i] = lp_build_undef(gallivm, zs_load_type);
+         continue;
+      }
+
+      if (i > 0) {
+         LLVMValueRef row_offset = LLVMBuildMul(builder, depth_stride,
+                                                lp_build_const_int32(gallivm, i), "");
+         depth_offset = LLVMBuildAdd(builder, depth_offset1, row_offset, "");
+      }
+
+      zs_dst_ptr = LLVMBuildGEP(builder, depth_ptr, &depth_offset, 1, "");
       zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, load_ptr_type, "");
-      zs_dst2 = LLVMBuildLoad(builder, zs_dst_ptr, "");
+      zs_dst[i] = LLVMBuildLoad(builder, zs_dst_ptr, "");
+   }
+
+   if (num_rows == 4) {
+      zs_dst[0] = lp_build_concat(gallivm, &zs_dst[0], zs_load_type, 2);
+      zs_dst[1] = lp_build_concat(gallivm, &zs_dst[2], zs_load_type, 2);
    }
 
-   *z_fb = LLVMBuildShuffleVector(builder, zs_dst1, zs_dst2,
+   *z_fb = LLVMBuildShuffleVector(builder, zs_dst[0], zs_dst[1],
                                   LLVMConstVector(shuffles, zs_type.length), "");
    *s_fb = *z_fb;
 
@@ -607,7 +639,6 @@ lp_build_depth_stencil_load_swizzled(struct gallivm_state *gallivm,
 
    else if (format_desc->block.bits > 32) {
       /* rely on llvm to handle too wide vector we have here nicely */
-      unsigned i;
       struct lp_type typex2 = zs_type;
       struct lp_type s_type = zs_type;
       LLVMValueRef shuffles1[LP_MAX_VECTOR_LENGTH / 4];
@@ -675,16 +706,18 @@ lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
    LLVMValueRef shuffles[LP_MAX_VECTOR_LENGTH / 4];
    LLVMBuilderRef builder = gallivm->builder;
    LLVMValueRef mask_value = NULL;
-   LLVMValueRef zs_dst1, zs_dst2;
-   LLVMValueRef zs_dst_ptr1, zs_dst_ptr2;
-   LLVMValueRef depth_offset1, depth_offset2;
+   LLVMValueRef zs_dst[4];
+   LLVMValueRef zs_dst_ptr;
+   LLVMValueRef depth_offset1;
    LLVMTypeRef load_ptr_type;
    unsigned depth_bytes = format_desc->block.bits / 8;
    struct lp_type zs_type = lp_depth_type(format_desc, z_src_type.length);
    struct lp_type z_type = zs_type;
    struct lp_type zs_load_type = zs_type;
+   unsigned num_rows = z_src_type.length == 16 ? 4 : 2;
+   unsigned i;
 
-   zs_load_type.length = zs_load_type.length / 2;
+   zs_load_type.length = zs_load_type.length / num_rows;
    load_ptr_type = LLVMPointerType(lp_build_vec_type(gallivm, zs_load_type), 0);
 
    z_type.width = z_src_type.width;
@@ -706,27 +739,26 @@ lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
                                    lp_build_const_int32(gallivm, depth_bytes * 2), "");
       depth_offset1 = LLVMBuildAdd(builder, depth_offset1, offset2, "");
    }
-   else {
-      unsigned i;
+   else if (z_src_type.length == 8) {
       LLVMValueRef loopx2 = LLVMBuildShl(builder, loop_counter,
                                          lp_build_const_int32(gallivm, 1), "");
-      assert(z_src_type.length == 8);
       depth_offset1 = LLVMBuildMul(builder, loopx2, depth_stride, "");
       /*
        * We load 2x4 values, and need to swizzle them (order
        * 0,1,4,5,2,3,6,7) - not so hot with avx unfortunately.
        */
       for (i = 0; i < 8; i++) {
-         shuffles[i] = lp_build_const_int32(gallivm, (i&1) + (i&2) * 2 + (i&4) / 2);
+         shuffles[i] = lp_build_const_int32(gallivm, lp_depth_quad_swizzle(i));
+      }
+   }
+   else {
+      /* The whole 4x4 block, stored as 4 rows. */
+      assert(z_src_type.length == 16);
+      depth_offset1 = lp_build_const_int32(gallivm, 0);
+      for (i = 0; i < 16; i++) {
+         shuffles[i] = lp_build_const_int32(gallivm, lp_depth_quad_swizzle(i));
       }
    }
-
-   depth_offset2 = LLVMBuildAdd(builder, depth_offset1, depth_stride, "");
-
-   zs_dst_ptr1 = LLVMBuildGEP(builder, depth_ptr, &depth_offset1, 1, "");
-   zs_dst_ptr1 = LLVMBuildBitCast(builder, zs_dst_ptr1, load_ptr_type, "");
-   zs_dst_ptr2 = LLVMBuildGEP(builder, depth_ptr, &depth_offset2, 1, "");
-   zs_dst_ptr2 = LLVMBuildBitCast(builder, zs_dst_ptr2, load_ptr_type, "");
 
    if (format_desc->block.bits > 32) {
       s_value = LLVMBuildBitCast(builder, s_value, z_bld.vec_type, "");
@@ -749,51 +781,59 @@ lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
 
    if (format_desc->block.bits <= 32) {
       if (z_src_type.length == 4) {
-         zs_dst1 = lp_build_extract_range(gallivm, z_value, 0, 2);
-         zs_dst2 = lp_build_extract_range(gallivm, z_value, 2, 2);
+         zs_dst[0] = lp_build_extract_range(gallivm, z_value, 0, 2);
+         zs_dst[1] = lp_build_extract_range(gallivm, z_value, 2, 2);
       }
       else {
-         assert(z_src_type.length == 8);
-         zs_dst1 = LLVMBuildShuffleVector(builder, z_value, z_value,
-                                          LLVMConstVector(&shuffles[0],
-                                                          zs_load_type.length), "");
-         zs_dst2 = LLVMBuildShuffleVector(builder, z_value, z_value,
-                                          LLVMConstVector(&shuffles[4],
-                                                          zs_load_type.length), "");
+         for (i = 0; i < num_rows; i++) {
+            zs_dst[i] = LLVMBuildShuffleVector(builder, z_value, z_value,
+                                               LLVMConstVector(&shuffles[i * zs_load_type.length],
+                                                               zs_load_type.length), "");
+         }
       }
    }
    else {
       if (z_src_type.length == 4) {
-         zs_dst1 = lp_build_interleave2(gallivm, z_type,
-                                        z_value, s_value, 0);
-         zs_dst2 = lp_build_interleave2(gallivm, z_type,
-                                        z_value, s_value, 1);
+         zs_dst[0] = lp_build_interleave2(gallivm, z_type,
+                                          z_value, s_value, 0);
+         zs_dst[1] = lp_build_interleave2(gallivm, z_type,
+                                          z_value, s_value, 1);
       }
       else {
-         unsigned i;
          LLVMValueRef shuffles[LP_MAX_VECTOR_LENGTH / 2];
-         assert(z_src_type.length == 8);
-         for (i = 0; i < 8; i++) {
-            shuffles[i*2] = lp_build_const_int32(gallivm, (i&1) + (i&2) * 2 + (i&4) / 2);
-            shuffles[i*2+1] = lp_build_const_int32(gallivm, (i&1) + (i&2) * 2 + (i&4) / 2 +
+         for (i = 0; i < z_src_type.length; i++) {
+            shuffles[i*2] = lp_build_const_int32(gallivm, lp_depth_quad_swizzle(i));
+            shuffles[i*2+1] = lp_build_const_int32(gallivm, lp_depth_quad_swizzle(i) +
                                                    z_src_type.length);
          }
-         zs_dst1 = LLVMBuildShuffleVector(builder, z_value, s_value,
-                                          LLVMConstVector(&shuffles[0],
-                                                          z_src_type.length), "");
-         zs_dst2 = LLVMBuildShuffleVector(builder, z_value, s_value,
-                                          LLVMConstVector(&shuffles[8],
-                                                          z_src_type.length), "");
+         for (i = 0; i < num_rows; i++) {
+            zs_dst[i] = LLVMBuildShuffleVector(builder, z_value, s_value,
+                                               LLVMConstVector(&shuffles[i * zs_load_type.length * 2],
+                                                               zs_load_type.length * 2), "");
+         }
+      }
+      for (i = 0; i < num_rows; i++) {
+         zs_dst[i] = LLVMBuildBitCast(builder, zs_dst[i],
+                                      lp_build_vec_type(gallivm, zs_load_type), "");
       }
-      zs_dst1 = LLVMBuildBitCast(builder, zs_dst1,
-                                 lp_build_vec_type(gallivm, zs_load_type), "");
-      zs_dst2 = LLVMBuildBitCast(builder, zs_dst2,
-                                 lp_build_vec_type(gallivm, zs_load_type), "");
    }
 
-   LLVMBuildStore(builder, zs_dst1, zs_dst_ptr1);
-   if (!is_1d) {
-      LLVMBuildStore(builder, zs_dst2, zs_dst_ptr2);
+   for (i = 0; i < num_rows; i++) {
+      LLVMValueRef depth_offset = depth_offset1;
+
+      if (is_1d && i > 0) {
+         break;
+      }
+
+      if (i > 0) {
+         LLVMValueRef row_offset = LLVMBuildMul(builder, depth_stride,
+                                                lp_build_const_int32(gallivm, i), "");
+         depth_offset = LLVMBuildAdd(builder, depth_offset1, row_offset, "");
+      }
+
+      zs_dst_ptr = LLVMBuildGEP(builder, depth_ptr, &depth_offset, 1, "");
+      zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, load_ptr_type, "");
+      LLVMBuildStore(builder, zs_dst[i], zs_dst_ptr);
    }
 }
 
@@ -44,6 +44,7 @@
 #include "lp_state.h"
 #include "lp_surface.h"
 #include "lp_query.h"
+#include "lp_screen.h"
 #include "lp_setup.h"
 
 /* This is only safe if there's just one concurrent context */
@@ -56,7 +57,7 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    uint i, j;
 
-   lp_print_counters();
+   lp_print_counters(&llvmpipe->counters);
 
    if (llvmpipe->blitter) {
       util_blitter_destroy(llvmpipe->blitter);
@@ -97,6 +98,8 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
 
    lp_delete_setup_variants(llvmpipe);
 
+   llvmpipe_cleanup_cs(llvmpipe);
+
 #ifndef USE_GLOBAL_LLVM_CONTEXT
    LLVMContextDispose(llvmpipe->context);
 #endif
@@ -142,6 +145,10 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    memset(llvmpipe, 0, sizeof *llvmpipe);
 
    make_empty_list(&llvmpipe->fs_variants_list);
+   llvmpipe->max_fs_code_size =
+      (size_t)debug_get_num_option("LP_SHADER_CACHE_SIZE",
+                                   LP_MAX_SHADER_CODE_SIZE / (1024 * 1024))
+      * 1024 * 1024;
 
    make_empty_list(&llvmpipe->setup_variants_list);
 
@@ -167,6 +174,7 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    llvmpipe_init_fs_funcs(llvmpipe);
    llvmpipe_init_vs_funcs(llvmpipe);
    llvmpipe_init_gs_funcs(llvmpipe);
+   llvmpipe_init_cs_funcs(llvmpipe);
    llvmpipe_init_rasterizer_funcs(llvmpipe);
    llvmpipe_init_context_resource_funcs( &llvmpipe->pipe );
    llvmpipe_init_surface_functions(llvmpipe);
@@ -188,6 +196,9 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    if (!llvmpipe->draw)
       goto fail;
 
+   if (util_queue_is_initialized(&llvmpipe_screen(screen)->vs_queue))
+      draw_set_vs_queue(llvmpipe->draw, &llvmpipe_screen(screen)->vs_queue);
+
    /* FIXME: devise alternative to draw_texture_samplers */
 
    llvmpipe->setup = lp_setup_create( &llvmpipe->pipe,
@@ -216,8 +227,6 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    draw_wide_point_threshold(llvmpipe->draw, 10000.0);
    draw_wide_line_threshold(llvmpipe->draw, 10000.0);
 
-   lp_reset_counters();
-
    return &llvmpipe->pipe;
 
  fail:
@@ -38,7 +38,9 @@
 
 #include "lp_tex_sample.h"
 #include "lp_jit.h"
+#include "lp_perf.h"
 #include "lp_setup.h"
+#include "lp_state_cs.h"
 #include "lp_state_fs.h"
 #include "lp_state_setup.h"
 
@@ -67,6 +69,7 @@ struct llvmpipe_context {
    const struct lp_geometry_shader *gs;
    const struct lp_velems_state *velems;
    const struct lp_so_state *so;
+   struct lp_compute_shader *cs;
 
    /** Other rendering state */
    unsigned sample_mask;
@@ -78,6 +81,7 @@ struct llvmpipe_context {
    struct pipe_poly_stipple poly_stipple;
    struct pipe_scissor_state scissors[PIPE_MAX_VIEWPORTS];
    struct pipe_sampler_view *sampler_views[PIPE_SHADER_TYPES][PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   struct pipe_shader_buffer ssbos[PIPE_SHADER_TYPES][PIPE_MAX_SHADER_BUFFERS];
 
    struct pipe_viewport_state viewports[PIPE_MAX_VIEWPORTS];
    struct pipe_vertex_buffer vertex_buffer[PIPE_MAX_ATTRIBS];
@@ -97,6 +101,9 @@ struct llvmpipe_context {
 
    unsigned active_occlusion_queries;
 
+   /** Performance counters, read with driver-specific queries */
+   struct lp_counters counters;
+
    unsigned dirty; /**< Mask of LP_NEW_x flags */
 
    /** Mapped vertex buffers */
@@ -143,10 +150,16 @@ struct llvmpipe_context {
    struct lp_fs_variant_list_item fs_variants_list;
    unsigned nr_fs_variants;
    unsigned nr_fs_instrs;
+   size_t fs_code_size;      /**< bytes of JIT'ed code for all variants */
+   size_t max_fs_code_size;  /**< evict variants beyond this size */
 
    struct lp_setup_variant_list_item setup_variants_list;
    unsigned nr_setup_variants;
 
+   /** Compute shader state of each rasterizer thread */
+   struct lp_cs_exec **cs_exec;
+   unsigned num_cs_exec;
+
    /** Conditional query object and mode */
    struct pipe_query *render_cond_query;
    uint render_cond_mode;
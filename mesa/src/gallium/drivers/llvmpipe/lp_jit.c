@@ -39,6 +39,7 @@
 #include "gallivm/lp_bld_format.h"
 #include "lp_context.h"
 #include "lp_jit.h"
+#include "lp_state_cs.h"
 
 
 static void
@@ -247,3 +248,95 @@ lp_jit_init_types(struct lp_fragment_shader_variant *lp)
    if (!lp->jit_context_ptr_type)
       lp_jit_create_types(lp);
 }
+
+
+static void
+lp_jit_create_cs_types(struct lp_compute_shader *cs)
+{
+   struct gallivm_state *gallivm = cs->gallivm;
+   LLVMContextRef lc = gallivm->context;
+
+   /* struct lp_jit_cs_context */
+   {
+      LLVMTypeRef elem_types[LP_JIT_CS_CTX_COUNT];
+      LLVMTypeRef context_type;
+
+      elem_types[LP_JIT_CS_CTX_CONSTANTS] =
+         LLVMArrayType(LLVMPointerType(LLVMFloatTypeInContext(lc), 0), LP_MAX_TGSI_CONST_BUFFERS);
+      elem_types[LP_JIT_CS_CTX_NUM_CONSTANTS] =
+         LLVMArrayType(LLVMInt32TypeInContext(lc), LP_MAX_TGSI_CONST_BUFFERS);
+      elem_types[LP_JIT_CS_CTX_SSBOS] =
+         LLVMArrayType(LLVMPointerType(LLVMInt8TypeInContext(lc), 0), PIPE_MAX_SHADER_BUFFERS);
+      elem_types[LP_JIT_CS_CTX_SSBO_SIZES] =
+         LLVMArrayType(LLVMInt32TypeInContext(lc), PIPE_MAX_SHADER_BUFFERS);
+      elem_types[LP_JIT_CS_CTX_BLOCK_SIZE] =
+      elem_types[LP_JIT_CS_CTX_GRID_SIZE] =
+         LLVMArrayType(LLVMInt32TypeInContext(lc), 3);
+
+      context_type = LLVMStructTypeInContext(lc, elem_types,
+                                             ARRAY_SIZE(elem_types), 0);
+
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, constants,
+                             gallivm->target, context_type,
+                             LP_JIT_CS_CTX_CONSTANTS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, num_constants,
+                             gallivm->target, context_type,
+                             LP_JIT_CS_CTX_NUM_CONSTANTS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, ssbos,
+                             gallivm->target, context_type,
+                             LP_JIT_CS_CTX_SSBOS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, ssbo_sizes,
+                             gallivm->target, context_type,
+                             LP_JIT_CS_CTX_SSBO_SIZES);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, block_size,
+                             gallivm->target, context_type,
+                             LP_JIT_CS_CTX_BLOCK_SIZE);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, grid_size,
+                             gallivm->target, context_type,
+                             LP_JIT_CS_CTX_GRID_SIZE);
+      LP_CHECK_STRUCT_SIZE(struct lp_jit_cs_context,
+                           gallivm->target, context_type);
+
+      cs->jit_context_ptr_type = LLVMPointerType(context_type, 0);
+   }
+
+   /* struct lp_jit_cs_thread_data */
+   {
+      LLVMTypeRef elem_types[LP_JIT_CS_THREAD_DATA_COUNT];
+      LLVMTypeRef thread_data_type;
+
+      elem_types[LP_JIT_CS_THREAD_DATA_SHARED] =
+      elem_types[LP_JIT_CS_THREAD_DATA_EXEC] =
+         LLVMPointerType(LLVMInt8TypeInContext(lc), 0);
+      elem_types[LP_JIT_CS_THREAD_DATA_SHARED_SIZE] = LLVMInt32TypeInContext(lc);
+
+      thread_data_type = LLVMStructTypeInContext(lc, elem_types,
+                                                 ARRAY_SIZE(elem_types), 0);
+
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_thread_data, shared,
+                             gallivm->target, thread_data_type,
+                             LP_JIT_CS_THREAD_DATA_SHARED);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_thread_data, shared_size,
+                             gallivm->target, thread_data_type,
+                             LP_JIT_CS_THREAD_DATA_SHARED_SIZE);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_thread_data, exec,
+                             gallivm->target, thread_data_type,
+                             LP_JIT_CS_THREAD_DATA_EXEC);
+      LP_CHECK_STRUCT_SIZE(struct lp_jit_cs_thread_data,
+                           gallivm->target, thread_data_type);
+
+      cs->jit_thread_data_ptr_type = LLVMPointerType(thread_data_type, 0);
+   }
+
+   if (gallivm_debug & GALLIVM_DEBUG_IR) {
+      LLVMDumpModule(gallivm->module);
+   }
+}
+
+
+void
+lp_jit_init_cs_types(struct lp_compute_shader *cs)
+{
+   if (!cs->jit_context_ptr_type)
+      lp_jit_create_cs_types(cs);
+}
@@ -61,7 +61,12 @@
 #define LP_MAX_WIDTH  (1 << (LP_MAX_TEXTURE_LEVELS - 1))
 
 
-#define LP_MAX_THREADS 16
+/**
+ * Sanity limit on the number of rasterizer threads.  All per-thread state
+ * is sized at runtime for the number of threads actually created, which
+ * defaults to the number of CPUs.
+ */
+#define LP_MAX_THREADS 1024
 
 
 /**
@@ -75,6 +80,13 @@
  */
 #define LP_MAX_SHADER_VARIANTS 1024
 
+/**
+ * Default max amount of JIT'ed code and data (for all fragment shader
+ * variants combined, per context) that will be kept around.  Can be
+ * overridden with the LP_SHADER_CACHE_SIZE environment variable (in MB).
+ */
+#define LP_MAX_SHADER_CODE_SIZE (64 * 1024 * 1024)
+
 /**
  * Max number of instructions (for all fragment shaders combined per context)
  * that will be kept around (counted in terms of llvm ir).
@@ -25,86 +25,113 @@
  *
  **************************************************************************/
 
+#include <inttypes.h>
+
 #include "util/u_debug.h"
 #include "lp_debug.h"
 #include "lp_perf.h"
 
 
 
-struct lp_counters lp_count;
+/**
+ * Add all of src's counters to dst's.
+ */
+void
+lp_add_counters(struct lp_counters *dst, const struct lp_counters *src)
+{
+   uint64_t *d = (uint64_t *) dst;
+   const uint64_t *s = (const uint64_t *) src;
+   unsigned i;
+
+   for (i = 0; i < sizeof *dst / sizeof *d; i++)
+      d[i] += s[i];
+}
 
 
+/**
+ * Subtract all of src's counters from dst's.
+ */
 void
-lp_reset_counters(void)
+lp_sub_counters(struct lp_counters *dst, const struct lp_counters *src)
 {
-   memset(&lp_count, 0, sizeof(lp_count));
+   uint64_t *d = (uint64_t *) dst;
+   const uint64_t *s = (const uint64_t *) src;
+   unsigned i;
+
+   for (i = 0; i < sizeof *dst / sizeof *d; i++)
+      d[i] -= s[i];
 }
 
 
 void
-lp_print_counters(void)
+lp_print_counters(const struct lp_counters *counters)
 {
    if (LP_DEBUG & DEBUG_COUNTERS) {
-      unsigned total_64, total_16, total_4;
+      uint64_t total_64, total_16, total_4;
       float p1, p2, p3, p4, p5, p6;
 
-      debug_printf("llvmpipe: nr_triangles:                 %9u\n", lp_count.nr_tris);
-      debug_printf("llvmpipe: nr_culled_triangles:          %9u\n", lp_count.nr_culled_tris);
-
-      total_64 = (lp_count.nr_empty_64 + 
-                  lp_count.nr_fully_covered_64 +
-                  lp_count.nr_partially_covered_64);
-
-      p1 = 100.0 * (float) lp_count.nr_empty_64 / (float) total_64;
-      p2 = 100.0 * (float) lp_count.nr_fully_covered_64 / (float) total_64;
-      p3 = 100.0 * (float) lp_count.nr_partially_covered_64 / (float) total_64;
-      p5 = 100.0 * (float) lp_count.nr_shade_opaque_64 / (float) total_64;
-      p6 = 100.0 * (float) lp_count.nr_shade_64 / (float) total_64;
-
-      debug_printf("llvmpipe: nr_64x64:                     %9u\n", total_64);
-      debug_printf("llvmpipe:   nr_fully_covered_64x64:     %9u (%3.0f%% of %u)\n", lp_count.nr_fully_covered_64, p2, total_64);
-      debug_printf("llvmpipe:     nr_shade_opaque_64x64:    %9u (%3.0f%% of %u)\n", lp_count.nr_shade_opaque_64, p5, total_64);
-      debug_printf("llvmpipe:        nr_pure_shade_opaque:  %9u (%3.0f%% of %u)\n", lp_count.nr_pure_shade_opaque_64, 0.0, lp_count.nr_shade_opaque_64);
-      debug_printf("llvmpipe:     nr_shade_64x64:           %9u (%3.0f%% of %u)\n", lp_count.nr_shade_64, p6, total_64);
-      debug_printf("llvmpipe:        nr_pure_shade:         %9u (%3.0f%% of %u)\n", lp_count.nr_pure_shade_64, 0.0, lp_count.nr_shade_64);
-      debug_printf("llvmpipe:   nr_partially_covered_64x64: %9u (%3.0f%% of %u)\n", lp_count.nr_partially_covered_64, p3, total_64);
-      debug_printf("llvmpipe:   nr_empty_64x64:             %9u (%3.0f%% of %u)\n", lp_count.nr_empty_64, p1, total_64);
-
-      total_16 = (lp_count.nr_empty_16 + 
-                  lp_count.nr_fully_covered_16 +
-                  lp_count.nr_partially_covered_16);
-
-      p1 = 100.0 * (float) lp_count.nr_empty_16 / (float) total_16;
-      p2 = 100.0 * (float) lp_count.nr_fully_covered_16 / (float) total_16;
-      p3 = 100.0 * (float) lp_count.nr_partially_covered_16 / (float) total_16;
-
-      debug_printf("llvmpipe: nr_16x16:                     %9u\n", total_16);
-      debug_printf("llvmpipe:   nr_fully_covered_16x16:     %9u (%3.0f%% of %u)\n", lp_count.nr_fully_covered_16, p2, total_16);
-      debug_printf("llvmpipe:   nr_partially_covered_16x16: %9u (%3.0f%% of %u)\n", lp_count.nr_partially_covered_16, p3, total_16);
-      debug_printf("llvmpipe:   nr_empty_16x16:             %9u (%3.0f%% of %u)\n", lp_count.nr_empty_16, p1, total_16);
-
-      total_4 = (lp_count.nr_empty_4 +
-                 lp_count.nr_fully_covered_4 +
-                 lp_count.nr_partially_covered_4);
-
-      p1 = 100.0 * (float) lp_count.nr_empty_4 / (float) total_4;
-      p2 = 100.0 * (float) lp_count.nr_fully_covered_4 / (float) total_4;
-      p3 = 100.0 * (float) lp_count.nr_partially_covered_4 / (float) total_4;
-      p4 = 100.0 * (float) lp_count.nr_non_empty_4 / (float) total_4;
-
-      debug_printf("llvmpipe: nr_tri_4x4:                   %9u\n", total_4);
-      debug_printf("llvmpipe:   nr_fully_covered_4x4:       %9u (%3.0f%% of %u)\n", lp_count.nr_fully_covered_4, p2, total_4);
-      debug_printf("llvmpipe:   nr_partially_covered_4x4:   %9u (%3.0f%% of %u)\n", lp_count.nr_partially_covered_4, p3, total_4);
-      debug_printf("llvmpipe:   nr_empty_4x4:               %9u (%3.0f%% of %u)\n", lp_count.nr_empty_4, p1, total_4);
-      debug_printf("llvmpipe:   nr_non_empty_4x4:           %9u (%3.0f%% of %u)\n", lp_count.nr_non_empty_4, p4, total_4);
-
-      debug_printf("llvmpipe: nr_color_tile_clear:          %9u\n", lp_count.nr_color_tile_clear);
-      debug_printf("llvmpipe: nr_color_tile_load:           %9u\n", lp_count.nr_color_tile_load);
-      debug_printf("llvmpipe: nr_color_tile_store:          %9u\n", lp_count.nr_color_tile_store);
-
-      debug_printf("llvmpipe: nr_llvm_compiles:             %u\n", lp_count.nr_llvm_compiles);
-      debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", lp_count.llvm_compile_time / 1000000.0);
-      debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", lp_count.llvm_compile_time / 1000000.0 / lp_count.nr_llvm_compiles);
+      debug_printf("llvmpipe: nr_triangles:                 %9"PRIu64"\n", counters->nr_tris);
+      debug_printf("llvmpipe: nr_culled_triangles:          %9"PRIu64"\n", counters->nr_culled_tris);
+
+      total_64 = (counters->nr_empty_64 + 
+                  counters->nr_fully_covered_64 +
+                  counters->nr_partially_covered_64);
+
+      p1 = 100.0 * (float) counters->nr_empty_64 / (float) total_64;
+      p2 = 100.0 * (float) counters->nr_fully_covered_64 / (float) total_64;
+      p3 = 100.0 * (float) counters->nr_partially_covered_64 / (float) total_64;
+      p5 = 100.0 * (float) counters->nr_shade_opaque_64 / (float) total_64;
+      p6 = 100.0 * (float) counters->nr_shade_64 / (float) total_64;
+
+      debug_printf("llvmpipe: nr_64x64:                     %9"PRIu64"\n", total_64);
+      debug_printf("llvmpipe:   nr_fully_covered_64x64:     %9"PRIu64" (%3.0f%% of %"PRIu64")\n", counters->nr_fully_covered_64, p2, total_64);
+      debug_printf("llvmpipe:     nr_shade_opaque_64x64:    %9"PRIu64" (%3.0f%% of %"PRIu64")\n", counters->nr_shade_opaque_64, p5, total_64);
+      debug_printf("llvmpipe:        nr_pure_shade_opaque:  %9"PRIu64" (%3.0f%% of %"PRIu64")\n", counters->nr_pure_shade_opaque_64, 0.0, counters->nr_shade_opaque_64);
+      debug_printf("llvmpipe:     nr_shade_64x64:           %9"PRIu64" (%3.0f%% of %"PRIu64")\n", counters->nr_shade_64, p6, total_64);
+      debug_printf("llvmpipe:        nr_pure_shade:         %9"PRIu64" (%3.0f%% of %"PRIu64")\n", counters->nr_pure_shade_64, 0.0, counters->nr_shade_64);
+      debug_printf("llvmpipe:   nr_partially_covered_64x64: %9"PRIu64" (%3.0f%% of %"PRIu64")\n", counters->nr_partially_covered_64, p3, total_64);
+      debug_printf("llvmpipe:   nr_empty_64x64:             %9"PRIu64" (%3.0f%% of %"PRIu64")\n", counters->nr_empty_64, p1, total_64);
+
+      total_16 = (counters->nr_empty_16 + 
+                  counters->nr_fully_covered_16 +
+                  counters->nr_partially_covered_16);
+
+      p1 = 100.0 * (float) counters->nr_empty_16 / (float) total_16;
+      p2 = 100.0 * (float) counters->nr_fully_covered_16 / (float) total_16;
+      p3 = 100.0 * (float) counters->nr_partially_covered_16 / (float) total_16;
+
+      debug_printf("llvmpipe: nr_16x16:                     %9"PRIu64"\n", total_16);
+      debug_printf("llvmpipe:   nr_fully_covered_16x16:     %9"PRIu64" (%3.0f%% of %"PRIu64")\n", counters->nr_fully_covered_16, p2, total_16);
+      debug_printf("llvmpipe:   nr_partially_covered_16x16: %9"PRIu64" (%3.0f%% of %"PRIu64")\n", counters->nr_partially_covered_16, p3, total_16);
+      debug_printf("llvmpipe:   nr_empty_16x16:             %9"PRIu64" (%3.0f%% of %"PRIu64")\n", counters->nr_empty_16, p1, total_16);
+
+      total_4 = (counters->nr_empty_4 +
+                 counters->nr_fully_covered_4 +
+                 counters->nr_partially_covered_4);
+
+      p1 = 100.0 * (float) counters->nr_empty_4 / (float) total_4;
+      p2 = 100.0 * (float) counters->nr_fully_covered_4 / (float) total_4;
+      p3 = 100.0 * (float) counters->nr_partially_covered_4 / (float) total_4;
+      p4 = 100.0 * (float) counters->nr_non_empty_4 / (float) total_4;
+
+      debug_printf("llvmpipe: nr_tri_4x4:                   %9"PRIu64"\n", total_4);
+      debug_printf("llvmpipe:   nr_fully_covered_4x4:       %9"PRIu64" (%3.0f%% of %"PRIu64")\n", counters->nr_fully_covered_4, p2, total_4);
+      debug_printf("llvmpipe:   nr_partially_covered_4x4:   %9"PRIu64" (%3.0f%% of %"PRIu64")\n", counters->nr_partially_covered_4, p3, total_4);
+      debug_printf("llvmpipe:   nr_empty_4x4:               %9"PRIu64" (%3.0f%% of %"PRIu64")\n", counters->nr_empty_4, p1, total_4);
+      debug_printf("llvmpipe:   nr_non_empty_4x4:           %9"PRIu64" (%3.0f%% of %"PRIu64")\n", counters->nr_non_empty_4, p4, total_4);
+
+      debug_printf("llvmpipe: nr_color_tile_clear:          %9"PRIu64"\n", counters->nr_color_tile_clear);
+
+      debug_printf("llvmpipe: nr_llvm_compiles:             %"PRIu64"\n", counters->nr_llvm_compiles);
+      debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", counters->llvm_compile_time / 1000000.0);
+      debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", counters->llvm_compile_time / 1000000.0 / counters->nr_llvm_compiles);
+
+      debug_printf("llvmpipe: nr_scenes:                    %9"PRIu64"\n", counters->nr_scenes);
+      debug_printf("llvmpipe: total binning time:           %.2f sec\n", counters->bin_time / 1e9);
+      debug_printf("llvmpipe: total rasterization time:     %.2f sec\n", counters->rast_time / 1e9);
+      debug_printf("llvmpipe: total rasterizer idle time:   %.2f sec\n", counters->rast_idle_time / 1e9);
+      debug_printf("llvmpipe: total rasterizer wait time:   %.2f sec\n", counters->rast_wait_time / 1e9);
+      debug_printf("llvmpipe: average scene queue depth:    %.2f\n", (double) counters->scene_queue_depth / counters->nr_scenes);
 
    }
 }
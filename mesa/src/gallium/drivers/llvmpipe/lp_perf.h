@@ -36,56 +36,58 @@
 #include "pipe/p_compiler.h"
 
 /**
- * Various counters
+ * These are cheap enough to be always on: each rasterizer thread counts
+ * into its own lp_rasterizer_task::counters, without atomics, and those
+ * are added into the context's counters once the scene is done (see
+ * lp_rast_add_counters()).  Setup and shader compilation count straight
+ * into the context's counters on the API thread.
  */
 struct lp_counters
 {
-   unsigned nr_tris;
-   unsigned nr_culled_tris;
-   unsigned nr_empty_64;
-   unsigned nr_fully_covered_64;
-   unsigned nr_partially_covered_64;
-   unsigned nr_pure_shade_opaque_64;
-   unsigned nr_pure_shade_64;
-   unsigned nr_shade_64;
-   unsigned nr_shade_opaque_64;
-   unsigned nr_empty_16;
-   unsigned nr_fully_covered_16;
-   unsigned nr_partially_covered_16;
-   unsigned nr_empty_4;
-   unsigned nr_fully_covered_4;
-   unsigned nr_partially_covered_4;
-   unsigned nr_non_empty_4;
-   unsigned nr_llvm_compiles;
-   int64_t llvm_compile_time;  /**< total, in microseconds */
-
-   unsigned nr_color_tile_clear;
-   unsigned nr_color_tile_load;
-   unsigned nr_color_tile_store;
+   uint64_t nr_tris;
+   uint64_t nr_culled_tris;
+   uint64_t nr_empty_64;
+   uint64_t nr_fully_covered_64;
+   uint64_t nr_partially_covered_64;
+   uint64_t nr_pure_shade_opaque_64;
+   uint64_t nr_pure_shade_64;
+   uint64_t nr_shade_64;
+   uint64_t nr_shade_opaque_64;
+   uint64_t nr_empty_16;
+   uint64_t nr_fully_covered_16;
+   uint64_t nr_partially_covered_16;
+   uint64_t nr_empty_4;
+   uint64_t nr_fully_covered_4;
+   uint64_t nr_partially_covered_4;
+   uint64_t nr_non_empty_4;
+   uint64_t nr_llvm_compiles;
+   uint64_t llvm_compile_time;  /**< total, in microseconds */
+
+   uint64_t nr_color_tile_clear;
+
+   uint64_t nr_scenes;
+   uint64_t bin_time;         /**< in draw calls, in nanoseconds */
+   uint64_t rast_time;        /**< summed over threads, in nanoseconds */
+   uint64_t rast_idle_time;   /**< threads waiting within a scene, in ns */
+   uint64_t rast_wait_time;   /**< API thread waiting for rasterizer, in ns */
+   uint64_t scene_queue_depth; /**< summed over scenes, see lp_setup.c */
 };
 
 
-extern struct lp_counters lp_count;
+#define LP_COUNT(counters, counter) (counters)->counter++
+#define LP_COUNT_ADD(counters, counter, incr) (counters)->counter += (incr)
 
 
-/** Increment the named counter (only for debug builds) */
-#ifdef DEBUG
-#define LP_COUNT(counter) lp_count.counter++
-#define LP_COUNT_ADD(counter, incr)  lp_count.counter += (incr)
-#define LP_COUNT_GET(counter) (lp_count.counter)
-#else
-#define LP_COUNT(counter)
-#define LP_COUNT_ADD(counter, incr) (void)(incr)
-#define LP_COUNT_GET(counter) 0
-#endif
+extern void
+lp_add_counters(struct lp_counters *dst, const struct lp_counters *src);
 
 
 extern void
-lp_reset_counters(void);
+lp_sub_counters(struct lp_counters *dst, const struct lp_counters *src);
 
 
 extern void
-lp_print_counters(void);
+lp_print_counters(const struct lp_counters *counters);
 
 
 #endif /* LP_PERF_H */
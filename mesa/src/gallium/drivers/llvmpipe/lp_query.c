@@ -48,19 +48,120 @@ static struct llvmpipe_query *llvmpipe_query( struct pipe_query *p )
    return (struct llvmpipe_query *)p;
 }
 
+
+/**
+ * Driver-specific queries, one per counter in struct lp_counters.  Query
+ * type PIPE_QUERY_DRIVER_SPECIFIC + i is lp_driver_queries[i].
+ */
+struct lp_driver_query
+{
+   const char *name;
+   enum pipe_driver_query_type type;
+   unsigned offset;   /**< of the counter in struct lp_counters */
+   unsigned divisor;  /**< to convert the counter to the query's units */
+};
+
+#define QUERY(NAME, TYPE, COUNTER, DIVISOR) \
+   { NAME, PIPE_DRIVER_QUERY_TYPE_##TYPE, \
+     offsetof(struct lp_counters, COUNTER), DIVISOR }
+
+static const struct lp_driver_query lp_driver_queries[] = {
+   QUERY("num-triangles", UINT64, nr_tris, 1),
+   QUERY("num-culled-triangles", UINT64, nr_culled_tris, 1),
+   QUERY("num-empty-64x64", UINT64, nr_empty_64, 1),
+   QUERY("num-fully-covered-64x64", UINT64, nr_fully_covered_64, 1),
+   QUERY("num-partially-covered-64x64", UINT64, nr_partially_covered_64, 1),
+   QUERY("num-empty-16x16", UINT64, nr_empty_16, 1),
+   QUERY("num-fully-covered-16x16", UINT64, nr_fully_covered_16, 1),
+   QUERY("num-partially-covered-16x16", UINT64, nr_partially_covered_16, 1),
+   QUERY("num-empty-4x4", UINT64, nr_empty_4, 1),
+   QUERY("num-fully-covered-4x4", UINT64, nr_fully_covered_4, 1),
+   QUERY("num-partially-covered-4x4", UINT64, nr_partially_covered_4, 1),
+   QUERY("num-color-tile-clears", UINT64, nr_color_tile_clear, 1),
+   QUERY("num-llvm-compiles", UINT64, nr_llvm_compiles, 1),
+   QUERY("llvm-compile-time", MICROSECONDS, llvm_compile_time, 1),
+   QUERY("num-scenes", UINT64, nr_scenes, 1),
+   QUERY("binning-time", MICROSECONDS, bin_time, 1000),
+   QUERY("rasterization-time", MICROSECONDS, rast_time, 1000),
+   QUERY("rasterizer-idle-time", MICROSECONDS, rast_idle_time, 1000),
+   QUERY("rasterizer-wait-time", MICROSECONDS, rast_wait_time, 1000),
+   /* averaged over the scenes, see below */
+   QUERY("scene-queue-depth", UINT64, scene_queue_depth, 0),
+};
+
+#undef QUERY
+
+
+static const struct lp_driver_query *
+lp_driver_query(unsigned type)
+{
+   if (type < PIPE_QUERY_DRIVER_SPECIFIC ||
+       type - PIPE_QUERY_DRIVER_SPECIFIC >= ARRAY_SIZE(lp_driver_queries))
+      return NULL;
+
+   return &lp_driver_queries[type - PIPE_QUERY_DRIVER_SPECIFIC];
+}
+
+
+/**
+ * The result of a driver-specific query, from the change in the counters
+ * between begin and end.
+ */
+static uint64_t
+lp_driver_query_result(const struct lp_driver_query *query,
+                       const struct lp_counters *counters)
+{
+   uint64_t value = *(const uint64_t *)((const char *)counters + query->offset);
+
+   if (query->divisor)
+      return value / query->divisor;
+
+   /* divisor 0: average per scene */
+   if (!counters->nr_scenes)
+      return 0;
+   return (value + counters->nr_scenes / 2) / counters->nr_scenes;
+}
+
+
+int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+   if (!info)
+      return ARRAY_SIZE(lp_driver_queries);
+
+   if (index >= ARRAY_SIZE(lp_driver_queries))
+      return 0;
+
+   memset(info, 0, sizeof *info);
+   info->name = lp_driver_queries[index].name;
+   info->query_type = PIPE_QUERY_DRIVER_SPECIFIC + index;
+   info->type = lp_driver_queries[index].type;
+   info->result_type = PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE;
+   return 1;
+}
+
+
 static struct pipe_query *
 llvmpipe_create_query(struct pipe_context *pipe, 
                       unsigned type,
                       unsigned index)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   unsigned num_threads = MAX2(1, screen->num_threads);
    struct llvmpipe_query *pq;
 
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES || lp_driver_query(type));
 
-   pq = CALLOC_STRUCT( llvmpipe_query );
+   /* per-thread counters follow the query in the same allocation */
+   pq = CALLOC(1, sizeof *pq + 2 * num_threads * sizeof(uint64_t));
 
    if (pq) {
       pq->type = type;
+      pq->num_threads = num_threads;
+      pq->start = (uint64_t *)(pq + 1);
+      pq->end = pq->start + num_threads;
    }
 
    return (struct pipe_query *) pq;
@@ -99,8 +200,15 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
    unsigned num_threads = MAX2(1, screen->num_threads);
    struct llvmpipe_query *pq = llvmpipe_query(q);
    uint64_t *result = (uint64_t *)vresult;
+   const struct lp_driver_query *query = lp_driver_query(pq->type);
    int i;
 
+   if (query) {
+      /* the counters were read at end_query, there's nothing to wait for */
+      *result = lp_driver_query_result(query, &pq->counters);
+      return TRUE;
+   }
+
    if (pq->fence) {
       /* only have a fence if there was a scene */
       if (!lp_fence_signalled(pq->fence)) {
@@ -190,6 +298,12 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   /* Driver-specific queries only need the counters, not a scene. */
+   if (lp_driver_query(pq->type)) {
+      pq->counters = llvmpipe->counters;
+      return true;
+   }
+
    /* Check if the query is already in the scene.  If so, we need to
     * flush the scene now.  Real apps shouldn't re-use a query in a
     * frame of rendering.
@@ -199,8 +313,8 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
    }
 
 
-   memset(pq->start, 0, sizeof(pq->start));
-   memset(pq->end, 0, sizeof(pq->end));
+   memset(pq->start, 0, pq->num_threads * sizeof(*pq->start));
+   memset(pq->end, 0, pq->num_threads * sizeof(*pq->end));
    lp_setup_begin_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -245,6 +359,15 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   /* Scenes which are still being binned are counted by the next query. */
+   if (lp_driver_query(pq->type)) {
+      struct lp_counters begin = pq->counters;
+
+      pq->counters = llvmpipe->counters;
+      lp_sub_counters(&pq->counters, &begin);
+      return true;
+   }
+
    lp_setup_end_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
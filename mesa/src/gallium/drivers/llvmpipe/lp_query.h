@@ -36,20 +36,28 @@
 #include <limits.h>
 #include "os/os_thread.h"
 #include "lp_limits.h"
+#include "lp_perf.h"
 
 
 struct llvmpipe_context;
+struct pipe_driver_query_info;
+struct pipe_screen;
 
 
 struct llvmpipe_query {
-   uint64_t start[LP_MAX_THREADS];  /* start count value for each thread */
-   uint64_t end[LP_MAX_THREADS];    /* end count value for each thread */
+   uint64_t *start;                 /* start count value for each thread */
+   uint64_t *end;                   /* end count value for each thread */
+   unsigned num_threads;            /* number of entries in start and end */
    struct lp_fence *fence;          /* fence from last scene this was binned in */
    unsigned type;                   /* PIPE_QUERY_* */
    unsigned num_primitives_generated;
    unsigned num_primitives_written;
 
    struct pipe_query_data_pipeline_statistics stats;
+
+   /* driver-specific queries: the context's counters at begin, and from
+    * end on, how much they changed in between */
+   struct lp_counters counters;
 };
 
 
@@ -57,4 +65,9 @@ extern void llvmpipe_init_query_funcs(struct llvmpipe_context * );
 
 extern boolean llvmpipe_check_render_cond(struct llvmpipe_context *);
 
+extern int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info);
+
 #endif /* LP_QUERY_H */
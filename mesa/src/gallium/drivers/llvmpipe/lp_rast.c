@@ -47,6 +47,7 @@
 #include "gallivm/lp_bld_debug.h"
 #include "lp_scene.h"
 #include "lp_tex_sample.h"
+#include "lp_topology.h"
 
 
 #ifdef DEBUG
@@ -69,7 +70,8 @@ lp_rast_begin( struct lp_rasterizer *rast,
    LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
 
    lp_scene_begin_rasterization( scene );
-   lp_scene_bin_iter_begin( scene );
+   lp_scene_bin_iter_begin( scene, rast->bin_order, rast->num_threads,
+                            rast->thread_nodes );
 }
 
 
@@ -165,7 +167,7 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
                  &uc);
 
    /* this will increase for each rb which probably doesn't mean much */
-   LP_COUNT(nr_color_tile_clear);
+   LP_COUNT(&task->counters, nr_color_tile_clear);
 }
 
 
@@ -634,9 +636,9 @@ rasterize_bin(struct lp_rasterizer_task *task,
     */
    if (bin->head->count == 1) {
       if (bin->head->cmd[0] == LP_RAST_OP_SHADE_TILE_OPAQUE)
-         LP_COUNT(nr_pure_shade_opaque_64);
+         LP_COUNT(&task->counters, nr_pure_shade_opaque_64);
       else if (bin->head->cmd[0] == LP_RAST_OP_SHADE_TILE)
-         LP_COUNT(nr_pure_shade_64);
+         LP_COUNT(&task->counters, nr_pure_shade_64);
    }
 }
 
@@ -683,9 +685,10 @@ rasterize_scene(struct lp_rasterizer_task *task,
          int i, j;
 
          assert(scene);
-         while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
-            if (!is_empty_bin( bin ))
-               rasterize_bin(task, bin, i, j);
+         while ((bin = lp_scene_bin_iter_next(scene, task->thread_index,
+                                              &i, &j))) {
+            assert(!is_empty_bin( bin ));
+            rasterize_bin(task, bin, i, j);
          }
       }
    }
@@ -725,6 +728,7 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
    if (rast->num_threads == 0) {
       /* no threading */
       unsigned fpstate = util_fpstate_get();
+      int64_t start;
 
       /* Make sure that denorms are treated like zeros. This is 
        * the behavior required by D3D10. OpenGL doesn't care.
@@ -733,7 +737,9 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 
       lp_rast_begin( rast, scene );
 
+      start = os_time_get_nano();
       rasterize_scene( &rast->tasks[0], scene );
+      rast->tasks[0].counters.rast_time += os_time_get_nano() - start;
 
       lp_rast_end( rast );
 
@@ -774,6 +780,71 @@ lp_rast_finish( struct lp_rasterizer *rast )
 }
 
 
+/**
+ * Add what each thread counted while rasterizing the last scene to
+ * \p counters, and reset the threads' counters.  Must be called after
+ * lp_rast_finish(), so that no thread is still counting.
+ */
+void
+lp_rast_add_counters( struct lp_rasterizer *rast,
+                      struct lp_counters *counters )
+{
+   unsigned i;
+
+   for (i = 0; i < MAX2(rast->num_threads, 1); i++) {
+      lp_add_counters(counters, &rast->tasks[i].counters);
+      memset(&rast->tasks[i].counters, 0, sizeof rast->tasks[i].counters);
+   }
+}
+
+
+/**
+ * Run func(data, thread_index) once on every rasterizer thread, or once on
+ * the calling thread if there are none, and wait for all of them to return.
+ * The caller must hold the screen's rast_mutex, so that no scene is being
+ * rasterized meanwhile.
+ */
+void
+lp_rast_run_tasks( struct lp_rasterizer *rast,
+                   lp_rast_task_func func,
+                   void *data )
+{
+   unsigned i;
+
+   if (rast->num_threads == 0) {
+      unsigned fpstate = util_fpstate_get();
+
+      util_fpstate_set_denorms_to_zero(fpstate);
+      func(data, 0);
+      util_fpstate_set(fpstate);
+      return;
+   }
+
+   rast->task_func = func;
+   rast->task_data = data;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      pipe_semaphore_signal(&rast->tasks[i].work_ready);
+   }
+   for (i = 0; i < rast->num_threads; i++) {
+      pipe_semaphore_wait(&rast->tasks[i].work_done);
+   }
+
+   rast->task_func = NULL;
+   rast->task_data = NULL;
+}
+
+
+/**
+ * Number of threads lp_rast_run_tasks() will use.
+ */
+unsigned
+lp_rast_num_tasks( const struct lp_rasterizer *rast )
+{
+   return MAX2(rast->num_threads, 1);
+}
+
+
 /**
  * This is the thread's main entrypoint.
  * It's a simple loop:
@@ -788,10 +859,14 @@ static PIPE_THREAD_ROUTINE( thread_function, init_data )
    boolean debug = false;
    char thread_name[16];
    unsigned fpstate;
+   int64_t ready, start, end;
 
    util_snprintf(thread_name, sizeof thread_name, "llvmpipe-%u", task->thread_index);
    pipe_thread_setname(thread_name);
 
+   if (task->cpu >= 0)
+      pipe_thread_bind_cpu(task->cpu);
+
    /* Make sure that denorms are treated like zeros. This is 
     * the behavior required by D3D10. OpenGL doesn't care.
     */
@@ -807,6 +882,12 @@ static PIPE_THREAD_ROUTINE( thread_function, init_data )
       if (rast->exit_flag)
          break;
 
+      if (rast->task_func) {
+         rast->task_func(rast->task_data, task->thread_index);
+         pipe_semaphore_signal(&task->work_done);
+         continue;
+      }
+
       if (task->thread_index == 0) {
          /* thread[0]:
           *  - get next scene to rasterize
@@ -819,18 +900,28 @@ static PIPE_THREAD_ROUTINE( thread_function, init_data )
       /* Wait for all threads to get here so that threads[1+] don't
        * get a null rast->curr_scene pointer.
        */
+      ready = os_time_get_nano();
       pipe_barrier_wait( &rast->barrier );
 
       /* do work */
       if (debug)
          debug_printf("thread %d doing work\n", task->thread_index);
 
+      start = os_time_get_nano();
       rasterize_scene(task,
                       rast->curr_scene);
+      end = os_time_get_nano();
       
       /* wait for all threads to finish with this scene */
       pipe_barrier_wait( &rast->barrier );
 
+      /* Time spent in the barriers is time this thread could have been
+       * rasterizing, had the bins been spread more evenly.
+       */
+      task->counters.rast_time += end - start;
+      task->counters.rast_idle_time += (start - ready) +
+                                       (os_time_get_nano() - end);
+
       /* XXX: shouldn't be necessary:
        */
       if (task->thread_index == 0) {
@@ -871,6 +962,57 @@ create_rast_threads(struct lp_rasterizer *rast)
 
 
 
+/**
+ * Get the bin traversal order from the LP_BIN_ORDER environment variable.
+ */
+static enum lp_bin_order
+get_bin_order(void)
+{
+   const char *order = debug_get_option("LP_BIN_ORDER", "hilbert");
+
+   if (strcmp(order, "raster") == 0)
+      return LP_BIN_ORDER_RASTER;
+   else if (strcmp(order, "morton") == 0)
+      return LP_BIN_ORDER_MORTON;
+   else
+      return LP_BIN_ORDER_HILBERT;
+}
+
+
+/**
+ * Decide where the rasterizer threads run.  By default they are only bound
+ * to CPUs on machines with several NUMA nodes, where leaving placement to
+ * the OS scheduler makes threads migrate away from the memory they work on.
+ */
+static void
+place_rast_threads(struct lp_rasterizer *rast)
+{
+   struct lp_thread_placement *placement;
+   boolean bind;
+   unsigned i;
+
+   bind = debug_get_bool_option("LP_BIND_THREADS",
+                                lp_topology_num_nodes() > 1);
+
+   placement = MALLOC(rast->num_threads * sizeof *placement);
+   if (placement)
+      lp_topology_place_threads(placement, rast->num_threads);
+
+   for (i = 0; i < rast->num_threads; i++) {
+      if (bind && placement) {
+         rast->tasks[i].cpu = placement[i].cpu;
+         rast->thread_nodes[i] = placement[i].node;
+      }
+      else {
+         rast->tasks[i].cpu = -1;
+         rast->thread_nodes[i] = 0;
+      }
+   }
+
+   FREE(placement);
+}
+
+
 /**
  * Create new lp_rasterizer.  If num_threads is zero, don't create any
  * new threads, do rendering synchronously.
@@ -882,6 +1024,8 @@ lp_rast_create( unsigned num_threads )
    struct lp_rasterizer *rast;
    unsigned i;
 
+   lp_rast_tri_init();
+
    rast = CALLOC_STRUCT(lp_rasterizer);
    if (!rast) {
       goto no_rast;
@@ -892,10 +1036,19 @@ lp_rast_create( unsigned num_threads )
       goto no_full_scenes;
    }
 
+   rast->tasks = CALLOC(MAX2(1, num_threads), sizeof *rast->tasks);
+   rast->threads = CALLOC(MAX2(1, num_threads), sizeof *rast->threads);
+   rast->thread_nodes = CALLOC(MAX2(1, num_threads),
+                               sizeof *rast->thread_nodes);
+   if (!rast->tasks || !rast->threads || !rast->thread_nodes) {
+      goto no_thread_data_cache;
+   }
+
    for (i = 0; i < MAX2(1, num_threads); i++) {
       struct lp_rasterizer_task *task = &rast->tasks[i];
       task->rast = rast;
       task->thread_index = i;
+      task->cpu = -1;
       task->thread_data.cache = align_malloc(sizeof(struct lp_build_format_cache),
                                              16);
       if (!task->thread_data.cache) {
@@ -906,7 +1059,9 @@ lp_rast_create( unsigned num_threads )
    rast->num_threads = num_threads;
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", FALSE);
+   rast->bin_order = get_bin_order();
 
+   place_rast_threads(rast);
    create_rast_threads(rast);
 
    /* for synchronizing rasterization threads */
@@ -919,11 +1074,16 @@ lp_rast_create( unsigned num_threads )
    return rast;
 
 no_thread_data_cache:
-   for (i = 0; i < MAX2(1, rast->num_threads); i++) {
-      if (rast->tasks[i].thread_data.cache) {
-         align_free(rast->tasks[i].thread_data.cache);
+   if (rast->tasks) {
+      for (i = 0; i < MAX2(1, num_threads); i++) {
+         if (rast->tasks[i].thread_data.cache) {
+            align_free(rast->tasks[i].thread_data.cache);
+         }
       }
    }
+   FREE(rast->tasks);
+   FREE(rast->threads);
+   FREE(rast->thread_nodes);
 
    lp_scene_queue_destroy(rast->full_scenes);
 no_full_scenes:
@@ -975,6 +1135,9 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
 
    lp_scene_queue_destroy(rast->full_scenes);
 
+   FREE(rast->tasks);
+   FREE(rast->threads);
+   FREE(rast->thread_nodes);
    FREE(rast);
 }
 
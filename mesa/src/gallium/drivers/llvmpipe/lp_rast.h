@@ -46,6 +46,7 @@ struct lp_rasterizer;
 struct lp_scene;
 struct lp_fence;
 struct cmd_bin;
+struct lp_counters;
 
 #define FIXED_TYPE_WIDTH 64
 /** For sub-pixel positioning */
@@ -169,6 +170,24 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 void
 lp_rast_finish( struct lp_rasterizer *rast );
 
+void
+lp_rast_add_counters( struct lp_rasterizer *rast,
+                      struct lp_counters *counters );
+
+
+/**
+ * Function run by every rasterizer thread, see lp_rast_run_tasks().
+ */
+typedef void (*lp_rast_task_func)(void *data, unsigned thread_index);
+
+void
+lp_rast_run_tasks( struct lp_rasterizer *rast,
+                   lp_rast_task_func func,
+                   void *data );
+
+unsigned
+lp_rast_num_tasks( const struct lp_rasterizer *rast );
+
 
 union lp_rast_cmd_arg {
    const struct lp_rast_shader_inputs *shade_tile;
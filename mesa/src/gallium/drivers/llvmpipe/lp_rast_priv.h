@@ -37,6 +37,7 @@
 #include "lp_state.h"
 #include "lp_texture.h"
 #include "lp_limits.h"
+#include "lp_perf.h"
 
 
 #define TILE_VECTOR_HEIGHT 4
@@ -97,11 +98,17 @@ struct lp_rasterizer_task
    /** "my" index */
    unsigned thread_index;
 
+   /** CPU this thread is bound to, or -1 */
+   int cpu;
+
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
    uint64_t ps_invocations;
    uint8_t ps_inv_multiplier;
 
+   /** This thread's share, added to the context's after each scene */
+   struct lp_counters counters;
+
    pipe_semaphore work_ready;
    pipe_semaphore work_done;
 };
@@ -116,6 +123,7 @@ struct lp_rasterizer
 {
    boolean exit_flag;
    boolean no_rast;  /**< For debugging/profiling */
+   enum lp_bin_order bin_order;  /**< Order in which bins are rasterized */
 
    /** The incoming queue of scenes ready to rasterize */
    struct lp_scene_queue *full_scenes;
@@ -124,13 +132,20 @@ struct lp_rasterizer
    struct lp_scene *curr_scene;
 
    /** A task object for each rasterization thread */
-   struct lp_rasterizer_task tasks[LP_MAX_THREADS];
+   struct lp_rasterizer_task *tasks;
 
    unsigned num_threads;
-   pipe_thread threads[LP_MAX_THREADS];
+   pipe_thread *threads;
+
+   /** NUMA node of each rasterization thread */
+   unsigned *thread_nodes;
 
    /** For synchronizing the rasterization threads */
    pipe_barrier barrier;
+
+   /** Work other than a scene, set by lp_rast_run_tasks() */
+   lp_rast_task_func task_func;
+   void *task_data;
 };
 
 
@@ -337,6 +352,60 @@ void lp_rast_triangle_32_3_16( struct lp_rasterizer_task *,
 void lp_rast_triangle_32_4_16( struct lp_rasterizer_task *, 
                             const union lp_rast_cmd_arg );
 
+
+/**
+ * Coverage of a 4x4 block within a 16x16 block, as found by the
+ * lp_rast_tri_3_16 kernels.
+ */
+struct lp_rast_block_mask {
+   unsigned mask:16;            /* covered pixels */
+   unsigned i:8;                /* block row */
+   unsigned j:8;                /* block column */
+};
+
+/**
+ * Coverage kernels for 3-plane triangles with 32-bit edge functions.
+ *
+ * The 16x16 kernels store the covered 4x4 blocks of the 16x16 block at
+ * x, y in row-major order and return how many there are.  The 4x4 kernels
+ * return the coverage mask of the 4x4 block at x, y.
+ *
+ * plane must be 16 byte aligned.
+ */
+typedef unsigned (*lp_rast_tri_3_16_func)(const struct lp_rast_plane *plane,
+                                          int x, int y,
+                                          struct lp_rast_block_mask *out);
+
+typedef unsigned (*lp_rast_tri_3_4_func)(const struct lp_rast_plane *plane,
+                                         int x, int y);
+
+#if defined(PIPE_ARCH_SSE)
+unsigned
+lp_rast_tri_3_16_sse2(const struct lp_rast_plane *plane, int x, int y,
+                      struct lp_rast_block_mask *out);
+unsigned
+lp_rast_tri_3_4_sse2(const struct lp_rast_plane *plane, int x, int y);
+#endif
+
+#if defined(USE_AVX2)
+unsigned
+lp_rast_tri_3_16_avx2(const struct lp_rast_plane *plane, int x, int y,
+                      struct lp_rast_block_mask *out);
+unsigned
+lp_rast_tri_3_4_avx2(const struct lp_rast_plane *plane, int x, int y);
+#endif
+
+#if defined(USE_AVX512)
+unsigned
+lp_rast_tri_3_16_avx512(const struct lp_rast_plane *plane, int x, int y,
+                        struct lp_rast_block_mask *out);
+unsigned
+lp_rast_tri_3_4_avx512(const struct lp_rast_plane *plane, int x, int y);
+#endif
+
+void
+lp_rast_tri_init(void);
+
 void
 lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg);
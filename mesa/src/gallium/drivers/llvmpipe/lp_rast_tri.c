@@ -136,6 +136,8 @@ lp_rast_triangle_4_16(struct lp_rasterizer_task *task,
 #if defined(PIPE_ARCH_SSE)
 
 #include <emmintrin.h>
+#include "c11/threads.h"
+#include "util/u_cpu_detect.h"
 #include "util/u_sse.h"
 
 
@@ -235,19 +237,15 @@ sign_bits4(const __m128i *cstep, int cdiff)
 }
 
 
-#define NR_PLANES 3
-
-void
-lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
-                         const union lp_rast_cmd_arg arg)
+/**
+ * Find the coverage of the 4x4 blocks of a 16x16 block by a 3-plane
+ * triangle, evaluating the 3 planes of a block corner or pixel at once.
+ */
+unsigned
+lp_rast_tri_3_16_sse2(const struct lp_rast_plane *plane, int x, int y,
+                      struct lp_rast_block_mask *out)
 {
-   const struct lp_rast_triangle *tri = arg.triangle.tri;
-   const struct lp_rast_plane *plane = GET_PLANES(tri);
-   int x = (arg.triangle.plane_mask & 0xff) + task->x;
-   int y = (arg.triangle.plane_mask >> 8) + task->y;
    unsigned i, j;
-
-   struct { unsigned mask:16; unsigned i:8; unsigned j:8; } out[16];
    unsigned nr = 0;
 
    /* p0 and p2 are aligned, p1 is not (plane size 24 bytes). */
@@ -332,7 +330,7 @@ lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
 
             out[nr].i = i;
             out[nr].j = j;
-            out[nr].mask = mask;
+            out[nr].mask = 0xffff & ~mask;
             if (mask != 0xffff)
                nr++;
          }
@@ -342,23 +340,12 @@ lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
       c = _mm_add_epi32(c, _mm_slli_epi32(dcdy, 2));
    }
 
-   for (i = 0; i < nr; i++)
-      lp_rast_shade_quads_mask(task,
-                               &tri->inputs,
-                               x + 4 * out[i].j,
-                               y + 4 * out[i].i,
-                               0xffff & ~out[i].mask);
+   return nr;
 }
 
-void
-lp_rast_triangle_32_3_4(struct lp_rasterizer_task *task,
-                        const union lp_rast_cmd_arg arg)
+unsigned
+lp_rast_tri_3_4_sse2(const struct lp_rast_plane *plane, int x, int y)
 {
-   const struct lp_rast_triangle *tri = arg.triangle.tri;
-   const struct lp_rast_plane *plane = GET_PLANES(tri);
-   unsigned x = (arg.triangle.plane_mask & 0xff) + task->x;
-   unsigned y = (arg.triangle.plane_mask >> 8) + task->y;
-
    /* p0 and p2 are aligned, p1 is not (plane size 24 bytes). */
    __m128i p0 = _mm_load_si128((__m128i *)&plane[0]); /* clo, chi, dcdx, dcdy */
    __m128i p1 = _mm_loadu_si128((__m128i *)&plane[1]);
@@ -423,16 +410,89 @@ lp_rast_triangle_32_3_4(struct lp_rasterizer_task *task,
 
       unsigned mask = _mm_movemask_epi8(c_0123);
 
-      if (mask != 0xffff)
-         lp_rast_shade_quads_mask(task,
-                                  &tri->inputs,
-                                  x,
-                                  y,
-                                  0xffff & ~mask);
+      return 0xffff & ~mask;
    }
 }
 
-#undef NR_PLANES
+
+/* Widest 16x16 kernel the CPU supports, picked by lp_rast_tri_init().
+ *
+ * There is no such choice for single 4x4 blocks: the AVX2 and AVX-512
+ * variants spend more on setup than they save (see lp_test_tri).
+ */
+static lp_rast_tri_3_16_func tri_3_16 = lp_rast_tri_3_16_sse2;
+
+
+static void
+choose_tri_kernels(void)
+{
+   util_cpu_detect();
+
+#if defined(USE_AVX2)
+   if (util_cpu_caps.has_avx2)
+      tri_3_16 = lp_rast_tri_3_16_avx2;
+#endif
+
+#if defined(USE_AVX512)
+   if (util_cpu_caps.has_avx512f)
+      tri_3_16 = lp_rast_tri_3_16_avx512;
+#endif
+}
+
+
+/**
+ * Select the coverage kernel for this CPU.  Must be called before any
+ * triangle is rasterized.
+ */
+void
+lp_rast_tri_init(void)
+{
+   static once_flag once = ONCE_FLAG_INIT;
+
+   call_once(&once, choose_tri_kernels);
+}
+
+
+void
+lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
+                         const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_triangle *tri = arg.triangle.tri;
+   const struct lp_rast_plane *plane = GET_PLANES(tri);
+   int x = (arg.triangle.plane_mask & 0xff) + task->x;
+   int y = (arg.triangle.plane_mask >> 8) + task->y;
+   struct lp_rast_block_mask out[16];
+   unsigned i, nr;
+
+   nr = tri_3_16(plane, x, y, out);
+
+   for (i = 0; i < nr; i++)
+      lp_rast_shade_quads_mask(task,
+                               &tri->inputs,
+                               x + 4 * out[i].j,
+                               y + 4 * out[i].i,
+                               out[i].mask);
+}
+
+void
+lp_rast_triangle_32_3_4(struct lp_rasterizer_task *task,
+                        const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_triangle *tri = arg.triangle.tri;
+   const struct lp_rast_plane *plane = GET_PLANES(tri);
+   int x = (arg.triangle.plane_mask & 0xff) + task->x;
+   int y = (arg.triangle.plane_mask >> 8) + task->y;
+   unsigned mask;
+
+   mask = lp_rast_tri_3_4_sse2(plane, x, y);
+
+   if (mask)
+      lp_rast_shade_quads_mask(task,
+                               &tri->inputs,
+                               x,
+                               y,
+                               mask);
+}
 
 #else
 
@@ -681,6 +741,11 @@ lp_rast_triangle_32_3_4(struct lp_rasterizer_task *task,
    lp_rast_triangle_32_3_16(task, arg);
 }
 
+void
+lp_rast_tri_init(void)
+{
+}
+
 #endif
 
 
@@ -0,0 +1,210 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * AVX2 coverage kernels for 3-plane triangles, 8 edge values at a time.
+ *
+ * This file is built with -mavx2, so nothing in here may be called
+ * unless util_cpu_caps.has_avx2 is set.
+ */
+
+#include <immintrin.h>
+
+#include "util/u_math.h"
+#include "lp_rast_priv.h"
+
+
+/**
+ * Per-plane setup shared by the 16x16 and 4x4 kernels: the edge value of
+ * pixel x, y (minus one, so that only the sign bit needs checking) and
+ * the steps in each direction.
+ */
+struct plane_avx2 {
+   int32_t c;
+   int32_t dcdx;
+   int32_t dcdy;
+   int32_t rej;
+};
+
+
+static inline void
+setup_planes(const struct lp_rast_plane *plane, int x, int y,
+             struct plane_avx2 *p)
+{
+   unsigned k;
+
+   for (k = 0; k < 3; k++) {
+      /* Wrapping arithmetic, like the SSE2 kernels */
+      uint32_t dcdx = -(uint32_t)plane[k].dcdx;
+      uint32_t dcdy = (uint32_t)plane[k].dcdy;
+      uint32_t eo = 0;
+
+      if (plane[k].dcdx < 0) eo -= plane[k].dcdx;
+      if (plane[k].dcdy > 0) eo += plane[k].dcdy;
+
+      p[k].c = (int32_t)((uint32_t)plane[k].c + dcdx * x + dcdy * y - 1);
+      p[k].dcdx = (int32_t)dcdx;
+      p[k].dcdy = (int32_t)dcdy;
+      p[k].rej = (int32_t)(eo * 4 + 1);
+   }
+}
+
+
+/**
+ * Sign bits of the 16 pixels of the 4x4 block whose top-left edge values
+ * are c0, c1, c2, as two 8-wide halves of two rows each.
+ */
+static inline unsigned
+block_4_outside(const __m256i *span, const __m256i *span_hi,
+                int32_t c0, int32_t c1, int32_t c2)
+{
+   __m256i lo, hi;
+
+   lo = _mm256_or_si256(
+           _mm256_or_si256(_mm256_add_epi32(_mm256_set1_epi32(c0), span[0]),
+                           _mm256_add_epi32(_mm256_set1_epi32(c1), span[1])),
+           _mm256_add_epi32(_mm256_set1_epi32(c2), span[2]));
+
+   hi = _mm256_or_si256(
+           _mm256_or_si256(_mm256_add_epi32(_mm256_set1_epi32(c0), span_hi[0]),
+                           _mm256_add_epi32(_mm256_set1_epi32(c1), span_hi[1])),
+           _mm256_add_epi32(_mm256_set1_epi32(c2), span_hi[2]));
+
+   return _mm256_movemask_ps(_mm256_castsi256_ps(lo)) |
+          (_mm256_movemask_ps(_mm256_castsi256_ps(hi)) << 8);
+}
+
+
+/**
+ * Edge values of the top two rows of a 4x4 grid with the given spacing
+ * (1 << shift), relative to its top-left corner.  Built from masks rather
+ * than multiplies, which would dominate the cost of a single 4x4 block.
+ */
+static inline __m256i
+grid_4x2(const struct plane_avx2 *p, unsigned shift)
+{
+   const __m256i x1 = _mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1);
+   const __m256i x2 = _mm256_setr_epi32(0, 0, -1, -1, 0, 0, -1, -1);
+   const __m256i y1 = _mm256_setr_epi32(0, 0, 0, 0, -1, -1, -1, -1);
+   __m256i dcdx = _mm256_set1_epi32((uint32_t)p->dcdx << shift);
+   __m256i dcdy = _mm256_set1_epi32((uint32_t)p->dcdy << shift);
+
+   return _mm256_add_epi32(
+             _mm256_add_epi32(_mm256_and_si256(dcdx, x1),
+                              _mm256_and_si256(_mm256_slli_epi32(dcdx, 1), x2)),
+             _mm256_and_si256(dcdy, y1));
+}
+
+
+/**
+ * Edge value offsets of the pixels in the top (span) and bottom (span_hi)
+ * halves of a 4x4 block.
+ */
+static inline void
+setup_spans(const struct plane_avx2 *p, __m256i *span, __m256i *span_hi)
+{
+   unsigned k;
+
+   for (k = 0; k < 3; k++) {
+      span[k] = grid_4x2(&p[k], 0);
+      span_hi[k] = _mm256_add_epi32(span[k],
+                                    _mm256_set1_epi32((uint32_t)p[k].dcdy << 1));
+   }
+}
+
+
+unsigned
+lp_rast_tri_3_16_avx2(const struct lp_rast_plane *plane, int x, int y,
+                      struct lp_rast_block_mask *out)
+{
+   struct plane_avx2 p[3];
+   __m256i span[3], span_hi[3];
+   __m256i rej_lo = _mm256_setzero_si256();
+   __m256i rej_hi = _mm256_setzero_si256();
+   PIPE_ALIGN_VAR(32) int32_t corner[3][16];
+   unsigned nr = 0;
+   unsigned live;
+   unsigned k;
+
+   setup_planes(plane, x, y, p);
+
+   /* Find the corners of all 16 blocks at once, and reject the blocks
+    * outside any plane.
+    */
+   for (k = 0; k < 3; k++) {
+      __m256i rej = _mm256_set1_epi32(p[k].rej);
+      __m256i lo, hi;
+
+      /* Corners of the blocks in the top and bottom halves */
+      lo = _mm256_add_epi32(_mm256_set1_epi32(p[k].c), grid_4x2(&p[k], 2));
+      hi = _mm256_add_epi32(lo, _mm256_set1_epi32((uint32_t)p[k].dcdy << 3));
+
+      _mm256_store_si256((__m256i *)&corner[k][0], lo);
+      _mm256_store_si256((__m256i *)&corner[k][8], hi);
+
+      rej_lo = _mm256_or_si256(rej_lo, _mm256_add_epi32(lo, rej));
+      rej_hi = _mm256_or_si256(rej_hi, _mm256_add_epi32(hi, rej));
+   }
+
+   live = ~(_mm256_movemask_ps(_mm256_castsi256_ps(rej_lo)) |
+            (_mm256_movemask_ps(_mm256_castsi256_ps(rej_hi)) << 8)) & 0xffff;
+   if (!live)
+      return 0;
+
+   setup_spans(p, span, span_hi);
+
+   while (live) {
+      unsigned b = ffs(live) - 1;
+      unsigned mask;
+
+      live &= live - 1;
+
+      mask = block_4_outside(span, span_hi,
+                             corner[0][b], corner[1][b], corner[2][b]);
+      if (mask != 0xffff) {
+         out[nr].i = b >> 2;
+         out[nr].j = b & 3;
+         out[nr].mask = 0xffff & ~mask;
+         nr++;
+      }
+   }
+
+   return nr;
+}
+
+
+unsigned
+lp_rast_tri_3_4_avx2(const struct lp_rast_plane *plane, int x, int y)
+{
+   struct plane_avx2 p[3];
+   __m256i span[3], span_hi[3];
+
+   setup_planes(plane, x, y, p);
+   setup_spans(p, span, span_hi);
+
+   return 0xffff & ~block_4_outside(span, span_hi, p[0].c, p[1].c, p[2].c);
+}
@@ -0,0 +1,177 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * AVX-512 coverage kernels for 3-plane triangles.  A 16-wide vector holds
+ * either the corners of all the 4x4 blocks of a 16x16 block or all the
+ * pixels of one 4x4 block, and compares straight into a 16-bit mask.
+ *
+ * This file is built with -mavx512f, so nothing in here may be called
+ * unless util_cpu_caps.has_avx512f is set.
+ */
+
+#include <immintrin.h>
+
+#include "util/u_math.h"
+#include "lp_rast_priv.h"
+
+
+struct plane_avx512 {
+   int32_t c;
+   int32_t dcdx;
+   int32_t dcdy;
+   int32_t rej;
+};
+
+
+/* Same as setup_planes() in lp_rast_tri_avx2.c */
+static inline void
+setup_planes(const struct lp_rast_plane *plane, int x, int y,
+             struct plane_avx512 *p)
+{
+   unsigned k;
+
+   for (k = 0; k < 3; k++) {
+      uint32_t dcdx = -(uint32_t)plane[k].dcdx;
+      uint32_t dcdy = (uint32_t)plane[k].dcdy;
+      uint32_t eo = 0;
+
+      if (plane[k].dcdx < 0) eo -= plane[k].dcdx;
+      if (plane[k].dcdy > 0) eo += plane[k].dcdy;
+
+      p[k].c = (int32_t)((uint32_t)plane[k].c + dcdx * x + dcdy * y - 1);
+      p[k].dcdx = (int32_t)dcdx;
+      p[k].dcdy = (int32_t)dcdy;
+      p[k].rej = (int32_t)(eo * 4 + 1);
+   }
+}
+
+
+/**
+ * Edge values of a 4x4 grid with the given spacing (1 << shift), relative
+ * to its top-left corner.  Built from masked moves rather than multiplies,
+ * which would dominate the cost of a single 4x4 block.
+ */
+static inline __m512i
+grid_4x4(const struct plane_avx512 *p, unsigned shift)
+{
+   __m512i dcdx = _mm512_set1_epi32((uint32_t)p->dcdx << shift);
+   __m512i dcdy = _mm512_set1_epi32((uint32_t)p->dcdy << shift);
+   __m512i x, y;
+
+   x = _mm512_add_epi32(_mm512_maskz_mov_epi32(0xaaaa, dcdx),
+                        _mm512_maskz_mov_epi32(0xcccc,
+                                               _mm512_slli_epi32(dcdx, 1)));
+   y = _mm512_add_epi32(_mm512_maskz_mov_epi32(0xf0f0, dcdy),
+                        _mm512_maskz_mov_epi32(0xff00,
+                                               _mm512_slli_epi32(dcdy, 1)));
+
+   return _mm512_add_epi32(x, y);
+}
+
+
+static inline unsigned
+block_4_outside(const __m512i *span, int32_t c0, int32_t c1, int32_t c2)
+{
+   __m512i c;
+
+   c = _mm512_or_si512(
+          _mm512_or_si512(_mm512_add_epi32(_mm512_set1_epi32(c0), span[0]),
+                          _mm512_add_epi32(_mm512_set1_epi32(c1), span[1])),
+          _mm512_add_epi32(_mm512_set1_epi32(c2), span[2]));
+
+   return _mm512_cmplt_epi32_mask(c, _mm512_setzero_si512());
+}
+
+
+unsigned
+lp_rast_tri_3_16_avx512(const struct lp_rast_plane *plane, int x, int y,
+                        struct lp_rast_block_mask *out)
+{
+   struct plane_avx512 p[3];
+   __m512i span[3];
+   __m512i rej = _mm512_setzero_si512();
+   PIPE_ALIGN_VAR(64) int32_t corner[3][16];
+   unsigned nr = 0;
+   unsigned live;
+   unsigned k;
+
+   setup_planes(plane, x, y, p);
+
+   /* Find the corners of all 16 blocks, and reject the blocks outside any
+    * plane.
+    */
+   for (k = 0; k < 3; k++) {
+      __m512i c = _mm512_add_epi32(_mm512_set1_epi32(p[k].c),
+                                   grid_4x4(&p[k], 2));
+
+      _mm512_store_si512(corner[k], c);
+
+      rej = _mm512_or_si512(rej,
+                            _mm512_add_epi32(c, _mm512_set1_epi32(p[k].rej)));
+   }
+
+   live = ~_mm512_cmplt_epi32_mask(rej, _mm512_setzero_si512()) & 0xffff;
+   if (!live)
+      return 0;
+
+   for (k = 0; k < 3; k++)
+      span[k] = grid_4x4(&p[k], 0);
+
+   while (live) {
+      unsigned b = ffs(live) - 1;
+      unsigned mask;
+
+      live &= live - 1;
+
+      mask = block_4_outside(span, corner[0][b], corner[1][b], corner[2][b]);
+      if (mask != 0xffff) {
+         out[nr].i = b >> 2;
+         out[nr].j = b & 3;
+         out[nr].mask = 0xffff & ~mask;
+         nr++;
+      }
+   }
+
+   return nr;
+}
+
+
+unsigned
+lp_rast_tri_3_4_avx512(const struct lp_rast_plane *plane, int x, int y)
+{
+   struct plane_avx512 p[3];
+   __m512i span[3];
+   unsigned k;
+
+   setup_planes(plane, x, y, p);
+
+   for (k = 0; k < 3; k++)
+      span[k] = grid_4x4(&p[k], 0);
+
+   return 0xffff & ~block_4_outside(span, p[0].c, p[1].c, p[2].c);
+}
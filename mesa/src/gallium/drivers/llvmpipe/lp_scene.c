@@ -29,6 +29,7 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_inlines.h"
+#include "util/u_atomic.h"
 #include "util/simple_list.h"
 #include "util/u_format.h"
 #include "lp_scene.h"
@@ -51,7 +52,7 @@ struct resource_ref {
  * \param queue  the queue to put newly rendered/emptied scenes into
  */
 struct lp_scene *
-lp_scene_create( struct pipe_context *pipe )
+lp_scene_create( struct pipe_context *pipe, unsigned num_threads )
 {
    struct lp_scene *scene = CALLOC_STRUCT(lp_scene);
    if (!scene)
@@ -59,11 +60,17 @@ lp_scene_create( struct pipe_context *pipe )
 
    scene->pipe = pipe;
 
+   scene->max_ranges = MAX2(1, num_threads);
+   scene->ranges = align_malloc(scene->max_ranges * sizeof(*scene->ranges),
+                                sizeof(struct lp_bin_range));
+   if (!scene->ranges) {
+      FREE(scene);
+      return NULL;
+   }
+
    scene->data.head =
       CALLOC_STRUCT(data_block);
 
-   pipe_mutex_init(scene->mutex);
-
 #ifdef DEBUG
    /* Do some scene limit sanity checks here */
    {
@@ -90,9 +97,9 @@ void
 lp_scene_destroy(struct lp_scene *scene)
 {
    lp_fence_reference(&scene->fence, NULL);
-   pipe_mutex_destroy(scene->mutex);
    assert(scene->data.head->next == NULL);
    FREE(scene->data.head);
+   align_free(scene->ranges);
    FREE(scene);
 }
 
@@ -265,6 +272,7 @@ lp_scene_end_rasterization(struct lp_scene *scene )
                             ref->resource[i]->height0,
                             llvmpipe_resource_size(ref->resource[i]));
             j++;
+            llvmpipe_resource_scene_unref(ref->resource[i]);
             pipe_resource_reference(&ref->resource[i], NULL);
          }
       }
@@ -412,6 +420,7 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
    /* Append the reference to the reference block.
     */
    pipe_resource_reference(&ref->resource[ref->count++], resource);
+   llvmpipe_resource_scene_ref(resource);
    scene->resource_reference_size += llvmpipe_resource_size(resource);
 
    /* Heuristic to advise scene flushes.  This isn't helpful in the
@@ -449,61 +458,294 @@ lp_scene_is_resource_referenced(const struct lp_scene *scene,
 
 
 
-/** advance curr_x,y to the next bin */
-static boolean
-next_bin(struct lp_scene *scene)
+/**
+ * Map a distance along a Hilbert curve covering an n x n grid (n a power
+ * of two) to a grid position.
+ */
+static void
+hilbert_d2xy(unsigned n, unsigned d, unsigned *x, unsigned *y)
 {
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
+   unsigned s, t = d;
+
+   *x = *y = 0;
+   for (s = 1; s < n; s *= 2) {
+      unsigned rx = 1 & (t / 2);
+      unsigned ry = 1 & (t ^ rx);
+
+      if (ry == 0) {
+         unsigned tmp;
+         if (rx == 1) {
+            *x = s - 1 - *x;
+            *y = s - 1 - *y;
+         }
+         tmp = *x;
+         *x = *y;
+         *y = tmp;
+      }
+      *x += s * rx;
+      *y += s * ry;
+      t /= 4;
    }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return FALSE;
+}
+
+
+/** Gather the even bits of a Morton code */
+static unsigned
+morton_compact(unsigned v)
+{
+   v &= 0x55555555;
+   v = (v | (v >> 1)) & 0x33333333;
+   v = (v | (v >> 2)) & 0x0f0f0f0f;
+   v = (v | (v >> 4)) & 0x00ff00ff;
+   v = (v | (v >> 8)) & 0x0000ffff;
+   return v;
+}
+
+
+/**
+ * Compute the traversal order of all the bins of the current framebuffer.
+ */
+static void
+build_bin_curve(struct lp_scene *scene, enum lp_bin_order order)
+{
+   unsigned n = util_next_power_of_two(MAX2(scene->tiles_x, scene->tiles_y));
+   unsigned len = 0;
+   unsigned d, x, y;
+
+   if (order == LP_BIN_ORDER_RASTER) {
+      for (y = 0; y < scene->tiles_y; y++) {
+         for (x = 0; x < scene->tiles_x; x++) {
+            scene->curve[len].x = x;
+            scene->curve[len].y = y;
+            len++;
+         }
+      }
    }
-   return TRUE;
+   else {
+      /* Walk the curve over the enclosing power of two square and drop
+       * the positions outside of the framebuffer.
+       */
+      for (d = 0; d < n * n; d++) {
+         if (order == LP_BIN_ORDER_MORTON) {
+            x = morton_compact(d);
+            y = morton_compact(d >> 1);
+         }
+         else {
+            hilbert_d2xy(n, d, &x, &y);
+         }
+
+         if (x < scene->tiles_x && y < scene->tiles_y) {
+            scene->curve[len].x = x;
+            scene->curve[len].y = y;
+            len++;
+         }
+      }
+   }
+
+   assert(len == scene->tiles_x * scene->tiles_y);
+
+   scene->curve_order = order;
+   scene->curve_tiles_x = scene->tiles_x;
+   scene->curve_tiles_y = scene->tiles_y;
+   scene->curve_len = len;
 }
 
 
-void
-lp_scene_bin_iter_begin( struct lp_scene *scene )
+/**
+ * Estimated cost of rasterizing a bin: the number of commands in it plus
+ * one for the tile begin/end work.
+ */
+static unsigned
+bin_cost(const struct cmd_bin *bin)
+{
+   const struct cmd_block *block;
+   unsigned cost = 1;
+
+   for (block = bin->head; block; block = block->next)
+      cost += block->count;
+
+   return cost;
+}
+
+
+static inline unsigned
+range_start(unsigned bounds)
+{
+   return bounds & 0xffff;
+}
+
+
+static inline unsigned
+range_end(unsigned bounds)
+{
+   return bounds >> 16;
+}
+
+
+static inline unsigned
+range_bounds(unsigned start, unsigned end)
 {
-   scene->curr_x = scene->curr_y = -1;
+   return start | (end << 16);
 }
 
 
 /**
- * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
- * Multiple rendering threads will call this function to get a chunk
- * of work (a bin) to work on.
+ * Prepare the scene's bins to be handed out to the rasterizer threads.
+ *
+ * The non-empty bins are listed in the given traversal order and split in
+ * one contiguous run per thread, balanced by the number of commands
+ * binned, so that every thread starts on a compact region of the
+ * framebuffer with about the same amount of work.
+ * thread_nodes optionally gives the NUMA node each thread runs on; idle
+ * threads prefer stealing work from threads on their own node.
+ * Called once per scene by one thread, before the others start.
  */
-struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene , int *x, int *y)
+void
+lp_scene_bin_iter_begin( struct lp_scene *scene,
+                         enum lp_bin_order order,
+                         unsigned num_threads,
+                         const unsigned *thread_nodes )
 {
-   struct cmd_bin *bin = NULL;
+   unsigned num_bins = 0;
+   unsigned start = 0;
+   unsigned i, r;
 
-   pipe_mutex_lock(scene->mutex);
+   STATIC_ASSERT(LP_MAX_BINS <= 0xffff);
 
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
+   if (scene->curve_order != order ||
+       scene->curve_tiles_x != scene->tiles_x ||
+       scene->curve_tiles_y != scene->tiles_y) {
+      build_bin_curve(scene, order);
    }
-   else if (!next_bin(scene)) {
-      /* no more bins left */
-      goto end;
+
+   scene->cost[0] = 0;
+   for (i = 0; i < scene->curve_len; i++) {
+      struct lp_bin_pos pos = scene->curve[i];
+      const struct cmd_bin *bin = lp_scene_get_bin(scene, pos.x, pos.y);
+
+      if (bin->head) {
+         scene->bins[num_bins] = pos;
+         scene->cost[num_bins + 1] = scene->cost[num_bins] + bin_cost(bin);
+         num_bins++;
+      }
+   }
+   scene->num_bins = num_bins;
+
+   scene->num_ranges = CLAMP(num_threads, 1, scene->max_ranges);
+   for (r = 0; r < scene->num_ranges; r++) {
+      uint64_t target = (uint64_t)scene->cost[num_bins] * (r + 1) /
+                        scene->num_ranges;
+      unsigned end = start;
+
+      while (end < num_bins && scene->cost[end] < target)
+         end++;
+      if (r == scene->num_ranges - 1)
+         end = num_bins;
+
+      scene->ranges[r].bounds = range_bounds(start, end);
+      scene->ranges[r].node = thread_nodes ? thread_nodes[r] : 0;
+      start = end;
    }
+}
+
+
+/**
+ * Take the first bin of a thread's own range.
+ * Returns the position in lp_scene::bins, or -1 if the range is empty.
+ */
+static int
+claim_own_bin(struct lp_bin_range *range)
+{
+   unsigned bounds = p_atomic_read(&range->bounds);
+
+   while (range_start(bounds) < range_end(bounds)) {
+      unsigned start = range_start(bounds);
+      unsigned old = p_atomic_cmpxchg(&range->bounds, bounds,
+                                      range_bounds(start + 1,
+                                                   range_end(bounds)));
+      if (old == bounds)
+         return start;
+      bounds = old;
+   }
+
+   return -1;
+}
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
 
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   pipe_mutex_unlock(scene->mutex);
-   return bin;
+/**
+ * Steal the last bin of the range with the most work left, looking at
+ * the ranges of threads on the given NUMA node first.
+ * Returns the position in lp_scene::bins, or -1 if all the bins of the
+ * scene have been claimed.
+ */
+static int
+steal_bin(struct lp_scene *scene, unsigned node)
+{
+   while (1) {
+      struct lp_bin_range *victim = NULL;
+      unsigned victim_bounds = 0;
+      boolean victim_local = FALSE;
+      unsigned max_cost = 0;
+      unsigned r;
+
+      for (r = 0; r < scene->num_ranges; r++) {
+         unsigned bounds = p_atomic_read(&scene->ranges[r].bounds);
+         unsigned start = range_start(bounds);
+         unsigned end = range_end(bounds);
+         unsigned cost = scene->cost[end] - scene->cost[start];
+         boolean local = scene->ranges[r].node == node;
+
+         if (start >= end || (victim_local && !local))
+            continue;
+
+         if (cost > max_cost || (local && !victim_local)) {
+            max_cost = cost;
+            victim = &scene->ranges[r];
+            victim_bounds = bounds;
+            victim_local = local;
+         }
+      }
+
+      if (!victim)
+         return -1;
+
+      {
+         unsigned end = range_end(victim_bounds) - 1;
+         unsigned new_bounds = range_bounds(range_start(victim_bounds), end);
+
+         if (p_atomic_cmpxchg(&victim->bounds, victim_bounds,
+                              new_bounds) == victim_bounds)
+            return end;
+      }
+   }
+}
+
+
+/**
+ * Return pointer to next bin to be rendered by the given thread.
+ * Threads first work through their own range of bins, then steal from
+ * the ends of the other threads' ranges.  Empty bins are never returned.
+ * This is lock-free and may be called concurrently by all the
+ * rasterizer threads.
+ */
+struct cmd_bin *
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned thread,
+                        int *x, int *y )
+{
+   int pos;
+
+   assert(thread < scene->num_ranges);
+
+   pos = claim_own_bin(&scene->ranges[thread]);
+   if (pos < 0) {
+      pos = steal_bin(scene, scene->ranges[thread].node);
+      if (pos < 0)
+         return NULL;
+   }
+
+   *x = scene->bins[pos].x;
+   *y = scene->bins[pos].y;
+   return lp_scene_get_bin(scene, *x, *y);
 }
 
 
@@ -47,6 +47,7 @@ struct lp_rast_state;
  */
 #define TILES_X (LP_MAX_WIDTH / TILE_SIZE)
 #define TILES_Y (LP_MAX_HEIGHT / TILE_SIZE)
+#define LP_MAX_BINS (TILES_X * TILES_Y)
 
 
 /* Commands per command block (ideally so sizeof(cmd_block) is a power of
@@ -117,6 +118,38 @@ struct data_block_list {
 
 struct resource_ref;
 
+
+/**
+ * Order in which the rasterizer threads walk the bins of a scene.
+ * The space filling curves keep consecutive bins close together in the
+ * framebuffer, so that each thread works on a compact region.
+ */
+enum lp_bin_order {
+   LP_BIN_ORDER_RASTER,
+   LP_BIN_ORDER_MORTON,
+   LP_BIN_ORDER_HILBERT
+};
+
+
+/** Position of a bin, in tiles */
+struct lp_bin_pos {
+   uint8_t x, y;
+};
+
+
+/**
+ * A run of positions in lp_scene::bins owned by one rasterizer thread.
+ * Start and end are packed in one word so that the owner (taking bins
+ * from the start) and other threads (stealing from the end) can each
+ * claim a bin with a single compare-and-swap.  Padded so that every
+ * thread's range sits on its own cache line.
+ */
+struct lp_bin_range {
+   unsigned bounds;   /**< start | (end << 16) */
+   unsigned node;     /**< NUMA node of the owning thread */
+   unsigned pad[14];
+};
+
 /**
  * All bins and bin data are contained here.
  * Per-bin data goes into the 'tile' bins.
@@ -173,16 +206,31 @@ struct lp_scene {
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
-   pipe_mutex mutex;
-
    struct cmd_bin tile[TILES_X][TILES_Y];
+
+   /** Bin traversal state, see lp_scene_bin_iter_begin() */
+   struct lp_bin_range *ranges;            /**< one per rasterizer thread */
+   unsigned max_ranges;
+   unsigned num_ranges;
+   unsigned num_bins;                      /**< number of non-empty bins */
+   struct lp_bin_pos bins[LP_MAX_BINS];    /**< non-empty bins, in order */
+   unsigned cost[LP_MAX_BINS + 1];         /**< prefix sums of bin costs */
+
+   /** All bins of the framebuffer in traversal order, rebuilt only when
+    * the order or the framebuffer size changes.
+    */
+   enum lp_bin_order curve_order;
+   unsigned curve_tiles_x, curve_tiles_y;
+   unsigned curve_len;
+   struct lp_bin_pos curve[LP_MAX_BINS];
+
    struct data_block_list data;
 };
 
 
 
-struct lp_scene *lp_scene_create(struct pipe_context *pipe);
+struct lp_scene *lp_scene_create(struct pipe_context *pipe,
+                                 unsigned num_threads);
 
 void lp_scene_destroy(struct lp_scene *scene);
 
@@ -379,10 +427,14 @@ lp_scene_get_num_bins( const struct lp_scene *scene )
 
 
 void
-lp_scene_bin_iter_begin( struct lp_scene *scene );
+lp_scene_bin_iter_begin( struct lp_scene *scene,
+                         enum lp_bin_order order,
+                         unsigned num_threads,
+                         const unsigned *thread_nodes );
 
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene, int *x, int *y );
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned thread,
+                        int *x, int *y );
 
 
 
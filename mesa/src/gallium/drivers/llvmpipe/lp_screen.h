@@ -37,6 +37,7 @@
 #include "pipe/p_screen.h"
 #include "pipe/p_defines.h"
 #include "os/os_thread.h"
+#include "util/u_queue.h"
 #include "gallivm/lp_bld.h"
 
 
@@ -57,6 +58,19 @@ struct llvmpipe_screen
 
    struct lp_rasterizer *rast;
    pipe_mutex rast_mutex;
+
+   /** Scenes waiting for or being rasterized, by all contexts */
+   int32_t num_queued_scenes;
+
+   /** Background compilation of fragment shader variants, for all contexts */
+   struct util_queue compile_queue;
+   int64_t compile_wait;     /**< usecs to wait for optimized code */
+
+   /** Threads the draw modules of all contexts shade vertices on */
+   struct util_queue vs_queue;
+
+   /** Generate fragment shader code from NIR rather than from TGSI */
+   boolean use_nir;
 };
 
 
@@ -35,6 +35,7 @@
 #include <limits.h>
 
 #include "pipe/p_defines.h"
+#include "util/u_atomic.h"
 #include "util/u_framebuffer.h"
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
@@ -153,6 +154,7 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
 {
    struct lp_scene *scene = setup->scene;
    struct llvmpipe_screen *screen = llvmpipe_screen(scene->pipe->screen);
+   int64_t start;
 
    scene->num_active_queries = setup->active_binned_queries;
    memcpy(scene->active_queries, setup->active_queries,
@@ -165,6 +167,14 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
    if (setup->last_fence)
       setup->last_fence->issued = TRUE;
 
+   /* Scenes of all contexts share the one rasterizer; count this one and
+    * any still waiting for or being rasterized as the queue depth.
+    */
+   setup->counters->scene_queue_depth +=
+      p_atomic_inc_return(&screen->num_queued_scenes);
+   setup->counters->nr_scenes++;
+
+   start = os_time_get_nano();
    pipe_mutex_lock(screen->rast_mutex);
 
    /* FIXME: We enqueue the scene then wait on the rasterizer to finish.
@@ -179,8 +189,12 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
     */
    lp_rast_queue_scene(screen->rast, scene);
    lp_rast_finish(screen->rast);
+   lp_rast_add_counters(screen->rast, setup->counters);
    pipe_mutex_unlock(screen->rast_mutex);
 
+   p_atomic_dec(&screen->num_queued_scenes);
+   setup->counters->rast_wait_time += os_time_get_nano() - start;
+
    lp_scene_end_rasterization(setup->scene);
    lp_setup_reset( setup );
 
@@ -1322,7 +1336,7 @@ lp_setup_create( struct pipe_context *pipe,
    /* Used only in update_state():
     */
    setup->pipe = pipe;
-
+   setup->counters = &llvmpipe_context(pipe)->counters;
 
    setup->num_threads = screen->num_threads;
    setup->vbuf = draw_vbuf_stage(draw, &setup->base);
@@ -1335,7 +1349,7 @@ lp_setup_create( struct pipe_context *pipe,
 
    /* create some empty scenes */
    for (i = 0; i < MAX_SCENES; i++) {
-      setup->scenes[i] = lp_scene_create( pipe );
+      setup->scenes[i] = lp_scene_create( pipe, setup->num_threads );
       if (!setup->scenes[i]) {
          goto no_scenes;
       }
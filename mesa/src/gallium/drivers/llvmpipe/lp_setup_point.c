@@ -438,7 +438,7 @@ try_setup_point( struct lp_setup_context *setup,
 
    if (!u_rect_test_intersection(&setup->draw_regions[viewport_index], &bbox)) {
       if (0) debug_printf("offscreen\n");
-      LP_COUNT(nr_culled_tris);
+      LP_COUNT(setup->counters, nr_culled_tris);
       return TRUE;
    }
 
@@ -456,7 +456,7 @@ try_setup_point( struct lp_setup_context *setup,
    point->v[0][1] = v0[0][1];
 #endif
 
-   LP_COUNT(nr_tris);
+   LP_COUNT(setup->counters, nr_tris);
 
    if (lp_context->active_statistics_queries &&
        !llvmpipe_rasterization_disabled(lp_context)) {
@@ -0,0 +1,845 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Compute shaders.
+ *
+ * A compute shader is compiled into a single function which runs one SIMD
+ * vector of invocations of a block.  launch_grid hands the blocks out to
+ * the rasterizer threads, which run each block vector by vector.
+ *
+ * Blocks whose shader uses BARRIER run every vector in a fiber of its own:
+ * a barrier switches to the next fiber of the block, round robin, so that
+ * when the last vector reaches the barrier the first one resumes past it.
+ * Fibers are only switched at barriers, and all the fibers of a block run
+ * on the same thread, so no other synchronization is needed.
+ */
+
+
+#include "pipe/p_defines.h"
+#include "util/u_atomic.h"
+#include "util/u_inlines.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_pointer.h"
+#include "util/u_string.h"
+#include "tgsi/tgsi_dump.h"
+#include "tgsi/tgsi_parse.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_logic.h"
+#include "gallivm/lp_bld_struct.h"
+#include "gallivm/lp_bld_tgsi.h"
+#include "gallivm/lp_bld_type.h"
+#include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_flush.h"
+#include "lp_rast.h"
+#include "lp_screen.h"
+#include "lp_state_cs.h"
+#include "lp_texture.h"
+
+#if LP_HAVE_COMPUTE
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+
+
+/** Stack size of each fiber */
+#define LP_CS_FIBER_STACK_SIZE (64 * 1024)
+
+
+static unsigned cs_no = 0;
+
+/** Bound to unbound buffer slots, reads from it return zero */
+static const uint32_t lp_dummy_ssbo[4];
+
+
+/**
+ * Per rasterizer thread state.
+ */
+struct lp_cs_exec
+{
+   struct lp_jit_cs_thread_data thread_data;
+   unsigned shared_size;
+
+#if LP_HAVE_COMPUTE
+   /* Fibers of the block being run */
+   ucontext_t main;
+   ucontext_t *fibers;
+   /* max_fibers stacks, each above an inaccessible guard page, stack_stride
+    * bytes apart
+    */
+   uint8_t *stacks;
+   size_t stack_stride;
+   unsigned max_fibers;
+   unsigned num_fibers;
+   unsigned current;
+
+   const struct lp_cs_launch *launch;
+   unsigned block[3];
+#endif
+};
+
+
+/**
+ * State of a launch_grid call, shared by all the rasterizer threads.
+ */
+struct lp_cs_launch
+{
+   const struct lp_compute_shader *cs;
+   struct lp_cs_exec **exec;
+   struct lp_jit_cs_context jit_context;
+
+   unsigned grid[3];
+   uint64_t num_blocks;
+   uint64_t next_block;
+
+   /** SIMD vectors per block */
+   unsigned num_vectors;
+};
+
+
+#if LP_HAVE_COMPUTE
+
+/**
+ * Called by the generated code on BARRIER: switch to the next fiber.
+ */
+static void
+lp_cs_barrier(struct lp_jit_cs_thread_data *thread_data)
+{
+   struct lp_cs_exec *exec = (struct lp_cs_exec *)thread_data->exec;
+   unsigned cur = exec->current;
+   unsigned next = cur + 1 < exec->num_fibers ? cur + 1 : 0;
+
+   if (next != cur) {
+      exec->current = next;
+      swapcontext(&exec->fibers[cur], &exec->fibers[next]);
+   }
+}
+
+
+/**
+ * Fiber entry point.  makecontext only passes int arguments, so the exec
+ * pointer comes in two halves.
+ */
+static void
+cs_fiber_entry(unsigned lo, unsigned hi)
+{
+   struct lp_cs_exec *exec =
+      (struct lp_cs_exec *)(uintptr_t)(((uint64_t)hi << 32) | lo);
+   const struct lp_cs_launch *launch = exec->launch;
+   unsigned i = exec->current;
+
+   launch->cs->jit_function(&launch->jit_context,
+                            exec->block[0], exec->block[1], exec->block[2],
+                            i * launch->cs->vector_length,
+                            &exec->thread_data);
+
+   /*
+    * Every fiber executes the same barriers, so the following fibers are
+    * either waiting at the last one, or haven't started at all.
+    */
+   if (i + 1 < exec->num_fibers) {
+      exec->current = i + 1;
+      setcontext(&exec->fibers[i + 1]);
+   }
+   setcontext(&exec->main);
+}
+
+
+static void
+cs_run_block_fibers(struct lp_cs_exec *exec)
+{
+   uintptr_t ptr = (uintptr_t)exec;
+   unsigned i;
+
+   for (i = 0; i < exec->num_fibers; i++) {
+      ucontext_t *fiber = &exec->fibers[i];
+
+      getcontext(fiber);
+      fiber->uc_stack.ss_sp = exec->stacks + i * exec->stack_stride +
+                              exec->stack_stride - LP_CS_FIBER_STACK_SIZE;
+      fiber->uc_stack.ss_size = LP_CS_FIBER_STACK_SIZE;
+      fiber->uc_link = NULL;
+      makecontext(fiber, (void (*)(void))cs_fiber_entry, 2,
+                  (unsigned)ptr, (unsigned)((uint64_t)ptr >> 32));
+   }
+
+   exec->current = 0;
+   swapcontext(&exec->main, &exec->fibers[0]);
+}
+
+
+
+static void
+cs_free_stacks(struct lp_cs_exec *exec)
+{
+   if (exec->stacks)
+      munmap(exec->stacks, (size_t)exec->max_fibers * exec->stack_stride);
+   exec->stacks = NULL;
+   exec->max_fibers = 0;
+}
+
+
+/**
+ * Map the fiber stacks, with a PROT_NONE page below each one, so that a
+ * shader overflowing its stack faults instead of overwriting the stack of
+ * the next fiber.
+ */
+static boolean
+cs_alloc_stacks(struct lp_cs_exec *exec, unsigned num_fibers)
+{
+   const size_t guard_size = sysconf(_SC_PAGESIZE);
+   const size_t stride = LP_CS_FIBER_STACK_SIZE + guard_size;
+   uint8_t *stacks;
+   unsigned i;
+
+   stacks = mmap(NULL, (size_t)num_fibers * stride, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (stacks == MAP_FAILED)
+      return FALSE;
+
+   exec->stacks = stacks;
+   exec->stack_stride = stride;
+   exec->max_fibers = num_fibers;
+
+   for (i = 0; i < num_fibers; i++) {
+      if (mprotect(stacks + i * stride, guard_size, PROT_NONE) != 0) {
+         cs_free_stacks(exec);
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+#endif /* LP_HAVE_COMPUTE */
+
+
+/**
+ * lp_rast_task_func running blocks until there are none left.
+ */
+static void
+cs_run_task(void *data, unsigned thread_index)
+{
+   struct lp_cs_launch *launch = (struct lp_cs_launch *)data;
+   const struct lp_compute_shader *cs = launch->cs;
+   struct lp_cs_exec *exec = launch->exec[thread_index];
+   const unsigned grid_xy = launch->grid[0] * launch->grid[1];
+   uint64_t b;
+
+   while ((b = p_atomic_inc_return(&launch->next_block) - 1) <
+          launch->num_blocks) {
+      unsigned x = (unsigned)(b % launch->grid[0]);
+      unsigned y = (unsigned)((b / launch->grid[0]) % launch->grid[1]);
+      unsigned z = (unsigned)(b / grid_xy);
+      unsigned i;
+
+#if LP_HAVE_COMPUTE
+      if (cs->has_barrier && launch->num_vectors > 1) {
+         exec->launch = launch;
+         exec->block[0] = x;
+         exec->block[1] = y;
+         exec->block[2] = z;
+         cs_run_block_fibers(exec);
+         continue;
+      }
+#endif
+
+      for (i = 0; i < launch->num_vectors; i++) {
+         cs->jit_function(&launch->jit_context, x, y, z,
+                          i * cs->vector_length, &exec->thread_data);
+      }
+   }
+}
+
+
+/**
+ * Make sure every rasterizer thread has enough shared memory and fibers
+ * for the launch.
+ */
+static boolean
+cs_prepare_exec(struct llvmpipe_context *lp,
+                const struct lp_compute_shader *cs,
+                unsigned num_tasks,
+                unsigned num_vectors)
+{
+   /* Out of bounds loads read the first dword, so never go empty */
+   unsigned shared_size = align(MAX2(cs->req_local_mem, 16), 16);
+   unsigned i;
+
+   if (lp->num_cs_exec < num_tasks) {
+      struct lp_cs_exec **exec;
+
+      exec = REALLOC(lp->cs_exec,
+                     lp->num_cs_exec * sizeof *exec,
+                     num_tasks * sizeof *exec);
+      if (!exec)
+         return FALSE;
+      for (i = lp->num_cs_exec; i < num_tasks; i++) {
+         exec[i] = CALLOC_STRUCT(lp_cs_exec);
+      }
+      lp->cs_exec = exec;
+      lp->num_cs_exec = num_tasks;
+   }
+
+   for (i = 0; i < num_tasks; i++) {
+      struct lp_cs_exec *exec = lp->cs_exec[i];
+
+      if (!exec)
+         return FALSE;
+
+      exec->thread_data.exec = exec;
+
+      if (exec->shared_size < shared_size) {
+         align_free(exec->thread_data.shared);
+         exec->thread_data.shared = align_malloc(shared_size, 16);
+         if (!exec->thread_data.shared) {
+            exec->shared_size = 0;
+            return FALSE;
+         }
+         exec->shared_size = shared_size;
+      }
+      exec->thread_data.shared_size = cs->req_local_mem;
+
+#if LP_HAVE_COMPUTE
+      if (cs->has_barrier && exec->max_fibers < num_vectors) {
+         FREE(exec->fibers);
+         cs_free_stacks(exec);
+
+         exec->fibers = CALLOC(num_vectors, sizeof *exec->fibers);
+         if (!exec->fibers)
+            return FALSE;
+
+         if (!cs_alloc_stacks(exec, num_vectors))
+            return FALSE;
+      }
+
+      /* With a single fiber barriers are no-ops */
+      exec->num_fibers = cs->has_barrier ? num_vectors : 1;
+#else
+      if (cs->has_barrier && num_vectors > 1)
+         return FALSE;
+#endif
+   }
+
+   return TRUE;
+}
+
+
+void
+llvmpipe_cleanup_cs(struct llvmpipe_context *lp)
+{
+   unsigned i;
+
+   for (i = 0; i < lp->num_cs_exec; i++) {
+      struct lp_cs_exec *exec = lp->cs_exec[i];
+
+      if (!exec)
+         continue;
+
+      align_free(exec->thread_data.shared);
+#if LP_HAVE_COMPUTE
+      FREE(exec->fibers);
+      cs_free_stacks(exec);
+#endif
+      FREE(exec);
+   }
+
+   FREE(lp->cs_exec);
+   lp->cs_exec = NULL;
+   lp->num_cs_exec = 0;
+
+   for (i = 0; i < ARRAY_SIZE(lp->ssbos[0]); i++) {
+      pipe_resource_reference(&lp->ssbos[PIPE_SHADER_COMPUTE][i].buffer, NULL);
+   }
+}
+
+
+/**
+ * Memory access interface of the generated code.
+ */
+struct lp_cs_iface
+{
+   struct lp_build_tgsi_cs_iface base;
+
+   LLVMValueRef context_ptr;
+   LLVMValueRef thread_data_ptr;
+};
+
+
+static void
+cs_fetch_buffer(const struct lp_build_tgsi_cs_iface *cs_iface,
+                struct lp_build_tgsi_context *bld_base,
+                unsigned unit,
+                LLVMValueRef *base_ptr,
+                LLVMValueRef *size)
+{
+   const struct lp_cs_iface *iface = (const struct lp_cs_iface *)cs_iface;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMValueRef index = lp_build_const_int32(gallivm, unit);
+
+   assert(unit < PIPE_MAX_SHADER_BUFFERS);
+
+   *base_ptr = lp_build_array_get(gallivm,
+                                  lp_jit_cs_context_ssbos(gallivm,
+                                                          iface->context_ptr),
+                                  index);
+   *size = lp_build_array_get(gallivm,
+                              lp_jit_cs_context_ssbo_sizes(gallivm,
+                                                           iface->context_ptr),
+                              index);
+}
+
+
+static void
+cs_fetch_shared(const struct lp_build_tgsi_cs_iface *cs_iface,
+                struct lp_build_tgsi_context *bld_base,
+                LLVMValueRef *base_ptr,
+                LLVMValueRef *size)
+{
+   const struct lp_cs_iface *iface = (const struct lp_cs_iface *)cs_iface;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+
+   *base_ptr = lp_jit_cs_thread_data_shared(gallivm, iface->thread_data_ptr);
+   *size = lp_jit_cs_thread_data_shared_size(gallivm, iface->thread_data_ptr);
+}
+
+
+static void
+cs_emit_barrier(const struct lp_build_tgsi_cs_iface *cs_iface,
+                struct lp_build_tgsi_context *bld_base)
+{
+#if LP_HAVE_COMPUTE
+   const struct lp_cs_iface *iface = (const struct lp_cs_iface *)cs_iface;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMTypeRef arg_type = LLVMTypeOf(iface->thread_data_ptr);
+   LLVMValueRef args[1];
+   LLVMValueRef func;
+
+   func = lp_build_const_func_pointer(gallivm,
+                                      func_to_pointer((func_pointer)lp_cs_barrier),
+                                      LLVMVoidTypeInContext(gallivm->context),
+                                      &arg_type, 1, "lp_cs_barrier");
+   args[0] = iface->thread_data_ptr;
+   LLVMBuildCall(gallivm->builder, func, args, 1, "");
+#endif
+}
+
+
+static void
+generate_compute(struct llvmpipe_context *lp,
+                 struct lp_compute_shader *cs)
+{
+   struct gallivm_state *gallivm = cs->gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef arg_types[6];
+   LLVMTypeRef func_type;
+   LLVMValueRef function;
+   LLVMValueRef context_ptr, thread_data_ptr, first_invocation;
+   LLVMValueRef block_id[3];
+   LLVMValueRef consts_ptr, num_consts_ptr;
+   LLVMValueRef block_size_ptr, grid_size_ptr;
+   LLVMValueRef invocation, block_xy, num_invocations, t;
+   LLVMBasicBlockRef block;
+   struct lp_bld_tgsi_system_values system_values;
+   struct lp_build_context uint_bld;
+   struct lp_build_mask_context mask;
+   struct lp_cs_iface iface;
+   struct lp_type cs_type;
+   char func_name[64];
+   unsigned i;
+
+   memset(&cs_type, 0, sizeof cs_type);
+   cs_type.floating = TRUE;
+   cs_type.sign = TRUE;
+   cs_type.width = 32;
+   cs_type.length = cs->vector_length;
+
+   lp_build_context_init(&uint_bld, gallivm, lp_uint_type(cs_type));
+
+   /*
+    * Generate the function prototype. Any change here must be reflected in
+    * lp_jit.h's lp_jit_cs_func function pointer type, and vice-versa.
+    */
+   util_snprintf(func_name, sizeof(func_name), "cs%u", cs->no);
+
+   arg_types[0] = cs->jit_context_ptr_type;       /* context */
+   arg_types[1] = int32_type;                     /* block_x */
+   arg_types[2] = int32_type;                     /* block_y */
+   arg_types[3] = int32_type;                     /* block_z */
+   arg_types[4] = int32_type;                     /* first_invocation */
+   arg_types[5] = cs->jit_thread_data_ptr_type;   /* per thread data */
+
+   func_type = LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
+                                arg_types, ARRAY_SIZE(arg_types), 0);
+
+   function = LLVMAddFunction(gallivm->module, func_name, func_type);
+   LLVMSetFunctionCallConv(function, LLVMCCallConv);
+   cs->function = function;
+
+   context_ptr      = LLVMGetParam(function, 0);
+   block_id[0]      = LLVMGetParam(function, 1);
+   block_id[1]      = LLVMGetParam(function, 2);
+   block_id[2]      = LLVMGetParam(function, 3);
+   first_invocation = LLVMGetParam(function, 4);
+   thread_data_ptr  = LLVMGetParam(function, 5);
+
+   lp_build_name(context_ptr, "context");
+   lp_build_name(block_id[0], "block_x");
+   lp_build_name(block_id[1], "block_y");
+   lp_build_name(block_id[2], "block_z");
+   lp_build_name(first_invocation, "first_invocation");
+   lp_build_name(thread_data_ptr, "thread_data");
+
+   /*
+    * Function body
+    */
+
+   block = LLVMAppendBasicBlockInContext(gallivm->context, function, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   memset(&system_values, 0, sizeof(system_values));
+
+   block_size_ptr = lp_jit_cs_context_block_size(gallivm, context_ptr);
+   grid_size_ptr = lp_jit_cs_context_grid_size(gallivm, context_ptr);
+   for (i = 0; i < 3; i++) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, i);
+      system_values.block_id[i] = block_id[i];
+      system_values.block_size[i] =
+         lp_build_array_get(gallivm, block_size_ptr, index);
+      system_values.grid_size[i] =
+         lp_build_array_get(gallivm, grid_size_ptr, index);
+   }
+
+   /*
+    * Linear invocation index of each lane, split into the thread id, and
+    * masked against the number of invocations in the block.
+    */
+   invocation = lp_build_broadcast_scalar(&uint_bld, first_invocation);
+   {
+      LLVMValueRef lanes[LP_MAX_VECTOR_LENGTH];
+      for (i = 0; i < cs_type.length; i++)
+         lanes[i] = lp_build_const_int32(gallivm, i);
+      invocation = LLVMBuildAdd(builder, invocation,
+                                LLVMConstVector(lanes, cs_type.length), "");
+   }
+
+   block_xy = LLVMBuildMul(builder, system_values.block_size[0],
+                           system_values.block_size[1], "");
+   num_invocations = LLVMBuildMul(builder, block_xy,
+                                  system_values.block_size[2], "");
+
+   t = lp_build_broadcast_scalar(&uint_bld, system_values.block_size[0]);
+   system_values.thread_id[0] = LLVMBuildURem(builder, invocation, t, "");
+   t = LLVMBuildUDiv(builder, invocation, t, "");
+   system_values.thread_id[1] =
+      LLVMBuildURem(builder, t,
+                    lp_build_broadcast_scalar(&uint_bld,
+                                              system_values.block_size[1]), "");
+   system_values.thread_id[2] =
+      LLVMBuildUDiv(builder, invocation,
+                    lp_build_broadcast_scalar(&uint_bld, block_xy), "");
+
+   lp_build_mask_begin(&mask, gallivm, cs_type,
+                       lp_build_cmp(&uint_bld, PIPE_FUNC_LESS, invocation,
+                                    lp_build_broadcast_scalar(&uint_bld,
+                                                              num_invocations)));
+
+   consts_ptr = lp_jit_cs_context_constants(gallivm, context_ptr);
+   num_consts_ptr = lp_jit_cs_context_num_constants(gallivm, context_ptr);
+
+   memset(&iface, 0, sizeof iface);
+   iface.base.fetch_buffer = cs_fetch_buffer;
+   iface.base.fetch_shared = cs_fetch_shared;
+   iface.base.emit_barrier = cs_emit_barrier;
+   iface.context_ptr = context_ptr;
+   iface.thread_data_ptr = thread_data_ptr;
+
+   lp_build_tgsi_soa(gallivm, cs->tokens, cs_type, &mask,
+                     consts_ptr, num_consts_ptr, &system_values,
+                     NULL, NULL, context_ptr, thread_data_ptr,
+                     NULL, &cs->info, NULL, &iface.base);
+
+   lp_build_mask_end(&mask);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, function);
+}
+
+
+static void *
+llvmpipe_create_compute_state(struct pipe_context *pipe,
+                              const struct pipe_compute_state *templ)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct lp_compute_shader *cs;
+   char module_name[64];
+
+   assert(templ->ir_type == PIPE_SHADER_IR_TGSI);
+
+   cs = CALLOC_STRUCT(lp_compute_shader);
+   if (!cs)
+      return NULL;
+
+   cs->no = cs_no++;
+   cs->tokens = tgsi_dup_tokens(templ->prog);
+   if (!cs->tokens)
+      goto fail;
+
+   tgsi_scan_shader(cs->tokens, &cs->info);
+   cs->req_local_mem = templ->req_local_mem;
+   cs->has_barrier = cs->info.opcode_count[TGSI_OPCODE_BARRIER] > 0;
+   cs->vector_length = MIN2(lp_native_vector_width / 32, 16);
+
+   if (LP_DEBUG & DEBUG_TGSI) {
+      debug_printf("llvmpipe: Create compute shader %p:\n", (void *)cs);
+      tgsi_dump(cs->tokens, 0);
+   }
+
+   util_snprintf(module_name, sizeof(module_name), "cs%u", cs->no);
+
+   cs->gallivm = gallivm_create(module_name, llvmpipe->context);
+   if (!cs->gallivm)
+      goto fail;
+
+   lp_jit_init_cs_types(cs);
+
+   generate_compute(llvmpipe, cs);
+
+   gallivm_compile_module(cs->gallivm);
+
+   cs->jit_function = (lp_jit_cs_func)
+      gallivm_jit_function(cs->gallivm, cs->function);
+
+   gallivm_free_ir(cs->gallivm);
+
+   return cs;
+
+fail:
+   FREE(cs->tokens);
+   FREE(cs);
+   return NULL;
+}
+
+
+static void
+llvmpipe_bind_compute_state(struct pipe_context *pipe, void *cs)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+
+   llvmpipe->cs = (struct lp_compute_shader *)cs;
+}
+
+
+static void
+llvmpipe_delete_compute_state(struct pipe_context *pipe, void *_cs)
+{
+   struct lp_compute_shader *cs = (struct lp_compute_shader *)_cs;
+
+   if (!cs)
+      return;
+
+   gallivm_destroy(cs->gallivm);
+   FREE(cs->tokens);
+   FREE(cs);
+}
+
+
+static void
+llvmpipe_set_shader_buffers(struct pipe_context *pipe,
+                            enum pipe_shader_type shader,
+                            unsigned start_slot, unsigned count,
+                            const struct pipe_shader_buffer *buffers)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   unsigned i;
+
+   assert(shader < PIPE_SHADER_TYPES);
+   assert(start_slot + count <= PIPE_MAX_SHADER_BUFFERS);
+
+   for (i = 0; i < count; i++) {
+      struct pipe_shader_buffer *dst = &llvmpipe->ssbos[shader][start_slot + i];
+
+      if (buffers && buffers[i].buffer) {
+         pipe_resource_reference(&dst->buffer, buffers[i].buffer);
+         dst->buffer_offset = buffers[i].buffer_offset;
+         dst->buffer_size = buffers[i].buffer_size;
+      }
+      else {
+         pipe_resource_reference(&dst->buffer, NULL);
+         dst->buffer_offset = 0;
+         dst->buffer_size = 0;
+      }
+   }
+}
+
+
+static void
+cs_update_jit_context(struct llvmpipe_context *lp,
+                      struct lp_jit_cs_context *jit_context)
+{
+   static const float fake_const_buf[4];
+   unsigned i;
+
+   for (i = 0; i < LP_MAX_TGSI_CONST_BUFFERS; i++) {
+      const struct pipe_constant_buffer *cb =
+         &lp->constants[PIPE_SHADER_COMPUTE][i];
+      const unsigned size = MIN2(cb->buffer_size, LP_MAX_TGSI_CONST_BUFFER_SIZE);
+      const ubyte *data = NULL;
+
+      if (cb->buffer)
+         data = (const ubyte *) llvmpipe_resource_data(cb->buffer);
+      else if (cb->user_buffer)
+         data = (const ubyte *) cb->user_buffer;
+
+      if (data) {
+         jit_context->constants[i] = (const float *)(data + cb->buffer_offset);
+         jit_context->num_constants[i] = size / (sizeof(float) * 4);
+      }
+      else {
+         jit_context->constants[i] = fake_const_buf;
+         jit_context->num_constants[i] = 0;
+      }
+   }
+
+   for (i = 0; i < PIPE_MAX_SHADER_BUFFERS; i++) {
+      const struct pipe_shader_buffer *sb = &lp->ssbos[PIPE_SHADER_COMPUTE][i];
+
+      if (sb->buffer && sb->buffer_offset < sb->buffer->width0) {
+         const uint8_t *data =
+            (const uint8_t *) llvmpipe_resource_data(sb->buffer);
+         jit_context->ssbos[i] = data + sb->buffer_offset;
+         jit_context->ssbo_sizes[i] =
+            MIN2(sb->buffer_size, sb->buffer->width0 - sb->buffer_offset);
+      }
+      else {
+         jit_context->ssbos[i] = (const uint8_t *) lp_dummy_ssbo;
+         jit_context->ssbo_sizes[i] = 0;
+      }
+   }
+}
+
+
+static void
+llvmpipe_launch_grid(struct pipe_context *pipe,
+                     const struct pipe_grid_info *info)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   struct lp_compute_shader *cs = llvmpipe->cs;
+   struct lp_cs_launch launch;
+   unsigned num_invocations;
+   unsigned i;
+
+   if (!cs || !cs->jit_function)
+      return;
+
+   /*
+    * The shader reads and writes the buffers from the rasterizer threads,
+    * so scenes still using them must be done first.
+    */
+   for (i = 0; i < PIPE_MAX_SHADER_BUFFERS; i++) {
+      struct pipe_resource *buffer =
+         llvmpipe->ssbos[PIPE_SHADER_COMPUTE][i].buffer;
+
+      if (buffer) {
+         llvmpipe_flush_resource(pipe, buffer, 0, FALSE, TRUE, FALSE,
+                                 "launch_grid");
+      }
+   }
+   if (info->indirect) {
+      llvmpipe_flush_resource(pipe, info->indirect, 0, TRUE, TRUE, FALSE,
+                              "launch_grid");
+   }
+
+   memset(&launch, 0, sizeof launch);
+   launch.cs = cs;
+
+   if (info->indirect) {
+      const uint8_t *data =
+         (const uint8_t *) llvmpipe_resource_data(info->indirect);
+      memcpy(launch.grid, data + info->indirect_offset, sizeof launch.grid);
+   }
+   else {
+      memcpy(launch.grid, info->grid, sizeof launch.grid);
+   }
+
+   num_invocations = info->block[0] * info->block[1] * info->block[2];
+   launch.num_blocks = (uint64_t)launch.grid[0] * launch.grid[1] *
+                       launch.grid[2];
+   if (!launch.num_blocks || !num_invocations)
+      return;
+
+   launch.num_vectors = DIV_ROUND_UP(num_invocations, cs->vector_length);
+
+   cs_update_jit_context(llvmpipe, &launch.jit_context);
+   for (i = 0; i < 3; i++) {
+      launch.jit_context.block_size[i] = info->block[i];
+      launch.jit_context.grid_size[i] = launch.grid[i];
+   }
+
+   if (llvmpipe->active_statistics_queries) {
+      llvmpipe->pipeline_statistics.cs_invocations +=
+         launch.num_blocks * num_invocations;
+   }
+
+   /*
+    * The rasterizer threads are shared by all the contexts of the screen,
+    * and must not be rasterizing a scene meanwhile.
+    */
+   pipe_mutex_lock(screen->rast_mutex);
+
+   if (cs_prepare_exec(llvmpipe, cs, lp_rast_num_tasks(screen->rast),
+                       launch.num_vectors)) {
+      launch.exec = llvmpipe->cs_exec;
+      lp_rast_run_tasks(screen->rast, cs_run_task, &launch);
+   }
+   else {
+      debug_printf("llvmpipe: out of memory for compute shader\n");
+   }
+
+   pipe_mutex_unlock(screen->rast_mutex);
+}
+
+
+void
+llvmpipe_init_cs_funcs(struct llvmpipe_context *llvmpipe)
+{
+   llvmpipe->pipe.create_compute_state = llvmpipe_create_compute_state;
+   llvmpipe->pipe.bind_compute_state = llvmpipe_bind_compute_state;
+   llvmpipe->pipe.delete_compute_state = llvmpipe_delete_compute_state;
+   llvmpipe->pipe.set_shader_buffers = llvmpipe_set_shader_buffers;
+   llvmpipe->pipe.launch_grid = llvmpipe_launch_grid;
+}
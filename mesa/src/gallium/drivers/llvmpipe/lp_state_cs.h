@@ -0,0 +1,84 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Compute shaders.
+ */
+
+#ifndef LP_STATE_CS_H
+#define LP_STATE_CS_H
+
+#include "pipe/p_config.h"
+#include "pipe/p_state.h"
+#include "tgsi/tgsi_scan.h"
+#include "gallivm/lp_bld.h"
+#include "lp_jit.h"
+
+
+/*
+ * Barriers need the invocations of a block to be suspended and resumed,
+ * which is done with ucontext fibers.
+ */
+#if (defined(PIPE_OS_LINUX) && defined(__GLIBC__)) || defined(PIPE_OS_BSD)
+#define LP_HAVE_COMPUTE 1
+#else
+#define LP_HAVE_COMPUTE 0
+#endif
+
+
+struct llvmpipe_context;
+struct lp_cs_exec;
+
+
+struct lp_compute_shader
+{
+   struct tgsi_token *tokens;
+   struct tgsi_shader_info info;
+
+   unsigned no;
+   unsigned req_local_mem;
+   boolean has_barrier;
+
+   /** Invocations run by one call of jit_function */
+   unsigned vector_length;
+
+   struct gallivm_state *gallivm;
+   LLVMTypeRef jit_context_ptr_type;
+   LLVMTypeRef jit_thread_data_ptr_type;
+   LLVMValueRef function;
+   lp_jit_cs_func jit_function;
+};
+
+
+void
+llvmpipe_init_cs_funcs(struct llvmpipe_context *llvmpipe);
+
+void
+llvmpipe_cleanup_cs(struct llvmpipe_context *llvmpipe);
+
+
+#endif /* LP_STATE_CS_H */
@@ -67,12 +67,19 @@
 #include "util/u_string.h"
 #include "util/simple_list.h"
 #include "util/u_dual_blend.h"
+#include "util/u_hash.h"
+#include "util/u_atomic.h"
+#include "util/u_queue.h"
+#include "util/ralloc.h"
+#include "cso_cache/cso_hash.h"
 #include "os/os_time.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
 #include "tgsi/tgsi_dump.h"
 #include "tgsi/tgsi_scan.h"
 #include "tgsi/tgsi_parse.h"
+#include "nir/nir_to_tgsi_info.h"
+#include "compiler/nir/nir.h"
 #include "gallivm/lp_bld_type.h"
 #include "gallivm/lp_bld_const.h"
 #include "gallivm/lp_bld_conv.h"
@@ -80,6 +87,7 @@
 #include "gallivm/lp_bld_intr.h"
 #include "gallivm/lp_bld_logic.h"
 #include "gallivm/lp_bld_tgsi.h"
+#include "gallivm/lp_bld_nir.h"
 #include "gallivm/lp_bld_swizzle.h"
 #include "gallivm/lp_bld_flow.h"
 #include "gallivm/lp_bld_debug.h"
@@ -99,6 +107,7 @@
 #include "lp_state.h"
 #include "lp_tex_sample.h"
 #include "lp_flush.h"
+#include "lp_screen.h"
 #include "lp_state_fs.h"
 #include "lp_rast.h"
 
@@ -106,7 +115,6 @@
 /** Fragment shader number (for debugging) */
 static unsigned fs_no = 0;
 
-
 /**
  * Expand the relevant bits of mask_input to a n*4-dword mask for the
  * n*four pixels in n 2x2 quads.  This will set the n*four elements of the
@@ -473,11 +481,20 @@ generate_fs_loop(struct gallivm_state *gallivm,
    lp_build_interp_soa_update_inputs_dyn(interp, gallivm, loop_state.counter);
 
    /* Build the actual shader */
-   lp_build_tgsi_soa(gallivm, tokens, type, &mask,
-                     consts_ptr, num_consts_ptr, &system_values,
-                     interp->inputs,
-                     outputs, context_ptr, thread_data_ptr,
-                     sampler, &shader->info.base, NULL);
+   if (shader->nir) {
+      lp_build_nir_soa(gallivm, shader->nir, type, &mask,
+                       consts_ptr, num_consts_ptr,
+                       interp->inputs,
+                       outputs, context_ptr, thread_data_ptr,
+                       sampler, &shader->info.base);
+   }
+   else {
+      lp_build_tgsi_soa(gallivm, tokens, type, &mask,
+                        consts_ptr, num_consts_ptr, &system_values,
+                        interp->inputs,
+                        outputs, context_ptr, thread_data_ptr,
+                        sampler, &shader->info.base, NULL, NULL);
+   }
 
    /* Alpha test */
    if (key->alpha.enabled) {
@@ -2214,7 +2231,9 @@ generate_fragment(struct llvmpipe_context *lp,
    LLVMValueRef fs_out_color[PIPE_MAX_COLOR_BUFS][TGSI_NUM_CHANNELS][16 / 4];
    LLVMValueRef function;
    LLVMValueRef facing;
+   struct lp_type fs_blend_type;
    unsigned num_fs;
+   unsigned num_blend;
    unsigned i;
    unsigned chan;
    unsigned cbuf;
@@ -2339,7 +2358,7 @@ generate_fragment(struct llvmpipe_context *lp,
 
    num_fs = 16 / fs_type.length; /* number of loops per 4x4 stamp */
    /* for 1d resources only run "upper half" of stamp */
-   if (key->resource_1d)
+   if (key->resource_1d && num_fs > 1)
       num_fs /= 2;
 
    {
@@ -2379,6 +2398,16 @@ generate_fragment(struct llvmpipe_context *lp,
          else {
             mask = lp_build_const_int_vec(gallivm, fs_type, ~0);
          }
+         if (key->resource_1d && fs_type.length == 16) {
+            /* a single loop covers the whole stamp, mask off the lower half */
+            LLVMValueRef half_mask[16];
+            unsigned j;
+
+            for (j = 0; j < 16; j++) {
+               half_mask[j] = lp_build_const_int32(gallivm, j < 8 ? ~0 : 0);
+            }
+            mask = LLVMBuildAnd(builder, mask, LLVMConstVector(half_mask, 16), "");
+         }
          LLVMBuildStore(builder, mask, mask_ptr);
       }
 
@@ -2425,6 +2454,38 @@ generate_fragment(struct llvmpipe_context *lp,
 
    sampler->destroy(sampler);
 
+   /*
+    * The blend code only handles up to 8-wide vectors, so with 16-wide
+    * vectors split the outputs of the whole 4x4 stamp into its upper and
+    * lower half (quads 0,1 and 2,3), which is what an 8-wide shader would
+    * have produced with two loops.
+    */
+   fs_blend_type = fs_type;
+   num_blend = num_fs;
+   if (fs_type.length == 16) {
+      unsigned num_outputs = dual_source_blend ? MAX2(key->nr_cbufs, 2) :
+                                                 key->nr_cbufs;
+      LLVMTypeRef half_ptr_type;
+
+      fs_blend_type.length = 8;
+      num_blend = key->resource_1d ? 1 : 2;
+      half_ptr_type = LLVMPointerType(lp_build_vec_type(gallivm, fs_blend_type), 0);
+
+      for (i = num_blend; i > 0; i--) {
+         LLVMValueRef indexi = lp_build_const_int32(gallivm, i - 1);
+
+         fs_mask[i - 1] = lp_build_extract_range(gallivm, fs_mask[0], (i - 1) * 8, 8);
+         for (cbuf = 0; cbuf < num_outputs; cbuf++) {
+            for (chan = 0; chan < TGSI_NUM_CHANNELS; ++chan) {
+               LLVMValueRef ptr = fs_out_color[cbuf][chan][0];
+               ptr = LLVMBuildBitCast(builder, ptr, half_ptr_type, "");
+               fs_out_color[cbuf][chan][i - 1] =
+                  LLVMBuildGEP(builder, ptr, &indexi, 1, "");
+            }
+         }
+      }
+   }
+
    /* Loop over color outputs / color buffers to do blending.
     */
    for(cbuf = 0; cbuf < key->nr_cbufs; cbuf++) {
@@ -2451,7 +2512,7 @@ generate_fragment(struct llvmpipe_context *lp,
 
          generate_unswizzled_blend(gallivm, cbuf, variant,
                                    key->cbuf_format[cbuf],
-                                   num_fs, fs_type, fs_mask, fs_out_color,
+                                   num_blend, fs_blend_type, fs_mask, fs_out_color,
                                    context_ptr, color_ptr, stride,
                                    partial_mask, do_branch);
       }
@@ -2559,7 +2620,10 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
 {
    debug_printf("llvmpipe: Fragment shader #%u variant #%u:\n", 
                 variant->shader->no, variant->no);
-   tgsi_dump(variant->shader->base.tokens, 0);
+   if (variant->shader->base.tokens)
+      tgsi_dump(variant->shader->base.tokens, 0);
+   else
+      nir_print_shader(variant->shader->nir, stderr);
    dump_fs_variant_key(&variant->key);
    debug_printf("variant->opaque = %u\n", variant->opaque);
    debug_printf("\n");
@@ -2567,36 +2631,29 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
 
 
 /**
- * Generate a new fragment shader variant from the shader code and
- * other state indicated by the key.
+ * Create a new fragment shader variant object for the given key, without
+ * any code yet.
  */
 static struct lp_fragment_shader_variant *
-generate_variant(struct llvmpipe_context *lp,
-                 struct lp_fragment_shader *shader,
-                 const struct lp_fragment_shader_variant_key *key)
+create_variant(struct llvmpipe_context *lp,
+               struct lp_fragment_shader *shader,
+               const struct lp_fragment_shader_variant_key *key)
 {
    struct lp_fragment_shader_variant *variant;
    const struct util_format_description *cbuf0_format_desc;
    boolean fullcolormask;
-   char module_name[64];
 
    variant = CALLOC_STRUCT(lp_fragment_shader_variant);
    if (!variant)
       return NULL;
 
-   util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
-                 shader->no, shader->variants_created);
-
-   variant->gallivm = gallivm_create(module_name, lp->context);
-   if (!variant->gallivm) {
-      FREE(variant);
-      return NULL;
-   }
-
+   variant->lp = lp;
    variant->shader = shader;
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
    variant->no = shader->variants_created++;
+   pipe_mutex_init(variant->mutex);
+   util_queue_fence_init(&variant->fence);
 
    memcpy(&variant->key, key, shader->variant_key_size);
 
@@ -2627,45 +2684,188 @@ generate_variant(struct llvmpipe_context *lp,
       variant->ps_inv_multiplier = 1;
    }
 
+   return variant;
+}
+
+
+/**
+ * Generate and compile the code of a fragment shader variant.
+ *
+ * The code is built into a scratch copy of the variant, as both a fast
+ * unoptimized build and the optimized build may be in flight at the same
+ * time on different threads, each in its own LLVM context.  The result is
+ * then installed into the variant, unless optimized code is there already.
+ */
+static boolean
+build_variant(struct lp_fragment_shader_variant *variant,
+              LLVMContextRef context,
+              boolean fast)
+{
+   struct llvmpipe_context *lp = variant->lp;
+   struct lp_fragment_shader *shader = variant->shader;
+   struct lp_fragment_shader_variant *build;
+   char module_name[64];
+
+   build = CALLOC_STRUCT(lp_fragment_shader_variant);
+   if (!build)
+      return FALSE;
+
+   memcpy(&build->key, &variant->key, shader->variant_key_size);
+   build->opaque = variant->opaque;
+   build->ps_inv_multiplier = variant->ps_inv_multiplier;
+   build->shader = shader;
+   build->no = variant->no;
+
+   util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u%s",
+                 shader->no, variant->no, fast ? "_fast" : "");
+
+   build->gallivm = gallivm_create(module_name, context);
+   if (!build->gallivm) {
+      FREE(build);
+      return FALSE;
+   }
+   build->gallivm->fast_compile = fast;
+
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
-      lp_debug_fs_variant(variant);
+      lp_debug_fs_variant(build);
    }
 
-   lp_jit_init_types(variant);
+   lp_jit_init_types(build);
    
-   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
+   generate_fragment(lp, shader, build, RAST_EDGE_TEST);
 
-   if (variant->jit_function[RAST_WHOLE] == NULL) {
-      if (variant->opaque) {
-         /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
-      }
+   if (build->opaque) {
+      /* Specialized shader, which doesn't need to read the color buffer. */
+      generate_fragment(lp, shader, build, RAST_WHOLE);
    }
 
    /*
     * Compile everything
     */
 
-   gallivm_compile_module(variant->gallivm);
+   gallivm_compile_module(build->gallivm);
 
-   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+   build->nr_instrs += lp_build_count_ir_module(build->gallivm->module);
 
-   if (variant->function[RAST_EDGE_TEST]) {
-      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
-            gallivm_jit_function(variant->gallivm,
-                                 variant->function[RAST_EDGE_TEST]);
+   if (build->function[RAST_EDGE_TEST]) {
+      build->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
+            gallivm_jit_function(build->gallivm,
+                                 build->function[RAST_EDGE_TEST]);
    }
 
-   if (variant->function[RAST_WHOLE]) {
-         variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
-               gallivm_jit_function(variant->gallivm,
-                                    variant->function[RAST_WHOLE]);
-   } else if (!variant->jit_function[RAST_WHOLE]) {
-      variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
+   if (build->function[RAST_WHOLE]) {
+         build->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
+               gallivm_jit_function(build->gallivm,
+                                    build->function[RAST_WHOLE]);
+   } else {
+      build->jit_function[RAST_WHOLE] = build->jit_function[RAST_EDGE_TEST];
    }
 
-   gallivm_free_ir(variant->gallivm);
+   build->code_size = gallivm_code_size(build->gallivm);
+
+   gallivm_free_ir(build->gallivm);
+
+   /*
+    * Install the code.  The rasterizer threads may be running the variant
+    * concurrently, but they will either see the old or the new function
+    * pointers, which do the same thing.
+    */
+   pipe_mutex_lock(variant->mutex);
+   if (fast) {
+      variant->gallivm = build->gallivm;
+   } else {
+      variant->gallivm_opt = build->gallivm;
+   }
+   if (!variant->optimized) {
+      variant->jit_function[RAST_EDGE_TEST] = build->jit_function[RAST_EDGE_TEST];
+      variant->jit_function[RAST_WHOLE] = build->jit_function[RAST_WHOLE];
+      variant->optimized = !fast;
+   }
+   variant->nr_instrs += build->nr_instrs;
+   variant->code_size += build->code_size;
+   pipe_mutex_unlock(variant->mutex);
+
+   p_atomic_add(&lp->nr_fs_instrs, build->nr_instrs);
+   p_atomic_add(&lp->fs_code_size, build->code_size);
+
+   FREE(build);
+   return TRUE;
+}
+
+
+/**
+ * util_queue job compiling the optimized code of a variant in the
+ * background, in a private LLVM context.
+ */
+static void
+build_variant_job(void *data, int thread_index)
+{
+   struct lp_fragment_shader_variant *variant = data;
+
+   variant->context = LLVMContextCreate();
+   if (variant->context)
+      build_variant(variant, variant->context, FALSE);
+}
+
+
+/**
+ * Wait for the background compilation of a variant to finish, but no
+ * longer than the LP_COMPILE_WAIT deadline.
+ * \return  whether the optimized code is ready
+ */
+static boolean
+wait_variant(struct llvmpipe_context *lp,
+             struct lp_fragment_shader_variant *variant)
+{
+   boolean optimized;
+
+   util_queue_job_wait_timeout(&variant->fence,
+                               llvmpipe_screen(lp->pipe.screen)->compile_wait);
+
+   pipe_mutex_lock(variant->mutex);
+   optimized = variant->optimized;
+   pipe_mutex_unlock(variant->mutex);
+
+   return optimized;
+}
+
+
+/**
+ * Generate a new fragment shader variant from the shader code and
+ * other state indicated by the key.
+ *
+ * With background compilation, the optimized code is compiled on the
+ * compile queue.  If it isn't ready by the deadline, unoptimized code is
+ * compiled here and used until the optimized code replaces it.
+ */
+static struct lp_fragment_shader_variant *
+generate_variant(struct llvmpipe_context *lp,
+                 struct lp_fragment_shader *shader,
+                 const struct lp_fragment_shader_variant_key *key)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   struct lp_fragment_shader_variant *variant;
+
+   variant = create_variant(lp, shader, key);
+   if (!variant)
+      return NULL;
+
+   if (util_queue_is_initialized(&screen->compile_queue)) {
+      variant->async = TRUE;
+      util_queue_add_job(&screen->compile_queue, variant, &variant->fence,
+                         build_variant_job, NULL);
+
+      if (!wait_variant(lp, variant))
+         build_variant(variant, lp->context, TRUE);
+   }
+   else {
+      build_variant(variant, lp->context, FALSE);
+   }
+
+   if (!variant->jit_function[RAST_EDGE_TEST]) {
+      llvmpipe_remove_shader_variant(lp, variant);
+      return NULL;
+   }
 
    return variant;
 }
@@ -2685,22 +2885,52 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
    if (!shader)
       return NULL;
 
+   shader->variants_hash = cso_hash_create();
+   if (!shader->variants_hash) {
+      FREE(shader);
+      return NULL;
+   }
+
    shader->no = fs_no++;
    make_empty_list(&shader->variants);
 
-   /* get/save the summary info for this shader */
-   lp_build_tgsi_info(templ->tokens, &shader->info);
+   if (templ->type == PIPE_SHADER_IR_NIR) {
+      /* The state tracker hands the shader over to us. */
+      shader->nir = templ->ir.nir;
+      nir_tgsi_scan_shader(shader->nir, &shader->info.base);
 
-   /* we need to keep a local copy of the tokens */
-   shader->base.tokens = tgsi_dup_tokens(templ->tokens);
+      /* There is no TGSI to fall back to, so this has to work. */
+      if (!lp_build_nir_prepare(shader->nir)) {
+         debug_printf("llvmpipe: can't translate NIR fragment shader\n");
+         ralloc_free(shader->nir);
+         cso_hash_delete(shader->variants_hash);
+         FREE(shader);
+         return NULL;
+      }
+   }
+   else {
+      /* get/save the summary info for this shader */
+      lp_build_tgsi_info(templ->tokens, &shader->info);
+
+      /* we need to keep a local copy of the tokens */
+      shader->base.tokens = tgsi_dup_tokens(templ->tokens);
+   }
 
    shader->draw_data = draw_create_fragment_shader(llvmpipe->draw, templ);
    if (shader->draw_data == NULL) {
+      cso_hash_delete(shader->variants_hash);
+      ralloc_free(shader->nir);
       FREE((void *) shader->base.tokens);
       FREE(shader);
       return NULL;
    }
 
+   /* Shaders the NIR translation can't handle stay on the TGSI path. */
+   if (!shader->nir && llvmpipe_screen(pipe->screen)->use_nir) {
+      shader->nir = lp_build_nir_from_tgsi(shader->base.tokens,
+                                           &shader->info.base);
+   }
+
    nr_samplers = shader->info.base.file_max[TGSI_FILE_SAMPLER] + 1;
    nr_sampler_views = shader->info.base.file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
 
@@ -2749,7 +2979,10 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
       unsigned attrib;
       debug_printf("llvmpipe: Create fragment shader #%u %p:\n",
                    shader->no, (void *) shader);
-      tgsi_dump(templ->tokens, 0);
+      if (templ->type == PIPE_SHADER_IR_NIR)
+         nir_print_shader(shader->nir, stderr);
+      else
+         tgsi_dump(templ->tokens, 0);
       debug_printf("usage masks:\n");
       for (attrib = 0; attrib < shader->info.base.num_inputs; ++attrib) {
          unsigned usage_mask = shader->info.base.input_usage_mask[attrib];
@@ -2802,16 +3035,44 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                    lp->nr_fs_variants);
    }
 
-   gallivm_destroy(variant->gallivm);
+   if (variant->async)
+      util_queue_job_wait(&variant->fence);
+
+   if (variant->gallivm)
+      gallivm_destroy(variant->gallivm);
+   if (variant->gallivm_opt)
+      gallivm_destroy(variant->gallivm_opt);
+   if (variant->context)
+      LLVMContextDispose(variant->context);
 
-   /* remove from shader's list */
+   p_atomic_add(&lp->nr_fs_instrs, 0 - variant->nr_instrs);
+   p_atomic_add(&lp->fs_code_size, 0 - variant->code_size);
+
+   util_queue_fence_destroy(&variant->fence);
+   pipe_mutex_destroy(variant->mutex);
+
+   /* Variants which failed to compile were never added to the lists */
+   if (!variant->list_item_local.next) {
+      FREE(variant);
+      return;
+   }
+
+   /* remove from shader's list and hash table */
    remove_from_list(&variant->list_item_local);
    variant->shader->variants_cached--;
+   {
+      struct cso_hash_iter iter =
+         cso_hash_find(variant->shader->variants_hash, variant->hash);
+      while (cso_hash_iter_data(iter) != variant) {
+         assert(!cso_hash_iter_is_null(iter));
+         iter = cso_hash_iter_next(iter);
+      }
+      cso_hash_erase(variant->shader->variants_hash, iter);
+   }
 
    /* remove from context's list */
    remove_from_list(&variant->list_item_global);
    lp->nr_fs_variants--;
-   lp->nr_fs_instrs -= variant->nr_instrs;
 
    FREE(variant);
 }
@@ -2845,6 +3106,8 @@ llvmpipe_delete_fs_state(struct pipe_context *pipe, void *fs)
    draw_delete_fragment_shader(llvmpipe->draw, shader->draw_data);
 
    assert(shader->variants_cached == 0);
+   cso_hash_delete(shader->variants_hash);
+   ralloc_free(shader->nir);
    FREE((void *) shader->base.tokens);
    FREE(shader);
 }
@@ -2894,7 +3157,7 @@ llvmpipe_set_constant_buffer(struct pipe_context *pipe,
       draw_set_mapped_constant_buffer(llvmpipe->draw, shader,
                                       index, data, size);
    }
-   else {
+   else if (shader == PIPE_SHADER_FRAGMENT) {
       llvmpipe->dirty |= LP_NEW_FS_CONSTANTS;
    }
 
@@ -3104,6 +3367,8 @@ make_variant_key(struct llvmpipe_context *lp,
          if(shader->info.base.file_mask[TGSI_FILE_SAMPLER_VIEW] & (1 << i)) {
             lp_sampler_static_texture_state(&key->state[i].texture_state,
                                             lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
+            key->state[i].texture_state.tiled =
+               llvmpipe_sampler_view_is_tiled(lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
          }
       }
    }
@@ -3113,6 +3378,8 @@ make_variant_key(struct llvmpipe_context *lp,
          if(shader->info.base.file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
             lp_sampler_static_texture_state(&key->state[i].texture_state,
                                             lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
+            key->state[i].texture_state.tiled =
+               llvmpipe_sampler_view_is_tiled(lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
          }
       }
    }
@@ -3130,18 +3397,21 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
    struct lp_fragment_shader *shader = lp->fs;
    struct lp_fragment_shader_variant_key key;
    struct lp_fragment_shader_variant *variant = NULL;
-   struct lp_fs_variant_list_item *li;
+   struct cso_hash_iter iter;
+   unsigned hash;
 
    make_variant_key(lp, shader, &key);
-
-   /* Search the variants for one which matches the key */
-   li = first_elem(&shader->variants);
-   while(!at_end(&shader->variants, li)) {
-      if(memcmp(&li->base->key, &key, shader->variant_key_size) == 0) {
-         variant = li->base;
+   hash = util_hash_crc32(&key, shader->variant_key_size);
+
+   /* Look up the variants with a matching key hash */
+   iter = cso_hash_find(shader->variants_hash, hash);
+   while (!cso_hash_iter_is_null(iter) && cso_hash_iter_key(iter) == hash) {
+      struct lp_fragment_shader_variant *v = cso_hash_iter_data(iter);
+      if (memcmp(&v->key, &key, shader->variant_key_size) == 0) {
+         variant = v;
          break;
       }
-      li = next_elem(li);
+      iter = cso_hash_iter_next(iter);
    }
 
    if (variant) {
@@ -3153,24 +3423,25 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
    else {
       /* variant not found, create it now */
       int64_t t0, t1, dt;
-      unsigned i;
-      unsigned variants_to_cull;
 
       if (0) {
-         debug_printf("%u variants,\t%u instrs,\t%u instrs/variant\n",
+         debug_printf("%u variants,\t%u instrs,\t%u instrs/variant,\t%u bytes\n",
                       lp->nr_fs_variants,
                       lp->nr_fs_instrs,
-                      lp->nr_fs_variants ? lp->nr_fs_instrs / lp->nr_fs_variants : 0);
+                      lp->nr_fs_variants ? lp->nr_fs_instrs / lp->nr_fs_variants : 0,
+                      (unsigned) lp->fs_code_size);
       }
 
-      /* First, check if we've exceeded the max number of shader variants.
-       * If so, free 25% of them (the least recently used ones).
+      /* First, check if we've exceeded the memory budget for JIT'ed code.
+       * If so, free the least recently used variants until we're down to
+       * 75% of it, so that we don't have to do this again on every new
+       * variant.
        */
-      variants_to_cull = lp->nr_fs_variants >= LP_MAX_SHADER_VARIANTS ? LP_MAX_SHADER_VARIANTS / 4 : 0;
-
-      if (variants_to_cull ||
+      if (lp->fs_code_size >= lp->max_fs_code_size ||
           lp->nr_fs_instrs >= LP_MAX_SHADER_INSTRUCTIONS) {
          struct pipe_context *pipe = &lp->pipe;
+         size_t target_code_size = lp->max_fs_code_size / 4 * 3;
+         unsigned target_instrs = LP_MAX_SHADER_INSTRUCTIONS / 4 * 3;
 
          /*
           * XXX: we need to flush the context until we have some sort of
@@ -3180,12 +3451,13 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
          llvmpipe_finish(pipe, __FUNCTION__);
 
          /*
-          * We need to re-check lp->nr_fs_variants because an arbitrarliy large
+          * We need to re-check the totals because an arbitrarliy large
           * number of shader variants (potentially all of them) could be
           * pending for destruction on flush.
           */
 
-         for (i = 0; i < variants_to_cull || lp->nr_fs_instrs >= LP_MAX_SHADER_INSTRUCTIONS; i++) {
+         while (lp->fs_code_size > target_code_size ||
+                lp->nr_fs_instrs > target_instrs) {
             struct lp_fs_variant_list_item *item;
             if (is_empty_list(&lp->fs_variants_list)) {
                break;
@@ -3204,15 +3476,16 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       variant = generate_variant(lp, shader, &key);
       t1 = os_time_get();
       dt = t1 - t0;
-      LP_COUNT_ADD(llvm_compile_time, dt);
-      LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+      LP_COUNT_ADD(&lp->counters, llvm_compile_time, dt);
+      LP_COUNT_ADD(&lp->counters, nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
 
-      /* Put the new variant into the list */
+      /* Put the new variant into the lists and the hash table */
       if (variant) {
+         variant->hash = hash;
+         cso_hash_insert(shader->variants_hash, hash, variant);
          insert_at_head(&shader->variants, &variant->list_item_local);
          insert_at_head(&lp->fs_variants_list, &variant->list_item_global);
          lp->nr_fs_variants++;
-         lp->nr_fs_instrs += variant->nr_instrs;
          shader->variants_cached++;
       }
    }
@@ -32,6 +32,8 @@
 
 #include "pipe/p_compiler.h"
 #include "pipe/p_state.h"
+#include "os/os_thread.h"
+#include "util/u_queue.h"
 #include "tgsi/tgsi_scan.h" /* for tgsi_shader_info */
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
@@ -39,6 +41,9 @@
 
 
 struct tgsi_token;
+struct cso_hash;
+struct nir_shader;
+struct llvmpipe_context;
 struct lp_fragment_shader;
 
 
@@ -96,12 +101,25 @@ struct lp_fs_variant_list_item
 struct lp_fragment_shader_variant
 {
    struct lp_fragment_shader_variant_key key;
+   unsigned hash;   /**< hash of the key, see lp_fragment_shader::variants_hash */
 
    boolean opaque;
    uint8_t ps_inv_multiplier;
 
    struct gallivm_state *gallivm;
 
+   /*
+    * Background compilation (see LP_COMPILE_THREADS).  The optimized code
+    * is built in its own LLVM context and replaces the unoptimized code in
+    * gallivm/jit_function once ready.  Protected by mutex.
+    */
+   boolean async;
+   boolean optimized;
+   struct util_queue_fence fence;
+   LLVMContextRef context;
+   struct gallivm_state *gallivm_opt;
+   pipe_mutex mutex;
+
    LLVMTypeRef jit_context_ptr_type;
    LLVMTypeRef jit_thread_data_ptr_type;
    LLVMTypeRef jit_linear_context_ptr_type;
@@ -113,8 +131,12 @@ struct lp_fragment_shader_variant
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
+   /* Size of the JIT'ed code and data, in bytes */
+   size_t code_size;
+
    struct lp_fs_variant_list_item list_item_global, list_item_local;
    struct lp_fragment_shader *shader;
+   struct llvmpipe_context *lp;
 
    /* For debugging/profiling purposes */
    unsigned no;
@@ -130,8 +152,14 @@ struct lp_fragment_shader
 
    struct lp_fs_variant_list_item variants;
 
+   /** The variants again, indexed by the hash of their key */
+   struct cso_hash *variants_hash;
+
    struct draw_fragment_shader *draw_data;
 
+   /** The shader in NIR form if LP_NIR is set and it can be translated */
+   struct nir_shader *nir;
+
    /* For debugging/profiling purposes */
    unsigned variant_key_size;
    unsigned no;
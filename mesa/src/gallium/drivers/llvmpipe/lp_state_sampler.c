@@ -140,6 +140,13 @@ llvmpipe_set_sampler_views(struct pipe_context *pipe,
       }
       pipe_sampler_view_reference(&llvmpipe->sampler_views[shader][start + i],
                                   views[i]);
+
+      /* draw's samplers only handle linear textures */
+      if (views[i] && views[i]->texture &&
+          llvmpipe_resource_is_texture(views[i]->texture) &&
+          (shader == PIPE_SHADER_VERTEX || shader == PIPE_SHADER_GEOMETRY)) {
+         llvmpipe_resource_untile(pipe, views[i]->texture);
+      }
    }
 
    /* find highest non-null sampler_views[] entry */
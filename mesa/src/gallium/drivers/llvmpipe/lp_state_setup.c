@@ -738,9 +738,7 @@ generate_setup_variant(struct lp_setup_variant_key *key,
 
    builder = gallivm->builder;
 
-   if (LP_DEBUG & DEBUG_COUNTERS) {
-      t0 = os_time_get();
-   }
+   t0 = os_time_get();
 
    memcpy(&variant->key, key, key->size);
    variant->list_item_global.base = variant;
@@ -811,11 +809,9 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    /*
     * Update timing information:
     */
-   if (LP_DEBUG & DEBUG_COUNTERS) {
-      t1 = os_time_get();
-      LP_COUNT_ADD(llvm_compile_time, t1 - t0);
-      LP_COUNT_ADD(nr_llvm_compiles, 1);
-   }
+   t1 = os_time_get();
+   LP_COUNT_ADD(&lp->counters, llvm_compile_time, t1 - t0);
+   LP_COUNT_ADD(&lp->counters, nr_llvm_compiles, 1);
 
    return variant;
 
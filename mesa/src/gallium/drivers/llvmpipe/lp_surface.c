@@ -141,6 +141,11 @@ llvmpipe_create_surface(struct pipe_context *pipe,
       }
    }
 
+   if (llvmpipe_resource_is_texture(pt)) {
+      /* rendering only knows about the linear layout */
+      llvmpipe_resource_untile(pipe, pt);
+   }
+
    ps = CALLOC_STRUCT(pipe_surface);
    if (ps) {
       pipe_reference_init(&ps->reference, 1);
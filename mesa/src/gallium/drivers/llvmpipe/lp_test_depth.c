@@ -0,0 +1,388 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Unit tests for the swizzled depth/stencil load and store of the
+ * fragment shader.
+ *
+ * A 4x4 block of the depth buffer is loaded into vectors of 2x2 quads,
+ * and quads are stored back to it, with 4, 8 and 16 wide vectors.  LLVM
+ * splits the 16-wide vectors used with LP_NATIVE_VECTOR_WIDTH=512 on CPUs
+ * without AVX-512, so all the widths are checked on any host.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "util/u_pointer.h"
+#include "util/u_format.h"
+#include "gallivm/lp_bld.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_type.h"
+
+#include "lp_bld_depth.h"
+#include "lp_test.h"
+
+
+#define BLOCK_STRIDE 64
+
+
+typedef void (*depth_func_t)(void *depth, int32_t stride, int32_t loop,
+                             uint32_t *z, uint32_t *s);
+
+
+static const enum pipe_format formats[] = {
+   PIPE_FORMAT_Z16_UNORM,
+   PIPE_FORMAT_Z24_UNORM_S8_UINT,
+   PIPE_FORMAT_Z32_FLOAT,
+   PIPE_FORMAT_Z32_FLOAT_S8X24_UINT,
+};
+
+static const unsigned lengths[] = { 4, 8, 16 };
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "format\t"
+           "length\t"
+           "1d\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              const struct util_format_description *desc,
+              unsigned length, boolean is_1d,
+              boolean success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+   fprintf(fp, "%s\t", desc->short_name);
+   fprintf(fp, "%u\t", length);
+   fprintf(fp, "%u\n", is_1d);
+
+   fflush(fp);
+}
+
+
+/**
+ * Position in the 4x4 block of element i of the vector for the given
+ * iteration of the fragment shader loop.  Returns the row among those
+ * accessed by the iteration, 1D resources only have the first one.
+ */
+static unsigned
+lane_position(unsigned length, unsigned loop, unsigned i,
+              unsigned *x, unsigned *y)
+{
+   unsigned p;
+
+   if (length == 4) {
+      /* one 2x2 quad per iteration */
+      *x = (loop & 1) * 2 + (i & 1);
+      *y = (loop & 2) + i / 2;
+      return i / 2;
+   }
+
+   /* quads of 2x4 or 4x4 rows, row-major */
+   p = (i & 1) + (i & 2) * 2 + (i & 4) / 2 + (i & 8);
+   *x = p % 4;
+   *y = p / 4 + (length == 8 ? loop * 2 : 0);
+   return p / 4;
+}
+
+
+/* Texel values which don't change when truncated to 16 bits */
+static uint32_t
+z_value(unsigned x, unsigned y)
+{
+   return 0x3f80a000 | (y << 4) | x;
+}
+
+static uint32_t
+s_value(unsigned x, unsigned y)
+{
+   return 0x00000500 | (y << 4) | x;
+}
+
+
+static void
+write_texel(uint8_t *block, unsigned bytes, unsigned x, unsigned y,
+            uint32_t z, uint32_t s)
+{
+   uint8_t *texel = block + y * BLOCK_STRIDE + x * bytes;
+
+   if (bytes == 2) {
+      uint16_t z16 = z;
+      memcpy(texel, &z16, 2);
+   }
+   else {
+      memcpy(texel, &z, 4);
+      if (bytes == 8)
+         memcpy(texel + 4, &s, 4);
+   }
+}
+
+
+/**
+ * Build
+ *    void load(void *depth, int32_t stride, int32_t loop, uint32_t *z,
+ *              uint32_t *s)
+ * which loads the values of the given loop iteration, or
+ *    void store(void *depth, int32_t stride, int32_t loop,
+ *               const uint32_t *z, const uint32_t *s)
+ * which stores them.
+ */
+static LLVMValueRef
+add_depth_test(struct gallivm_state *gallivm,
+               const struct util_format_description *desc,
+               unsigned length, boolean is_1d, boolean store)
+{
+   LLVMContextRef context = gallivm->context;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef i8_ptr = LLVMPointerType(LLVMInt8TypeInContext(context), 0);
+   LLVMTypeRef i32 = LLVMInt32TypeInContext(context);
+   LLVMTypeRef i32_vec = LLVMVectorType(i32, length);
+   LLVMTypeRef args[5];
+   LLVMValueRef func, depth_ptr, stride, loop, z_ptr, s_ptr;
+   LLVMBasicBlockRef block;
+   struct lp_type z_src_type = lp_type_float_vec(32, 32 * length);
+   boolean has_s = desc->block.bits > 32;
+
+   args[0] = i8_ptr;
+   args[1] = i32;
+   args[2] = i32;
+   args[3] = LLVMPointerType(i32_vec, 0);
+   args[4] = LLVMPointerType(i32_vec, 0);
+
+   func = LLVMAddFunction(gallivm->module, store ? "store" : "load",
+                          LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                           args, 5, 0));
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+   depth_ptr = LLVMGetParam(func, 0);
+   stride = LLVMGetParam(func, 1);
+   loop = LLVMGetParam(func, 2);
+   z_ptr = LLVMGetParam(func, 3);
+   s_ptr = LLVMGetParam(func, 4);
+
+   block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   if (store) {
+      struct lp_type z_type = lp_depth_type(desc, length);
+      LLVMTypeRef z_vec_type;
+      LLVMValueRef z, s;
+
+      /* the type the depth test leaves its results in */
+      z_type.width = 32;
+      z_vec_type = lp_build_vec_type(gallivm, z_type);
+
+      z = LLVMBuildLoad(builder, z_ptr, "");
+      LLVMSetAlignment(z, 4);
+      z = LLVMBuildBitCast(builder, z, z_vec_type, "");
+      s = LLVMBuildLoad(builder, s_ptr, "");
+      LLVMSetAlignment(s, 4);
+
+      lp_build_depth_stencil_write_swizzled(gallivm, z_src_type, desc, is_1d,
+                                            NULL, NULL, NULL, loop,
+                                            depth_ptr, stride, z, s);
+   }
+   else {
+      LLVMValueRef z_fb, s_fb, res;
+
+      lp_build_depth_stencil_load_swizzled(gallivm, z_src_type, desc, is_1d,
+                                           depth_ptr, stride,
+                                           &z_fb, &s_fb, loop);
+
+      res = LLVMBuildStore(builder,
+                           LLVMBuildBitCast(builder, z_fb, i32_vec, ""),
+                           z_ptr);
+      LLVMSetAlignment(res, 4);
+      if (has_s) {
+         res = LLVMBuildStore(builder,
+                              LLVMBuildBitCast(builder, s_fb, i32_vec, ""),
+                              s_ptr);
+         LLVMSetAlignment(res, 4);
+      }
+   }
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+PIPE_ALIGN_STACK
+static boolean
+test_depth(unsigned verbose, FILE *fp,
+           const struct util_format_description *desc,
+           unsigned length, boolean is_1d)
+{
+   PIPE_ALIGN_VAR(LP_MIN_VECTOR_ALIGN) uint8_t block[4 * BLOCK_STRIDE];
+   PIPE_ALIGN_VAR(LP_MIN_VECTOR_ALIGN) uint8_t expected[4 * BLOCK_STRIDE];
+   uint32_t z[16], s[16];
+   LLVMContextRef context;
+   struct gallivm_state *gallivm;
+   LLVMValueRef load, store;
+   depth_func_t load_func, store_func;
+   unsigned bytes = desc->block.bits / 8;
+   unsigned loops = length == 16 ? 1 : length == 8 ? 2 : 4;
+   unsigned loop, i, x, y;
+   boolean success = TRUE;
+
+   context = LLVMContextCreate();
+   gallivm = gallivm_create("test_module", context);
+
+   load = add_depth_test(gallivm, desc, length, is_1d, FALSE);
+   store = add_depth_test(gallivm, desc, length, is_1d, TRUE);
+
+   gallivm_compile_module(gallivm);
+
+   load_func = (depth_func_t) pointer_to_func(gallivm_jit_function(gallivm, load));
+   store_func = (depth_func_t) pointer_to_func(gallivm_jit_function(gallivm, store));
+
+   gallivm_free_ir(gallivm);
+
+   /* loads */
+   memset(block, 0, sizeof block);
+   for (y = 0; y < 4; y++) {
+      for (x = 0; x < 4; x++)
+         write_texel(block, bytes, x, y, z_value(x, y), s_value(x, y));
+   }
+
+   for (loop = 0; loop < loops; loop++) {
+      memset(z, 0, sizeof z);
+      memset(s, 0, sizeof s);
+      load_func(block, BLOCK_STRIDE, loop, z, s);
+
+      for (i = 0; i < length; i++) {
+         uint32_t z_expected, s_expected;
+
+         if (lane_position(length, loop, i, &x, &y) > 0 && is_1d)
+            continue;
+
+         z_expected = z_value(x, y);
+         if (bytes == 2)
+            z_expected &= 0xffff;
+         s_expected = bytes == 8 ? s_value(x, y) : 0;
+
+         if (z[i] != z_expected || (bytes == 8 && s[i] != s_expected)) {
+            if (verbose)
+               printf("  load %u, lane %u (%u,%u): got 0x%08x/0x%08x, "
+                      "expected 0x%08x/0x%08x\n", loop, i, x, y,
+                      z[i], s[i], z_expected, s_expected);
+            success = FALSE;
+         }
+      }
+   }
+
+   /* stores, which must leave everything else alone */
+   memset(block, 0xcd, sizeof block);
+   memset(expected, 0xcd, sizeof expected);
+
+   for (loop = 0; loop < loops; loop++) {
+      for (i = 0; i < length; i++) {
+         unsigned row = lane_position(length, loop, i, &x, &y);
+
+         z[i] = z_value(x, y);
+         s[i] = s_value(x, y);
+         if (row == 0 || !is_1d)
+            write_texel(expected, bytes, x, y, z[i], s[i]);
+      }
+
+      store_func(block, BLOCK_STRIDE, loop, z, s);
+   }
+
+   for (y = 0; y < 4; y++) {
+      if (memcmp(block + y * BLOCK_STRIDE, expected + y * BLOCK_STRIDE,
+                 BLOCK_STRIDE) != 0) {
+         if (verbose)
+            printf("  store: row %u differs\n", y);
+         success = FALSE;
+      }
+   }
+
+   if (verbose)
+      printf("%s: %s, %u wide%s\n", success ? "pass" : "fail",
+             desc->short_name, length, is_1d ? ", 1d" : "");
+
+   if (fp)
+      write_tsv_row(fp, desc, length, is_1d, success);
+
+   gallivm_destroy(gallivm);
+   LLVMContextDispose(context);
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   boolean success = TRUE;
+   unsigned i, j, is_1d;
+
+   for (i = 0; i < ARRAY_SIZE(formats); i++) {
+      const struct util_format_description *desc =
+         util_format_description(formats[i]);
+
+      for (j = 0; j < ARRAY_SIZE(lengths); j++) {
+         for (is_1d = 0; is_1d < 2; is_1d++) {
+            if (!test_depth(verbose, fp, desc, lengths[j], is_1d))
+               success = FALSE;
+         }
+      }
+   }
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_depth(verbose, fp,
+                     util_format_description(PIPE_FORMAT_Z32_FLOAT), 16,
+                     FALSE);
+}
@@ -0,0 +1,393 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Unit tests and microbenchmarks for the triangle coverage kernels.
+ *
+ * Every kernel the CPU supports is checked against a scalar reference on
+ * random small triangles, and timed.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "util/u_cpu_detect.h"
+#include "util/u_memory.h"
+
+#include "lp_rast_priv.h"
+#include "lp_test.h"
+
+
+#define NUM_REPEATS 100
+
+/* Planes per triangle in the test array, so that every triangle's planes
+ * are 16 byte aligned like in a scene.
+ */
+#define TRI_STRIDE 4
+
+/* Block the triangles are rasterized against */
+#define BLOCK_X 64
+#define BLOCK_Y 32
+
+
+struct tri_kernel {
+   const char *name;
+   lp_rast_tri_3_16_func func_16;
+   lp_rast_tri_3_4_func func_4;
+   boolean supported;
+};
+
+
+static const struct tri_kernel *
+get_kernels(unsigned *num_kernels)
+{
+   static struct tri_kernel kernels[3];
+   unsigned n = 0;
+
+#if defined(PIPE_ARCH_SSE)
+   kernels[n].name = "sse2";
+   kernels[n].func_16 = lp_rast_tri_3_16_sse2;
+   kernels[n].func_4 = lp_rast_tri_3_4_sse2;
+   kernels[n].supported = util_cpu_caps.has_sse2;
+   n++;
+#endif
+#if defined(USE_AVX2)
+   kernels[n].name = "avx2";
+   kernels[n].func_16 = lp_rast_tri_3_16_avx2;
+   kernels[n].func_4 = lp_rast_tri_3_4_avx2;
+   kernels[n].supported = util_cpu_caps.has_avx2;
+   n++;
+#endif
+#if defined(USE_AVX512)
+   kernels[n].name = "avx512";
+   kernels[n].func_16 = lp_rast_tri_3_16_avx512;
+   kernels[n].func_4 = lp_rast_tri_3_4_avx512;
+   kernels[n].supported = util_cpu_caps.has_avx512f;
+   n++;
+#endif
+
+   *num_kernels = n;
+   return kernels;
+}
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "cycles_per_call\t"
+           "kernel\t"
+           "block\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              const struct tri_kernel *kernel,
+              unsigned block,
+              double cycles,
+              boolean success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+   fprintf(fp, "%.1f\t", cycles);
+   fprintf(fp, "%s\t", kernel->name);
+   fprintf(fp, "%ux%u\n", block, block);
+
+   fflush(fp);
+}
+
+
+/**
+ * Scalar reference: evaluate every pixel of the 4x4 block at x, y.
+ */
+static unsigned
+ref_tri_3_4(const struct lp_rast_plane *plane, int x, int y)
+{
+   unsigned mask = 0;
+   int ix, iy;
+   unsigned k;
+
+   for (iy = 0; iy < 4; iy++) {
+      for (ix = 0; ix < 4; ix++) {
+         boolean inside = TRUE;
+
+         for (k = 0; k < 3; k++) {
+            int32_t c = (int32_t)((uint32_t)plane[k].c -
+                                  (uint32_t)plane[k].dcdx * (x + ix) +
+                                  (uint32_t)plane[k].dcdy * (y + iy) - 1);
+            if (c < 0)
+               inside = FALSE;
+         }
+
+         if (inside)
+            mask |= 1 << (iy * 4 + ix);
+      }
+   }
+
+   return mask;
+}
+
+
+static unsigned
+ref_tri_3_16(const struct lp_rast_plane *plane, int x, int y,
+             struct lp_rast_block_mask *out)
+{
+   unsigned nr = 0;
+   unsigned i, j;
+
+   for (i = 0; i < 4; i++) {
+      for (j = 0; j < 4; j++) {
+         unsigned mask = ref_tri_3_4(plane, x + 4 * j, y + 4 * i);
+         if (mask) {
+            out[nr].i = i;
+            out[nr].j = j;
+            out[nr].mask = mask;
+            nr++;
+         }
+      }
+   }
+
+   return nr;
+}
+
+
+/**
+ * Set up the planes of a triangle the way lp_setup_tri.c does for the
+ * 32-bit rasterizer.  Coordinates are in FIXED_ORDER fixed point.
+ */
+static void
+setup_planes(struct lp_rast_plane *plane, const int *vx, const int *vy)
+{
+   unsigned i;
+
+   plane[0].dcdy = vx[0] - vx[1];
+   plane[1].dcdy = vx[1] - vx[2];
+   plane[2].dcdy = vx[2] - vx[0];
+   plane[0].dcdx = vy[0] - vy[1];
+   plane[1].dcdx = vy[1] - vy[2];
+   plane[2].dcdx = vy[2] - vy[0];
+
+   for (i = 0; i < 3; i++) {
+      plane[i].c = IMUL64(plane[i].dcdx, vx[i]) -
+                   IMUL64(plane[i].dcdy, vy[i]);
+
+      /* top-left fill convention */
+      if (plane[i].dcdx < 0 ||
+          (plane[i].dcdx == 0 && plane[i].dcdy > 0))
+         plane[i].c++;
+
+      plane[i].dcdx <<= FIXED_ORDER;
+      plane[i].dcdy <<= FIXED_ORDER;
+
+      plane[i].eo = 0;
+      if (plane[i].dcdx < 0) plane[i].eo -= plane[i].dcdx;
+      if (plane[i].dcdy > 0) plane[i].eo += plane[i].dcdy;
+      plane[i].pad = 0;
+   }
+}
+
+
+/**
+ * Random triangle up to 32 pixels wide around the test block, wound so
+ * that its inside is covered.
+ */
+static void
+random_tri(struct lp_rast_plane *plane)
+{
+   struct lp_rast_block_mask out[16];
+   int vx[3], vy[3];
+   unsigned i;
+
+   for (i = 0; i < 3; i++) {
+      vx[i] = ((BLOCK_X - 8) << FIXED_ORDER) + rand() % (32 << FIXED_ORDER);
+      vy[i] = ((BLOCK_Y - 8) << FIXED_ORDER) + rand() % (32 << FIXED_ORDER);
+   }
+
+   setup_planes(plane, vx, vy);
+
+   if (!ref_tri_3_16(plane, BLOCK_X, BLOCK_Y, out)) {
+      int tmp;
+
+      tmp = vx[1]; vx[1] = vx[2]; vx[2] = tmp;
+      tmp = vy[1]; vy[1] = vy[2]; vy[2] = tmp;
+      setup_planes(plane, vx, vy);
+   }
+}
+
+
+static boolean
+compare_blocks(const struct lp_rast_block_mask *res, unsigned res_nr,
+               const struct lp_rast_block_mask *ref, unsigned ref_nr)
+{
+   unsigned i;
+
+   if (res_nr != ref_nr)
+      return FALSE;
+
+   for (i = 0; i < ref_nr; i++) {
+      if (res[i].i != ref[i].i ||
+          res[i].j != ref[i].j ||
+          res[i].mask != ref[i].mask)
+         return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+static boolean
+test_kernel(unsigned verbose, FILE *fp,
+            const struct tri_kernel *kernel,
+            const struct lp_rast_plane *planes,
+            unsigned num_tris)
+{
+   boolean success_16 = TRUE, success_4 = TRUE;
+   int64_t cycles_16 = 0, cycles_4 = 0;
+   volatile unsigned sink = 0;
+   unsigned t, r;
+
+   for (t = 0; t < num_tris; t++) {
+      const struct lp_rast_plane *plane = &planes[t * TRI_STRIDE];
+      struct lp_rast_block_mask res[16], ref[16];
+      unsigned res_nr, ref_nr;
+      unsigned i, j;
+
+      res_nr = kernel->func_16(plane, BLOCK_X, BLOCK_Y, res);
+      ref_nr = ref_tri_3_16(plane, BLOCK_X, BLOCK_Y, ref);
+      if (!compare_blocks(res, res_nr, ref, ref_nr)) {
+         fprintf(stderr, "%s 16x16: triangle %u mismatch\n",
+                 kernel->name, t);
+         success_16 = FALSE;
+      }
+
+      for (i = 0; i < 4; i++) {
+         for (j = 0; j < 4; j++) {
+            int x = BLOCK_X + 4 * j, y = BLOCK_Y + 4 * i;
+            unsigned res_mask = kernel->func_4(plane, x, y);
+            unsigned ref_mask = ref_tri_3_4(plane, x, y);
+
+            if (res_mask != ref_mask) {
+               fprintf(stderr, "%s 4x4: triangle %u at %d,%d: "
+                       "0x%04x, expected 0x%04x\n",
+                       kernel->name, t, x, y, res_mask, ref_mask);
+               success_4 = FALSE;
+            }
+         }
+      }
+   }
+
+   for (r = 0; r < NUM_REPEATS; r++) {
+      struct lp_rast_block_mask res[16];
+      int64_t start;
+
+      start = rdtsc();
+      for (t = 0; t < num_tris; t++)
+         sink += kernel->func_16(&planes[t * TRI_STRIDE], BLOCK_X, BLOCK_Y, res);
+      cycles_16 += rdtsc() - start;
+
+      start = rdtsc();
+      for (t = 0; t < num_tris; t++)
+         sink += kernel->func_4(&planes[t * TRI_STRIDE], BLOCK_X + 4, BLOCK_Y + 4);
+      cycles_4 += rdtsc() - start;
+   }
+
+   if (verbose >= 1) {
+      printf("%s: 16x16 %.1f cycles, 4x4 %.1f cycles%s\n",
+             kernel->name,
+             (double)cycles_16 / (NUM_REPEATS * num_tris),
+             (double)cycles_4 / (NUM_REPEATS * num_tris),
+             success_16 && success_4 ? "" : " FAILED");
+   }
+
+   if (fp) {
+      write_tsv_row(fp, kernel, 16,
+                    (double)cycles_16 / (NUM_REPEATS * num_tris), success_16);
+      write_tsv_row(fp, kernel, 4,
+                    (double)cycles_4 / (NUM_REPEATS * num_tris), success_4);
+   }
+
+   return success_16 && success_4;
+}
+
+
+static boolean
+test_tris(unsigned verbose, FILE *fp, unsigned num_tris)
+{
+   const struct tri_kernel *kernels;
+   struct lp_rast_plane *planes;
+   unsigned num_kernels, k, t;
+   boolean success = TRUE;
+
+   kernels = get_kernels(&num_kernels);
+
+   planes = align_malloc(num_tris * TRI_STRIDE * sizeof *planes, 16);
+   if (!planes)
+      return FALSE;
+
+   for (t = 0; t < num_tris; t++)
+      random_tri(&planes[t * TRI_STRIDE]);
+
+   for (k = 0; k < num_kernels; k++) {
+      if (!kernels[k].supported)
+         continue;
+
+      if (!test_kernel(verbose, fp, &kernels[k], planes, num_tris))
+         success = FALSE;
+   }
+
+   align_free(planes);
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_tris(verbose, fp, 10000);
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_tris(verbose, fp, n);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_tris(verbose, fp, 1);
+}
@@ -0,0 +1,347 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Unit tests for the tiled -> linear texture conversion.
+ *
+ * A tiled texture is filled through transfers, converted back to linear
+ * by creating a surface for it, and read back through a second context,
+ * which must also have been told that the layout changed.  The tiled
+ * storage must outlive a scene of the second context which references the
+ * texture.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "state_tracker/sw_winsys.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_surface.h"
+
+#include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_public.h"
+#include "lp_screen.h"
+#include "lp_texture.h"
+#include "lp_test.h"
+
+
+/*
+ * The test never creates display targets, so the winsys only has to
+ * answer format queries and destroy itself.
+ */
+
+static boolean
+test_winsys_is_displaytarget_format_supported(struct sw_winsys *ws,
+                                              unsigned tex_usage,
+                                              enum pipe_format format)
+{
+   return FALSE;
+}
+
+
+static void
+test_winsys_destroy(struct sw_winsys *ws)
+{
+   FREE(ws);
+}
+
+
+static struct sw_winsys *
+test_winsys_create(void)
+{
+   struct sw_winsys *ws = CALLOC_STRUCT(sw_winsys);
+
+   if (!ws)
+      return NULL;
+
+   ws->destroy = test_winsys_destroy;
+   ws->is_displaytarget_format_supported =
+      test_winsys_is_displaytarget_format_supported;
+
+   return ws;
+}
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "size\t"
+           "levels\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              unsigned width, unsigned height, unsigned levels,
+              boolean success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+   fprintf(fp, "%ux%u\t", width, height);
+   fprintf(fp, "%u\n", levels);
+
+   fflush(fp);
+}
+
+
+static uint32_t
+texel_value(unsigned level, unsigned x, unsigned y)
+{
+   return (level << 24) | (y << 12) | x;
+}
+
+
+static void
+write_level(struct pipe_context *pipe, struct pipe_resource *tex,
+            unsigned level)
+{
+   unsigned width = u_minify(tex->width0, level);
+   unsigned height = u_minify(tex->height0, level);
+   struct pipe_transfer *transfer;
+   ubyte *map;
+   unsigned x, y;
+
+   map = pipe_transfer_map(pipe, tex, level, 0, PIPE_TRANSFER_WRITE,
+                           0, 0, width, height, &transfer);
+   if (!map)
+      return;
+
+   for (y = 0; y < height; y++) {
+      uint32_t *row = (uint32_t *)(map + y * transfer->stride);
+      for (x = 0; x < width; x++)
+         row[x] = texel_value(level, x, y);
+   }
+
+   pipe_transfer_unmap(pipe, transfer);
+}
+
+
+static boolean
+check_level(unsigned verbose, struct pipe_context *pipe,
+            struct pipe_resource *tex, unsigned level)
+{
+   unsigned width = u_minify(tex->width0, level);
+   unsigned height = u_minify(tex->height0, level);
+   struct pipe_transfer *transfer;
+   const ubyte *map;
+   unsigned x, y;
+   boolean success = TRUE;
+
+   map = pipe_transfer_map(pipe, tex, level, 0, PIPE_TRANSFER_READ,
+                           0, 0, width, height, &transfer);
+   if (!map)
+      return FALSE;
+
+   for (y = 0; y < height && success; y++) {
+      const uint32_t *row = (const uint32_t *)(map + y * transfer->stride);
+      for (x = 0; x < width; x++) {
+         if (row[x] != texel_value(level, x, y)) {
+            if (verbose)
+               printf("  level %u texel %u,%u: got 0x%08x, expected 0x%08x\n",
+                      level, x, y, row[x], texel_value(level, x, y));
+            success = FALSE;
+            break;
+         }
+      }
+   }
+
+   pipe_transfer_unmap(pipe, transfer);
+
+   return success;
+}
+
+
+static boolean
+test_untile(unsigned verbose, FILE *fp,
+            unsigned width, unsigned height, unsigned last_level)
+{
+   struct sw_winsys *winsys;
+   struct pipe_screen *screen;
+   struct llvmpipe_screen *lp_screen;
+   struct pipe_context *pipe[2] = { NULL, NULL };
+   struct pipe_resource templ, *tex = NULL;
+   struct pipe_surface surf_templ, *surf = NULL;
+   unsigned level, i;
+   boolean scene_ref = FALSE;
+   boolean success = TRUE;
+
+   winsys = test_winsys_create();
+   if (!winsys)
+      return FALSE;
+
+   screen = llvmpipe_create_screen(winsys);
+   if (!screen) {
+      winsys->destroy(winsys);
+      return FALSE;
+   }
+   lp_screen = llvmpipe_screen(screen);
+
+   /* LP_PERF is read from the environment at screen creation */
+   LP_PERF |= PERF_TILED_TEX;
+
+   for (i = 0; i < 2; i++) {
+      pipe[i] = screen->context_create(screen, NULL, 0);
+      if (!pipe[i]) {
+         success = FALSE;
+         goto out;
+      }
+   }
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   templ.width0 = width;
+   templ.height0 = height;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.last_level = last_level;
+   templ.usage = PIPE_USAGE_DEFAULT;
+   templ.bind = PIPE_BIND_SAMPLER_VIEW | PIPE_BIND_RENDER_TARGET;
+
+   tex = screen->resource_create(screen, &templ);
+   if (!tex || !llvmpipe_resource(tex)->tiled) {
+      if (verbose)
+         printf("  texture was not created tiled\n");
+      success = FALSE;
+      goto out;
+   }
+
+   for (level = 0; level <= last_level; level++)
+      write_level(pipe[0], tex, level);
+
+   /* as if the second context had validated its state after the upload,
+    * and binned a scene which samples the texture
+    */
+   llvmpipe_context(pipe[1])->tex_timestamp = lp_screen->timestamp;
+   llvmpipe_resource_scene_ref(tex);
+   scene_ref = TRUE;
+
+   u_surface_default_template(&surf_templ, tex);
+   surf = pipe[0]->create_surface(pipe[0], tex, &surf_templ);
+   if (!surf || llvmpipe_resource(tex)->tiled) {
+      if (verbose)
+         printf("  texture was not converted to linear\n");
+      success = FALSE;
+      goto out;
+   }
+
+   if (llvmpipe_context(pipe[1])->tex_timestamp == lp_screen->timestamp) {
+      if (verbose)
+         printf("  second context not told about the layout change\n");
+      success = FALSE;
+   }
+
+   if (!llvmpipe_resource(tex)->retired_tex_data) {
+      if (verbose)
+         printf("  tiled storage freed while a scene references it\n");
+      success = FALSE;
+   }
+
+   llvmpipe_resource_scene_unref(tex);
+   scene_ref = FALSE;
+
+   if (llvmpipe_resource(tex)->retired_tex_data) {
+      if (verbose)
+         printf("  tiled storage not freed by the last scene\n");
+      success = FALSE;
+   }
+
+   for (level = 0; level <= last_level; level++) {
+      if (!check_level(verbose, pipe[1], tex, level))
+         success = FALSE;
+   }
+
+out:
+   if (verbose)
+      printf("%s: %ux%u, %u levels\n", success ? "pass" : "fail",
+             width, height, last_level + 1);
+
+   if (fp)
+      write_tsv_row(fp, width, height, last_level + 1, success);
+
+   if (scene_ref)
+      llvmpipe_resource_scene_unref(tex);
+   pipe_surface_reference(&surf, NULL);
+   pipe_resource_reference(&tex, NULL);
+   for (i = 0; i < 2; i++) {
+      if (pipe[i])
+         pipe[i]->destroy(pipe[i]);
+   }
+   screen->destroy(screen);
+
+   return success;
+}
+
+
+static const struct {
+   unsigned width, height, last_level;
+} test_sizes[] = {
+   { 1, 1, 0 },
+   { 4, 4, 0 },
+   { 5, 3, 0 },
+   { 64, 64, 6 },
+   { 97, 33, 3 },
+};
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   boolean success = TRUE;
+   unsigned i;
+
+   for (i = 0; i < ARRAY_SIZE(test_sizes); i++) {
+      if (!test_untile(verbose, fp, test_sizes[i].width,
+                       test_sizes[i].height, test_sizes[i].last_level))
+         success = FALSE;
+   }
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_untile(verbose, fp, 5, 3, 0);
+}
@@ -43,7 +43,10 @@
 #include "util/simple_list.h"
 #include "util/u_transfer.h"
 
+#include "gallivm/lp_bld_sample.h"
+
 #include "lp_context.h"
+#include "lp_debug.h"
 #include "lp_flush.h"
 #include "lp_screen.h"
 #include "lp_texture.h"
@@ -59,6 +62,117 @@ static struct llvmpipe_resource resource_list;
 #endif
 static unsigned id_counter = 0;
 
+/** Protects llvmpipe_resource::scene_refs and retired_tex_data */
+pipe_static_mutex(scene_ref_mutex);
+
+
+/**
+ * Number of 3D image slices, cube faces or texture array layers
+ * in a mipmap level.
+ */
+static unsigned
+llvmpipe_texture_num_slices(const struct pipe_resource *pt, unsigned level)
+{
+   if (pt->target == PIPE_TEXTURE_3D)
+      return u_minify(pt->depth0, level);
+   else if (pt->target == PIPE_TEXTURE_1D_ARRAY ||
+            pt->target == PIPE_TEXTURE_2D_ARRAY ||
+            pt->target == PIPE_TEXTURE_CUBE ||
+            pt->target == PIPE_TEXTURE_CUBE_ARRAY)
+      return pt->array_size;
+   else
+      return 1;
+}
+
+
+/**
+ * Whether a texture may be stored in the tiled layout.
+ *
+ * We only tile textures which the sampler is the sole reader and writer
+ * of (besides transfers).  st/mesa asks for PIPE_BIND_RENDER_TARGET on
+ * every renderable texture, so that flag alone is tolerated and the
+ * texture gets converted back to linear once a surface is actually
+ * created for it (see llvmpipe_resource_untile()).
+ */
+static boolean
+llvmpipe_texture_can_tile(const struct pipe_resource *pt)
+{
+   const struct util_format_description *desc;
+
+   if (!(LP_PERF & PERF_TILED_TEX))
+      return FALSE;
+
+   switch (pt->target) {
+   case PIPE_TEXTURE_2D:
+   case PIPE_TEXTURE_2D_ARRAY:
+   case PIPE_TEXTURE_RECT:
+   case PIPE_TEXTURE_3D:
+   case PIPE_TEXTURE_CUBE:
+   case PIPE_TEXTURE_CUBE_ARRAY:
+      break;
+   default:
+      return FALSE;
+   }
+
+   if (!(pt->bind & PIPE_BIND_SAMPLER_VIEW) ||
+       (pt->bind & ~(PIPE_BIND_SAMPLER_VIEW | PIPE_BIND_RENDER_TARGET)))
+      return FALSE;
+
+   if (pt->usage == PIPE_USAGE_STAGING ||
+       pt->usage == PIPE_USAGE_STREAM ||
+       (pt->flags & (PIPE_RESOURCE_FLAG_MAP_PERSISTENT |
+                     PIPE_RESOURCE_FLAG_MAP_COHERENT)) ||
+       pt->nr_samples > 1)
+      return FALSE;
+
+   desc = util_format_description(pt->format);
+   if (!desc ||
+       desc->block.width != 1 ||
+       desc->block.height != 1 ||
+       util_format_is_depth_or_stencil(pt->format))
+      return FALSE;
+
+   return TRUE;
+}
+
+
+/**
+ * Copy a box of texels between a tiled image and a linear buffer.
+ *
+ * \param tiled_stride  bytes between rows of tiles in the tiled image
+ * \param x, y  position of the box in the tiled image, in texels
+ */
+static void
+llvmpipe_copy_tiled_box(ubyte *tiled, unsigned tiled_stride,
+                        ubyte *linear, unsigned linear_stride,
+                        unsigned x, unsigned y,
+                        unsigned width, unsigned height,
+                        unsigned bpp, boolean to_tiled)
+{
+   const unsigned ts = LP_SAMPLER_TILE_SIZE;
+   unsigned i, j, n;
+
+   for (j = 0; j < height; j++) {
+      unsigned ty = y + j;
+      ubyte *tiled_row = tiled + (ty / ts) * tiled_stride +
+                         (ty % ts) * ts * bpp;
+      ubyte *linear_row = linear + j * linear_stride;
+
+      /* copy runs of texels which are contiguous in the tile */
+      for (i = 0; i < width; i += n) {
+         unsigned tx = x + i;
+         ubyte *t = tiled_row + ((tx / ts) * ts * ts + tx % ts) * bpp;
+         ubyte *l = linear_row + i * bpp;
+
+         n = MIN2(ts - tx % ts, width - i);
+         if (to_tiled)
+            memcpy(t, l, n * bpp);
+         else
+            memcpy(l, t, n * bpp);
+      }
+   }
+}
+
 
 /**
  * Conventional allocation path for non-display textures:
@@ -73,9 +187,7 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
    unsigned level;
    unsigned width = pt->width0;
    unsigned height = pt->height0;
-   unsigned depth = pt->depth0;
    uint64_t total_size = 0;
-   unsigned layers = pt->array_size;
    /* XXX:
     * This alignment here (same for displaytarget) was added for the purpose of
     * ARB_map_buffer_alignment. I am not convinced it's needed for non-buffer
@@ -104,6 +216,8 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
        */
       if (util_format_is_compressed(pt->format))
          align_x = align_y = 1;
+      else if (lpr->tiled)
+         align_x = align_y = MAX2(LP_RASTER_BLOCK_SIZE, LP_SAMPLER_TILE_SIZE);
       else {
          align_x = LP_RASTER_BLOCK_SIZE;
          if (llvmpipe_resource_is_1d(&lpr->base))
@@ -120,6 +234,12 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
 
       if (util_format_is_compressed(pt->format))
          lpr->row_stride[level] = nblocksx * block_size;
+      else if (lpr->tiled) {
+         /* row_stride is the distance between rows of tiles */
+         lpr->row_stride[level] = align(nblocksx * block_size * LP_SAMPLER_TILE_SIZE,
+                                        util_cpu_caps.cacheline);
+         nblocksy /= LP_SAMPLER_TILE_SIZE;
+      }
       else
          lpr->row_stride[level] = align(nblocksx * block_size, util_cpu_caps.cacheline);
 
@@ -133,18 +253,10 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
 
       /* Number of 3D image slices, cube faces or texture array layers */
       if (lpr->base.target == PIPE_TEXTURE_CUBE) {
-         assert(layers == 6);
+         assert(pt->array_size == 6);
       }
 
-      if (lpr->base.target == PIPE_TEXTURE_3D)
-         num_slices = depth;
-      else if (lpr->base.target == PIPE_TEXTURE_1D_ARRAY ||
-               lpr->base.target == PIPE_TEXTURE_2D_ARRAY ||
-               lpr->base.target == PIPE_TEXTURE_CUBE ||
-               lpr->base.target == PIPE_TEXTURE_CUBE_ARRAY)
-         num_slices = layers;
-      else
-         num_slices = 1;
+      num_slices = llvmpipe_texture_num_slices(pt, level);
 
       /* if img_stride * num_slices_faces > LP_MAX_TEXTURE_SIZE */
       mipsize = (uint64_t)lpr->img_stride[level] * num_slices;
@@ -163,7 +275,6 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
       /* Compute size of next mipmap level */
       width = u_minify(width, 1);
       height = u_minify(height, 1);
-      depth = u_minify(depth, 1);
    }
 
    if (allocate) {
@@ -262,6 +373,7 @@ llvmpipe_resource_create_front(struct pipe_screen *_screen,
       }
       else {
          /* texture map */
+         lpr->tiled = llvmpipe_texture_can_tile(&lpr->base);
          if (!llvmpipe_texture_layout(screen, lpr, true))
             goto fail;
       }
@@ -328,6 +440,8 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
          align_free(lpr->tex_data);
          lpr->tex_data = NULL;
       }
+      /* scenes hold a reference, so this has been freed by the last one */
+      assert(!lpr->retired_tex_data);
    }
    else if (!lpr->userBuffer) {
       assert(lpr->data);
@@ -387,6 +501,8 @@ llvmpipe_resource_map(struct pipe_resource *resource,
       return map;
    }
    else if (llvmpipe_resource_is_texture(resource)) {
+      /* callers expect linear images */
+      assert(!lpr->tiled);
 
       map = llvmpipe_get_texture_image_address(lpr, layer, level);
       return map;
@@ -431,6 +547,124 @@ llvmpipe_resource_data(struct pipe_resource *resource)
 }
 
 
+/**
+ * Convert a tiled texture back to the linear layout.
+ *
+ * Called before the texture is used for anything but sampling and
+ * transfers, e.g. when a surface is created for it.  This is one-way;
+ * the texture stays linear from then on.
+ */
+void
+llvmpipe_resource_untile(struct pipe_context *pipe,
+                         struct pipe_resource *resource)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct llvmpipe_screen *screen = llvmpipe_screen(resource->screen);
+   struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
+   unsigned row_stride[LP_MAX_TEXTURE_LEVELS];
+   unsigned img_stride[LP_MAX_TEXTURE_LEVELS];
+   unsigned mip_offsets[LP_MAX_TEXTURE_LEVELS];
+   unsigned bpp = util_format_get_blocksize(resource->format);
+   ubyte *tiled_data;
+   unsigned level, slice;
+
+   if (!lpr->tiled)
+      return;
+
+   memcpy(row_stride, lpr->row_stride, sizeof row_stride);
+   memcpy(img_stride, lpr->img_stride, sizeof img_stride);
+   memcpy(mip_offsets, lpr->mip_offsets, sizeof mip_offsets);
+   tiled_data = lpr->tex_data;
+
+   lpr->tiled = FALSE;
+   if (!llvmpipe_texture_layout(screen, lpr, TRUE)) {
+      debug_printf("llvmpipe: out of memory converting texture to linear\n");
+      memcpy(lpr->row_stride, row_stride, sizeof row_stride);
+      memcpy(lpr->img_stride, img_stride, sizeof img_stride);
+      memcpy(lpr->mip_offsets, mip_offsets, sizeof mip_offsets);
+      lpr->tex_data = tiled_data;
+      lpr->tiled = TRUE;
+      return;
+   }
+
+   for (level = 0; level <= resource->last_level; level++) {
+      unsigned num_slices = llvmpipe_texture_num_slices(resource, level);
+
+      for (slice = 0; slice < num_slices; slice++) {
+         llvmpipe_copy_tiled_box(tiled_data + mip_offsets[level] +
+                                 slice * img_stride[level],
+                                 row_stride[level],
+                                 llvmpipe_get_texture_image_address(lpr, slice,
+                                                                    level),
+                                 lpr->row_stride[level],
+                                 0, 0,
+                                 u_minify(resource->width0, level),
+                                 u_minify(resource->height0, level),
+                                 bpp, FALSE);
+      }
+   }
+
+   /* Scenes of any context which were binned with the texture may still
+    * sample the tiled images, whether they are queued for rasterization or
+    * not flushed yet.  Each of them holds a reference to the resource, so
+    * the last one to release it frees the tiled storage.
+    */
+   pipe_mutex_lock(scene_ref_mutex);
+   if (lpr->scene_refs) {
+      assert(!lpr->retired_tex_data);
+      lpr->retired_tex_data = tiled_data;
+      tiled_data = NULL;
+   }
+   pipe_mutex_unlock(scene_ref_mutex);
+
+   align_free(tiled_data);
+
+   /* Shader variants and jit texture state have to pick up the new layout
+    * in every context which has the texture bound, not just this one.
+    * Bumping the screen timestamp makes each of them revalidate its
+    * sampler views in llvmpipe_update_derived().
+    */
+   screen->timestamp++;
+   llvmpipe->dirty |= LP_NEW_SAMPLER_VIEW;
+}
+
+
+/**
+ * Called when a scene takes a reference to the resource.
+ */
+void
+llvmpipe_resource_scene_ref(struct pipe_resource *resource)
+{
+   struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
+
+   pipe_mutex_lock(scene_ref_mutex);
+   lpr->scene_refs++;
+   pipe_mutex_unlock(scene_ref_mutex);
+}
+
+
+/**
+ * Called when a scene releases its reference to the resource, after it
+ * was rasterized or discarded.
+ */
+void
+llvmpipe_resource_scene_unref(struct pipe_resource *resource)
+{
+   struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
+   void *retired_tex_data = NULL;
+
+   pipe_mutex_lock(scene_ref_mutex);
+   assert(lpr->scene_refs > 0);
+   if (--lpr->scene_refs == 0) {
+      retired_tex_data = lpr->retired_tex_data;
+      lpr->retired_tex_data = NULL;
+   }
+   pipe_mutex_unlock(scene_ref_mutex);
+
+   align_free(retired_tex_data);
+}
+
+
 static struct pipe_resource *
 llvmpipe_resource_from_handle(struct pipe_screen *screen,
                               const struct pipe_resource *template,
@@ -556,6 +790,10 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
       }
    }
 
+   /* tiled textures are only ever mapped through a linear staging copy */
+   if (lpr->tiled && (usage & PIPE_TRANSFER_MAP_DIRECTLY))
+      return NULL;
+
    lpt = CALLOC_STRUCT(llvmpipe_transfer);
    if (!lpt)
       return NULL;
@@ -566,6 +804,42 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
    pt->stride = lpr->row_stride[level];
    pt->layer_stride = lpr->img_stride[level];
    pt->usage = usage;
+
+   if (lpr->tiled) {
+      unsigned bpp = util_format_get_blocksize(resource->format);
+      int z;
+
+      pt->stride = align(box->width * bpp, 16);
+      pt->layer_stride = pt->stride * box->height;
+      lpt->staging = align_malloc(pt->layer_stride * box->depth, 16);
+      if (!lpt->staging) {
+         pipe_resource_reference(&pt->resource, NULL);
+         FREE(lpt);
+         return NULL;
+      }
+
+      if (!(usage & (PIPE_TRANSFER_DISCARD_RANGE |
+                     PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE))) {
+         for (z = 0; z < box->depth; z++) {
+            llvmpipe_copy_tiled_box(llvmpipe_get_texture_image_address(lpr,
+                                                                       box->z + z,
+                                                                       level),
+                                    lpr->row_stride[level],
+                                    (ubyte *)lpt->staging + z * pt->layer_stride,
+                                    pt->stride,
+                                    box->x, box->y, box->width, box->height,
+                                    bpp, FALSE);
+         }
+      }
+
+      if (usage & PIPE_TRANSFER_WRITE) {
+         screen->timestamp++;
+      }
+
+      *transfer = pt;
+      return lpt->staging;
+   }
+
    *transfer = pt;
 
    assert(level < LP_MAX_TEXTURE_LEVELS);
@@ -620,16 +894,41 @@ static void
 llvmpipe_transfer_unmap(struct pipe_context *pipe,
                         struct pipe_transfer *transfer)
 {
-   assert(transfer->resource);
+   struct llvmpipe_transfer *lpt = llvmpipe_transfer(transfer);
 
-   llvmpipe_resource_unmap(transfer->resource,
-                           transfer->level,
-                           transfer->box.z);
+   assert(transfer->resource);
 
-   /* Effectively do the texture_update work here - if texture images
-    * needed post-processing to put them into hardware layout, this is
-    * where it would happen.  For llvmpipe, nothing to do.
+   /* Effectively do the texture_update work here - tiled textures get
+    * the staging copy written back into the tiled layout.
     */
+   if (lpt->staging) {
+      struct llvmpipe_resource *lpr = llvmpipe_resource(transfer->resource);
+      const struct pipe_box *box = &transfer->box;
+      unsigned bpp = util_format_get_blocksize(lpr->base.format);
+      int z;
+
+      if (transfer->usage & PIPE_TRANSFER_WRITE) {
+         for (z = 0; z < box->depth; z++) {
+            llvmpipe_copy_tiled_box(llvmpipe_get_texture_image_address(lpr,
+                                                                       box->z + z,
+                                                                       transfer->level),
+                                    lpr->row_stride[transfer->level],
+                                    (ubyte *)lpt->staging +
+                                    z * transfer->layer_stride,
+                                    transfer->stride,
+                                    box->x, box->y, box->width, box->height,
+                                    bpp, TRUE);
+         }
+      }
+
+      align_free(lpt->staging);
+   }
+   else {
+      llvmpipe_resource_unmap(transfer->resource,
+                              transfer->level,
+                              transfer->box.z);
+   }
+
    assert (transfer->resource);
    pipe_resource_reference(&transfer->resource, NULL);
    FREE(transfer);
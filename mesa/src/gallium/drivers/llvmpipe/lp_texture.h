@@ -69,6 +69,14 @@ struct llvmpipe_resource
    /** allocated total size (for non-display target texture resources only) */
    unsigned total_alloc_size;
 
+   /**
+    * Texture images are stored in LP_SAMPLER_TILE_SIZE square tiles
+    * (see lp_bld_sample.h) and row_stride is the distance between rows
+    * of tiles.  Only ever set for textures which are merely sampled from;
+    * anything else converts the texture back to the linear layout first.
+    */
+   boolean tiled;
+
    /**
     * Display target, for textures with the PIPE_BIND_DISPLAY_TARGET
     * usage.
@@ -88,6 +96,15 @@ struct llvmpipe_resource
    boolean userBuffer;  /** Is this a user-space buffer? */
    unsigned timestamp;
 
+   /**
+    * Number of scenes, of any context, which hold a reference to the
+    * resource, and the tiled storage which they may still sample after
+    * the texture was untiled.  It is freed when the last of these scenes
+    * releases the resource.  Both are protected by a global mutex.
+    */
+   unsigned scene_refs;
+   void *retired_tex_data;
+
    unsigned id;  /**< temporary, for debugging */
 
 #ifdef DEBUG
@@ -102,6 +119,9 @@ struct llvmpipe_transfer
    struct pipe_transfer base;
 
    unsigned long offset;
+
+   /** linear copy of the mapped box, for tiled textures */
+   void *staging;
 };
 
 
@@ -175,6 +195,18 @@ llvmpipe_resource_is_1d(const struct pipe_resource *resource)
 }
 
 
+/**
+ * Whether the texture of a sampler view is stored in the tiled layout.
+ */
+static inline boolean
+llvmpipe_sampler_view_is_tiled(const struct pipe_sampler_view *view)
+{
+   return view && view->texture &&
+          llvmpipe_resource_is_texture(view->texture) &&
+          llvmpipe_resource_const(view->texture)->tiled;
+}
+
+
 static inline unsigned
 llvmpipe_layer_stride(struct pipe_resource *resource,
                       unsigned level)
@@ -211,6 +243,17 @@ void *
 llvmpipe_resource_data(struct pipe_resource *resource);
 
 
+void
+llvmpipe_resource_untile(struct pipe_context *pipe,
+                         struct pipe_resource *resource);
+
+void
+llvmpipe_resource_scene_ref(struct pipe_resource *resource);
+
+void
+llvmpipe_resource_scene_unref(struct pipe_resource *resource);
+
+
 unsigned
 llvmpipe_resource_size(const struct pipe_resource *resource);
 
@@ -0,0 +1,228 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * CPU/NUMA topology used to place the rasterizer threads.
+ *
+ * On Linux the NUMA nodes and their CPUs are read from sysfs.  Elsewhere,
+ * or when sysfs is not available, all CPUs are assumed to be on a single
+ * node.
+ */
+
+#include <stdio.h>
+
+#include "c11/threads.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_math.h"
+#include "util/u_string.h"
+#include "lp_topology.h"
+
+
+#define LP_TOPOLOGY_MAX_NODES 64
+#define LP_TOPOLOGY_MAX_CPUS  1024
+
+
+static struct {
+   unsigned num_nodes;
+   unsigned num_cpus;
+   /** cpus[node_first[n] .. node_first[n + 1]) are the CPUs of node n */
+   unsigned node_first[LP_TOPOLOGY_MAX_NODES + 1];
+   unsigned cpus[LP_TOPOLOGY_MAX_CPUS];
+} topology;
+
+
+#if defined(PIPE_OS_LINUX)
+
+/**
+ * Parse a sysfs CPU list such as "0-7,16-23".
+ * Returns the number of CPUs stored in cpus.
+ */
+static unsigned
+read_cpu_list(const char *path, unsigned *cpus, unsigned max_cpus)
+{
+   FILE *f = fopen(path, "r");
+   unsigned n = 0;
+   unsigned first, last;
+
+   if (!f)
+      return 0;
+
+   while (fscanf(f, "%u", &first) == 1) {
+      int c = fgetc(f);
+
+      last = first;
+      if (c == '-') {
+         if (fscanf(f, "%u", &last) != 1)
+            break;
+         c = fgetc(f);
+      }
+      for (; first <= last && n < max_cpus; first++)
+         cpus[n++] = first;
+      if (c != ',')
+         break;
+   }
+
+   fclose(f);
+   return n;
+}
+
+
+/**
+ * Whether the CPU is the first hardware thread of its core.
+ */
+static boolean
+is_primary_thread(unsigned cpu)
+{
+   char path[128];
+   unsigned siblings[1];
+
+   util_snprintf(path, sizeof path,
+                 "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list",
+                 cpu);
+   if (!read_cpu_list(path, siblings, 1))
+      return TRUE;
+
+   return siblings[0] == cpu;
+}
+
+
+/**
+ * Append the CPUs of each NUMA node to the topology, listing the first
+ * hardware thread of every core before the SMT siblings so that threads
+ * spread over physical cores first.
+ */
+static void
+detect_numa_nodes(void)
+{
+   unsigned node;
+
+   for (node = 0; node < LP_TOPOLOGY_MAX_NODES; node++) {
+      unsigned node_cpus[LP_TOPOLOGY_MAX_CPUS];
+      unsigned first = topology.num_cpus;
+      unsigned n, i, pass;
+      char path[128];
+
+      util_snprintf(path, sizeof path,
+                    "/sys/devices/system/node/node%u/cpulist", node);
+      n = read_cpu_list(path, node_cpus,
+                        LP_TOPOLOGY_MAX_CPUS - topology.num_cpus);
+      if (!n)
+         continue;
+
+      for (pass = 0; pass < 2; pass++) {
+         for (i = 0; i < n; i++) {
+            if (is_primary_thread(node_cpus[i]) == (pass == 0))
+               topology.cpus[topology.num_cpus++] = node_cpus[i];
+         }
+      }
+
+      topology.node_first[topology.num_nodes++] = first;
+   }
+   topology.node_first[topology.num_nodes] = topology.num_cpus;
+}
+
+#endif /* PIPE_OS_LINUX */
+
+
+static void
+detect_topology(void)
+{
+   unsigned i;
+
+   util_cpu_detect();
+
+#if defined(PIPE_OS_LINUX)
+   detect_numa_nodes();
+#endif
+
+   if (!topology.num_nodes) {
+      topology.num_cpus = MIN2(util_cpu_caps.nr_cpus, LP_TOPOLOGY_MAX_CPUS);
+      for (i = 0; i < topology.num_cpus; i++)
+         topology.cpus[i] = i;
+      topology.num_nodes = 1;
+      topology.node_first[0] = 0;
+      topology.node_first[1] = topology.num_cpus;
+   }
+}
+
+
+static void
+get_topology(void)
+{
+   static once_flag once = ONCE_FLAG_INIT;
+
+   call_once(&once, detect_topology);
+}
+
+
+/**
+ * Number of NUMA nodes with CPUs in the system.
+ */
+unsigned
+lp_topology_num_nodes(void)
+{
+   get_topology();
+   return topology.num_nodes;
+}
+
+
+/**
+ * Choose a CPU and NUMA node for each of num_threads rasterizer threads.
+ *
+ * Threads are spread over the nodes in proportion to their number of
+ * CPUs, and consecutive thread indices are kept on the same node.  As
+ * consecutive threads rasterize neighbouring parts of the bin curve this
+ * keeps shared texture and framebuffer cache lines within a node.  Threads
+ * in excess of a node's CPUs are left unbound.
+ */
+void
+lp_topology_place_threads(struct lp_thread_placement *placement,
+                          unsigned num_threads)
+{
+   unsigned node, t = 0;
+
+   get_topology();
+
+   for (node = 0; node < topology.num_nodes; node++) {
+      unsigned first = topology.node_first[node];
+      unsigned node_cpus = topology.node_first[node + 1] - first;
+      unsigned end = topology.num_cpus ?
+         (unsigned)((uint64_t)num_threads * topology.node_first[node + 1] /
+                    topology.num_cpus) : num_threads;
+      unsigned k;
+
+      for (k = 0; t < end; t++, k++) {
+         placement[t].cpu = k < node_cpus ? (int)topology.cpus[first + k] : -1;
+         placement[t].node = node;
+      }
+   }
+
+   for (; t < num_threads; t++) {
+      placement[t].cpu = -1;
+      placement[t].node = 0;
+   }
+}
@@ -0,0 +1,54 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * CPU/NUMA topology used to place the rasterizer threads.
+ */
+
+#ifndef LP_TOPOLOGY_H
+#define LP_TOPOLOGY_H
+
+#include "pipe/p_compiler.h"
+
+
+/** Where a rasterizer thread should run */
+struct lp_thread_placement
+{
+   int cpu;          /**< CPU to bind the thread to, or -1 for any */
+   unsigned node;    /**< NUMA node of that CPU */
+};
+
+
+unsigned
+lp_topology_num_nodes(void);
+
+void
+lp_topology_place_threads(struct lp_thread_placement *placement,
+                          unsigned num_threads);
+
+
+#endif /* LP_TOPOLOGY_H */
@@ -73,6 +73,18 @@ HANDLE SwrCreateContext(
     pContext->driverType = pCreateInfo->driver;
     pContext->privateStateSize = pCreateInfo->privateStateSize;
 
+    // The rings are indexed with drawId % KNOB_MAX_DRAWS_IN_FLIGHT, which
+    // only stays consistent across drawId wrap-around for powers of two.
+    if (!IsPow2(KNOB_MAX_DRAWS_IN_FLIGHT))
+    {
+        uint32_t numDraws = 1;
+        while (numDraws < KNOB_MAX_DRAWS_IN_FLIGHT)
+        {
+            numDraws <<= 1;
+        }
+        SET_KNOB(MAX_DRAWS_IN_FLIGHT, numDraws);
+    }
+
     pContext->dcRing.Init(KNOB_MAX_DRAWS_IN_FLIGHT);
     pContext->dsRing.Init(KNOB_MAX_DRAWS_IN_FLIGHT);
 
@@ -103,6 +115,10 @@ HANDLE SwrCreateContext(
     memset(&pContext->FifosNotEmpty, 0, sizeof(pContext->FifosNotEmpty));
     new (&pContext->WaitLock) std::mutex();
     new (&pContext->FifosNotEmpty) std::condition_variable();
+    memset(&pContext->RetireLock, 0, sizeof(pContext->RetireLock));
+    memset(&pContext->DrawRetired, 0, sizeof(pContext->DrawRetired));
+    new (&pContext->RetireLock) std::mutex();
+    new (&pContext->DrawRetired) std::condition_variable();
 
     CreateThreadPool(pContext, &pContext->threadPool);
 
@@ -468,6 +484,53 @@ void SwrWaitForIdleFE(HANDLE hContext)
     RDTSC_STOP(APIWaitForIdle, 1, 0);
 }
 
+uint32_t SwrGetLastDrawId(HANDLE hContext)
+{
+    SWR_CONTEXT *pContext = GetContext(hContext);
+
+    // Draw IDs are taken from the ring head when the DC is set up.
+    return pContext->dcRing.GetHead() - 1;
+}
+
+bool SwrIsDrawRetired(HANDLE hContext, uint32_t drawId)
+{
+    SWR_CONTEXT *pContext = GetContext(hContext);
+
+    // The tail only moves past a draw once all earlier draws have retired
+    // too.  An empty ring also covers IDs too old to compare against the tail.
+    uint32_t tail = pContext->dcRing.GetTail();
+    return pContext->dcRing.IsEmpty() || (int32_t(drawId - tail) < 0);
+}
+
+void SwrWaitForDraw(HANDLE hContext, uint32_t drawId)
+{
+    SWR_CONTEXT *pContext = GetContext(hContext);
+
+    RDTSC_START(APIWaitForIdle);
+
+    // Spin for a while like the workers waiting for work, then sleep until
+    // the draw retires.
+    uint32_t loop = 0;
+    while (loop++ < KNOB_WORKER_SPIN_LOOP_COUNT && !SwrIsDrawRetired(hContext, drawId))
+    {
+        _mm_pause();
+    }
+
+    if (!SwrIsDrawRetired(hContext, drawId))
+    {
+        std::unique_lock<std::mutex> lock(pContext->RetireLock);
+
+        // Workers only signal retired draws while someone is waiting.
+        // Registering is a full barrier, so either the worker retiring the
+        // draw sees us, or we see the draw retired.
+        InterlockedIncrement((volatile LONG*)&pContext->drawRetireWaiters);
+        pContext->DrawRetired.wait(lock, [&] { return SwrIsDrawRetired(hContext, drawId); });
+        InterlockedDecrement((volatile LONG*)&pContext->drawRetireWaiters);
+    }
+
+    RDTSC_STOP(APIWaitForIdle, 1, 0);
+}
+
 void SwrSetVertexBuffers(
     HANDLE hContext,
     uint32_t numBuffers,
@@ -274,6 +274,31 @@ void SWR_API SwrWaitForIdle(
 void SWR_API SwrWaitForIdleFE(
     HANDLE hContext);
 
+//////////////////////////////////////////////////////////////////////////
+/// @brief Returns the ID of the most recently queued draw, clear, store
+///        or sync.  Work is retired in ID order.
+/// @param hContext - Handle passed back from SwrCreateContext
+uint32_t SWR_API SwrGetLastDrawId(
+    HANDLE hContext);
+
+//////////////////////////////////////////////////////////////////////////
+/// @brief Returns true if the draw has retired, i.e. its memory accesses
+///        are complete.
+/// @param hContext - Handle passed back from SwrCreateContext
+/// @param drawId - ID returned by SwrGetLastDrawId
+bool SWR_API SwrIsDrawRetired(
+    HANDLE hContext,
+    uint32_t drawId);
+
+//////////////////////////////////////////////////////////////////////////
+/// @brief Blocks until the draw has retired.  Unlike SwrWaitForIdle, work
+///        queued after the draw is left running.
+/// @param hContext - Handle passed back from SwrCreateContext
+/// @param drawId - ID returned by SwrGetLastDrawId
+void SWR_API SwrWaitForDraw(
+    HANDLE hContext,
+    uint32_t drawId);
+
 //////////////////////////////////////////////////////////////////////////
 /// @brief Set vertex buffer state.
 /// @param hContext - Handle passed back from SwrCreateContext
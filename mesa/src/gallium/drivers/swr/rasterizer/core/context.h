@@ -478,6 +478,11 @@ struct SWR_CONTEXT
     std::condition_variable FifosNotEmpty;
     std::mutex WaitLock;
 
+    // Signaled as draws retire while an API thread waits in SwrWaitForDraw
+    std::condition_variable DrawRetired;
+    std::mutex RetireLock;
+    volatile int32_t drawRetireWaiters;
+
     DRIVER_TYPE driverType;
 
     uint32_t privateStateSize;
@@ -373,6 +373,13 @@ INLINE int32_t CompleteDrawContextInl(SWR_CONTEXT* pContext, DRAW_CONTEXT* pDC)
         _ReadWriteBarrier();
 
         pContext->dcRing.Dequeue();  // Remove from tail
+
+        // Dequeue is a full barrier, see SwrWaitForDraw
+        if (pContext->drawRetireWaiters > 0)
+        {
+            std::lock_guard<std::mutex> lock(pContext->RetireLock);
+            pContext->DrawRetired.notify_all();
+        }
     }
 
     return result;
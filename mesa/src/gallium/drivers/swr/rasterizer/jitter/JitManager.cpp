@@ -45,6 +45,7 @@
 
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/MD5.h"
 
 #include "llvm/Analysis/CFGPrinter.h"
 #include "llvm/IRReader/IRReader.h"
@@ -61,6 +62,9 @@
 
 #include "state_llvm.h"
 
+#include "util/disk_cache.h"
+#include "util/mesa-sha1.h"
+
 #include <sstream>
 #if defined(_WIN32)
 #include <psapi.h>
@@ -163,6 +167,12 @@ JitManager::JitManager(uint32_t simdWidth, const char *arch, const char* core)
 
     mpExec = EB.create();
 
+    if (KNOB_JIT_ENABLE_CACHE)
+    {
+        mCache.Init(hostCPUName.str());
+        mpExec->setObjectCache(&mCache);
+    }
+
 #if LLVM_USE_INTEL_JITEVENTS
     JITEventListener *vTune = JITEventListener::createIntelJITEventListener();
     mpExec->RegisterJITEventListener(vTune);
@@ -265,6 +275,53 @@ bool JitManager::SetupModuleFromIR(const uint8_t *pIR)
     return true;
 }
 
+//////////////////////////////////////////////////////////////////////////
+/// @brief Print the IR of a module, leaving out the module name, which
+///        comes from a per-process counter.
+static std::string GetStableIR(const Module* pModule)
+{
+    std::string ir;
+    raw_string_ostream irStream(ir);
+    pModule->print(irStream, nullptr);
+    irStream.flush();
+
+    std::string stableIR;
+    StringRef rest(ir);
+    while (!rest.empty())
+    {
+        std::pair<StringRef, StringRef> line = rest.split('\n');
+        if (!line.first.startswith("; ModuleID") && !line.first.startswith("source_filename"))
+        {
+            stableIR += line.first;
+            stableIR += '\n';
+        }
+        rest = line.second;
+    }
+
+    return stableIR;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// @brief Rename a finished function after a hash of its module's IR.
+///        Names built from a per-process counter differ from run to run,
+///        which would keep the JitCache from ever finding them again.
+/// @param pFunction - the only function defined in mpCurrentModule
+/// @param prefix - readable part of the name, e.g. "FetchShader"
+void JitManager::SetStableName(Function* pFunction, const char* prefix)
+{
+    pFunction->setName(prefix);
+
+    MD5 hash;
+    hash.update(GetStableIR(pFunction->getParent()));
+
+    MD5::MD5Result result;
+    hash.final(result);
+    SmallString<32> digest;
+    MD5::stringifyResult(result, digest);
+
+    pFunction->setName(Twine(prefix) + "_" + digest.str());
+}
+
 //////////////////////////////////////////////////////////////////////////
 /// @brief Dump function x86 assembly to file.
 /// @note This should only be called after the module has been jitted to x86 and the
@@ -375,3 +432,84 @@ extern "C"
         }
     }
 }
+
+//////////////////////////////////////////////////////////////////////////
+/// JitCache
+//////////////////////////////////////////////////////////////////////////
+
+static const uint32_t JIT_CACHE_VERSION = 1;
+
+JitCache::~JitCache()
+{
+    disk_cache_destroy(mpCache);
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// @brief Open the on-disk cache.  Caching stays off if it can't be used.
+/// @param cpu - target CPU name the JitManager generates code for
+void JitCache::Init(const std::string& cpu)
+{
+    mCpu = cpu;
+
+    disk_cache_destroy(mpCache);
+    mpCache = disk_cache_create(KNOB_JIT_CACHE_DIR.empty() ? nullptr : KNOB_JIT_CACHE_DIR.c_str(),
+                                "swr", (uint64_t)KNOB_JIT_CACHE_SIZE << 20);
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// @brief Cache key: SHA-1 of the module IR, the LLVM version, the target
+///        CPU and the entry format version.
+std::string JitCache::ComputeKey(const Module* M)
+{
+    std::stringstream target;
+    target << "llvm-" << LLVM_VERSION_MAJOR << "." << LLVM_VERSION_MINOR << "." << LLVM_VERSION_PATCH
+           << " cpu-" << mCpu << " v" << JIT_CACHE_VERSION;
+
+    std::string data = GetStableIR(M) + target.str();
+
+    unsigned char key[DISK_CACHE_KEY_SIZE];
+    _mesa_sha1_compute(data.data(), data.size(), key);
+
+    return std::string((const char*)key, sizeof(key));
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// @brief Called by MCJIT before compiling a module.  Returns the cached
+///        object, or null to have the module compiled.
+std::unique_ptr<MemoryBuffer> JitCache::getObject(const Module* M)
+{
+    if (mpCache == nullptr)
+    {
+        return nullptr;
+    }
+
+    std::string key = ComputeKey(M);
+
+    size_t size;
+    void* pData = disk_cache_get(mpCache, (const unsigned char*)key.data(), &size);
+    if (pData == nullptr)
+    {
+        mModuleKeys[M] = key;
+        return nullptr;
+    }
+
+    std::unique_ptr<MemoryBuffer> obj =
+        MemoryBuffer::getMemBufferCopy(StringRef((const char*)pData, size), M->getModuleIdentifier());
+    free(pData);
+    return obj;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// @brief Called by MCJIT after compiling a module that missed the cache.
+void JitCache::notifyObjectCompiled(const Module* M, MemoryBufferRef Obj)
+{
+    auto it = mModuleKeys.find(M);
+    if (it == mModuleKeys.end())
+    {
+        return;
+    }
+
+    disk_cache_put(mpCache, (const unsigned char*)it->second.data(),
+                   Obj.getBufferStart(), Obj.getBufferSize());
+    mModuleKeys.erase(it);
+}
@@ -32,6 +32,9 @@
 #include "common/os.h"
 #include "common/isa.hpp"
 
+#include <string>
+#include <unordered_map>
+
 #if defined(_WIN32)
 #pragma warning(disable : 4146 4244 4267 4800 4996)
 #endif
@@ -76,6 +79,7 @@ using PassManager = llvm::legacy::PassManager;
 
 #include "llvm/CodeGen/Passes.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Transforms/IPO.h"
@@ -141,6 +145,35 @@ struct JitLLVMContext : LLVMContext
 };
 
 
+struct disk_cache;
+
+//////////////////////////////////////////////////////////////////////////
+/// JitCache
+/// @brief MCJIT object cache on top of Mesa's on-disk cache (util/disk_cache),
+/// shared by all contexts and processes.  Entries are keyed by a hash of the
+/// module IR, the LLVM version and the target CPU, so a cached object is only
+/// reused for the same code on the same ISA.
+//////////////////////////////////////////////////////////////////////////
+class JitCache : public ObjectCache
+{
+public:
+    JitCache() : mpCache(nullptr) {};
+    virtual ~JitCache();
+
+    void Init(const std::string& cpu);
+
+    virtual void notifyObjectCompiled(const Module* M, MemoryBufferRef Obj);
+    virtual std::unique_ptr<MemoryBuffer> getObject(const Module* M);
+
+private:
+    std::string ComputeKey(const Module* M);
+
+    std::string mCpu;
+    struct disk_cache* mpCache;
+    std::unordered_map<const Module*, std::string> mModuleKeys;
+};
+
+
 //////////////////////////////////////////////////////////////////////////
 /// JitManager
 //////////////////////////////////////////////////////////////////////////
@@ -152,6 +185,7 @@ struct JitManager
     JitLLVMContext          mContext;   ///< LLVM compiler
     IRBuilder<>             mBuilder;   ///< LLVM IR Builder
     ExecutionEngine*        mpExec;
+    JitCache                mCache;
 
     // Need to be rebuilt after a JIT and before building new IR
     Module* mpCurrentModule;
@@ -183,6 +217,8 @@ struct JitManager
     void SetupNewModule();
     bool SetupModuleFromIR(const uint8_t *pIR);
 
+    void SetStableName(Function* pFunction, const char* prefix);
+
     void DumpAsm(Function* pFunction, const char* fileName);
     static void DumpToFile(Function *f, const char *fileName);
 };
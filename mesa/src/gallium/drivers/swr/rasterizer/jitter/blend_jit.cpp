@@ -742,6 +742,8 @@ struct BlendJit : public Builder
 
         JitManager::DumpToFile(blendFunc, "optimized");
 
+        JM()->SetStableName(blendFunc, "BlendShader");
+
         return blendFunc;
     }
 };
@@ -220,6 +220,8 @@ Function* FetchJit::Create(const FETCH_COMPILE_STATE& fetchState)
 
     JitManager::DumpToFile(fetch, "opt");
 
+    JM()->SetStableName(fetch, "FetchShader");
+
     return fetch;
 }
 
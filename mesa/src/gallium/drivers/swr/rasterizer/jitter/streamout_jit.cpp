@@ -310,6 +310,8 @@ struct StreamOutJit : public Builder
 
         JitManager::DumpToFile(soFunc, "SoFunc_optimized");
 
+        JM()->SetStableName(soFunc, "SOShader");
+
         return soFunc;
     }
 };
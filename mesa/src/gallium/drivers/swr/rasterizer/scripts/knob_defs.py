@@ -37,6 +37,30 @@ KNOBS = [
         'category'  : 'debug',
     }],
 
+    ['JIT_ENABLE_CACHE', {
+        'type'      : 'bool',
+        'default'   : 'true',
+        'desc'      : ['Keep jitted fetch, blend and streamout code in an on-disk cache,',
+                       'shared by all processes, and reuse it instead of compiling again.'],
+        'category'  : 'perf',
+    }],
+
+    ['JIT_CACHE_DIR', {
+        'type'      : 'std::string',
+        'default'   : '',
+        'desc'      : ['Directory for the jit cache.  Defaults to $XDG_CACHE_HOME/mesa/swr',
+                       'or $HOME/.cache/mesa/swr.'],
+        'category'  : 'perf',
+    }],
+
+    ['JIT_CACHE_SIZE', {
+        'type'      : 'uint32_t',
+        'default'   : '256',
+        'desc'      : ['Maximum size of the jit cache in megabytes.  The least recently',
+                       'used entries are removed when it grows larger.'],
+        'category'  : 'perf',
+    }],
+
     ['USE_GENERIC_STORETILE', {
         'type'      : 'bool',
         'default'   : 'false',
@@ -123,7 +147,7 @@ KNOBS = [
         'type'      : 'uint32_t',
         'default'   : '128',
         'desc'      : ['Maximum number of draws outstanding before API thread blocks.',
-                       'This value MUST be evenly divisible into 2^32'],
+                       'Rounded up to a power of two.'],
         'category'  : 'perf',
     }],
 
@@ -22,6 +22,7 @@
  ***************************************************************************/
 
 #include "swr_context.h"
+#include "swr_resource.h"
 #include "swr_query.h"
 
 static void
@@ -70,6 +71,9 @@ swr_clear(struct pipe_context *pipe,
    swr_update_draw_context(ctx);
    SwrClearRenderTarget(ctx->swrContext, clearMask, color->f, depth, stencil,
                         ctx->swr_scissor);
+
+   /* Record the clear against the render targets */
+   swr_update_resource_status(pipe, NULL);
 }
 
 
@@ -102,7 +102,6 @@ swr_transfer_map(struct pipe_context *pipe,
                  const struct pipe_box *box,
                  struct pipe_transfer **transfer)
 {
-   struct swr_screen *screen = swr_screen(pipe->screen);
    struct swr_resource *spr = swr_resource(resource);
    struct pipe_transfer *pt;
    enum pipe_format format = resource->format;
@@ -116,21 +115,13 @@ swr_transfer_map(struct pipe_context *pipe,
    swr_store_dirty_resource(pipe, resource, SWR_TILE_INVALID);
 
    if (!(usage & PIPE_TRANSFER_UNSYNCHRONIZED)) {
-      /* If resource is in use, finish fence before mapping.
+      /* If resource is in use, wait for the draws using it before mapping.
        * Unless requested not to block, then if not done return NULL map */
       if (usage & PIPE_TRANSFER_DONTBLOCK) {
-         if (swr_is_fence_pending(screen->flush_fence))
+         if (swr_resource_is_busy(pipe, resource))
             return NULL;
       } else {
-         if (spr->status) {
-            /* But, if there's no fence pending, submit one.
-             * XXX: Remove once draw timestamps are finished. */
-            if (!swr_is_fence_pending(screen->flush_fence))
-               swr_fence_submit(swr_context(pipe), screen->flush_fence);
-
-            swr_fence_finish(pipe->screen, NULL, screen->flush_fence, 0);
-            swr_resource_unused(resource);
-         }
+         swr_resource_wait(pipe, resource);
       }
    }
 
@@ -199,15 +190,12 @@ swr_resource_copy(struct pipe_context *pipe,
                   unsigned src_level,
                   const struct pipe_box *src_box)
 {
-   struct swr_screen *screen = swr_screen(pipe->screen);
-
    /* If either the src or dst is a renderTarget, store tiles before copy */
    swr_store_dirty_resource(pipe, src, SWR_TILE_RESOLVED);
    swr_store_dirty_resource(pipe, dst, SWR_TILE_RESOLVED);
 
-   swr_fence_finish(pipe->screen, NULL, screen->flush_fence, 0);
-   swr_resource_unused(src);
-   swr_resource_unused(dst);
+   swr_resource_wait(pipe, src);
+   swr_resource_wait(pipe, dst);
 
    if ((dst->target == PIPE_BUFFER && src->target == PIPE_BUFFER)
        || (dst->target != PIPE_BUFFER && src->target != PIPE_BUFFER)) {
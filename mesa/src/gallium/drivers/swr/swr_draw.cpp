@@ -210,6 +210,9 @@ swr_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
                        info->instance_count,
                        info->start,
                        info->start_instance);
+
+   /* Record the draw against every resource it uses */
+   swr_update_resource_status(pipe, info);
 }
 
 
@@ -293,6 +296,10 @@ swr_store_dirty_resource(struct pipe_context *pipe,
                   pipe, SWR_ATTACHMENT_STENCIL, post_tile_state);
             }
 
+            /* The StoreTiles is now the last use of the resource */
+            spr->swr_ctx = ctx->swrContext;
+            spr->draw_id = SwrGetLastDrawId(ctx->swrContext);
+
             /* This fence signals StoreTiles completion */
             swr_fence_submit(ctx, screen->flush_fence);
 
@@ -301,6 +308,55 @@ swr_store_dirty_resource(struct pipe_context *pipe,
    }
 }
 
+/*
+ * Whether draws queued so far still use the resource.
+ */
+boolean
+swr_resource_is_busy(struct pipe_context *pipe,
+                     struct pipe_resource *resource)
+{
+   struct swr_context *ctx = swr_context(pipe);
+   struct swr_screen *screen = swr_screen(pipe->screen);
+   struct swr_resource *spr = swr_resource(resource);
+
+   if (!spr->status)
+      return FALSE;
+
+   /* Last used on another context, whose draw IDs we can't compare */
+   if (spr->swr_ctx != ctx->swrContext)
+      return swr_is_fence_pending(screen->flush_fence);
+
+   return !SwrIsDrawRetired(ctx->swrContext, spr->draw_id);
+}
+
+/*
+ * Wait until no queued draw uses the resource.  Only the draws up to the
+ * last one that uses it have to retire; later ones keep running.
+ */
+void
+swr_resource_wait(struct pipe_context *pipe,
+                  struct pipe_resource *resource)
+{
+   struct swr_context *ctx = swr_context(pipe);
+   struct swr_screen *screen = swr_screen(pipe->screen);
+   struct swr_resource *spr = swr_resource(resource);
+
+   if (!spr->status)
+      return;
+
+   if (spr->swr_ctx == ctx->swrContext) {
+      SwrWaitForDraw(ctx->swrContext, spr->draw_id);
+   } else {
+      /* Last used on another context, so wait for everything */
+      if (!swr_is_fence_pending(screen->flush_fence))
+         swr_fence_submit(ctx, screen->flush_fence);
+
+      swr_fence_finish(pipe->screen, NULL, screen->flush_fence, 0);
+   }
+
+   swr_resource_unused(resource);
+}
+
 void
 swr_draw_init(struct pipe_context *pipe)
 {
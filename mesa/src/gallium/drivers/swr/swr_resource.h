@@ -54,6 +54,10 @@ struct swr_resource {
    unsigned mip_offsets[PIPE_MAX_TEXTURE_LEVELS];
 
    enum swr_resource_status status;
+
+   /* Last draw queued to swr_ctx which uses the resource */
+   HANDLE swr_ctx;
+   uint32_t draw_id;
 };
 
 
@@ -107,6 +111,12 @@ void swr_store_dirty_resource(struct pipe_context *pipe,
 void swr_update_resource_status(struct pipe_context *,
                                 const struct pipe_draw_info *);
 
+void swr_resource_wait(struct pipe_context *pipe,
+                       struct pipe_resource *resource);
+
+boolean swr_resource_is_busy(struct pipe_context *pipe,
+                             struct pipe_resource *resource);
+
 /*
  * Functions to indicate a resource's in-use status.
  */
@@ -117,15 +127,21 @@ swr_resource_status & operator|=(enum swr_resource_status & a,
 }
 
 static INLINE void
-swr_resource_read(struct pipe_resource *resource)
+swr_resource_read(struct pipe_resource *resource,
+                  HANDLE swr_ctx, uint32_t draw_id)
 {
    swr_resource(resource)->status |= SWR_RESOURCE_READ;
+   swr_resource(resource)->swr_ctx = swr_ctx;
+   swr_resource(resource)->draw_id = draw_id;
 }
 
 static INLINE void
-swr_resource_write(struct pipe_resource *resource)
+swr_resource_write(struct pipe_resource *resource,
+                   HANDLE swr_ctx, uint32_t draw_id)
 {
    swr_resource(resource)->status |= SWR_RESOURCE_WRITE;
+   swr_resource(resource)->swr_ctx = swr_ctx;
+   swr_resource(resource)->draw_id = draw_id;
 }
 
 static INLINE void
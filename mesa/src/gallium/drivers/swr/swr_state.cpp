@@ -640,6 +640,8 @@ swr_set_sample_mask(struct pipe_context *pipe, unsigned sample_mask)
  * Update resource in-use status
  * All resources bound to color or depth targets marked as WRITE resources.
  * VBO Vertex/index buffers and texture views marked as READ resources.
+ * Called after queuing each draw or clear, so that waiting for a resource
+ * only waits for the last draw which used it.
  */
 void
 swr_update_resource_status(struct pipe_context *pipe,
@@ -647,29 +649,31 @@ swr_update_resource_status(struct pipe_context *pipe,
 {
    struct swr_context *ctx = swr_context(pipe);
    struct pipe_framebuffer_state *fb = &ctx->framebuffer;
+   HANDLE swr_ctx = ctx->swrContext;
+   uint32_t draw_id = SwrGetLastDrawId(swr_ctx);
 
    /* colorbuffer targets */
    if (fb->nr_cbufs)
       for (uint32_t i = 0; i < fb->nr_cbufs; ++i)
          if (fb->cbufs[i])
-            swr_resource_write(fb->cbufs[i]->texture);
+            swr_resource_write(fb->cbufs[i]->texture, swr_ctx, draw_id);
 
    /* depth/stencil target */
    if (fb->zsbuf)
-      swr_resource_write(fb->zsbuf->texture);
+      swr_resource_write(fb->zsbuf->texture, swr_ctx, draw_id);
 
    /* VBO vertex buffers */
    for (uint32_t i = 0; i < ctx->num_vertex_buffers; i++) {
       struct pipe_vertex_buffer *vb = &ctx->vertex_buffer[i];
       if (!vb->user_buffer)
-         swr_resource_read(vb->buffer);
+         swr_resource_read(vb->buffer, swr_ctx, draw_id);
    }
 
    /* VBO index buffer */
    if (p_draw_info && p_draw_info->indexed) {
       struct pipe_index_buffer *ib = &ctx->index_buffer;
       if (!ib->user_buffer)
-         swr_resource_read(ib->buffer);
+         swr_resource_read(ib->buffer, swr_ctx, draw_id);
    }
 
    /* texture sampler views */
@@ -677,7 +681,7 @@ swr_update_resource_status(struct pipe_context *pipe,
       struct pipe_sampler_view *view =
          ctx->sampler_views[PIPE_SHADER_FRAGMENT][i];
       if (view)
-         swr_resource_read(view->texture);
+         swr_resource_read(view->texture, swr_ctx, draw_id);
    }
 }
 
@@ -1393,9 +1397,6 @@ swr_update_derived(struct pipe_context *pipe,
    if (swr_is_fence_pending(screen->flush_fence))
       swr_fence_finish(pipe->screen, NULL, screen->flush_fence, 0);
 
-   /* Finally, update the in-use status of all resources involved in draw */
-   swr_update_resource_status(pipe, p_draw_info);
-
    ctx->dirty = post_update_dirty_flags;
 }
 
@@ -2546,7 +2546,7 @@ vc4_update_compiled_fs(struct vc4_context *vc4, uint8_t prim_mode)
         } else {
                 key->logicop_func = PIPE_LOGICOP_COPY;
         }
-        if (vc4->msaa) {
+        if (vc4->job->msaa) {
                 key->msaa = vc4->rasterizer->base.multisample;
                 key->sample_coverage = (vc4->rasterizer->base.multisample &&
                                         vc4->sample_mask != (1 << VC4_MAX_SAMPLES) - 1);
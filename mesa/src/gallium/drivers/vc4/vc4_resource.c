@@ -22,6 +22,7 @@
  * IN THE SOFTWARE.
  */
 
+#include "util/hash_table.h"
 #include "util/u_blit.h"
 #include "util/u_memory.h"
 #include "util/u_format.h"
@@ -115,7 +116,7 @@ vc4_resource_transfer_unmap(struct pipe_context *pctx,
                 blit.filter = PIPE_TEX_FILTER_NEAREST;
 
                 pctx->blit(pctx, &blit);
-                vc4_flush(pctx);
+                vc4_flush_jobs_writing_resource(vc4, blit.dst.resource);
 
                 pipe_resource_reference(&trans->ss_resource, NULL);
         }
@@ -142,6 +143,41 @@ vc4_get_temp_resource(struct pipe_context *pctx,
         return pctx->screen->resource_create(pctx->screen, &temp_setup);
 }
 
+/**
+ * Returns whether queued rendering writes the resource or, if include_reads
+ * is set, references it at all.
+ *
+ * This helps avoid flushing the command buffers when unnecessary.
+ */
+static bool
+vc4_resource_is_busy(struct vc4_context *vc4, struct pipe_resource *prsc,
+                     bool include_reads)
+{
+        struct vc4_resource *rsc = vc4_resource(prsc);
+
+        if (_mesa_hash_table_search(vc4->write_jobs, prsc))
+                return true;
+
+        if (!include_reads)
+                return false;
+
+        /* Walk all the referenced BOs in the drawing command lists to see if
+         * they match.
+         */
+        struct hash_entry *entry;
+        hash_table_foreach(vc4->jobs, entry) {
+                struct vc4_job *job = entry->data;
+                struct vc4_bo **referenced_bos = job->bo_pointers.base;
+
+                for (int i = 0; i < cl_offset(&job->bo_handles) / 4; i++) {
+                        if (referenced_bos[i] == rsc->bo)
+                                return true;
+                }
+        }
+
+        return false;
+}
+
 static void *
 vc4_resource_transfer_map(struct pipe_context *pctx,
                           struct pipe_resource *prsc,
@@ -175,7 +211,7 @@ vc4_resource_transfer_map(struct pipe_context *pctx,
                  * have to flush the CL first.  If we're only reading, we need
                  * to flush if the CL has written our buffer.
                  */
-                if (vc4_cl_references_bo(pctx, rsc->bo,
+                if (vc4_resource_is_busy(vc4, prsc,
                                          usage & PIPE_TRANSFER_WRITE)) {
                         if ((usage & PIPE_TRANSFER_DISCARD_RANGE) &&
                             prsc->last_level == 0 &&
@@ -185,8 +221,10 @@ vc4_resource_transfer_map(struct pipe_context *pctx,
                             vc4_resource_bo_alloc(rsc)) {
                                 if (prsc->bind & PIPE_BIND_VERTEX_BUFFER)
                                         vc4->dirty |= VC4_DIRTY_VTXBUF;
+                        } else if (usage & PIPE_TRANSFER_WRITE) {
+                                vc4_flush_jobs_reading_resource(vc4, prsc);
                         } else {
-                                vc4_flush(pctx);
+                                vc4_flush_jobs_writing_resource(vc4, prsc);
                         }
                 }
         }
@@ -242,7 +280,8 @@ vc4_resource_transfer_map(struct pipe_context *pctx,
                         blit.filter = PIPE_TEX_FILTER_NEAREST;
 
                         pctx->blit(pctx, &blit);
-                        vc4_flush(pctx);
+                        vc4_flush_jobs_writing_resource(vc4,
+                                                        blit.dst.resource);
                 }
 
                 /* The rest of the mapping process should use our temporary. */
@@ -411,6 +411,15 @@ struct st_context_iface
     */
    boolean (*get_resource_for_egl_image)(struct st_context_iface *stctxi,
                                          struct st_context_resource *stres);
+
+   /**
+    * Wait until the GL calls made so far have been executed.  Must be
+    * called before using the pipe context directly, since the calls may
+    * run on another thread.
+    *
+    * This function is optional.
+    */
+   void (*thread_finish)(struct st_context_iface *stctxi);
 };
 
 
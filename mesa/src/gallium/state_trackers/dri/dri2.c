@@ -1225,6 +1225,9 @@ dri2_blit_image(__DRIcontext *context, __DRIimage *dst, __DRIimage *src,
    if (!dst || !src)
       return;
 
+   if (ctx->st->thread_finish)
+      ctx->st->thread_finish(ctx->st);
+
    memset(&blit, 0, sizeof(blit));
    blit.dst.resource = dst->texture;
    blit.dst.box.x = dstx0;
@@ -1271,6 +1274,9 @@ dri2_map_image(__DRIcontext *context, __DRIimage *image,
    if (!image || !data || *data)
       return NULL;
 
+   if (ctx->st->thread_finish)
+      ctx->st->thread_finish(ctx->st);
+
    if (flags & __DRI_IMAGE_TRANSFER_READ)
          pipe_access |= PIPE_TRANSFER_READ;
    if (flags & __DRI_IMAGE_TRANSFER_WRITE)
@@ -1293,6 +1299,9 @@ dri2_unmap_image(__DRIcontext *context, __DRIimage *image, void *data)
    struct dri_context *ctx = dri_context(context);
    struct pipe_context *pipe = ctx->st->pipe;
 
+   if (ctx->st->thread_finish)
+      ctx->st->thread_finish(ctx->st);
+
    pipe_transfer_unmap(pipe, (struct pipe_transfer *)data);
 }
 
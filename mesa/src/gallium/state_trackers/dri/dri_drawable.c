@@ -451,6 +451,9 @@ dri_flush(__DRIcontext *cPriv,
       return;
    }
 
+   if (ctx->st->thread_finish)
+      ctx->st->thread_finish(ctx->st);
+
    if (drawable) {
       /* prevent recursion */
       if (drawable->flushing)
@@ -0,0 +1,350 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Measures how the throughput of a software rasterizer scales with its
+ * number of threads.  For every thread count a new screen is created with
+ * LP_NUM_THREADS set accordingly, and a full HD frame of overlapping
+ * triangles is drawn repeatedly.
+ *
+ * Usage: tri-scaling [threads...]
+ *
+ * Without arguments powers of two up to the number of CPUs are measured.
+ * Use GALLIUM_DRIVER to choose the software driver (llvmpipe by default).
+ */
+
+#define WIDTH 1920
+#define HEIGHT 1080
+#define NUM_TRIS 20000
+#define TRI_SIZE 0.1f
+#define NUM_FRAMES 50
+#define MAX_RUNS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* pipe_*_state structs */
+#include "pipe/p_state.h"
+/* pipe_context */
+#include "pipe/p_context.h"
+/* pipe_screen */
+#include "pipe/p_screen.h"
+/* PIPE_* */
+#include "pipe/p_defines.h"
+/* TGSI_SEMANTIC_{POSITION|GENERIC} */
+#include "pipe/p_shader_tokens.h"
+/* pipe_buffer_* helpers */
+#include "util/u_inlines.h"
+
+/* constant state object helper */
+#include "cso_cache/cso_context.h"
+
+/* util_draw_vertex_buffer helper */
+#include "util/u_draw_quad.h"
+/* FREE & CALLOC_STRUCT */
+#include "util/u_memory.h"
+/* util_make_[fragment|vertex]_passthrough_shader */
+#include "util/u_simple_shaders.h"
+/* util_cpu_caps */
+#include "util/u_cpu_detect.h"
+/* os_time_get */
+#include "os/os_time.h"
+/* to get a software pipe driver */
+#include "pipe-loader/pipe_loader.h"
+
+struct program
+{
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	struct pipe_context *pipe;
+	struct cso_context *cso;
+
+	struct pipe_blend_state blend;
+	struct pipe_depth_stencil_alpha_state depthstencil;
+	struct pipe_rasterizer_state rasterizer;
+	struct pipe_viewport_state viewport;
+	struct pipe_framebuffer_state framebuffer;
+	struct pipe_vertex_element velem[2];
+
+	void *vs;
+	void *fs;
+
+	union pipe_color_union clear_color;
+
+	struct pipe_resource *vbuf;
+	struct pipe_resource *target;
+};
+
+static float frand(void)
+{
+	return (float)rand() / (float)RAND_MAX;
+}
+
+static boolean init_prog(struct program *p, unsigned num_threads)
+{
+	struct pipe_surface surf_tmpl;
+	char value[16];
+
+	/* the thread count is read when the screen is created */
+	snprintf(value, sizeof(value), "%u", num_threads);
+	setenv("LP_NUM_THREADS", value, 1);
+
+	if (!pipe_loader_sw_probe_null(&p->dev))
+		return FALSE;
+
+	p->screen = pipe_loader_create_screen(p->dev);
+	if (!p->screen)
+		return FALSE;
+
+	p->pipe = p->screen->context_create(p->screen, NULL, 0);
+	p->cso = cso_create_context(p->pipe);
+
+	p->clear_color.f[0] = 0.3;
+	p->clear_color.f[1] = 0.1;
+	p->clear_color.f[2] = 0.3;
+	p->clear_color.f[3] = 1.0;
+
+	/* vertex buffer: the same random triangles for every run */
+	{
+		unsigned size = NUM_TRIS * 3 * 2 * 4 * sizeof(float);
+		float *vertices = MALLOC(size);
+		float *v = vertices;
+		unsigned i, j;
+
+		srand(0);
+		for (i = 0; i < NUM_TRIS; i++) {
+			float x = frand() * (2.0f - TRI_SIZE) - 1.0f;
+			float y = frand() * (2.0f - TRI_SIZE) - 1.0f;
+
+			for (j = 0; j < 3; j++) {
+				/* position */
+				*v++ = x + (j == 1 ? TRI_SIZE : 0.0f);
+				*v++ = y + (j == 2 ? TRI_SIZE : 0.0f);
+				*v++ = 0.0f;
+				*v++ = 1.0f;
+				/* color */
+				*v++ = frand();
+				*v++ = frand();
+				*v++ = frand();
+				*v++ = 1.0f;
+			}
+		}
+
+		p->vbuf = pipe_buffer_create(p->screen, PIPE_BIND_VERTEX_BUFFER,
+					     PIPE_USAGE_DEFAULT, size);
+		pipe_buffer_write(p->pipe, p->vbuf, 0, size, vertices);
+		FREE(vertices);
+	}
+
+	/* render target texture */
+	{
+		struct pipe_resource tmplt;
+		memset(&tmplt, 0, sizeof(tmplt));
+		tmplt.target = PIPE_TEXTURE_2D;
+		tmplt.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+		tmplt.width0 = WIDTH;
+		tmplt.height0 = HEIGHT;
+		tmplt.depth0 = 1;
+		tmplt.array_size = 1;
+		tmplt.last_level = 0;
+		tmplt.bind = PIPE_BIND_RENDER_TARGET;
+
+		p->target = p->screen->resource_create(p->screen, &tmplt);
+	}
+
+	/* alpha blending, so that every triangle is actually shaded */
+	memset(&p->blend, 0, sizeof(p->blend));
+	p->blend.rt[0].blend_enable = 1;
+	p->blend.rt[0].rgb_func = PIPE_BLEND_ADD;
+	p->blend.rt[0].rgb_src_factor = PIPE_BLENDFACTOR_SRC_ALPHA;
+	p->blend.rt[0].rgb_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+	p->blend.rt[0].alpha_func = PIPE_BLEND_ADD;
+	p->blend.rt[0].alpha_src_factor = PIPE_BLENDFACTOR_ONE;
+	p->blend.rt[0].alpha_dst_factor = PIPE_BLENDFACTOR_ZERO;
+	p->blend.rt[0].colormask = PIPE_MASK_RGBA;
+
+	memset(&p->depthstencil, 0, sizeof(p->depthstencil));
+
+	memset(&p->rasterizer, 0, sizeof(p->rasterizer));
+	p->rasterizer.cull_face = PIPE_FACE_NONE;
+	p->rasterizer.half_pixel_center = 1;
+	p->rasterizer.bottom_edge_rule = 1;
+	p->rasterizer.depth_clip = 1;
+
+	surf_tmpl.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	surf_tmpl.u.tex.level = 0;
+	surf_tmpl.u.tex.first_layer = 0;
+	surf_tmpl.u.tex.last_layer = 0;
+	memset(&p->framebuffer, 0, sizeof(p->framebuffer));
+	p->framebuffer.width = WIDTH;
+	p->framebuffer.height = HEIGHT;
+	p->framebuffer.nr_cbufs = 1;
+	p->framebuffer.cbufs[0] = p->pipe->create_surface(p->pipe, p->target, &surf_tmpl);
+
+	p->viewport.scale[0] = (float)WIDTH / 2.0f;
+	p->viewport.scale[1] = (float)HEIGHT / 2.0f;
+	p->viewport.scale[2] = 0.5f;
+	p->viewport.translate[0] = (float)WIDTH / 2.0f;
+	p->viewport.translate[1] = (float)HEIGHT / 2.0f;
+	p->viewport.translate[2] = 0.5f;
+
+	memset(p->velem, 0, sizeof(p->velem));
+	p->velem[0].src_offset = 0 * 4 * sizeof(float);
+	p->velem[0].vertex_buffer_index = 0;
+	p->velem[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	p->velem[1].src_offset = 1 * 4 * sizeof(float);
+	p->velem[1].vertex_buffer_index = 0;
+	p->velem[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	{
+		const uint semantic_names[] = { TGSI_SEMANTIC_POSITION,
+						TGSI_SEMANTIC_COLOR };
+		const uint semantic_indexes[] = { 0, 0 };
+		p->vs = util_make_vertex_passthrough_shader(p->pipe, 2, semantic_names, semantic_indexes, FALSE);
+	}
+
+	p->fs = util_make_fragment_passthrough_shader(p->pipe,
+		    TGSI_SEMANTIC_COLOR, TGSI_INTERPOLATE_PERSPECTIVE, TRUE);
+
+	return TRUE;
+}
+
+static void close_prog(struct program *p)
+{
+	if (p->cso)
+		cso_destroy_context(p->cso);
+
+	if (p->pipe) {
+		p->pipe->delete_vs_state(p->pipe, p->vs);
+		p->pipe->delete_fs_state(p->pipe, p->fs);
+
+		pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+		pipe_resource_reference(&p->target, NULL);
+		pipe_resource_reference(&p->vbuf, NULL);
+
+		p->pipe->destroy(p->pipe);
+	}
+	if (p->screen)
+		p->screen->destroy(p->screen);
+	if (p->dev)
+		pipe_loader_release(&p->dev, 1);
+
+	memset(p, 0, sizeof(*p));
+}
+
+static void draw_frame(struct program *p)
+{
+	struct pipe_fence_handle *fence = NULL;
+
+	cso_set_framebuffer(p->cso, &p->framebuffer);
+
+	p->pipe->clear(p->pipe, PIPE_CLEAR_COLOR, &p->clear_color, 0, 0);
+
+	cso_set_blend(p->cso, &p->blend);
+	cso_set_depth_stencil_alpha(p->cso, &p->depthstencil);
+	cso_set_rasterizer(p->cso, &p->rasterizer);
+	cso_set_viewport(p->cso, &p->viewport);
+
+	cso_set_fragment_shader_handle(p->cso, p->fs);
+	cso_set_vertex_shader_handle(p->cso, p->vs);
+
+	cso_set_vertex_elements(p->cso, 2, p->velem);
+
+	util_draw_vertex_buffer(p->pipe, p->cso,
+	                        p->vbuf, 0, 0,
+	                        PIPE_PRIM_TRIANGLES,
+	                        2,             /* attribs/vert */
+	                        NUM_TRIS * 3); /* verts */
+
+	/* wait for the rasterizer, not just for binning */
+	p->pipe->flush(p->pipe, &fence, 0);
+	p->screen->fence_finish(p->screen, NULL, fence, PIPE_TIMEOUT_INFINITE);
+	p->screen->fence_reference(p->screen, &fence, NULL);
+}
+
+/**
+ * Returns frames per second, or zero if the screen can't be created.
+ */
+static double run(unsigned num_threads)
+{
+	struct program *p = CALLOC_STRUCT(program);
+	int64_t start, end;
+	double fps = 0.0;
+	unsigned i;
+
+	if (init_prog(p, num_threads)) {
+		/* warm up: compile shaders, fault in the framebuffer */
+		draw_frame(p);
+
+		start = os_time_get();
+		for (i = 0; i < NUM_FRAMES; i++)
+			draw_frame(p);
+		end = os_time_get();
+
+		fps = NUM_FRAMES * 1000000.0 / (double)(end - start);
+	}
+
+	close_prog(p);
+	FREE(p);
+
+	return fps;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned threads[MAX_RUNS];
+	unsigned num_runs = 0;
+	double base = 0.0;
+	unsigned i;
+
+	if (argc > 1) {
+		for (i = 1; i < (unsigned)argc && num_runs < MAX_RUNS; i++)
+			threads[num_runs++] = atoi(argv[i]);
+	} else {
+		util_cpu_detect();
+		for (i = 1; i < util_cpu_caps.nr_cpus && num_runs < MAX_RUNS - 1; i *= 2)
+			threads[num_runs++] = i;
+		threads[num_runs++] = util_cpu_caps.nr_cpus;
+	}
+
+	printf("%8s %10s %10s %8s\n", "threads", "frames/s", "Mtris/s", "speedup");
+
+	for (i = 0; i < num_runs; i++) {
+		double fps = run(threads[i]);
+
+		if (fps == 0.0) {
+			fprintf(stderr, "failed to create a software screen\n");
+			return 1;
+		}
+		if (i == 0)
+			base = fps;
+
+		printf("%8u %10.1f %10.2f %7.2fx\n", threads[i], fps,
+		       fps * NUM_TRIS / 1000000.0, fps / base);
+	}
+
+	return 0;
+}
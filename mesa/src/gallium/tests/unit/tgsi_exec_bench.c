@@ -0,0 +1,171 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Times the TGSI interpreter on a typical transform and lighting vertex
+ * shader, with the operands decoded when the shader is bound and with
+ * every operand going through the general path (TGSI_EXEC_DECODE=0), and
+ * checks that both give the same results.
+ *
+ * Usage: tgsi_exec_bench [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipe/p_shader_tokens.h"
+#include "tgsi/tgsi_exec.h"
+#include "tgsi/tgsi_text.h"
+#include "os/os_time.h"
+#include "util/u_memory.h"
+
+
+static const char shader_text[] =
+   "VERT\n"
+   "DCL IN[0]\n"
+   "DCL IN[1]\n"
+   "DCL OUT[0], POSITION\n"
+   "DCL OUT[1], COLOR\n"
+   "DCL CONST[0..11]\n"
+   "DCL TEMP[0..3]\n"
+   "IMM FLT32 { 0.0, 1.0, 0.5, 16.0 }\n"
+   "  0: MUL TEMP[0], IN[0].xxxx, CONST[0]\n"
+   "  1: MAD TEMP[0], IN[0].yyyy, CONST[1], TEMP[0]\n"
+   "  2: MAD TEMP[0], IN[0].zzzz, CONST[2], TEMP[0]\n"
+   "  3: MAD OUT[0], IN[0].wwww, CONST[3], TEMP[0]\n"
+   "  4: DP3 TEMP[1].x, IN[1], CONST[4]\n"
+   "  5: DP3 TEMP[1].y, IN[1], CONST[5]\n"
+   "  6: DP3 TEMP[1].z, IN[1], CONST[6]\n"
+   "  7: DP3 TEMP[2].x, TEMP[1], TEMP[1]\n"
+   "  8: RSQ TEMP[2].x, TEMP[2].xxxx\n"
+   "  9: MUL TEMP[1].xyz, TEMP[1], TEMP[2].xxxx\n"
+   " 10: DP3 TEMP[2].x, TEMP[1], CONST[8]\n"
+   " 11: MAX TEMP[2].x, TEMP[2].xxxx, IMM[0].xxxx\n"
+   " 12: POW TEMP[2].y, TEMP[2].xxxx, IMM[0].wwww\n"
+   " 13: MAD TEMP[3], CONST[9], TEMP[2].xxxx, CONST[10]\n"
+   " 14: MAD_SAT OUT[1], CONST[11], TEMP[2].yyyy, -TEMP[3]\n"
+   " 15: END\n";
+
+#define NUM_OUTPUTS 2
+
+
+static float constants[12][4];
+
+
+/**
+ * Run the shader \p iterations times on changing inputs and return the
+ * time taken in nanoseconds.  The outputs of the last run are left in
+ * \p outputs.
+ */
+static int64_t
+run_shader(const struct tgsi_token *tokens, unsigned iterations,
+           float outputs[NUM_OUTPUTS][4][TGSI_QUAD_SIZE])
+{
+   struct tgsi_exec_machine *mach;
+   const void *bufs[PIPE_MAX_CONSTANT_BUFFERS] = { constants };
+   unsigned sizes[PIPE_MAX_CONSTANT_BUFFERS] = { sizeof(constants) };
+   int64_t start, end;
+   unsigned i, j, k;
+
+   mach = tgsi_exec_machine_create(PIPE_SHADER_VERTEX);
+   if (!mach)
+      return -1;
+
+   tgsi_exec_machine_bind_shader(mach, tokens, NULL, NULL, NULL);
+   tgsi_exec_set_constant_buffers(mach, PIPE_MAX_CONSTANT_BUFFERS,
+                                  bufs, sizes);
+
+   start = os_time_get_nano();
+
+   for (i = 0; i < iterations; i++) {
+      for (j = 0; j < 4; j++) {
+         for (k = 0; k < TGSI_QUAD_SIZE; k++) {
+            mach->Inputs[0].xyzw[j].f[k] = (float) ((i + j + k) % 17) - 8.0f;
+            mach->Inputs[1].xyzw[j].f[k] = (float) ((i * 3 + j + k) % 5) + 0.25f;
+         }
+      }
+
+      mach->NonHelperMask = 0xf;
+      tgsi_exec_machine_run(mach, 0);
+   }
+
+   end = os_time_get_nano();
+
+   for (i = 0; i < NUM_OUTPUTS; i++)
+      for (j = 0; j < 4; j++)
+         for (k = 0; k < TGSI_QUAD_SIZE; k++)
+            outputs[i][j][k] = mach->Outputs[i].xyzw[j].f[k];
+
+   tgsi_exec_machine_destroy(mach);
+
+   return end - start;
+}
+
+
+int main(int argc, char **argv)
+{
+   struct tgsi_token tokens[1024];
+   float decoded[NUM_OUTPUTS][4][TGSI_QUAD_SIZE];
+   float general[NUM_OUTPUTS][4][TGSI_QUAD_SIZE];
+   unsigned iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+   int64_t decoded_time, general_time;
+   unsigned i, j;
+
+   if (!tgsi_text_translate(shader_text, tokens, ARRAY_SIZE(tokens))) {
+      fprintf(stderr, "failed to translate the shader\n");
+      return 1;
+   }
+
+   for (i = 0; i < 12; i++)
+      for (j = 0; j < 4; j++)
+         constants[i][j] = (float) ((i * 4 + j) % 7) * 0.125f - 0.25f;
+
+   setenv("TGSI_EXEC_DECODE", "1", 1);
+   decoded_time = run_shader(tokens, iterations, decoded);
+
+   setenv("TGSI_EXEC_DECODE", "0", 1);
+   general_time = run_shader(tokens, iterations, general);
+
+   if (decoded_time < 0 || general_time < 0) {
+      fprintf(stderr, "failed to create the machine\n");
+      return 1;
+   }
+
+   printf("%u quads\n", iterations);
+   printf("general path:     %8.1f ns/quad\n",
+          (double) general_time / iterations);
+   printf("decoded operands: %8.1f ns/quad (%.2fx)\n",
+          (double) decoded_time / iterations,
+          (double) general_time / decoded_time);
+
+   if (memcmp(decoded, general, sizeof(decoded))) {
+      printf("FAILED: results differ\n");
+      return 1;
+   }
+
+   return 0;
+}
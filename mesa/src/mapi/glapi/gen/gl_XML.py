@@ -608,6 +608,12 @@ class gl_function( gl_item ):
         self.desktop = True
         self.deprecated = None
 
+        # Marshalling overrides, see gl_marshal.py.  marshal is None when
+        # the flavor should be derived from the parameters.
+        self.marshal = None
+        self.marshal_fail = None
+        self.marshal_call_after = None
+
         # self.entry_point_api_map[name][api] is a decimal value
         # indicating the earliest version of the given API in which
         # each entry point exists.  Every entry point is included in
@@ -677,6 +683,16 @@ class gl_function( gl_item ):
         if not is_attr_true(element, 'desktop', 'true'):
             self.desktop = False
 
+        marshal = element.get('marshal')
+        if marshal:
+            self.marshal = marshal
+        marshal_fail = element.get('marshal_fail')
+        if marshal_fail:
+            self.marshal_fail = marshal_fail
+        marshal_call_after = element.get('marshal_call_after')
+        if marshal_call_after:
+            self.marshal_call_after = marshal_call_after
+
         if alias:
             true_name = alias
         else:
@@ -0,0 +1,423 @@
+#!/usr/bin/env python
+
+# Copyright (C) 2016 The Mesa Authors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+
+# This script generates the file marshal_generated.c, which contains the
+# client side of the GL command marshalling thread (see main/glthread.c):
+# one _mesa_marshal_* function per GL entry point, the matching
+# _mesa_unmarshal_* function run by the server thread, and
+# _mesa_create_marshal_table(), which builds the dispatch table installed
+# on the application's thread.
+#
+# Each function is marshalled in one of three ways:
+#
+#  - async: the parameters are copied into the current batch and the call
+#    returns at once.  Arrays with a fixed count or a count given by
+#    another parameter are copied too.
+#  - sync: the server thread is drained and the call is made directly on
+#    the application's thread, which then gets the marshal table back,
+#    since display lists and glBegin/glEnd switch the dispatch table of the
+#    thread they run on.  This is the default for anything that
+#    returns a value, writes through a pointer, or reads memory whose size
+#    can't be computed here.
+#  - skip: no entry is installed.
+#
+# The default can be overridden with the marshal attribute in the XML.
+# marshal_fail gives a C condition under which an async function falls
+# back to sync, and marshal_call_after a statement run on the application's
+# thread after the call has been queued or made.
+
+import argparse
+import license
+import gl_XML
+import sys
+
+
+header = """/**
+ * \\file marshal_generated.c
+ * GL command marshalling for the glthread server thread.
+ */
+
+
+#include "main/context.h"
+#include "main/dispatch.h"
+#include "main/glthread.h"
+#include "main/marshal.h"
+"""
+
+
+current_indent = 0
+
+
+def out(str):
+    if str:
+        print ' ' * current_indent + str
+    else:
+        print ''
+
+
+def indent(delta = 3):
+    global current_indent
+    current_indent += delta
+
+
+def marshal_flavor(func):
+    """Return 'async', 'sync' or 'skip' for a gl_function."""
+    if func.marshal:
+        return func.marshal
+    if func.exec_flavor == 'skip':
+        return 'skip'
+    if func.return_type != 'void':
+        return 'sync'
+
+    for p in func.parameters:
+        if p.is_padding:
+            continue
+        if p.is_output or p.is_image() or p.count_parameter_list:
+            return 'sync'
+        if p.is_pointer():
+            # Only const arrays of a known size can be copied.  Arrays of
+            # pointers would need each pointed-to array copied as well.
+            type_string = p.type_string()
+            if not type_string.startswith('const') or \
+                    type_string.count('*') > 1:
+                return 'sync'
+            if not p.count and not p.counter:
+                return 'sync'
+
+    return 'async'
+
+
+def fixed_params(func):
+    return [p for p in func.parameters
+            if not p.is_padding and not p.is_variable_length()]
+
+
+def variable_params(func):
+    # A pointer without a count is only marshalled asynchronously when the
+    # XML says so, and then it is the pointer value that gets copied.
+    return [p for p in func.parameters
+            if not p.is_padding and p.is_variable_length()]
+
+
+def sorted_functions(api):
+    return sorted(api.functionIterateAll(), key=lambda func: func.name)
+
+
+def is_fixed_array(p):
+    return p.is_pointer() and p.count and not p.counter
+
+
+class PrintCode(gl_XML.gl_print_base):
+
+    def __init__(self):
+        gl_XML.gl_print_base.__init__(self)
+
+        self.name = 'gl_marshal.py'
+        self.license = license.bsd_license_template % (
+            'Copyright (C) 2012 Intel Corporation',
+            'Intel Corporation')
+
+    def printRealHeader(self):
+        print header
+
+    def printRealFooter(self):
+        pass
+
+    def print_sync_call(self, func):
+        call = 'CALL_{0}(ctx->CurrentDispatch, ({1}))'.format(
+            func.name, func.get_called_parameter_string())
+        if func.return_type == 'void':
+            out('{0};'.format(call))
+        else:
+            out('return {0};'.format(call))
+
+    def print_sync_dispatch(self, func):
+        out('_mesa_glthread_finish(ctx);')
+        self.print_sync_call(func)
+        out('_mesa_glthread_restore_dispatch(ctx);')
+
+    def print_call_after(self, func):
+        if func.marshal_call_after:
+            out('{0};'.format(func.marshal_call_after))
+
+    def print_sync_body(self, func):
+        out('/* {0}: marshalled synchronously */'.format(func.name))
+        out('static {0} GLAPIENTRY'.format(func.return_type))
+        out('_mesa_marshal_{0}({1})'.format(
+            func.name, func.get_parameter_string()))
+        out('{')
+        indent()
+        out('GET_CURRENT_CONTEXT(ctx);')
+        if func.return_type == 'void':
+            self.print_sync_dispatch(func)
+            self.print_call_after(func)
+        else:
+            out('{0} ret;'.format(func.return_type))
+            out('_mesa_glthread_finish(ctx);')
+            out('ret = CALL_{0}(ctx->CurrentDispatch, ({1}));'.format(
+                func.name, func.get_called_parameter_string()))
+            out('_mesa_glthread_restore_dispatch(ctx);')
+            self.print_call_after(func)
+            out('return ret;')
+        indent(-3)
+        out('}')
+        out('')
+        out('')
+
+    def print_async_struct(self, func):
+        out('/* {0}: marshalled asynchronously */'.format(func.name))
+        out('struct marshal_cmd_{0}'.format(func.name))
+        out('{')
+        indent()
+        out('struct marshal_cmd_base cmd_base;')
+        for p in fixed_params(func):
+            if is_fixed_array(p):
+                out('{0} {1}[{2}];'.format(
+                    p.get_base_type_string(), p.name,
+                    p.get_element_count()))
+            else:
+                out('{0} {1};'.format(p.type_string(), p.name))
+        for p in variable_params(func):
+            out('GLboolean {0}_null; /* no data follows for {0} */'.format(
+                p.name))
+        for p in variable_params(func):
+            out('/* Next {0} bytes are {1} {2}[{3}] */'.format(
+                p.size_string(False), p.get_base_type_string(), p.name,
+                p.counter))
+        indent(-3)
+        out('};')
+
+    def print_async_unmarshal(self, func):
+        params = variable_params(func)
+
+        out('static inline void')
+        out(('_mesa_unmarshal_{0}(struct gl_context *ctx, '
+             'const struct marshal_cmd_{0} *cmd)').format(func.name))
+        out('{')
+        indent()
+        for p in fixed_params(func):
+            if is_fixed_array(p):
+                out('const {0} *{1} = cmd->{1};'.format(
+                    p.get_base_type_string(), p.name))
+            else:
+                decl = '{0} {1} = cmd->{1};'.format(p.type_string(), p.name)
+                if not decl.startswith('const '):
+                    decl = 'const ' + decl
+                out(decl)
+        if params:
+            for p in params:
+                out('const {0} *{1};'.format(p.get_base_type_string(), p.name))
+            out('const char *variable_data = (const char *) (cmd + 1);')
+            out('')
+            for p in params:
+                out('if (cmd->{0}_null) {{'.format(p.name))
+                indent()
+                out('{0} = NULL;'.format(p.name))
+                indent(-3)
+                out('} else {')
+                indent()
+                out('{0} = (const {1} *) variable_data;'.format(
+                    p.name, p.get_base_type_string()))
+                if p is not params[-1]:
+                    out('variable_data += {0};'.format(p.size_string()))
+                indent(-3)
+                out('}')
+        self.print_sync_call(func)
+        indent(-3)
+        out('}')
+
+    def print_async_marshal(self, func):
+        struct = 'struct marshal_cmd_{0}'.format(func.name)
+        params = variable_params(func)
+
+        out('static void GLAPIENTRY')
+        out('_mesa_marshal_{0}({1})'.format(
+            func.name, func.get_parameter_string()))
+        out('{')
+        indent()
+        out('GET_CURRENT_CONTEXT(ctx);')
+        for p in params:
+            out('GLsizeiptr {0}_size = {0} ? {1} : 0;'.format(
+                p.name, p.size_string()))
+        if params:
+            out('size_t cmd_size = sizeof({0}) + {1};'.format(
+                struct,
+                ' + '.join(['{0}_size'.format(p.name) for p in params])))
+        else:
+            out('size_t cmd_size = sizeof({0});'.format(struct))
+        out('{0} *cmd;'.format(struct))
+        if params:
+            out('char *variable_data;')
+        out('')
+
+        # A negative size is either an error for the real entry point to
+        # report or an overflow; both are left to the synchronous path, as
+        # are commands too big for a batch.
+        conditions = ['unlikely({0}_size < 0)'.format(p.name)
+                      for p in params]
+        if params:
+            conditions.append('cmd_size > MARSHAL_MAX_CMD_SIZE')
+        if func.marshal_fail:
+            conditions.append(func.marshal_fail)
+        if conditions:
+            separator = ' ||\n' + ' ' * (current_indent + 4)
+            out('if ({0}) {{'.format(separator.join(conditions)))
+            indent()
+            self.print_sync_dispatch(func)
+            self.print_call_after(func)
+            out('return;')
+            indent(-3)
+            out('}')
+            out('')
+
+        out('cmd = _mesa_glthread_allocate_command(ctx, '
+            'DISPATCH_CMD_{0}, cmd_size);'.format(func.name))
+        for p in fixed_params(func):
+            if is_fixed_array(p):
+                out('memcpy(cmd->{0}, {0}, {1});'.format(
+                    p.name, p.size_string()))
+            else:
+                out('cmd->{0} = {0};'.format(p.name))
+        for p in params:
+            out('cmd->{0}_null = !{0};'.format(p.name))
+        if params:
+            out('variable_data = (char *) (cmd + 1);')
+            for p in params:
+                out('memcpy(variable_data, {0}, {0}_size);'.format(p.name))
+                if p is not params[-1]:
+                    out('variable_data += {0}_size;'.format(p.name))
+        if not fixed_params(func) and not params:
+            out('(void) cmd;')
+        self.print_call_after(func)
+        indent(-3)
+        out('}')
+
+    def print_async_body(self, func):
+        self.print_async_struct(func)
+        out('')
+        self.print_async_unmarshal(func)
+        out('')
+        self.print_async_marshal(func)
+        out('')
+        out('')
+
+    def print_unmarshal_dispatch_cmd(self, api):
+        out('size_t')
+        out('_mesa_unmarshal_dispatch_cmd(struct gl_context *ctx, '
+            'const void *cmd)')
+        out('{')
+        indent()
+        out('const struct marshal_cmd_base *cmd_base = cmd;')
+        out('switch (cmd_base->cmd_id) {')
+        for func in sorted_functions(api):
+            if marshal_flavor(func) != 'async':
+                continue
+            out('case DISPATCH_CMD_{0}:'.format(func.name))
+            indent()
+            out('_mesa_unmarshal_{0}(ctx, (const struct marshal_cmd_{0} *) '
+                'cmd);'.format(func.name))
+            out('break;')
+            indent(-3)
+        out('default:')
+        indent()
+        out('assert(!"Unrecognized command ID");')
+        out('break;')
+        indent(-3)
+        out('}')
+        out('')
+        out('return cmd_base->cmd_size;')
+        indent(-3)
+        out('}')
+        out('')
+        out('')
+
+    def print_create_marshal_table(self, api):
+        out('struct _glapi_table *')
+        out('_mesa_create_marshal_table(void)')
+        out('{')
+        indent()
+        out('struct _glapi_table *table;')
+        out('')
+        out('table = _mesa_alloc_dispatch_table();')
+        out('if (table == NULL)')
+        indent()
+        out('return NULL;')
+        indent(-3)
+        out('')
+        for func in sorted_functions(api):
+            if marshal_flavor(func) == 'skip':
+                continue
+            out('SET_{0}(table, _mesa_marshal_{0});'.format(func.name))
+        out('')
+        out('return table;')
+        indent(-3)
+        out('}')
+
+    def printBody(self, api):
+        async_funcs = [func for func in sorted_functions(api)
+                       if marshal_flavor(func) == 'async']
+
+        out('enum marshal_dispatch_cmd_id')
+        out('{')
+        indent()
+        for func in async_funcs:
+            out('DISPATCH_CMD_{0},'.format(func.name))
+        indent(-3)
+        out('};')
+        out('')
+        out('')
+
+        for func in sorted_functions(api):
+            flavor = marshal_flavor(func)
+            if flavor == 'async':
+                self.print_async_body(func)
+            elif flavor == 'sync':
+                self.print_sync_body(func)
+            elif flavor != 'skip':
+                raise Exception(
+                    'Unrecognized marshal flavor {0!r}'.format(flavor))
+
+        self.print_unmarshal_dispatch_cmd(api)
+        self.print_create_marshal_table(api)
+
+
+def _parser():
+    """Parse arguments and return namespace."""
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-f',
+                        dest='filename',
+                        default='gl_and_es_API.xml',
+                        help='an xml file describing an API')
+    return parser.parse_args()
+
+
+def main():
+    """Main function."""
+    args = _parser()
+    printer = PrintCode()
+    api = gl_XML.parse_GL_API(args.filename)
+    printer.Print(api)
+
+
+if __name__ == '__main__':
+    main()
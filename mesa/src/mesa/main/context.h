@@ -149,6 +149,9 @@ _mesa_notifySwapBuffers(struct gl_context *gc);
 extern struct _glapi_table *
 _mesa_get_dispatch(struct gl_context *ctx);
 
+extern struct _glapi_table *
+_mesa_alloc_dispatch_table(void);
+
 extern void
 _mesa_set_context_lost_dispatch(struct gl_context *ctx);
 
@@ -26,6 +26,8 @@
 #include "glformats.h"
 #include "format_pack.h"
 #include "format_unpack.h"
+#include "format_utils_simd.h"
+#include "x86/common_x86_asm.h"
 
 const mesa_array_format RGBA32_FLOAT =
    MESA_ARRAY_FORMAT(4, 1, 1, 1, 4, 0, 1, 2, 3);
@@ -777,6 +779,37 @@ swizzle_convert_try_memcpy(void *dst,
    return true;
 }
 
+/**
+ * Convert as many pixels as possible with the SSE4.1 or AVX2 row kernels,
+ * picked according to what the CPU supports.
+ *
+ * \return  the number of leading pixels converted, which may be zero; the
+ *          caller converts the rest
+ */
+static int
+swizzle_convert_try_simd(void *dst,
+                         enum mesa_array_format_datatype dst_type,
+                         int num_dst_channels,
+                         const void *src,
+                         enum mesa_array_format_datatype src_type,
+                         int num_src_channels,
+                         const uint8_t swizzle[4], bool normalized, int count)
+{
+#if defined(USE_AVX2)
+   if (cpu_has_avx2)
+      return _mesa_swizzle_and_convert_avx2(dst, dst_type, num_dst_channels,
+                                            src, src_type, num_src_channels,
+                                            swizzle, normalized, count);
+#endif
+#if defined(USE_SSE41)
+   if (cpu_has_sse4_1)
+      return _mesa_swizzle_and_convert_sse41(dst, dst_type, num_dst_channels,
+                                             src, src_type, num_src_channels,
+                                             swizzle, normalized, count);
+#endif
+   return 0;
+}
+
 /**
  * Represents a single instance of the standard swizzle-and-convert loop
  *
@@ -1491,11 +1524,27 @@ _mesa_swizzle_and_convert(void *void_dst, enum mesa_array_format_datatype dst_ty
                           const void *void_src, enum mesa_array_format_datatype src_type, int num_src_channels,
                           const uint8_t swizzle[4], bool normalized, int count)
 {
+   int done;
+
    if (swizzle_convert_try_memcpy(void_dst, dst_type, num_dst_channels,
                                   void_src, src_type, num_src_channels,
                                   swizzle, normalized, count))
       return;
 
+   done = swizzle_convert_try_simd(void_dst, dst_type, num_dst_channels,
+                                   void_src, src_type, num_src_channels,
+                                   swizzle, normalized, count);
+   if (done == count)
+      return;
+
+   void_dst = (uint8_t *) void_dst +
+              done * num_dst_channels *
+              _mesa_array_format_datatype_get_size(dst_type);
+   void_src = (const uint8_t *) void_src +
+              done * num_src_channels *
+              _mesa_array_format_datatype_get_size(src_type);
+   count -= done;
+
    switch (dst_type) {
    case MESA_ARRAY_FORMAT_TYPE_FLOAT:
       convert_float(void_dst, num_dst_channels, void_src, src_type,
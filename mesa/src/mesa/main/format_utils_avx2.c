@@ -0,0 +1,303 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2016  The Mesa Authors   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file format_utils_avx2.c
+ * AVX2 and F16C row kernels for _mesa_swizzle_and_convert().
+ *
+ * The 256-bit shuffles work within each 128-bit lane, and every pixel
+ * handled here fits in a lane, so the same controls as the SSE4.1 kernels
+ * are used, broadcast to both lanes.
+ */
+
+#include "main/format_utils_simd.h"
+#include "x86/common_x86_asm.h"
+#include <immintrin.h>
+#include <stdint.h>
+
+
+static inline __m256i
+load_mask_avx2(const uint8_t bytes[16])
+{
+   return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) bytes));
+}
+
+
+/**
+ * Swizzle four-channel pixels without changing their type, 32 bytes at a
+ * time.
+ */
+static int
+swizzle_4ch_avx2(uint8_t *dst, const uint8_t *src, int chan_size,
+                 const uint8_t swizzle[4],
+                 enum mesa_array_format_datatype type, bool normalized,
+                 int count)
+{
+   const int pixels = 32 / (4 * chan_size);
+   uint8_t shuffle_bytes[16], one_bytes[16];
+   __m256i shuffle, ones;
+   int i;
+
+   _mesa_swizzle_shuffle_mask(swizzle, chan_size, shuffle_bytes);
+   _mesa_swizzle_one_mask(swizzle, type, normalized, one_bytes);
+   shuffle = load_mask_avx2(shuffle_bytes);
+   ones = load_mask_avx2(one_bytes);
+
+   for (i = 0; i + pixels <= count; i += pixels) {
+      __m256i v = _mm256_loadu_si256((const __m256i *) src);
+      v = _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), ones);
+      _mm256_storeu_si256((__m256i *) dst, v);
+      src += 32;
+      dst += 32;
+   }
+
+   return i;
+}
+
+
+/**
+ * Convert RGBA8 to RGBA32F, eight pixels at a time.
+ */
+static int
+ubyte4_to_float4_avx2(float *dst, const uint8_t *src,
+                      const uint8_t swizzle[4], bool normalized, int count)
+{
+   uint8_t shuffle_bytes[16], one_bytes[16];
+   const __m256 scale = _mm256_set1_ps(normalized ? 1.0f / 255.0f : 1.0f);
+   __m256i shuffle;
+   __m256 ones;
+   int i;
+
+   _mesa_swizzle_shuffle_mask(swizzle, 1, shuffle_bytes);
+   _mesa_swizzle_one_mask(swizzle, MESA_ARRAY_FORMAT_TYPE_FLOAT, normalized,
+                          one_bytes);
+   shuffle = load_mask_avx2(shuffle_bytes);
+   ones = _mm256_castsi256_ps(load_mask_avx2(one_bytes));
+
+   for (i = 0; i + 8 <= count; i += 8) {
+      __m256i v = _mm256_loadu_si256((const __m256i *) src);
+      __m128i b[4];
+      int j;
+
+      v = _mm256_shuffle_epi8(v, shuffle);
+      b[0] = _mm256_castsi256_si128(v);
+      b[1] = _mm_srli_si128(b[0], 8);
+      b[2] = _mm256_extracti128_si256(v, 1);
+      b[3] = _mm_srli_si128(b[2], 8);
+
+      for (j = 0; j < 4; j++) {
+         __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(b[j]));
+         f = _mm256_or_ps(_mm256_mul_ps(f, scale), ones);
+         _mm256_storeu_ps(dst + 8 * j, f);
+      }
+
+      src += 32;
+      dst += 32;
+   }
+
+   return i;
+}
+
+
+/**
+ * Convert RGBA32F to normalized RGBA8, eight pixels at a time.  See
+ * float4_to_unorm8_sse41() for how this matches _mesa_float_to_unorm().
+ */
+static int
+float4_to_unorm8_avx2(uint8_t *dst, const float *src,
+                      const uint8_t swizzle[4], int count)
+{
+   uint8_t shuffle_bytes[16], one_bytes[16];
+   const __m256 zero = _mm256_setzero_ps();
+   const __m256 one = _mm256_set1_ps(1.0f);
+   const __m256 scale = _mm256_set1_ps(255.0f);
+   /* The in-lane packs leave the pixels in the order 0 2 4 6 1 3 5 7 */
+   const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+   __m256i shuffle, ones;
+   int i;
+
+   _mesa_swizzle_shuffle_mask(swizzle, 1, shuffle_bytes);
+   _mesa_swizzle_one_mask(swizzle, MESA_ARRAY_FORMAT_TYPE_UBYTE, true,
+                          one_bytes);
+   shuffle = load_mask_avx2(shuffle_bytes);
+   ones = load_mask_avx2(one_bytes);
+
+   for (i = 0; i + 8 <= count; i += 8) {
+      __m256i p[4], v;
+      int j;
+
+      for (j = 0; j < 4; j++) {
+         __m256 f = _mm256_max_ps(_mm256_loadu_ps(src + 8 * j), zero);
+         f = _mm256_min_ps(f, one);
+         p[j] = _mm256_cvtps_epi32(_mm256_mul_ps(f, scale));
+      }
+
+      v = _mm256_packus_epi16(_mm256_packus_epi32(p[0], p[1]),
+                              _mm256_packus_epi32(p[2], p[3]));
+      v = _mm256_permutevar8x32_epi32(v, order);
+      v = _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), ones);
+      _mm256_storeu_si256((__m256i *) dst, v);
+
+      src += 32;
+      dst += 32;
+   }
+
+   return i;
+}
+
+
+/**
+ * Convert RGBA16F to RGBA32F, four pixels at a time.
+ *
+ * vcvtph2ps keeps NaN payloads, where _mesa_half_to_float() always gives
+ * a mantissa of 1, so NaNs are patched up afterwards.
+ */
+static int
+half4_to_float4_f16c(float *dst, const uint16_t *src,
+                     const uint8_t swizzle[4], int count)
+{
+   uint8_t shuffle_bytes[16], one_bytes[16];
+   const __m256 sign = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+   const __m256 nan = _mm256_castsi256_ps(_mm256_set1_epi32(0x7f800001));
+   __m256i shuffle;
+   __m256 ones;
+   int i;
+
+   _mesa_swizzle_shuffle_mask(swizzle, 2, shuffle_bytes);
+   _mesa_swizzle_one_mask(swizzle, MESA_ARRAY_FORMAT_TYPE_FLOAT, true,
+                          one_bytes);
+   shuffle = load_mask_avx2(shuffle_bytes);
+   ones = _mm256_castsi256_ps(load_mask_avx2(one_bytes));
+
+   for (i = 0; i + 4 <= count; i += 4) {
+      __m256i v = _mm256_loadu_si256((const __m256i *) src);
+      int j;
+
+      v = _mm256_shuffle_epi8(v, shuffle);
+      for (j = 0; j < 2; j++) {
+         __m256 f = _mm256_cvtph_ps(j ? _mm256_extracti128_si256(v, 1) :
+                                        _mm256_castsi256_si128(v));
+         __m256 is_nan = _mm256_cmp_ps(f, f, _CMP_UNORD_Q);
+         f = _mm256_blendv_ps(f, _mm256_or_ps(_mm256_and_ps(f, sign), nan),
+                              is_nan);
+         _mm256_storeu_ps(dst + 8 * j, _mm256_or_ps(f, ones));
+      }
+
+      src += 16;
+      dst += 16;
+   }
+
+   return i;
+}
+
+
+/**
+ * Convert RGBA32F to RGBA16F, four pixels at a time.
+ *
+ * vcvtps2ph rounds to nearest even like _mesa_float_to_half(); as above,
+ * only NaNs need patching up.
+ */
+static int
+float4_to_half4_f16c(uint16_t *dst, const float *src,
+                     const uint8_t swizzle[4], int count)
+{
+   uint8_t shuffle_bytes[16], one_bytes[16];
+   const __m128i sign = _mm_set1_epi16((short) 0x8000);
+   const __m128i nan = _mm_set1_epi16(0x7c01);
+   __m256i shuffle, ones;
+   int i;
+
+   _mesa_swizzle_shuffle_mask(swizzle, 2, shuffle_bytes);
+   _mesa_swizzle_one_mask(swizzle, MESA_ARRAY_FORMAT_TYPE_HALF, true,
+                          one_bytes);
+   shuffle = load_mask_avx2(shuffle_bytes);
+   ones = load_mask_avx2(one_bytes);
+
+   for (i = 0; i + 4 <= count; i += 4) {
+      __m128i h[2];
+      __m256i v;
+      int j;
+
+      for (j = 0; j < 2; j++) {
+         __m256 f = _mm256_loadu_ps(src + 8 * j);
+         __m256i is_nan = _mm256_castps_si256(_mm256_cmp_ps(f, f, _CMP_UNORD_Q));
+         __m128i nan_mask = _mm_packs_epi32(_mm256_castsi256_si128(is_nan),
+                                            _mm256_extracti128_si256(is_nan, 1));
+
+         h[j] = _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT);
+         h[j] = _mm_blendv_epi8(h[j], _mm_or_si128(_mm_and_si128(h[j], sign),
+                                                   nan), nan_mask);
+      }
+
+      v = _mm256_inserti128_si256(_mm256_castsi128_si256(h[0]), h[1], 1);
+      v = _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), ones);
+      _mm256_storeu_si256((__m256i *) dst, v);
+
+      src += 16;
+      dst += 16;
+   }
+
+   return i;
+}
+
+
+int
+_mesa_swizzle_and_convert_avx2(void *dst,
+                               enum mesa_array_format_datatype dst_type,
+                               int num_dst_channels,
+                               const void *src,
+                               enum mesa_array_format_datatype src_type,
+                               int num_src_channels,
+                               const uint8_t swizzle[4], bool normalized,
+                               int count)
+{
+   if (num_src_channels != 4 || num_dst_channels != 4 ||
+       !_mesa_swizzle_is_simd_friendly(swizzle))
+      return 0;
+
+   if (src_type == dst_type)
+      return swizzle_4ch_avx2(dst, src,
+                              _mesa_array_format_datatype_get_size(src_type),
+                              swizzle, dst_type, normalized, count);
+
+   if (src_type == MESA_ARRAY_FORMAT_TYPE_UBYTE &&
+       dst_type == MESA_ARRAY_FORMAT_TYPE_FLOAT)
+      return ubyte4_to_float4_avx2(dst, src, swizzle, normalized, count);
+
+   if (src_type == MESA_ARRAY_FORMAT_TYPE_FLOAT &&
+       dst_type == MESA_ARRAY_FORMAT_TYPE_UBYTE && normalized)
+      return float4_to_unorm8_avx2(dst, src, swizzle, count);
+
+   if (cpu_has_f16c) {
+      if (src_type == MESA_ARRAY_FORMAT_TYPE_HALF &&
+          dst_type == MESA_ARRAY_FORMAT_TYPE_FLOAT)
+         return half4_to_float4_f16c(dst, src, swizzle, count);
+
+      if (src_type == MESA_ARRAY_FORMAT_TYPE_FLOAT &&
+          dst_type == MESA_ARRAY_FORMAT_TYPE_HALF)
+         return float4_to_half4_f16c(dst, src, swizzle, count);
+   }
+
+   return 0;
+}
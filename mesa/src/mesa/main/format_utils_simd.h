@@ -0,0 +1,161 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2016  The Mesa Authors   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file format_utils_simd.h
+ * SIMD row kernels for _mesa_swizzle_and_convert().
+ *
+ * Each kernel handles four-channel pixels, for swizzles made of channel
+ * indices, MESA_FORMAT_SWIZZLE_ZERO and MESA_FORMAT_SWIZZLE_ONE only.  It
+ * converts as many whole vectors of pixels as it can and returns how many
+ * pixels it converted, leaving the rest to the scalar code.  Results are
+ * bit-exact with the scalar code.
+ */
+
+#ifndef FORMAT_UTILS_SIMD_H
+#define FORMAT_UTILS_SIMD_H
+
+#include "main/format_utils.h"
+
+
+/**
+ * Can the kernels handle this swizzle?
+ */
+static inline bool
+_mesa_swizzle_is_simd_friendly(const uint8_t swizzle[4])
+{
+   int i;
+
+   for (i = 0; i < 4; i++) {
+      if (swizzle[i] > MESA_FORMAT_SWIZZLE_ONE)
+         return false;
+   }
+
+   return true;
+}
+
+
+/**
+ * Build the pshufb control which applies swizzle to the four-channel
+ * pixels, of chan_size bytes per channel, held in 16 bytes.  Channels
+ * which are zero or one get 0x80, so pshufb clears them.
+ */
+static inline void
+_mesa_swizzle_shuffle_mask(const uint8_t swizzle[4], int chan_size,
+                           uint8_t shuffle[16])
+{
+   const int pixel_size = 4 * chan_size;
+   int i, c, b;
+
+   for (i = 0; i < 16; i += pixel_size) {
+      for (c = 0; c < 4; c++) {
+         for (b = 0; b < chan_size; b++) {
+            shuffle[i + c * chan_size + b] = swizzle[c] < 4 ?
+               i + swizzle[c] * chan_size + b : 0x80;
+         }
+      }
+   }
+}
+
+
+/**
+ * Build the 16 bytes to OR into swizzled pixels of the given type to set
+ * the channels which are one.
+ */
+static inline void
+_mesa_swizzle_one_mask(const uint8_t swizzle[4],
+                       enum mesa_array_format_datatype type, bool normalized,
+                       uint8_t ones[16])
+{
+   const int chan_size = _mesa_array_format_datatype_get_size(type);
+   union {
+      uint8_t ub;
+      int8_t b;
+      uint16_t us;
+      int16_t s;
+      uint32_t ui;
+      int32_t i;
+      float f;
+   } one;
+   int i, c;
+
+   switch (type) {
+   case MESA_ARRAY_FORMAT_TYPE_FLOAT:
+      one.f = 1.0f;
+      break;
+   case MESA_ARRAY_FORMAT_TYPE_HALF:
+      one.us = _mesa_float_to_half(1.0f);
+      break;
+   case MESA_ARRAY_FORMAT_TYPE_UBYTE:
+      one.ub = normalized ? UINT8_MAX : 1;
+      break;
+   case MESA_ARRAY_FORMAT_TYPE_BYTE:
+      one.b = normalized ? INT8_MAX : 1;
+      break;
+   case MESA_ARRAY_FORMAT_TYPE_USHORT:
+      one.us = normalized ? UINT16_MAX : 1;
+      break;
+   case MESA_ARRAY_FORMAT_TYPE_SHORT:
+      one.s = normalized ? INT16_MAX : 1;
+      break;
+   case MESA_ARRAY_FORMAT_TYPE_UINT:
+      one.ui = normalized ? UINT32_MAX : 1;
+      break;
+   case MESA_ARRAY_FORMAT_TYPE_INT:
+   default:
+      one.i = normalized ? INT32_MAX : 1;
+      break;
+   }
+
+   memset(ones, 0, 16);
+   for (i = 0; i < 16; i += 4 * chan_size) {
+      for (c = 0; c < 4; c++) {
+         if (swizzle[c] == MESA_FORMAT_SWIZZLE_ONE)
+            memcpy(&ones[i + c * chan_size], &one, chan_size);
+      }
+   }
+}
+
+
+int
+_mesa_swizzle_and_convert_sse41(void *dst,
+                                enum mesa_array_format_datatype dst_type,
+                                int num_dst_channels,
+                                const void *src,
+                                enum mesa_array_format_datatype src_type,
+                                int num_src_channels,
+                                const uint8_t swizzle[4], bool normalized,
+                                int count);
+
+int
+_mesa_swizzle_and_convert_avx2(void *dst,
+                               enum mesa_array_format_datatype dst_type,
+                               int num_dst_channels,
+                               const void *src,
+                               enum mesa_array_format_datatype src_type,
+                               int num_src_channels,
+                               const uint8_t swizzle[4], bool normalized,
+                               int count);
+
+#endif /* FORMAT_UTILS_SIMD_H */
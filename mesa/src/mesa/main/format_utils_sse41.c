@@ -0,0 +1,183 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2016  The Mesa Authors   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file format_utils_sse41.c
+ * SSE4.1 row kernels for _mesa_swizzle_and_convert().
+ */
+
+#include "main/format_utils_simd.h"
+#include <smmintrin.h>
+#include <stdint.h>
+
+
+/**
+ * Swizzle four-channel pixels without changing their type, 16 bytes at a
+ * time.
+ */
+static int
+swizzle_4ch_sse41(uint8_t *dst, const uint8_t *src, int chan_size,
+                  const uint8_t swizzle[4],
+                  enum mesa_array_format_datatype type, bool normalized,
+                  int count)
+{
+   const int pixels = 16 / (4 * chan_size);
+   uint8_t shuffle_bytes[16], one_bytes[16];
+   __m128i shuffle, ones;
+   int i;
+
+   _mesa_swizzle_shuffle_mask(swizzle, chan_size, shuffle_bytes);
+   _mesa_swizzle_one_mask(swizzle, type, normalized, one_bytes);
+   shuffle = _mm_loadu_si128((const __m128i *) shuffle_bytes);
+   ones = _mm_loadu_si128((const __m128i *) one_bytes);
+
+   for (i = 0; i + pixels <= count; i += pixels) {
+      __m128i v = _mm_loadu_si128((const __m128i *) src);
+      v = _mm_or_si128(_mm_shuffle_epi8(v, shuffle), ones);
+      _mm_storeu_si128((__m128i *) dst, v);
+      src += 16;
+      dst += 16;
+   }
+
+   return i;
+}
+
+
+/**
+ * Convert RGBA8 to RGBA32F, four pixels at a time.  The swizzle is applied
+ * to the bytes, and the ones are ORed in as floats afterwards.
+ */
+static int
+ubyte4_to_float4_sse41(float *dst, const uint8_t *src,
+                       const uint8_t swizzle[4], bool normalized, int count)
+{
+   uint8_t shuffle_bytes[16], one_bytes[16];
+   const __m128 scale = _mm_set1_ps(normalized ? 1.0f / 255.0f : 1.0f);
+   __m128i shuffle;
+   __m128 ones;
+   int i;
+
+   _mesa_swizzle_shuffle_mask(swizzle, 1, shuffle_bytes);
+   _mesa_swizzle_one_mask(swizzle, MESA_ARRAY_FORMAT_TYPE_FLOAT, normalized,
+                          one_bytes);
+   shuffle = _mm_loadu_si128((const __m128i *) shuffle_bytes);
+   ones = _mm_loadu_ps((const float *) one_bytes);
+
+   for (i = 0; i + 4 <= count; i += 4) {
+      __m128i v = _mm_loadu_si128((const __m128i *) src);
+      int j;
+
+      v = _mm_shuffle_epi8(v, shuffle);
+      for (j = 0; j < 4; j++) {
+         __m128 f = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(v));
+         /* x * 1.0f is exact, so the unnormalized case can share this */
+         f = _mm_or_ps(_mm_mul_ps(f, scale), ones);
+         _mm_storeu_ps(dst + 4 * j, f);
+         v = _mm_srli_si128(v, 4);
+      }
+
+      src += 16;
+      dst += 16;
+   }
+
+   return i;
+}
+
+
+/**
+ * Convert RGBA32F to normalized RGBA8, four pixels at a time.
+ *
+ * This matches _mesa_float_to_unorm(): the clamp maps NaN to zero, and
+ * cvtps2dq rounds to nearest even like _mesa_lroundevenf().
+ */
+static int
+float4_to_unorm8_sse41(uint8_t *dst, const float *src,
+                       const uint8_t swizzle[4], int count)
+{
+   uint8_t shuffle_bytes[16], one_bytes[16];
+   const __m128 zero = _mm_setzero_ps();
+   const __m128 one = _mm_set1_ps(1.0f);
+   const __m128 scale = _mm_set1_ps(255.0f);
+   __m128i shuffle, ones;
+   int i;
+
+   _mesa_swizzle_shuffle_mask(swizzle, 1, shuffle_bytes);
+   _mesa_swizzle_one_mask(swizzle, MESA_ARRAY_FORMAT_TYPE_UBYTE, true,
+                          one_bytes);
+   shuffle = _mm_loadu_si128((const __m128i *) shuffle_bytes);
+   ones = _mm_loadu_si128((const __m128i *) one_bytes);
+
+   for (i = 0; i + 4 <= count; i += 4) {
+      __m128i p[4], v;
+      int j;
+
+      for (j = 0; j < 4; j++) {
+         /* maxps returns the second operand when either is NaN */
+         __m128 f = _mm_max_ps(_mm_loadu_ps(src + 4 * j), zero);
+         f = _mm_min_ps(f, one);
+         p[j] = _mm_cvtps_epi32(_mm_mul_ps(f, scale));
+      }
+
+      v = _mm_packus_epi16(_mm_packus_epi32(p[0], p[1]),
+                           _mm_packus_epi32(p[2], p[3]));
+      v = _mm_or_si128(_mm_shuffle_epi8(v, shuffle), ones);
+      _mm_storeu_si128((__m128i *) dst, v);
+
+      src += 16;
+      dst += 16;
+   }
+
+   return i;
+}
+
+
+int
+_mesa_swizzle_and_convert_sse41(void *dst,
+                                enum mesa_array_format_datatype dst_type,
+                                int num_dst_channels,
+                                const void *src,
+                                enum mesa_array_format_datatype src_type,
+                                int num_src_channels,
+                                const uint8_t swizzle[4], bool normalized,
+                                int count)
+{
+   if (num_src_channels != 4 || num_dst_channels != 4 ||
+       !_mesa_swizzle_is_simd_friendly(swizzle))
+      return 0;
+
+   if (src_type == dst_type)
+      return swizzle_4ch_sse41(dst, src,
+                               _mesa_array_format_datatype_get_size(src_type),
+                               swizzle, dst_type, normalized, count);
+
+   if (src_type == MESA_ARRAY_FORMAT_TYPE_UBYTE &&
+       dst_type == MESA_ARRAY_FORMAT_TYPE_FLOAT)
+      return ubyte4_to_float4_sse41(dst, src, swizzle, normalized, count);
+
+   if (src_type == MESA_ARRAY_FORMAT_TYPE_FLOAT &&
+       dst_type == MESA_ARRAY_FORMAT_TYPE_UBYTE && normalized)
+      return float4_to_unorm8_sse41(dst, src, swizzle, count);
+
+   return 0;
+}
@@ -161,6 +161,14 @@ typedef void *GLeglImageOES;
 #define GL_SHADER_PROGRAM_MESA                                  0x9999
 
 
+/**
+ * Format of the program binaries returned by glGetProgramBinary.  These hold
+ * the compiled GLSL IR of the program's shaders, and are only accepted by
+ * the same Mesa build with the same context configuration.
+ */
+#define GL_PROGRAM_BINARY_FORMAT_MESA                           0x875F
+
+
 /* Several fields of struct gl_config can take these as values.  Since
  * GLX header files may not be available everywhere they need to be used,
  * redefine them here.
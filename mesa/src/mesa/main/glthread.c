@@ -0,0 +1,259 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2016  The Mesa Authors   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file glthread.c
+ * The server thread which executes marshalled GL commands.
+ *
+ * Batches form a ring.  The client fills one while the server executes
+ * the ones queued before it, and the client blocks only when the ring is
+ * full or when a call needs the server to be idle.
+ */
+
+#include "main/glthread.h"
+#include "main/marshal.h"
+#include "main/context.h"
+#include "main/hash.h"
+#include "main/imports.h"
+#include "glapi/glapi.h"
+
+
+static void
+glthread_unmarshal_batch(struct gl_context *ctx, struct glthread_batch *batch)
+{
+   const uint8_t *buffer = (const uint8_t *) batch->buffer;
+   size_t pos = 0;
+
+   /* A display list or glBegin may have switched the dispatch table on
+    * this thread; pick up whatever is current now.
+    */
+   _glapi_set_dispatch(ctx->CurrentDispatch);
+
+   while (pos < batch->used)
+      pos += _mesa_unmarshal_dispatch_cmd(ctx, buffer + pos);
+
+   assert(pos == batch->used);
+   batch->used = 0;
+}
+
+
+static int
+glthread_worker(void *data)
+{
+   struct gl_context *ctx = data;
+   struct glthread_state *glthread = ctx->GLThread;
+
+   _glapi_check_multithread();
+   _glapi_set_context(ctx);
+
+   mtx_lock(&glthread->mutex);
+   for (;;) {
+      struct glthread_batch *batch;
+
+      while (glthread->executed == glthread->submitted && !glthread->shutdown)
+         cnd_wait(&glthread->new_work, &glthread->mutex);
+
+      if (glthread->executed == glthread->submitted)
+         break;
+
+      batch = &glthread->batches[glthread->executed % MARSHAL_MAX_BATCHES];
+      mtx_unlock(&glthread->mutex);
+
+      glthread_unmarshal_batch(ctx, batch);
+
+      mtx_lock(&glthread->mutex);
+      glthread->executed++;
+      cnd_broadcast(&glthread->work_done);
+   }
+   mtx_unlock(&glthread->mutex);
+
+   _glapi_set_context(NULL);
+   _glapi_set_dispatch(NULL);
+
+   return 0;
+}
+
+
+/**
+ * Start the server thread for \p ctx and install the marshal dispatch
+ * table.  On failure the context simply stays single-threaded.
+ */
+void
+_mesa_glthread_init(struct gl_context *ctx)
+{
+   struct glthread_state *glthread;
+
+   if (ctx->GLThread)
+      return;
+
+   glthread = calloc(1, sizeof(*glthread));
+   if (!glthread)
+      return;
+
+   ctx->MarshalExec = _mesa_create_marshal_table();
+   glthread->VAOs = _mesa_NewHashTable();
+   if (!ctx->MarshalExec || !glthread->VAOs)
+      goto fail;
+
+   _mesa_glthread_init_vao(&glthread->DefaultVAO, 0);
+   glthread->CurrentVAO = &glthread->DefaultVAO;
+
+   mtx_init(&glthread->mutex, mtx_plain);
+   cnd_init(&glthread->new_work);
+   cnd_init(&glthread->work_done);
+
+   ctx->GLThread = glthread;
+   if (thrd_create(&glthread->thread, glthread_worker, ctx) != thrd_success) {
+      ctx->GLThread = NULL;
+      cnd_destroy(&glthread->work_done);
+      cnd_destroy(&glthread->new_work);
+      mtx_destroy(&glthread->mutex);
+      goto fail;
+   }
+
+   if (_mesa_get_current_context() == ctx)
+      _glapi_set_dispatch(ctx->MarshalExec);
+   return;
+
+fail:
+   if (glthread->VAOs)
+      _mesa_DeleteHashTable(glthread->VAOs);
+   free(ctx->MarshalExec);
+   ctx->MarshalExec = NULL;
+   free(glthread);
+}
+
+
+static void
+free_vao(GLuint key, void *data, void *userData)
+{
+   free(data);
+}
+
+
+/**
+ * Execute what is still queued, stop the server thread and go back to the
+ * context's own dispatch table.
+ */
+void
+_mesa_glthread_destroy(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread)
+      return;
+
+   _mesa_glthread_flush_batch(ctx);
+
+   mtx_lock(&glthread->mutex);
+   glthread->shutdown = true;
+   cnd_signal(&glthread->new_work);
+   mtx_unlock(&glthread->mutex);
+
+   thrd_join(glthread->thread, NULL);
+   ctx->GLThread = NULL;
+
+   cnd_destroy(&glthread->work_done);
+   cnd_destroy(&glthread->new_work);
+   mtx_destroy(&glthread->mutex);
+
+   _mesa_HashDeleteAll(glthread->VAOs, free_vao, NULL);
+   _mesa_DeleteHashTable(glthread->VAOs);
+   free(glthread);
+
+   if (_mesa_get_current_context() == ctx)
+      _glapi_set_dispatch(ctx->CurrentDispatch);
+
+   free(ctx->MarshalExec);
+   ctx->MarshalExec = NULL;
+}
+
+
+/**
+ * Hand the batch being filled to the server.  If that fills the ring,
+ * wait until the server is done with the batch the client is to use next.
+ */
+void
+_mesa_glthread_flush_batch(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread)
+      return;
+
+   if (!glthread->batches[glthread->submitted % MARSHAL_MAX_BATCHES].used)
+      return;
+
+   mtx_lock(&glthread->mutex);
+   glthread->submitted++;
+   cnd_signal(&glthread->new_work);
+
+   while (glthread->submitted - glthread->executed == MARSHAL_MAX_BATCHES)
+      cnd_wait(&glthread->work_done, &glthread->mutex);
+   mtx_unlock(&glthread->mutex);
+}
+
+
+/**
+ * Wait until every call made so far has been executed, after which the
+ * client may use the context directly.  Does nothing on the server thread
+ * itself, which is idle from its own point of view.
+ */
+void
+_mesa_glthread_finish(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread)
+      return;
+
+   if (thrd_equal(thrd_current(), glthread->thread))
+      return;
+
+   _mesa_glthread_flush_batch(ctx);
+
+   mtx_lock(&glthread->mutex);
+   while (glthread->executed != glthread->submitted)
+      cnd_wait(&glthread->work_done, &glthread->mutex);
+   mtx_unlock(&glthread->mutex);
+}
+
+
+/**
+ * Called on the client after a call which ran on it directly rather than
+ * being queued.  Display lists and glBegin/glEnd switch the dispatch table
+ * of the thread they run on to ctx->CurrentDispatch, which would take the
+ * client off the marshal table for good.
+ */
+void
+_mesa_glthread_restore_dispatch(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread || thrd_equal(thrd_current(), glthread->thread))
+      return;
+
+   if (_glapi_get_dispatch() != ctx->MarshalExec)
+      _glapi_set_dispatch(ctx->MarshalExec);
+}
@@ -0,0 +1,155 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2016  The Mesa Authors   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file glthread.h
+ * Optional server thread for a context.
+ *
+ * When enabled, the application's thread (the client) runs the marshal
+ * dispatch table, which records most GL calls into batches instead of
+ * executing them.  A server thread per context replays the batches through
+ * ctx->CurrentDispatch, so state validation and draw setup overlap with
+ * the application.  Calls which return data wait for the server to go idle
+ * and then run directly on the client.
+ */
+
+#ifndef GLTHREAD_H
+#define GLTHREAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "c11/threads.h"
+#include "main/glheader.h"
+#include "compiler/shader_enums.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+struct gl_context;
+struct _mesa_HashTable;
+
+
+/** Size of a batch, and so the largest command which can be queued */
+#define MARSHAL_MAX_CMD_SIZE (8 * 1024)
+
+/**
+ * Number of batches.  The client waits for the server when all of them
+ * are queued, which bounds how far ahead of the server it can run.
+ */
+#define MARSHAL_MAX_BATCHES 4
+
+
+struct glthread_batch
+{
+   /** Bytes of commands in buffer */
+   size_t used;
+
+   uint64_t buffer[MARSHAL_MAX_CMD_SIZE / 8];
+};
+
+
+/**
+ * What the client knows about a vertex array object.  This only needs to
+ * tell whether a draw may read the application's memory, so it errs on the
+ * side of saying yes.
+ */
+struct glthread_vao
+{
+   GLuint Name;
+
+   /** Enabled arrays, VERT_BIT_* */
+   uint64_t Enabled;
+
+   /** The buffer binding each array reads from, VERT_ATTRIB_* */
+   GLubyte BufferBinding[VERT_ATTRIB_MAX];
+
+   /** Buffer bound to each binding, 0 for client memory */
+   GLuint Buffer[VERT_ATTRIB_MAX];
+
+   /** Some enabled array reads client memory, derived from the above */
+   bool HasUserArrays;
+
+   GLuint ElementArrayBuffer;
+};
+
+
+struct glthread_state
+{
+   thrd_t thread;
+
+   /** Protects submitted, executed and shutdown */
+   mtx_t mutex;
+   /** Signalled when a batch is queued or the thread should quit */
+   cnd_t new_work;
+   /** Signalled when the server has finished a batch */
+   cnd_t work_done;
+
+   bool shutdown;
+
+   /**
+    * Batches queued and batches executed.  The client fills
+    * batches[submitted % MARSHAL_MAX_BATCHES] while the server works
+    * through the ones before it.
+    */
+   unsigned submitted;
+   unsigned executed;
+
+   struct glthread_batch batches[MARSHAL_MAX_BATCHES];
+
+   /** Client-side state, only touched by the client */
+   /*@{*/
+   GLuint ArrayBuffer;
+   /** glClientActiveTexture unit, or ~0 when unknown */
+   GLuint ClientActiveTexture;
+   struct _mesa_HashTable *VAOs;
+   struct glthread_vao DefaultVAO;
+   struct glthread_vao *CurrentVAO;
+   /*@}*/
+};
+
+
+extern void
+_mesa_glthread_init(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_destroy(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_flush_batch(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_finish(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_restore_dispatch(struct gl_context *ctx);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GLTHREAD_H */
@@ -3,7 +3,8 @@
  * Generic hash table. 
  *
  * Used for display lists, texture objects, vertex/fragment programs,
- * buffer objects, etc.  The hash functions are thread-safe.
+ * buffer objects, etc.  The hash functions are thread-safe, and lookups of
+ * the small names handed out by glGen*() don't take the table mutex.
  * 
  * \note key=0 is illegal.
  *
@@ -38,6 +39,7 @@
 #include "imports.h"
 #include "hash.h"
 #include "util/hash_table.h"
+#include "util/u_atomic.h"
 
 /**
  * Magic GLuint object name that gets stored outside of the struct hash_table.
@@ -49,20 +51,48 @@
  * able to track a GLuint that happens to match the deleted key outside of
  * struct hash_table.  We tell the hash table to use "1" as the deleted key
  * value, so that we test the deleted-key-in-the-table path as best we can.
+ *
+ * Since DELETED_KEY_VALUE is below DENSE_MIN_SIZE, it always lives in the
+ * dense array, and never actually reaches the hash table.
  */
 #define DELETED_KEY_VALUE 1
 
+/**
+ * Initial and maximum size of the dense array.
+ */
+#define DENSE_MIN_SIZE 64
+#define DENSE_MAX_SIZE (1 << 20)
+
+/**
+ * The dense part of the table: a flat array, indexed by key, holding the
+ * data of every key below \c Size (NULL for unused keys).  Keys at or above
+ * \c Size are in the hash table.
+ *
+ * Most GL object names are small contiguous integers handed out by
+ * glGen*(), so they end up in here, where _mesa_HashLookup() can find them
+ * without taking the table mutex.  The array is only modified with the mutex
+ * held.  When it grows, the new array is filled in before being published,
+ * and the old one is kept on the \c Prev list until the table is deleted,
+ * as readers may still be looking at it.  Since the size doubles each time,
+ * this at most doubles the memory used.
+ */
+struct dense_names {
+   GLuint Size;
+   uintptr_t *Data;
+   struct dense_names *Prev;   /**< arrays replaced by this one */
+};
+
 /**
  * The hash table data structure.  
  */
 struct _mesa_HashTable {
    struct hash_table *ht;
+   uintptr_t Dense;            /**< struct dense_names *, see dense_names() */
+   GLuint NumDense;            /**< number of used keys in Dense */
    GLuint MaxKey;                        /**< highest key inserted so far */
    mtx_t Mutex;                /**< mutual exclusion lock */
    mtx_t WalkMutex;            /**< for _mesa_HashWalk() */
    GLboolean InDeleteAll;                /**< Debug check */
-   /** Value that would be in the table for DELETED_KEY_VALUE. */
-   void *deleted_key_data;
 };
 
 /** @{
@@ -109,6 +139,107 @@ uint_key(GLuint id)
 }
 /** @} */
 
+
+/**
+ * Get the current dense array.  Safe to call without the mutex.
+ */
+static inline struct dense_names *
+dense_names(const struct _mesa_HashTable *table)
+{
+   return (struct dense_names *) p_atomic_read(&table->Dense);
+}
+
+
+static struct dense_names *
+dense_names_create(GLuint size, struct dense_names *prev)
+{
+   struct dense_names *dense;
+   GLuint prev_size = prev ? prev->Size : 0;
+
+   assert(size > prev_size);
+
+   dense = malloc(sizeof *dense + size * sizeof(uintptr_t));
+   if (!dense)
+      return NULL;
+
+   dense->Size = size;
+   dense->Data = (uintptr_t *) (dense + 1);
+   dense->Prev = prev;
+
+   if (prev)
+      memcpy(dense->Data, prev->Data, prev_size * sizeof(uintptr_t));
+   memset(dense->Data + prev_size, 0, (size - prev_size) * sizeof(uintptr_t));
+
+   return dense;
+}
+
+
+/**
+ * Grow the dense array so that it covers \p key, moving the entries it now
+ * covers out of the hash table.  Must be called with the mutex held.
+ *
+ * Keys too far above the current array go to the hash table instead, so
+ * that a few arbitrary names picked by the application don't make us
+ * allocate a huge array.
+ *
+ * \return GL_TRUE if the dense array now covers \p key.
+ */
+static GLboolean
+dense_names_grow(struct _mesa_HashTable *table, GLuint key)
+{
+   struct dense_names *old = dense_names(table);
+   struct dense_names *dense;
+   struct hash_entry *entry;
+   GLuint size = old->Size * 2;
+
+   if (key >= size || size > DENSE_MAX_SIZE)
+      return GL_FALSE;
+
+   dense = dense_names_create(size, old);
+   if (!dense)
+      return GL_FALSE;
+
+   hash_table_foreach(table->ht, entry) {
+      GLuint k = (uintptr_t) entry->key;
+
+      if (k < dense->Size) {
+         dense->Data[k] = (uintptr_t) entry->data;
+         table->NumDense++;
+         _mesa_hash_table_remove(table->ht, entry);
+      }
+   }
+
+   /* A full barrier, so that readers seeing the new array see its contents
+    * too.
+    */
+   p_atomic_cmpxchg(&table->Dense, (uintptr_t) old, (uintptr_t) dense);
+
+   return GL_TRUE;
+}
+
+
+/**
+ * Set the data of a key in the dense array.  Must be called with the mutex
+ * held.
+ */
+static inline void
+dense_names_set(struct _mesa_HashTable *table, struct dense_names *dense,
+                GLuint key, void *data)
+{
+   uintptr_t old = dense->Data[key];
+
+   if (!old && data)
+      table->NumDense++;
+   else if (old && !data)
+      table->NumDense--;
+
+   /* A full barrier, so that whoever finds the new object without taking
+    * the mutex also sees it completely initialized.
+    */
+   p_atomic_cmpxchg(&dense->Data[key], old, (uintptr_t) data);
+}
+
+
 /**
  * Create a new hash table.
  * 
@@ -128,6 +259,14 @@ _mesa_NewHashTable(void)
          return NULL;
       }
 
+      table->Dense = (uintptr_t) dense_names_create(DENSE_MIN_SIZE, NULL);
+      if (!table->Dense) {
+         _mesa_hash_table_destroy(table->ht, NULL);
+         free(table);
+         _mesa_error_no_memory(__func__);
+         return NULL;
+      }
+
       _mesa_hash_table_set_deleted_key(table->ht, uint_key(DELETED_KEY_VALUE));
       mtx_init(&table->Mutex, mtx_plain);
       mtx_init(&table->WalkMutex, mtx_plain);
@@ -152,14 +291,24 @@ _mesa_NewHashTable(void)
 void
 _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 {
+   struct dense_names *dense;
+
    assert(table);
 
-   if (_mesa_hash_table_next_entry(table->ht, NULL) != NULL) {
+   if (table->NumDense ||
+       _mesa_hash_table_next_entry(table->ht, NULL) != NULL) {
       _mesa_problem(NULL, "In _mesa_DeleteHashTable, found non-freed data");
    }
 
    _mesa_hash_table_destroy(table->ht, NULL);
 
+   dense = dense_names(table);
+   while (dense) {
+      struct dense_names *prev = dense->Prev;
+      free(dense);
+      dense = prev;
+   }
+
    mtx_destroy(&table->Mutex);
    mtx_destroy(&table->WalkMutex);
    free(table);
@@ -174,13 +323,14 @@ _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 static inline void *
 _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
 {
+   const struct dense_names *dense = dense_names(table);
    const struct hash_entry *entry;
 
    assert(table);
    assert(key);
 
-   if (key == DELETED_KEY_VALUE)
-      return table->deleted_key_data;
+   if (key < dense->Size)
+      return (void *) dense->Data[key];
 
    entry = _mesa_hash_table_search(table->ht, uint_key(key));
    if (!entry)
@@ -192,6 +342,10 @@ _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
 
 /**
  * Lookup an entry in the hash table.
+ *
+ * Keys in the dense array are looked up without locking; this races with
+ * concurrent inserts and removes exactly like a locked lookup would, the
+ * result is either the old or the new data.
  * 
  * \param table the hash table.
  * \param key the key.
@@ -201,8 +355,18 @@ _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
 void *
 _mesa_HashLookup(struct _mesa_HashTable *table, GLuint key)
 {
+   const struct dense_names *dense;
    void *res;
    assert(table);
+   assert(key);
+
+   dense = dense_names(table);
+   if (key < dense->Size)
+      return (void *) p_atomic_read(&dense->Data[key]);
+
+   /* The dense array may have grown to cover the key in the meantime, in
+    * which case the locked lookup below finds it there.
+    */
    mtx_lock(&table->Mutex);
    res = _mesa_HashLookup_unlocked(table, key);
    mtx_unlock(&table->Mutex);
@@ -262,6 +426,7 @@ static inline void
 _mesa_HashInsert_unlocked(struct _mesa_HashTable *table, GLuint key, void *data)
 {
    uint32_t hash = uint_hash(key);
+   struct dense_names *dense = dense_names(table);
    struct hash_entry *entry;
 
    assert(table);
@@ -270,8 +435,11 @@ _mesa_HashInsert_unlocked(struct _mesa_HashTable *table, GLuint key, void *data)
    if (key > table->MaxKey)
       table->MaxKey = key;
 
-   if (key == DELETED_KEY_VALUE) {
-      table->deleted_key_data = data;
+   if (key >= dense->Size && dense_names_grow(table, key))
+      dense = dense_names(table);
+
+   if (key < dense->Size) {
+      dense_names_set(table, dense, key, data);
    } else {
       entry = _mesa_hash_table_search_pre_hashed(table->ht, hash, uint_key(key));
       if (entry) {
@@ -331,6 +499,7 @@ _mesa_HashInsert(struct _mesa_HashTable *table, GLuint key, void *data)
 static inline void
 _mesa_HashRemove_unlocked(struct _mesa_HashTable *table, GLuint key)
 {
+   struct dense_names *dense = dense_names(table);
    struct hash_entry *entry;
 
    assert(table);
@@ -343,8 +512,8 @@ _mesa_HashRemove_unlocked(struct _mesa_HashTable *table, GLuint key)
       return;
    }
 
-   if (key == DELETED_KEY_VALUE) {
-      table->deleted_key_data = NULL;
+   if (key < dense->Size) {
+      dense_names_set(table, dense, key, NULL);
    } else {
       entry = _mesa_hash_table_search(table->ht, uint_key(key));
       _mesa_hash_table_remove(table->ht, entry);
@@ -380,20 +549,26 @@ _mesa_HashDeleteAll(struct _mesa_HashTable *table,
                     void (*callback)(GLuint key, void *data, void *userData),
                     void *userData)
 {
+   struct dense_names *dense;
    struct hash_entry *entry;
+   GLuint key;
 
    assert(table);
    assert(callback);
    mtx_lock(&table->Mutex);
    table->InDeleteAll = GL_TRUE;
+   dense = dense_names(table);
+   for (key = 1; key < dense->Size; key++) {
+      void *data = (void *) dense->Data[key];
+      if (data) {
+         callback(key, data, userData);
+         dense_names_set(table, dense, key, NULL);
+      }
+   }
    hash_table_foreach(table->ht, entry) {
       callback((uintptr_t)entry->key, entry->data, userData);
       _mesa_hash_table_remove(table->ht, entry);
    }
-   if (table->deleted_key_data) {
-      callback(DELETED_KEY_VALUE, table->deleted_key_data, userData);
-      table->deleted_key_data = NULL;
-   }
    table->InDeleteAll = GL_FALSE;
    mtx_unlock(&table->Mutex);
 }
@@ -419,15 +594,22 @@ _mesa_HashWalk(const struct _mesa_HashTable *table,
    /* cast-away const */
    struct _mesa_HashTable *table2 = (struct _mesa_HashTable *) table;
    struct hash_entry *entry;
+   GLuint key;
 
    assert(table);
    assert(callback);
    mtx_lock(&table2->WalkMutex);
+   /* The callback may insert or remove entries, so re-fetch the dense array
+    * every time.
+    */
+   for (key = 1; key < dense_names(table)->Size; key++) {
+      void *data = (void *) p_atomic_read(&dense_names(table)->Data[key]);
+      if (data)
+         callback(key, data, userData);
+   }
    hash_table_foreach(table->ht, entry) {
       callback((uintptr_t)entry->key, entry->data, userData);
    }
-   if (table->deleted_key_data)
-      callback(DELETED_KEY_VALUE, table->deleted_key_data, userData);
    mtx_unlock(&table2->WalkMutex);
 }
 
@@ -445,8 +627,6 @@ debug_print_entry(GLuint key, void *data, void *userData)
 void
 _mesa_HashPrint(const struct _mesa_HashTable *table)
 {
-   if (table->deleted_key_data)
-      debug_print_entry(DELETED_KEY_VALUE, table->deleted_key_data, NULL);
    _mesa_HashWalk(table, debug_print_entry, NULL);
 }
 
@@ -503,10 +683,7 @@ _mesa_HashFindFreeKeyBlock(struct _mesa_HashTable *table, GLuint numKeys)
 GLuint
 _mesa_HashNumEntries(const struct _mesa_HashTable *table)
 {
-   GLuint count = 0;
-
-   if (table->deleted_key_data)
-      count++;
+   GLuint count = table->NumDense;
 
    count += _mesa_hash_table_num_entries(table->ht);
 
@@ -0,0 +1,495 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2016  The Mesa Authors   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file marshal.c
+ * Client-side tracking of buffer and vertex array object bindings.
+ *
+ * A draw which reads vertex arrays or indices from application memory
+ * can't be queued, since the application may change that memory as soon
+ * as the call returns.  The functions here are called on the client thread
+ * after the binding calls have been queued (see marshal_call_after in the
+ * API XML) and keep just enough state to tell such draws apart: which
+ * arrays are enabled, which binding each of them reads, and which buffer,
+ * if any, is bound to each binding.  They only check indices, and
+ * otherwise assume that the calls succeed.  Whatever the client can't
+ * know, like what glPopClientAttrib restores, is assumed to read client
+ * memory.
+ */
+
+#include "main/marshal.h"
+#include "main/hash.h"
+#include "main/imports.h"
+#include "util/bitscan.h"
+
+
+/**
+ * Set up the tracking of a new vertex array object: every array disabled,
+ * reading from its own binding, with no buffer bound.
+ */
+void
+_mesa_glthread_init_vao(struct glthread_vao *vao, GLuint name)
+{
+   unsigned i;
+
+   memset(vao, 0, sizeof(*vao));
+   vao->Name = name;
+   for (i = 0; i < VERT_ATTRIB_MAX; i++)
+      vao->BufferBinding[i] = i;
+}
+
+
+/**
+ * Look up, or start tracking, the vertex array object \p name.  Returns
+ * NULL when out of memory.
+ */
+static struct glthread_vao *
+lookup_vao(struct glthread_state *glthread, GLuint name)
+{
+   struct glthread_vao *vao;
+
+   if (name == 0)
+      return &glthread->DefaultVAO;
+
+   vao = _mesa_HashLookup(glthread->VAOs, name);
+   if (!vao) {
+      vao = malloc(sizeof(*vao));
+      if (!vao)
+         return NULL;
+      _mesa_glthread_init_vao(vao, name);
+      _mesa_HashInsert(glthread->VAOs, name, vao);
+   }
+
+   return vao;
+}
+
+
+/**
+ * The vertex array object a call with \p vaobj applies to: the bound one
+ * for zero, as for the non-DSA entry points.
+ */
+static struct glthread_vao *
+get_vao(struct glthread_state *glthread, GLuint vaobj)
+{
+   return vaobj ? lookup_vao(glthread, vaobj) : glthread->CurrentVAO;
+}
+
+
+/**
+ * Recompute HasUserArrays after the enables or bindings changed.
+ */
+static void
+update_user_arrays(struct glthread_vao *vao)
+{
+   GLbitfield64 enabled = vao->Enabled;
+
+   vao->HasUserArrays = false;
+   while (enabled) {
+      const int attrib = u_bit_scan64(&enabled);
+
+      if (!vao->Buffer[vao->BufferBinding[attrib]]) {
+         vao->HasUserArrays = true;
+         return;
+      }
+   }
+}
+
+
+/**
+ * Forget everything about the arrays of \p vao: all of them may be enabled
+ * and read client memory.
+ */
+static void
+reset_vao(struct glthread_vao *vao)
+{
+   const GLuint name = vao->Name;
+
+   _mesa_glthread_init_vao(vao, name);
+   vao->Enabled = VERT_BIT_ALL;
+   vao->HasUserArrays = true;
+}
+
+
+/**
+ * A gl*Pointer call points \p arrays at the bound array buffer, or at
+ * client memory if there is none, each through its own binding.
+ */
+static void
+set_pointers(struct glthread_state *glthread, GLbitfield64 arrays)
+{
+   struct glthread_vao *vao = glthread->CurrentVAO;
+
+   while (arrays) {
+      const int attrib = u_bit_scan64(&arrays);
+
+      vao->BufferBinding[attrib] = attrib;
+      vao->Buffer[attrib] = glthread->ArrayBuffer;
+   }
+
+   update_user_arrays(vao);
+}
+
+
+/**
+ * The texture coordinate arrays the client active texture selects: all of
+ * them when it is unknown.
+ */
+static GLbitfield64
+client_texcoord_arrays(const struct glthread_state *glthread)
+{
+   if (glthread->ClientActiveTexture < VERT_ATTRIB_TEX_MAX)
+      return VERT_BIT_TEX(glthread->ClientActiveTexture);
+   return VERT_BIT_TEX_ALL;
+}
+
+
+/**
+ * Called after the fixed-function gl*Pointer calls but glTexCoordPointer.
+ */
+void
+_mesa_glthread_AttribPointer(struct gl_context *ctx, gl_vert_attrib attrib)
+{
+   set_pointers(ctx->GLThread, VERT_BIT(attrib));
+}
+
+
+void
+_mesa_glthread_TexCoordPointer(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   const GLbitfield64 arrays = client_texcoord_arrays(glthread);
+
+   /* With the unit unknown, only pointing all of them at client memory is
+    * safe.
+    */
+   if (_mesa_bitcount_64(arrays) == 1 || !glthread->ArrayBuffer)
+      set_pointers(glthread, arrays);
+}
+
+
+/**
+ * Called after glVertexAttrib{,I,L}Pointer.
+ */
+void
+_mesa_glthread_VertexAttribPointer(struct gl_context *ctx, GLuint index)
+{
+   if (index < VERT_ATTRIB_GENERIC_MAX)
+      set_pointers(ctx->GLThread, VERT_BIT_GENERIC(index));
+}
+
+
+/**
+ * glInterleavedArrays always sets the vertex array and enables or disables
+ * the color, normal and texture coordinate arrays depending on the format.
+ * Assume they all end up enabled, and only trust the vertex array to read
+ * the array buffer.
+ */
+void
+_mesa_glthread_InterleavedArrays(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   const GLbitfield64 arrays = VERT_BIT_POS | VERT_BIT_COLOR0 |
+                               VERT_BIT_NORMAL |
+                               client_texcoord_arrays(glthread);
+
+   glthread->CurrentVAO->Enabled |= arrays;
+   set_pointers(glthread, glthread->ArrayBuffer ? VERT_BIT_POS : arrays);
+}
+
+
+/**
+ * Called after glEnable/glDisable too, which take the client state
+ * enums as well; anything else is ignored.
+ */
+void
+_mesa_glthread_ClientState(struct gl_context *ctx, GLenum array, bool enable)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_vao *vao = glthread->CurrentVAO;
+   GLbitfield64 arrays;
+
+   switch (array) {
+   case GL_VERTEX_ARRAY:
+      arrays = VERT_BIT_POS;
+      break;
+   case GL_NORMAL_ARRAY:
+      arrays = VERT_BIT_NORMAL;
+      break;
+   case GL_COLOR_ARRAY:
+      arrays = VERT_BIT_COLOR0;
+      break;
+   case GL_SECONDARY_COLOR_ARRAY:
+      arrays = VERT_BIT_COLOR1;
+      break;
+   case GL_FOG_COORDINATE_ARRAY:
+      arrays = VERT_BIT_FOG;
+      break;
+   case GL_INDEX_ARRAY:
+      arrays = VERT_BIT_COLOR_INDEX;
+      break;
+   case GL_EDGE_FLAG_ARRAY:
+      arrays = VERT_BIT_EDGEFLAG;
+      break;
+   case GL_POINT_SIZE_ARRAY_OES:
+      arrays = VERT_BIT_POINT_SIZE;
+      break;
+   case GL_TEXTURE_COORD_ARRAY:
+      arrays = client_texcoord_arrays(glthread);
+      /* With the unit unknown, enabling all of them is the safe guess, and
+       * disabling any of them isn't.
+       */
+      if (!enable && _mesa_bitcount_64(arrays) != 1)
+         return;
+      break;
+   default:
+      return;
+   }
+
+   if (enable)
+      vao->Enabled |= arrays;
+   else
+      vao->Enabled &= ~arrays;
+   update_user_arrays(vao);
+}
+
+
+void
+_mesa_glthread_ClientActiveTexture(struct gl_context *ctx, GLenum texture)
+{
+   const GLuint unit = texture - GL_TEXTURE0;
+
+   /* An invalid unit leaves the client active texture as it was */
+   if (unit < VERT_ATTRIB_TEX_MAX)
+      ctx->GLThread->ClientActiveTexture = unit;
+}
+
+
+/**
+ * Called after gl{Enable,Disable}VertexAttribArray, with \p vaobj zero, and
+ * the DSA equivalents.
+ */
+void
+_mesa_glthread_EnableAttribArray(struct gl_context *ctx, GLuint vaobj,
+                                 GLuint index, bool enable)
+{
+   struct glthread_vao *vao;
+
+   if (index >= VERT_ATTRIB_GENERIC_MAX)
+      return;
+
+   vao = get_vao(ctx->GLThread, vaobj);
+   if (!vao)
+      return;
+
+   if (enable)
+      vao->Enabled |= VERT_BIT_GENERIC(index);
+   else
+      vao->Enabled &= ~VERT_BIT_GENERIC(index);
+   update_user_arrays(vao);
+}
+
+
+/**
+ * Called after glVertexAttribBinding, with \p vaobj zero, and the DSA
+ * equivalent.
+ */
+void
+_mesa_glthread_VertexAttribBinding(struct gl_context *ctx, GLuint vaobj,
+                                   GLuint attribindex, GLuint bindingindex)
+{
+   struct glthread_vao *vao;
+
+   if (attribindex >= VERT_ATTRIB_GENERIC_MAX ||
+       bindingindex >= VERT_ATTRIB_GENERIC_MAX)
+      return;
+
+   vao = get_vao(ctx->GLThread, vaobj);
+   if (!vao)
+      return;
+
+   vao->BufferBinding[VERT_ATTRIB_GENERIC(attribindex)] =
+      VERT_ATTRIB_GENERIC(bindingindex);
+   update_user_arrays(vao);
+}
+
+
+void
+_mesa_glthread_BindBuffer(struct gl_context *ctx, GLenum target,
+                          GLuint buffer)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   switch (target) {
+   case GL_ARRAY_BUFFER:
+      glthread->ArrayBuffer = buffer;
+      break;
+   case GL_ELEMENT_ARRAY_BUFFER:
+      glthread->CurrentVAO->ElementArrayBuffer = buffer;
+      break;
+   }
+}
+
+
+/**
+ * Deleting a buffer unbinds it from the context and from the bound vertex
+ * array object, whose arrays using it then read client memory.
+ */
+void
+_mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                             const GLuint *buffers)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_vao *vao = glthread->CurrentVAO;
+   GLsizei i;
+   unsigned j;
+
+   if (!buffers)
+      return;
+
+   for (i = 0; i < n; i++) {
+      if (!buffers[i])
+         continue;
+
+      if (buffers[i] == glthread->ArrayBuffer)
+         glthread->ArrayBuffer = 0;
+      if (buffers[i] == vao->ElementArrayBuffer)
+         vao->ElementArrayBuffer = 0;
+      for (j = 0; j < VERT_ATTRIB_MAX; j++) {
+         if (buffers[i] == vao->Buffer[j])
+            vao->Buffer[j] = 0;
+      }
+   }
+
+   update_user_arrays(vao);
+}
+
+
+void
+_mesa_glthread_BindVertexArray(struct gl_context *ctx, GLuint array)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_vao *vao = lookup_vao(glthread, array);
+
+   if (!vao) {
+      /* Untracked, so assume the worst from now on. */
+      vao = &glthread->DefaultVAO;
+      reset_vao(vao);
+   }
+
+   glthread->CurrentVAO = vao;
+}
+
+
+void
+_mesa_glthread_DeleteVertexArrays(struct gl_context *ctx, GLsizei n,
+                                  const GLuint *arrays)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   GLsizei i;
+
+   if (!arrays)
+      return;
+
+   for (i = 0; i < n; i++) {
+      struct glthread_vao *vao;
+
+      if (!arrays[i])
+         continue;
+
+      vao = _mesa_HashLookup(glthread->VAOs, arrays[i]);
+      if (!vao)
+         continue;
+
+      /* Deleting the bound object binds the default one. */
+      if (glthread->CurrentVAO == vao)
+         glthread->CurrentVAO = &glthread->DefaultVAO;
+
+      _mesa_HashRemove(glthread->VAOs, arrays[i]);
+      free(vao);
+   }
+}
+
+
+void
+_mesa_glthread_VertexArrayElementBuffer(struct gl_context *ctx,
+                                        GLuint vaobj, GLuint buffer)
+{
+   struct glthread_vao *vao;
+
+   if (!vaobj)
+      return;
+
+   vao = lookup_vao(ctx->GLThread, vaobj);
+   if (vao)
+      vao->ElementArrayBuffer = buffer;
+}
+
+
+/**
+ * Called after glBindVertexBuffer(s) and the DSA equivalents, with
+ * \p vaobj zero for the bound vertex array object.  Binding buffer zero
+ * makes the arrays using that binding read client memory.
+ */
+void
+_mesa_glthread_BindVertexBuffers(struct gl_context *ctx, GLuint vaobj,
+                                 GLuint first, GLsizei count,
+                                 const GLuint *buffers)
+{
+   struct glthread_vao *vao;
+   GLsizei i;
+
+   /* Out of range bindings make the whole call fail */
+   if (first >= VERT_ATTRIB_GENERIC_MAX || count < 0 ||
+       count > VERT_ATTRIB_GENERIC_MAX - first)
+      return;
+
+   vao = get_vao(ctx->GLThread, vaobj);
+   if (!vao)
+      return;
+
+   for (i = 0; i < count; i++) {
+      vao->Buffer[VERT_ATTRIB_GENERIC(first + i)] =
+         buffers ? buffers[i] : 0;
+   }
+
+   update_user_arrays(vao);
+}
+
+
+/**
+ * glPopClientAttrib may restore any array pointers, enables, buffer
+ * bindings and the client active texture, so forget what is known about
+ * them.
+ */
+void
+_mesa_glthread_PopClientAttrib(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   glthread->ArrayBuffer = 0;
+   glthread->ClientActiveTexture = ~0u;
+
+   reset_vao(glthread->CurrentVAO);
+   reset_vao(&glthread->DefaultVAO);
+}
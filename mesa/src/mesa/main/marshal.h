@@ -0,0 +1,199 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2016  The Mesa Authors   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file marshal.h
+ * Helpers for the generated marshal functions (marshal_generated.c): the
+ * command allocator and the client-side tracking which decides whether a
+ * draw may be queued or must run synchronously.
+ */
+
+#ifndef MARSHAL_H
+#define MARSHAL_H
+
+#include <limits.h>
+#include <string.h>
+
+#include "main/glthread.h"
+#include "main/context.h"
+#include "main/macros.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/** Header of every queued command */
+struct marshal_cmd_base
+{
+   /** Which _mesa_unmarshal_* function to call */
+   uint16_t cmd_id;
+
+   /** Size of the command in bytes, including this header */
+   uint16_t cmd_size;
+};
+
+
+/**
+ * Reserve \p size bytes for a command in the batch being filled, handing
+ * the batch over to the server first if the command doesn't fit.
+ */
+static inline void *
+_mesa_glthread_allocate_command(struct gl_context *ctx,
+                                uint16_t cmd_id, size_t size)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_batch *batch =
+      &glthread->batches[glthread->submitted % MARSHAL_MAX_BATCHES];
+   struct marshal_cmd_base *cmd_base;
+   const size_t aligned_size = ALIGN(size, 8);
+
+   assert(aligned_size <= MARSHAL_MAX_CMD_SIZE);
+
+   if (unlikely(batch->used + aligned_size > MARSHAL_MAX_CMD_SIZE)) {
+      _mesa_glthread_flush_batch(ctx);
+      batch = &glthread->batches[glthread->submitted % MARSHAL_MAX_BATCHES];
+   }
+
+   cmd_base = (struct marshal_cmd_base *)
+      ((uint8_t *) batch->buffer + batch->used);
+   batch->used += aligned_size;
+   cmd_base->cmd_id = cmd_id;
+   cmd_base->cmd_size = aligned_size;
+   return cmd_base;
+}
+
+
+/**
+ * Size in bytes of an array of \p a elements of \p b bytes, or -1 if
+ * \p a is negative or the size doesn't fit in an int.  Either way such an
+ * array is far too big to queue.
+ */
+static inline GLsizeiptr
+safe_mul(GLsizeiptr a, GLsizeiptr b)
+{
+   if (a < 0 || b < 0)
+      return -1;
+   if (a == 0 || b == 0)
+      return 0;
+   if (a > INT_MAX / b)
+      return -1;
+   return a * b;
+}
+
+
+/**
+ * Whether a non-indexed draw may read vertex arrays in client memory,
+ * which has to happen before the draw call returns.
+ */
+static inline bool
+_mesa_glthread_has_user_arrays(const struct gl_context *ctx)
+{
+   return ctx->API != API_OPENGL_CORE &&
+          ctx->GLThread->CurrentVAO->HasUserArrays;
+}
+
+
+/**
+ * As above, for an indexed draw, which also reads the indices from client
+ * memory when there is no element array buffer.
+ */
+static inline bool
+_mesa_glthread_has_user_elements(const struct gl_context *ctx)
+{
+   return ctx->API != API_OPENGL_CORE &&
+          (ctx->GLThread->CurrentVAO->HasUserArrays ||
+           !ctx->GLThread->CurrentVAO->ElementArrayBuffer);
+}
+
+
+extern size_t
+_mesa_unmarshal_dispatch_cmd(struct gl_context *ctx, const void *cmd);
+
+extern struct _glapi_table *
+_mesa_create_marshal_table(void);
+
+extern void
+_mesa_glthread_init_vao(struct glthread_vao *vao, GLuint name);
+
+extern void
+_mesa_glthread_AttribPointer(struct gl_context *ctx, gl_vert_attrib attrib);
+
+extern void
+_mesa_glthread_TexCoordPointer(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_VertexAttribPointer(struct gl_context *ctx, GLuint index);
+
+extern void
+_mesa_glthread_InterleavedArrays(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_ClientState(struct gl_context *ctx, GLenum array,
+                           bool enable);
+
+extern void
+_mesa_glthread_ClientActiveTexture(struct gl_context *ctx, GLenum texture);
+
+extern void
+_mesa_glthread_EnableAttribArray(struct gl_context *ctx, GLuint vaobj,
+                                 GLuint index, bool enable);
+
+extern void
+_mesa_glthread_VertexAttribBinding(struct gl_context *ctx, GLuint vaobj,
+                                   GLuint attribindex, GLuint bindingindex);
+
+extern void
+_mesa_glthread_BindBuffer(struct gl_context *ctx, GLenum target,
+                          GLuint buffer);
+
+extern void
+_mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                             const GLuint *buffers);
+
+extern void
+_mesa_glthread_BindVertexArray(struct gl_context *ctx, GLuint array);
+
+extern void
+_mesa_glthread_DeleteVertexArrays(struct gl_context *ctx, GLsizei n,
+                                  const GLuint *arrays);
+
+extern void
+_mesa_glthread_VertexArrayElementBuffer(struct gl_context *ctx,
+                                        GLuint vaobj, GLuint buffer);
+
+extern void
+_mesa_glthread_BindVertexBuffers(struct gl_context *ctx, GLuint vaobj,
+                                 GLuint first, GLsizei count,
+                                 const GLuint *buffers);
+
+extern void
+_mesa_glthread_PopClientAttrib(struct gl_context *ctx);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MARSHAL_H */
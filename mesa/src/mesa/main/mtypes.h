@@ -83,6 +83,7 @@ struct gl_context;
 struct st_context;
 struct gl_uniform_storage;
 struct prog_instruction;
+struct glthread_state;
 struct gl_program_parameter_list;
 struct set;
 struct set_entry;
@@ -2703,6 +2704,12 @@ struct gl_shader_program
     */
    GLboolean BinaryRetreivableHint;
 
+   /**
+    * The GL_PROGRAM_BINARY_FORMAT_MESA binary of the program, made when it
+    * is linked or loaded by glProgramBinary.  NULL if serializing failed.
+    */
+   struct blob *Binary;
+
    /**
     * Indicates whether program can be bound for individual pipeline stages
     * using UseProgramStages after it is next linked.
@@ -4394,8 +4401,16 @@ struct gl_context
     * re-set on glXMakeCurrent().
     */
    struct _glapi_table *CurrentDispatch;
+   /**
+    * Dispatch table installed on the application's thread instead of
+    * CurrentDispatch when GLThread is set.  See glthread.h.
+    */
+   struct _glapi_table *MarshalExec;
    /*@}*/
 
+   /** Server thread state, or NULL when calls are executed directly */
+   struct glthread_state *GLThread;
+
    struct gl_config Visual;
    struct gl_framebuffer *DrawBuffer;	/**< buffer for writing */
    struct gl_framebuffer *ReadBuffer;	/**< buffer for reading */
@@ -49,10 +49,12 @@
 #include "main/shaderobj.h"
 #include "main/transformfeedback.h"
 #include "main/uniforms.h"
+#include "compiler/glsl/blob.h"
 #include "compiler/glsl/glsl_parser_extras.h"
 #include "compiler/glsl/ir.h"
 #include "compiler/glsl/ir_uniform.h"
 #include "compiler/glsl/program.h"
+#include "compiler/glsl/shader_cache.h"
 #include "program/program.h"
 #include "program/prog_print.h"
 #include "program/prog_parameter.h"
@@ -606,6 +608,26 @@ check_tes_query(struct gl_context *ctx, const struct gl_shader_program *shProg)
 }
 
 
+/**
+ * Serialize the shaders a program was linked from into a new
+ * GL_PROGRAM_BINARY_FORMAT_MESA binary.
+ * \return the binary, allocated from \p mem_ctx, or NULL on failure.
+ */
+static struct blob *
+serialize_program_binary(struct gl_context *ctx,
+                         struct gl_shader_program *shProg, void *mem_ctx)
+{
+   struct blob *binary = blob_create(mem_ctx);
+
+   if (binary && !_mesa_glsl_serialize_program(ctx, binary, shProg)) {
+      ralloc_free(binary);
+      binary = NULL;
+   }
+
+   return binary;
+}
+
+
 /**
  * glGetProgramiv() - get shader program state.
  * Note that this is for GLSL shader programs, not ARB vertex/fragment
@@ -797,7 +819,8 @@ get_programiv(struct gl_context *ctx, GLuint program, GLenum pname,
       *params = shProg->BinaryRetreivableHint;
       return;
    case GL_PROGRAM_BINARY_LENGTH:
-      *params = 0;
+      *params = shProg->LinkStatus && shProg->Binary ?
+                shProg->Binary->size : 0;
       return;
    case GL_ACTIVE_ATOMIC_COUNTER_BUFFERS:
       if (!ctx->Extensions.ARB_shader_atomic_counters)
@@ -1031,7 +1054,10 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
       /* this call will set the shader->CompileStatus field to indicate if
        * compilation was successful.
        */
-      _mesa_glsl_compile_shader(ctx, sh, false, false);
+      if (!_mesa_glsl_shader_cache_load(ctx, sh)) {
+         _mesa_glsl_compile_shader(ctx, sh, false, false);
+         _mesa_glsl_shader_cache_store(ctx, sh);
+      }
 
       if (ctx->_Shader->Flags & GLSL_LOG) {
          _mesa_write_shader_to_file(sh);
@@ -1092,6 +1118,15 @@ _mesa_link_program(struct gl_context *ctx, struct gl_shader_program *shProg)
 
    _mesa_glsl_link_shader(ctx, shProg);
 
+   /* The binary has to be made now: the attached shaders may be detached
+    * or recompiled before it's queried.  GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    * doesn't change that, as the spec allows querying it either way.
+    */
+   ralloc_free(shProg->Binary);
+   shProg->Binary = NULL;
+   if (shProg->LinkStatus)
+      shProg->Binary = serialize_program_binary(ctx, shProg, shProg);
+
    /* Capture .shader_test files. */
    const char *capture_path = _mesa_get_shader_capture_path();
    if (shProg->Name != 0 && shProg->Name != ~0 && capture_path != NULL) {
@@ -1971,6 +2006,7 @@ _mesa_GetProgramBinary(GLuint program, GLsizei bufSize, GLsizei *length,
                        GLenum *binaryFormat, GLvoid *binary)
 {
    struct gl_shader_program *shProg;
+   struct blob *program_binary;
    GLsizei length_dummy;
    GET_CURRENT_CONTEXT(ctx);
 
@@ -2008,12 +2044,29 @@ _mesa_GetProgramBinary(GLuint program, GLsizei bufSize, GLsizei *length,
       return;
    }
 
-   *length = 0;
-   _mesa_error(ctx, GL_INVALID_OPERATION,
-               "glGetProgramBinary(driver supports zero binary formats)");
+   program_binary = shProg->Binary;
+   if (!program_binary) {
+      _mesa_error(ctx, GL_INVALID_OPERATION,
+                  "glGetProgramBinary(program %u has no binary)",
+                  shProg->Name);
+      *length = 0;
+      return;
+   }
 
-   (void) binaryFormat;
-   (void) binary;
+   /* The ARB_get_program_binary spec says:
+    *
+    *     "If <bufSize> is less than the number of bytes in the program
+    *     binary, then an INVALID_OPERATION error is thrown."
+    */
+   if (program_binary->size > (size_t) bufSize) {
+      _mesa_error(ctx, GL_INVALID_OPERATION,
+                  "glGetProgramBinary(bufSize too small)");
+      *length = 0;
+   } else {
+      memcpy(binary, program_binary->data, program_binary->size);
+      *length = program_binary->size;
+      *binaryFormat = GL_PROGRAM_BINARY_FORMAT_MESA;
+   }
 }
 
 void GLAPIENTRY
@@ -2021,15 +2074,15 @@ _mesa_ProgramBinary(GLuint program, GLenum binaryFormat,
                     const GLvoid *binary, GLsizei length)
 {
    struct gl_shader_program *shProg;
+   struct gl_shader **shaders, **attached_shaders;
+   unsigned num_shaders, num_attached_shaders, i;
+   struct blob_reader reader;
    GET_CURRENT_CONTEXT(ctx);
 
    shProg = _mesa_lookup_shader_program_err(ctx, program, "glProgramBinary");
    if (!shProg)
       return;
 
-   (void) binaryFormat;
-   (void) binary;
-
    /* Section 2.3.1 (Errors) of the OpenGL 4.5 spec says:
     *
     *     "If a negative number is provided where an argument of type sizei or
@@ -2049,11 +2102,62 @@ _mesa_ProgramBinary(GLuint program, GLenum binaryFormat,
     *     setting the LINK_STATUS of <program> to FALSE, if these conditions
     *     are not met."
     *
-    * Since any value of binaryFormat passed "is not one of those specified as
+    * Any other value of binaryFormat "is not one of those specified as
     * allowable for [this] command, an INVALID_ENUM error is generated."
     */
-   shProg->LinkStatus = GL_FALSE;
-   _mesa_error(ctx, GL_INVALID_ENUM, "glProgramBinary");
+   if (binaryFormat != GL_PROGRAM_BINARY_FORMAT_MESA) {
+      shProg->LinkStatus = GL_FALSE;
+      _mesa_error(ctx, GL_INVALID_ENUM, "glProgramBinary");
+      return;
+   }
+
+   if (_mesa_transform_feedback_is_using_program(ctx, shProg)) {
+      _mesa_error(ctx, GL_INVALID_OPERATION,
+                  "glProgramBinary(transform feedback is using the program)");
+      return;
+   }
+
+   FLUSH_VERTICES(ctx, _NEW_PROGRAM);
+
+   ralloc_free(shProg->Binary);
+   shProg->Binary = NULL;
+
+   blob_reader_init(&reader, (uint8_t *) binary, length);
+   if (!binary ||
+       !_mesa_glsl_deserialize_program(ctx, &reader, shProg,
+                                       &shaders, &num_shaders)) {
+      _mesa_clear_shader_program_data(shProg);
+      shProg->LinkStatus = GL_FALSE;
+      ralloc_free(shProg->InfoLog);
+      shProg->InfoLog =
+         ralloc_strdup(shProg, "program binary is invalid or incompatible "
+                       "with this driver\n");
+      return;
+   }
+
+   /* The binary holds the compiled shaders the program was linked from:
+    * link them again in place of the attached shaders, which are left
+    * untouched.
+    */
+   attached_shaders = shProg->Shaders;
+   num_attached_shaders = shProg->NumShaders;
+   shProg->Shaders = shaders;
+   shProg->NumShaders = num_shaders;
+
+   _mesa_glsl_link_shader(ctx, shProg);
+
+   shProg->Shaders = attached_shaders;
+   shProg->NumShaders = num_attached_shaders;
+
+   if (shProg->LinkStatus) {
+      shProg->Binary = blob_create(shProg);
+      if (shProg->Binary)
+         blob_write_bytes(shProg->Binary, binary, length);
+   }
+
+   for (i = 0; i < num_shaders; i++)
+      _mesa_reference_shader(ctx, &shaders[i], NULL);
+   ralloc_free(shaders);
 }
 
 
@@ -26,69 +26,218 @@
  */
 
 #include "main/sse_minmax.h"
+#include <assert.h>
 #include <smmintrin.h>
 #include <stdint.h>
 
-void
-_mesa_uint_array_min_max(const unsigned *ui_indices, unsigned *min_index,
-                         unsigned *max_index, const unsigned count)
+/*
+ * The loops below keep a running minimum and maximum per vector lane.
+ * With primitive restart, lanes holding the restart index are set to all
+ * ones before taking the minimum and cleared before taking the maximum,
+ * so they never win and there is no branch per index.  A lane which only
+ * ever saw the restart index ends up with its minimum above its maximum,
+ * which is how the final reduction tells it apart.
+ *
+ * All the helpers take the index size as a parameter and are always
+ * inlined with a constant size, so each index type gets its own loop.
+ */
+
+static inline unsigned
+get_index(const void *ptr, unsigned index_size)
 {
+   switch (index_size) {
+   case 1:
+      return *(const uint8_t *) ptr;
+   case 2:
+      return *(const uint16_t *) ptr;
+   default:
+      return *(const uint32_t *) ptr;
+   }
+}
+
+static inline __m128i
+set1_index(unsigned value, unsigned index_size)
+{
+   switch (index_size) {
+   case 1:
+      return _mm_set1_epi8(value);
+   case 2:
+      return _mm_set1_epi16(value);
+   default:
+      return _mm_set1_epi32(value);
+   }
+}
+
+static inline __m128i
+cmpeq_index(__m128i a, __m128i b, unsigned index_size)
+{
+   switch (index_size) {
+   case 1:
+      return _mm_cmpeq_epi8(a, b);
+   case 2:
+      return _mm_cmpeq_epi16(a, b);
+   default:
+      return _mm_cmpeq_epi32(a, b);
+   }
+}
+
+static inline __m128i
+min_epu(__m128i a, __m128i b, unsigned index_size)
+{
+   switch (index_size) {
+   case 1:
+      return _mm_min_epu8(a, b);
+   case 2:
+      return _mm_min_epu16(a, b);
+   default:
+      return _mm_min_epu32(a, b);
+   }
+}
+
+static inline __m128i
+max_epu(__m128i a, __m128i b, unsigned index_size)
+{
+   switch (index_size) {
+   case 1:
+      return _mm_max_epu8(a, b);
+   case 2:
+      return _mm_max_epu16(a, b);
+   default:
+      return _mm_max_epu32(a, b);
+   }
+}
+
+static inline __attribute__((always_inline)) void
+array_min_max(const void *indices, const unsigned index_size,
+              unsigned count, const bool restart, unsigned restart_index,
+              unsigned *min_out, unsigned *max_out)
+{
+   const uint8_t *ptr = indices;
+   const unsigned lanes = 16 / index_size;
    unsigned max_ui = 0;
    unsigned min_ui = ~0U;
-   unsigned i = 0;
-   unsigned aligned_count = count;
+   unsigned vec_count, i;
 
    /* handle the first few values without SSE until the pointer is aligned */
-   while (((uintptr_t)ui_indices & 15) && aligned_count) {
-      if (*ui_indices > max_ui)
-         max_ui = *ui_indices;
-      if (*ui_indices < min_ui)
-         min_ui = *ui_indices;
-
-      aligned_count--;
-      ui_indices++;
+   while (((uintptr_t) ptr & 15) && count) {
+      const unsigned index = get_index(ptr, index_size);
+
+      if (!restart || index != restart_index) {
+         if (index > max_ui)
+            max_ui = index;
+         if (index < min_ui)
+            min_ui = index;
+      }
+
+      count--;
+      ptr += index_size;
    }
 
-   /* TODO: The actual threshold for SSE begin useful may be higher than 8.
-    * Some careful microbenchmarks and measurement are required to
-    * find the actual tipping point.
+   /* TODO: The actual threshold for SSE begin useful may be higher than
+    * two vectors.  Some careful microbenchmarks and measurement are
+    * required to find the actual tipping point.
     */
-   if (aligned_count >= 8) {
-      unsigned max_arr[4] __attribute__ ((aligned (16)));
-      unsigned min_arr[4] __attribute__ ((aligned (16)));
-      unsigned vec_count;
-      __m128i max_ui4 = _mm_setzero_si128();
-      __m128i min_ui4 = _mm_set1_epi32(~0U);
-      __m128i ui_indices4;
-      __m128i *ui_indices_ptr;
-
-      vec_count = aligned_count & ~0x3;
-      ui_indices_ptr = (__m128i *)ui_indices;
-      for (i = 0; i < vec_count / 4; i++) {
-         ui_indices4 = _mm_load_si128(&ui_indices_ptr[i]);
-         max_ui4 = _mm_max_epu32(ui_indices4, max_ui4);
-         min_ui4 = _mm_min_epu32(ui_indices4, min_ui4);
+   vec_count = count / lanes;
+   if (vec_count >= 2) {
+      uint8_t max_arr[16] __attribute__ ((aligned (16)));
+      uint8_t min_arr[16] __attribute__ ((aligned (16)));
+      const __m128i *vec_ptr = (const __m128i *) ptr;
+      const __m128i restart4 = set1_index(restart_index, index_size);
+      __m128i max4 = _mm_setzero_si128();
+      __m128i min4 = _mm_set1_epi32(~0U);
+
+      for (i = 0; i < vec_count; i++) {
+         const __m128i indices4 = _mm_load_si128(&vec_ptr[i]);
+
+         if (restart) {
+            const __m128i is_restart =
+               cmpeq_index(indices4, restart4, index_size);
+
+            max4 = max_epu(_mm_andnot_si128(is_restart, indices4), max4,
+                             index_size);
+            min4 = min_epu(_mm_or_si128(is_restart, indices4), min4,
+                             index_size);
+         } else {
+            max4 = max_epu(indices4, max4, index_size);
+            min4 = min_epu(indices4, min4, index_size);
+         }
       }
 
-      _mm_store_si128((__m128i *)max_arr, max_ui4);
-      _mm_store_si128((__m128i *)min_arr, min_ui4);
+      _mm_store_si128((__m128i *) max_arr, max4);
+      _mm_store_si128((__m128i *) min_arr, min4);
+
+      for (i = 0; i < lanes; i++) {
+         const unsigned lane_max = get_index(max_arr + i * index_size,
+                                             index_size);
+         const unsigned lane_min = get_index(min_arr + i * index_size,
+                                             index_size);
 
-      for (i = 0; i < 4; i++) {
-         if (max_arr[i] > max_ui)
-            max_ui = max_arr[i];
-         if (min_arr[i] < min_ui)
-            min_ui = min_arr[i];
+         if (lane_min > lane_max)
+            continue;
+         if (lane_max > max_ui)
+            max_ui = lane_max;
+         if (lane_min < min_ui)
+            min_ui = lane_min;
       }
-      i = vec_count;
+
+      ptr += vec_count * 16;
+      count -= vec_count * lanes;
    }
 
-   for (; i < aligned_count; i++) {
-      if (ui_indices[i] > max_ui)
-         max_ui = ui_indices[i];
-      if (ui_indices[i] < min_ui)
-         min_ui = ui_indices[i];
+   for (i = 0; i < count; i++) {
+      const unsigned index = get_index(ptr + i * index_size, index_size);
+
+      if (!restart || index != restart_index) {
+         if (index > max_ui)
+            max_ui = index;
+         if (index < min_ui)
+            min_ui = index;
+      }
    }
 
-   *min_index = min_ui;
-   *max_index = max_ui;
+   *min_out = min_ui;
+   *max_out = max_ui;
+}
+
+void
+_mesa_uint_array_min_max(const unsigned *ui_indices, unsigned *min_index,
+                         unsigned *max_index, const unsigned count)
+{
+   array_min_max(ui_indices, 4, count, false, 0, min_index, max_index);
+}
+
+void
+_mesa_index_array_min_max(const void *indices, unsigned index_size,
+                          unsigned count, bool restart,
+                          unsigned restart_index,
+                          unsigned *min_index, unsigned *max_index)
+{
+   /* A restart index which doesn't fit the index type never matches. */
+   if (restart && index_size < 4 && restart_index >> (index_size * 8))
+      restart = false;
+
+   switch (index_size) {
+   case 1:
+      if (restart)
+         array_min_max(indices, 1, count, true, restart_index,
+                       min_index, max_index);
+      else
+         array_min_max(indices, 1, count, false, 0, min_index, max_index);
+      break;
+   case 2:
+      if (restart)
+         array_min_max(indices, 2, count, true, restart_index,
+                       min_index, max_index);
+      else
+         array_min_max(indices, 2, count, false, 0, min_index, max_index);
+      break;
+   default:
+      assert(index_size == 4);
+      if (restart)
+         array_min_max(indices, 4, count, true, restart_index,
+                       min_index, max_index);
+      else
+         array_min_max(indices, 4, count, false, 0, min_index, max_index);
+      break;
+   }
 }
@@ -25,6 +25,19 @@
  *
  */
 
+#include <stdbool.h>
+
 void
 _mesa_uint_array_min_max(const unsigned *ui_indices, unsigned *min_index,
                          unsigned *max_index, const unsigned count);
+
+/**
+ * Minimum and maximum of an array of \p index_size byte indices, skipping
+ * \p restart_index if \p restart is set.  If every index is skipped, the
+ * minimum is ~0 and the maximum 0.
+ */
+void
+_mesa_index_array_min_max(const void *indices, unsigned index_size,
+                          unsigned count, bool restart,
+                          unsigned restart_index,
+                          unsigned *min_index, unsigned *max_index);
@@ -0,0 +1,322 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name format_convert.cpp
+ *
+ * Check that the SSE4.1 and AVX2 row kernels, and
+ * _mesa_swizzle_and_convert(), which picks one of them for the CPU, give
+ * the same bits as the scalar conversion.  The scalar reference is made by
+ * hiding the CPU features from _mesa_swizzle_and_convert().  Each kernel
+ * is skipped on CPUs without its instruction set.
+ *
+ * DISABLED_Throughput reports GB/s for each conversion; run it with
+ * --gtest_also_run_disabled_tests.
+ */
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <time.h>
+
+#include "main/format_utils.h"
+
+extern "C" {
+#include "main/cpuinfo.h"
+#include "main/format_utils_simd.h"
+}
+
+#define MAX_PIXELS 64
+
+struct conversion {
+   const char *name;
+   enum mesa_array_format_datatype dst_type;
+   enum mesa_array_format_datatype src_type;
+   bool normalized;
+};
+
+static const struct conversion conversions[] = {
+   { "RGBA8 -> RGBA8", MESA_ARRAY_FORMAT_TYPE_UBYTE,
+     MESA_ARRAY_FORMAT_TYPE_UBYTE, true },
+   { "RGBA16 -> RGBA16", MESA_ARRAY_FORMAT_TYPE_USHORT,
+     MESA_ARRAY_FORMAT_TYPE_USHORT, true },
+   { "RGBA16F -> RGBA16F", MESA_ARRAY_FORMAT_TYPE_HALF,
+     MESA_ARRAY_FORMAT_TYPE_HALF, false },
+   { "RGBA32F -> RGBA32F", MESA_ARRAY_FORMAT_TYPE_FLOAT,
+     MESA_ARRAY_FORMAT_TYPE_FLOAT, false },
+   { "RGBA32I -> RGBA32I", MESA_ARRAY_FORMAT_TYPE_INT,
+     MESA_ARRAY_FORMAT_TYPE_INT, false },
+   { "RGBA8 -> RGBA32F", MESA_ARRAY_FORMAT_TYPE_FLOAT,
+     MESA_ARRAY_FORMAT_TYPE_UBYTE, true },
+   { "RGBA8UI -> RGBA32F", MESA_ARRAY_FORMAT_TYPE_FLOAT,
+     MESA_ARRAY_FORMAT_TYPE_UBYTE, false },
+   { "RGBA32F -> RGBA8", MESA_ARRAY_FORMAT_TYPE_UBYTE,
+     MESA_ARRAY_FORMAT_TYPE_FLOAT, true },
+   { "RGBA16F -> RGBA32F", MESA_ARRAY_FORMAT_TYPE_FLOAT,
+     MESA_ARRAY_FORMAT_TYPE_HALF, false },
+   { "RGBA32F -> RGBA16F", MESA_ARRAY_FORMAT_TYPE_HALF,
+     MESA_ARRAY_FORMAT_TYPE_FLOAT, false },
+};
+
+static const uint8_t swizzles[][4] = {
+   { 2, 1, 0, 3 },
+   { 3, 2, 1, 0 },
+   { 0, 1, 2, MESA_FORMAT_SWIZZLE_ONE },
+   { MESA_FORMAT_SWIZZLE_ZERO, 0, MESA_FORMAT_SWIZZLE_ONE, 1 },
+   { 0, 0, 0, 0 },
+};
+
+/* Floats worth checking on top of the random bit patterns */
+static const uint32_t special_floats[] = {
+   0x00000000, /* 0.0 */
+   0x80000000, /* -0.0 */
+   0x3f800000, /* 1.0 */
+   0x3f000000, /* 0.5 */
+   0x3b808081, /* 1.0 / 255.0 */
+   0x3bc0c0c1, /* 1.5 / 255.0 */
+   0x477fe000, /* 65504.0, largest half */
+   0x477ff000, /* 65520.0, rounds to half infinity */
+   0x33800000, /* 2^-24, smallest half denorm */
+   0x00000001, /* float denorm */
+   0x7f800000, /* infinity */
+   0xff800000, /* -infinity */
+   0x7fc00000, /* quiet NaN */
+   0xff812345, /* signalling NaN with a payload */
+};
+
+static uint32_t
+next_random(uint32_t *seed)
+{
+   *seed = *seed * 1103515245 + 12345;
+   return *seed ^ (*seed >> 15);
+}
+
+static void
+fill_source(void *src, enum mesa_array_format_datatype type, uint32_t seed)
+{
+   const int size = _mesa_array_format_datatype_get_size(type);
+   const int n = MAX_PIXELS * 4;
+   int i;
+
+   for (i = 0; i < n; i++) {
+      uint32_t r = next_random(&seed);
+
+      if (type == MESA_ARRAY_FORMAT_TYPE_FLOAT) {
+         /* Mostly values in [0, 1], where unorm rounding matters */
+         float f = (r & 0xffff) / 65535.0f;
+         uint32_t bits;
+
+         switch ((r >> 16) % 4) {
+         case 0:
+            bits = special_floats[(r >> 18) % ARRAY_SIZE(special_floats)];
+            memcpy(&f, &bits, 4);
+            break;
+         case 1:
+            bits = next_random(&seed);
+            memcpy(&f, &bits, 4);
+            break;
+         }
+         ((float *) src)[i] = f;
+      } else {
+         memcpy((uint8_t *) src + i * size, &r, size);
+      }
+   }
+}
+
+typedef int (*convert_func)(void *dst,
+                            enum mesa_array_format_datatype dst_type,
+                            int num_dst_channels,
+                            const void *src,
+                            enum mesa_array_format_datatype src_type,
+                            int num_src_channels,
+                            const uint8_t swizzle[4], bool normalized,
+                            int count);
+
+/**
+ * Convert a row without any of the SIMD kernels.
+ */
+static void
+convert_scalar(void *dst, const struct conversion *conv, const void *src,
+               const uint8_t swizzle[4], int count)
+{
+#if defined(USE_X86_ASM) || defined(USE_X86_64_ASM)
+   const int features = _mesa_x86_cpu_features;
+
+   _mesa_x86_cpu_features = 0;
+#endif
+
+   _mesa_swizzle_and_convert(dst, conv->dst_type, 4, src, conv->src_type, 4,
+                             swizzle, conv->normalized, count);
+
+#if defined(USE_X86_ASM) || defined(USE_X86_64_ASM)
+   _mesa_x86_cpu_features = features;
+#endif
+}
+
+/**
+ * _mesa_swizzle_and_convert() with the interface of the row kernels.
+ */
+static int
+convert_dispatch(void *dst, enum mesa_array_format_datatype dst_type,
+                 int num_dst_channels,
+                 const void *src, enum mesa_array_format_datatype src_type,
+                 int num_src_channels,
+                 const uint8_t swizzle[4], bool normalized, int count)
+{
+   _mesa_swizzle_and_convert(dst, dst_type, num_dst_channels,
+                             src, src_type, num_src_channels,
+                             swizzle, normalized, count);
+   return count;
+}
+
+/**
+ * Convert rows of every length with func, finish the pixels it left with
+ * the scalar code, and compare the result with a scalar conversion of the
+ * whole row, including the bytes past its end.
+ */
+static void
+check_against_scalar(convert_func func, const char *func_name)
+{
+   uint32_t src[MAX_PIXELS * 4];
+   uint8_t row[MAX_PIXELS * 16 + 16], scalar[MAX_PIXELS * 16 + 16];
+   bool converted_any = false;
+   unsigned c, s;
+   int count;
+
+   for (c = 0; c < ARRAY_SIZE(conversions); c++) {
+      const struct conversion *conv = &conversions[c];
+      const int dst_size = 4 * _mesa_array_format_datatype_get_size(conv->dst_type);
+      const int src_size = 4 * _mesa_array_format_datatype_get_size(conv->src_type);
+
+      fill_source(src, conv->src_type, c + 1);
+
+      for (s = 0; s < ARRAY_SIZE(swizzles); s++) {
+         for (count = 0; count <= MAX_PIXELS; count++) {
+            int done;
+
+            memset(row, 0xcd, sizeof(row));
+            memset(scalar, 0xcd, sizeof(scalar));
+
+            done = func(row, conv->dst_type, 4,
+                        src, conv->src_type, 4,
+                        swizzles[s], conv->normalized, count);
+            ASSERT_GE(done, 0);
+            ASSERT_LE(done, count);
+            if (done > 0)
+               converted_any = true;
+
+            convert_scalar(row + done * dst_size, conv,
+                           (uint8_t *) src + done * src_size,
+                           swizzles[s], count - done);
+            convert_scalar(scalar, conv, src, swizzles[s], count);
+
+            EXPECT_EQ(0, memcmp(row, scalar, sizeof(row)))
+               << func_name << ": " << conv->name << ", swizzle " << s
+               << ", " << count << " pixels, " << done << " converted";
+         }
+      }
+   }
+
+   /* Make sure the kernel isn't just declining everything */
+   EXPECT_TRUE(converted_any) << func_name;
+}
+
+TEST(FormatConvertTest, DispatchMatchesScalar)
+{
+   _mesa_get_cpu_features();
+
+   check_against_scalar(convert_dispatch, "_mesa_swizzle_and_convert");
+}
+
+#if defined(USE_SSE41)
+TEST(FormatConvertTest, Sse41MatchesScalar)
+{
+   _mesa_get_cpu_features();
+   if (!cpu_has_sse4_1)
+      return;
+
+   check_against_scalar(_mesa_swizzle_and_convert_sse41,
+                        "_mesa_swizzle_and_convert_sse41");
+}
+#endif
+
+#if defined(USE_AVX2)
+TEST(FormatConvertTest, Avx2MatchesScalar)
+{
+   _mesa_get_cpu_features();
+   if (!cpu_has_avx2)
+      return;
+
+   check_against_scalar(_mesa_swizzle_and_convert_avx2,
+                        "_mesa_swizzle_and_convert_avx2");
+}
+#endif
+
+static double
+time_seconds(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+TEST(FormatConvertTest, DISABLED_Throughput)
+{
+   /* A 1024x1024 image, one row at a time, as _mesa_format_convert does */
+   const int width = 1024, height = 1024, passes = 8;
+   static const uint8_t bgra[4] = { 2, 1, 0, 3 };
+   uint8_t *src = new uint8_t[width * height * 16];
+   uint8_t *dst = new uint8_t[width * height * 16];
+   unsigned c;
+
+   _mesa_get_cpu_features();
+
+   memset(src, 0x3c, width * height * 16);
+
+   for (c = 0; c < ARRAY_SIZE(conversions); c++) {
+      const struct conversion *conv = &conversions[c];
+      const int dst_size = 4 * _mesa_array_format_datatype_get_size(conv->dst_type);
+      const int src_size = 4 * _mesa_array_format_datatype_get_size(conv->src_type);
+      double start, elapsed, bytes;
+      int p, y;
+
+      start = time_seconds();
+      for (p = 0; p < passes; p++) {
+         for (y = 0; y < height; y++) {
+            _mesa_swizzle_and_convert(dst + y * width * dst_size,
+                                      conv->dst_type, 4,
+                                      src + y * width * src_size,
+                                      conv->src_type, 4,
+                                      bgra, conv->normalized, width);
+         }
+      }
+      elapsed = time_seconds() - start;
+
+      /* Count both the bytes read and the bytes written */
+      bytes = (double) passes * width * height * (src_size + dst_size);
+      printf("%-24s %8.2f GB/s\n", conv->name, bytes / elapsed / 1e9);
+   }
+
+   delete [] src;
+   delete [] dst;
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name glthread_arrays.cpp
+ *
+ * Check the client-side vertex array tracking of glthread (main/marshal.c),
+ * which decides whether a draw may read client memory and so can't be
+ * queued.  The hooks are called directly, as the marshal functions do
+ * after queuing each call.
+ */
+
+#include <gtest/gtest.h>
+
+#include "main/marshal.h"
+
+extern "C" {
+#include "main/hash.h"
+}
+
+class GLThreadArraysTest : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   bool user_arrays()
+   {
+      return _mesa_glthread_has_user_arrays(&ctx);
+   }
+
+   bool user_elements()
+   {
+      return _mesa_glthread_has_user_elements(&ctx);
+   }
+
+   struct gl_context ctx;
+   struct glthread_state glthread;
+};
+
+void
+GLThreadArraysTest::SetUp()
+{
+   memset(&ctx, 0, sizeof(ctx));
+   memset(&glthread, 0, sizeof(glthread));
+
+   glthread.VAOs = _mesa_NewHashTable();
+   _mesa_glthread_init_vao(&glthread.DefaultVAO, 0);
+   glthread.CurrentVAO = &glthread.DefaultVAO;
+
+   ctx.API = API_OPENGL_COMPAT;
+   ctx.GLThread = &glthread;
+}
+
+static void
+free_vao(GLuint key, void *data, void *userData)
+{
+   free(data);
+}
+
+void
+GLThreadArraysTest::TearDown()
+{
+   _mesa_HashDeleteAll(glthread.VAOs, free_vao, NULL);
+   _mesa_DeleteHashTable(glthread.VAOs);
+}
+
+/* A client memory array only matters while it is enabled */
+TEST_F(GLThreadArraysTest, EnableAndDisable)
+{
+   _mesa_glthread_AttribPointer(&ctx, VERT_ATTRIB_POS);
+   EXPECT_FALSE(user_arrays());
+
+   _mesa_glthread_ClientState(&ctx, GL_VERTEX_ARRAY, true);
+   EXPECT_TRUE(user_arrays());
+
+   _mesa_glthread_ClientState(&ctx, GL_VERTEX_ARRAY, false);
+   EXPECT_FALSE(user_arrays());
+
+   /* glEnable takes the same enums */
+   _mesa_glthread_ClientState(&ctx, GL_VERTEX_ARRAY, true);
+   _mesa_glthread_ClientState(&ctx, GL_DEPTH_TEST, false);
+   EXPECT_TRUE(user_arrays());
+}
+
+/* Pointing an array at a buffer stops it reading client memory */
+TEST_F(GLThreadArraysTest, PointerToBuffer)
+{
+   _mesa_glthread_ClientState(&ctx, GL_VERTEX_ARRAY, true);
+   _mesa_glthread_ClientState(&ctx, GL_COLOR_ARRAY, true);
+   _mesa_glthread_AttribPointer(&ctx, VERT_ATTRIB_POS);
+   _mesa_glthread_AttribPointer(&ctx, VERT_ATTRIB_COLOR0);
+   EXPECT_TRUE(user_arrays());
+
+   _mesa_glthread_BindBuffer(&ctx, GL_ARRAY_BUFFER, 1);
+   _mesa_glthread_AttribPointer(&ctx, VERT_ATTRIB_POS);
+   EXPECT_TRUE(user_arrays());
+   _mesa_glthread_AttribPointer(&ctx, VERT_ATTRIB_COLOR0);
+   EXPECT_FALSE(user_arrays());
+
+   /* Unbinding the array buffer doesn't change the arrays */
+   _mesa_glthread_BindBuffer(&ctx, GL_ARRAY_BUFFER, 0);
+   EXPECT_FALSE(user_arrays());
+
+   /* Deleting the buffer does */
+   _mesa_glthread_BindBuffer(&ctx, GL_ARRAY_BUFFER, 1);
+   GLuint buffer = 1;
+   _mesa_glthread_DeleteBuffers(&ctx, 1, &buffer);
+   EXPECT_TRUE(user_arrays());
+}
+
+TEST_F(GLThreadArraysTest, Elements)
+{
+   _mesa_glthread_BindBuffer(&ctx, GL_ARRAY_BUFFER, 1);
+   _mesa_glthread_VertexAttribPointer(&ctx, 0);
+   _mesa_glthread_EnableAttribArray(&ctx, 0, 0, true);
+   EXPECT_FALSE(user_arrays());
+   EXPECT_TRUE(user_elements());
+
+   _mesa_glthread_BindBuffer(&ctx, GL_ELEMENT_ARRAY_BUFFER, 2);
+   EXPECT_FALSE(user_elements());
+}
+
+/* The texture coordinate array is picked by the client active texture */
+TEST_F(GLThreadArraysTest, TexCoords)
+{
+   _mesa_glthread_ClientActiveTexture(&ctx, GL_TEXTURE1);
+   _mesa_glthread_ClientState(&ctx, GL_TEXTURE_COORD_ARRAY, true);
+   _mesa_glthread_TexCoordPointer(&ctx);
+   EXPECT_TRUE(user_arrays());
+
+   _mesa_glthread_ClientActiveTexture(&ctx, GL_TEXTURE0);
+   _mesa_glthread_BindBuffer(&ctx, GL_ARRAY_BUFFER, 1);
+   _mesa_glthread_TexCoordPointer(&ctx);
+   EXPECT_TRUE(user_arrays());
+
+   _mesa_glthread_ClientActiveTexture(&ctx, GL_TEXTURE1);
+   _mesa_glthread_TexCoordPointer(&ctx);
+   EXPECT_FALSE(user_arrays());
+}
+
+TEST_F(GLThreadArraysTest, VertexBuffers)
+{
+   const GLuint buffers[2] = { 1, 0 };
+
+   _mesa_glthread_EnableAttribArray(&ctx, 0, 0, true);
+   _mesa_glthread_EnableAttribArray(&ctx, 0, 1, true);
+   _mesa_glthread_BindVertexBuffers(&ctx, 0, 0, 2, buffers);
+   EXPECT_TRUE(user_arrays());
+
+   /* Both arrays read binding 0 */
+   _mesa_glthread_VertexAttribBinding(&ctx, 0, 1, 0);
+   EXPECT_FALSE(user_arrays());
+
+   /* glVertexAttribPointer resets the binding */
+   _mesa_glthread_VertexAttribPointer(&ctx, 1);
+   EXPECT_TRUE(user_arrays());
+
+   /* An out of range call changes nothing */
+   _mesa_glthread_BindVertexBuffers(&ctx, 0, VERT_ATTRIB_GENERIC_MAX - 1, 2,
+                                    buffers);
+   EXPECT_TRUE(user_arrays());
+
+   _mesa_glthread_BindVertexBuffers(&ctx, 0, 1, 1, buffers);
+   EXPECT_FALSE(user_arrays());
+}
+
+/* Every vertex array object has its own arrays */
+TEST_F(GLThreadArraysTest, VertexArrayObjects)
+{
+   _mesa_glthread_AttribPointer(&ctx, VERT_ATTRIB_POS);
+   _mesa_glthread_ClientState(&ctx, GL_VERTEX_ARRAY, true);
+   EXPECT_TRUE(user_arrays());
+
+   _mesa_glthread_BindVertexArray(&ctx, 5);
+   EXPECT_FALSE(user_arrays());
+
+   /* DSA on another object doesn't touch the bound one */
+   _mesa_glthread_EnableAttribArray(&ctx, 6, 3, true);
+   EXPECT_FALSE(user_arrays());
+
+   _mesa_glthread_BindVertexArray(&ctx, 6);
+   EXPECT_TRUE(user_arrays());
+
+   GLuint array = 6;
+   _mesa_glthread_DeleteVertexArrays(&ctx, 1, &array);
+   EXPECT_EQ(&glthread.DefaultVAO, glthread.CurrentVAO);
+   EXPECT_TRUE(user_arrays());
+}
+
+/* What glPopClientAttrib restores is unknown, so assume the worst */
+TEST_F(GLThreadArraysTest, PopClientAttrib)
+{
+   _mesa_glthread_BindBuffer(&ctx, GL_ELEMENT_ARRAY_BUFFER, 1);
+   EXPECT_FALSE(user_arrays());
+   EXPECT_FALSE(user_elements());
+
+   _mesa_glthread_PopClientAttrib(&ctx);
+   EXPECT_TRUE(user_arrays());
+   EXPECT_TRUE(user_elements());
+}
+
+/* Core profiles have no client arrays */
+TEST_F(GLThreadArraysTest, CoreProfile)
+{
+   _mesa_glthread_EnableAttribArray(&ctx, 0, 0, true);
+   EXPECT_TRUE(user_arrays());
+
+   ctx.API = API_OPENGL_CORE;
+   EXPECT_FALSE(user_arrays());
+   EXPECT_FALSE(user_elements());
+}
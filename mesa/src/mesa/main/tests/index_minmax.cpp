@@ -0,0 +1,137 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name index_minmax.cpp
+ *
+ * Check the SSE4.1 index range scan against a plain loop, for every index
+ * size, with and without primitive restart, over all alignments and short
+ * lengths.
+ */
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+#include "main/cpuinfo.h"
+#include "main/sse_minmax.h"
+}
+
+#if defined(USE_SSE41)
+
+#define MAX_INDICES 96
+
+static void
+reference_min_max(const void *indices, unsigned index_size, unsigned count,
+                  bool restart, unsigned restart_index,
+                  unsigned *min_index, unsigned *max_index)
+{
+   unsigned i;
+
+   *min_index = ~0U;
+   *max_index = 0;
+
+   for (i = 0; i < count; i++) {
+      unsigned index;
+
+      switch (index_size) {
+      case 1:
+         index = ((const uint8_t *) indices)[i];
+         break;
+      case 2:
+         index = ((const uint16_t *) indices)[i];
+         break;
+      default:
+         index = ((const uint32_t *) indices)[i];
+         break;
+      }
+
+      if (restart && index == restart_index)
+         continue;
+      if (index < *min_index)
+         *min_index = index;
+      if (index > *max_index)
+         *max_index = index;
+   }
+}
+
+TEST(IndexMinMaxTest, MatchesScalar)
+{
+   static const unsigned sizes[] = { 1, 2, 4 };
+   uint32_t storage[MAX_INDICES + 4];
+   unsigned s, iter;
+
+   _mesa_get_cpu_features();
+   if (!cpu_has_sse4_1)
+      return;
+
+   srand(1);
+
+   for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+      const unsigned size = sizes[s];
+      const unsigned type_max = size == 4 ? ~0U : (1U << (size * 8)) - 1;
+
+      for (iter = 0; iter < 4000; iter++) {
+         const unsigned offset = (iter % 16) & ~(size - 1);
+         uint8_t *indices = (uint8_t *) storage + offset;
+         const unsigned count = rand() % MAX_INDICES;
+         /* restart with the fixed index, an ordinary value, and for the
+          * smaller types one which doesn't fit the index type
+          */
+         const unsigned restart_index =
+            iter % 3 == 0 ? type_max : iter % 3 == 1 ? 3 : type_max + 2;
+         const bool restart = iter & 4;
+         unsigned i, min_ref, max_ref, min_simd, max_simd;
+
+         for (i = 0; i < count; i++) {
+            unsigned index = rand();
+
+            /* half the runs use small values, so that restart indices and
+             * repeated extremes are common; all have the type's maximum
+             */
+            if (iter & 8)
+               index %= 8;
+            if (rand() % 4 == 0)
+               index = type_max;
+
+            memcpy(indices + i * size, &index, size);
+         }
+
+         reference_min_max(indices, size, count, restart, restart_index,
+                           &min_ref, &max_ref);
+         _mesa_index_array_min_max(indices, size, count, restart,
+                                   restart_index, &min_simd, &max_simd);
+
+         EXPECT_EQ(min_ref, min_simd)
+            << size << "-byte indices, " << count << " at offset " << offset
+            << ", restart " << restart << " index " << restart_index;
+         EXPECT_EQ(max_ref, max_simd)
+            << size << "-byte indices, " << count << " at offset " << offset
+            << ", restart " << restart << " index " << restart_index;
+      }
+   }
+}
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name name_hash.cpp
+ *
+ * Check the GL object name table, both for the small names which live in
+ * its dense array and for the sparse ones which live in the hash table,
+ * and lookups racing with inserts that grow the dense array.
+ */
+
+#include <gtest/gtest.h>
+
+#include "c11/threads.h"
+#include "util/u_atomic.h"
+
+extern "C" {
+#include "main/hash.h"
+}
+
+static void *
+data_for(GLuint key)
+{
+   return (void *) (uintptr_t) (key * 8);
+}
+
+static void
+count_entry(GLuint key, void *data, void *userData)
+{
+   EXPECT_EQ(data_for(key), data);
+   (*(unsigned *) userData)++;
+}
+
+TEST(NameHashTest, DenseAndSparse)
+{
+   struct _mesa_HashTable *table = _mesa_NewHashTable();
+   unsigned count = 0;
+   GLuint key;
+
+   ASSERT_TRUE(table != NULL);
+
+   /* Names out of the dense range, some of which it grows to cover later */
+   _mesa_HashInsert(table, 200, data_for(200));
+   _mesa_HashInsert(table, 100000, data_for(100000));
+
+   for (key = 1; key < 3000; key++)
+      _mesa_HashInsert(table, key, data_for(key));
+
+   EXPECT_EQ(3000u, _mesa_HashNumEntries(table));
+
+   for (key = 1; key < 3000; key++)
+      EXPECT_EQ(data_for(key), _mesa_HashLookup(table, key));
+   EXPECT_EQ(data_for(100000), _mesa_HashLookup(table, 100000));
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, 3000));
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, 100001));
+
+   _mesa_HashRemove(table, 1);
+   _mesa_HashRemove(table, 100000);
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, 1));
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, 100000));
+   EXPECT_EQ(2998u, _mesa_HashNumEntries(table));
+
+   _mesa_HashWalk(table, count_entry, &count);
+   EXPECT_EQ(2998u, count);
+
+   count = 0;
+   _mesa_HashDeleteAll(table, count_entry, &count);
+   EXPECT_EQ(2998u, count);
+   EXPECT_EQ(0u, _mesa_HashNumEntries(table));
+
+   _mesa_DeleteHashTable(table);
+}
+
+TEST(NameHashTest, FindFreeKeyBlock)
+{
+   struct _mesa_HashTable *table = _mesa_NewHashTable();
+   GLuint first;
+
+   ASSERT_TRUE(table != NULL);
+
+   first = _mesa_HashFindFreeKeyBlock(table, 10);
+   EXPECT_EQ(1u, first);
+
+   _mesa_HashInsert(table, first, data_for(first));
+   _mesa_HashInsert(table, 70, data_for(70));
+   EXPECT_EQ(71u, _mesa_HashFindFreeKeyBlock(table, 10));
+
+   _mesa_HashRemove(table, first);
+   _mesa_HashRemove(table, 70);
+   _mesa_DeleteHashTable(table);
+}
+
+#define CONCURRENT_READERS 4
+#define CONCURRENT_KEYS 20000
+#define CONCURRENT_SPARSE_KEY 2000000
+
+struct concurrent_state {
+   struct _mesa_HashTable *table;
+   GLuint inserted;            /**< keys up to this one are in the table */
+   unsigned running;           /**< readers which have started */
+   unsigned errors;
+};
+
+static int
+concurrent_reader(void *arg)
+{
+   struct concurrent_state *state = (struct concurrent_state *) arg;
+   unsigned errors = 0;
+   GLuint last, key, i;
+
+   p_atomic_inc(&state->running);
+
+   do {
+      last = p_atomic_read(&state->inserted);
+
+      /* Names there before the writer started, among them sparse ones the
+       * writer moves into the dense array as it grows it.
+       */
+      for (key = 1; key <= 32; key++)
+         errors += _mesa_HashLookup(state->table, key) != data_for(key);
+      for (key = 5000; key <= 5003; key++)
+         errors += _mesa_HashLookup(state->table, key) != data_for(key);
+      errors += _mesa_HashLookup(state->table, CONCURRENT_SPARSE_KEY) !=
+                data_for(CONCURRENT_SPARSE_KEY);
+
+      /* Names inserted by the writer so far, and the ones it's about to
+       * insert, which may or may not be there yet.
+       */
+      for (i = 0; i < 64; i++) {
+         void *data;
+
+         key = last > i ? last - i : 1;
+         errors += _mesa_HashLookup(state->table, key) != data_for(key);
+
+         key = last + 1 + i;
+         data = _mesa_HashLookup(state->table, key);
+         errors += data != NULL && data != data_for(key);
+      }
+   } while (last < CONCURRENT_KEYS);
+
+   p_atomic_add(&state->errors, errors);
+   return 0;
+}
+
+/* Lookups of a table another thread is inserting into see each name either
+ * not at all or with its data, and never lose a name while the dense array
+ * is replaced by a larger one.
+ */
+TEST(NameHashTest, ConcurrentLookupInsert)
+{
+   struct concurrent_state state;
+   thrd_t readers[CONCURRENT_READERS];
+   unsigned count = 0;
+   GLuint key;
+   int i;
+
+   state.table = _mesa_NewHashTable();
+   state.inserted = 32;
+   state.running = 0;
+   state.errors = 0;
+   ASSERT_TRUE(state.table != NULL);
+
+   for (key = 1; key <= 32; key++)
+      _mesa_HashInsert(state.table, key, data_for(key));
+   for (key = 5000; key <= 5003; key++)
+      _mesa_HashInsert(state.table, key, data_for(key));
+   _mesa_HashInsert(state.table, CONCURRENT_SPARSE_KEY,
+                    data_for(CONCURRENT_SPARSE_KEY));
+
+   for (i = 0; i < CONCURRENT_READERS; i++)
+      ASSERT_EQ(thrd_success,
+                thrd_create(&readers[i], concurrent_reader, &state));
+
+   /* Don't let the writer be done before the readers have started */
+   while (p_atomic_read(&state.running) < CONCURRENT_READERS)
+      thrd_yield();
+
+   for (key = 33; key <= CONCURRENT_KEYS; key++) {
+      if (key < 5000 || key > 5003)
+         _mesa_HashInsert(state.table, key, data_for(key));
+      p_atomic_inc(&state.inserted);
+   }
+
+   for (i = 0; i < CONCURRENT_READERS; i++)
+      thrd_join(readers[i], NULL);
+
+   EXPECT_EQ(0u, state.errors);
+   EXPECT_EQ(CONCURRENT_KEYS + 1u, _mesa_HashNumEntries(state.table));
+
+   _mesa_HashDeleteAll(state.table, count_entry, &count);
+   EXPECT_EQ(CONCURRENT_KEYS + 1u, count);
+   _mesa_DeleteHashTable(state.table);
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name texstore_bands.cpp
+ *
+ * Check how _mesa_texstore() splits an image into bands of rows for the
+ * worker pool: the bands must cover every row once, and the unpacking of
+ * each band must read the same source rows as the whole image would.
+ */
+
+#include <gtest/gtest.h>
+
+#include "main/glheader.h"
+#include "main/macros.h"
+#include "main/mtypes.h"
+
+extern "C" {
+#include "main/image.h"
+#include "main/texstore.h"
+}
+
+static const GLint heights[] = { 1, 15, 16, 31, 32, 33, 100, 257, 1000, 4096 };
+
+/* The bands follow each other without gaps and end at the last row */
+TEST(TexstoreBandsTest, CoverAllRows)
+{
+   struct gl_pixelstore_attrib packing, band;
+   unsigned i, threads, index;
+
+   memset(&packing, 0, sizeof(packing));
+   packing.Alignment = 4;
+
+   for (i = 0; i < ARRAY_SIZE(heights); i++) {
+      for (threads = 1; threads <= 17; threads++) {
+         const GLint height = heights[i];
+         const unsigned bands = _mesa_texstore_num_bands(height, threads);
+         GLint next = 0, y, rows;
+
+         ASSERT_GE(bands, 1u);
+         EXPECT_LE(bands, threads);
+
+         for (index = 0; index < bands; index++) {
+            _mesa_texstore_band(height, bands, index, &packing,
+                                &y, &rows, &band);
+            EXPECT_EQ(next, y);
+            if (bands > 1)
+               EXPECT_GE(rows, TEXSTORE_MIN_BAND_ROWS);
+            else
+               EXPECT_EQ(height, rows);
+            next = y + rows;
+         }
+
+         EXPECT_EQ(height, next)
+            << height << " rows in " << bands << " bands";
+      }
+   }
+}
+
+/* Each band starts as many rows further into the source as its first row */
+TEST(TexstoreBandsTest, SkipRows)
+{
+   struct gl_pixelstore_attrib packing, band;
+   const unsigned bands = _mesa_texstore_num_bands(100, 4);
+   unsigned index;
+   GLint y, rows;
+
+   memset(&packing, 0, sizeof(packing));
+   packing.Alignment = 1;
+   packing.SkipRows = 3;
+   packing.SkipPixels = 5;
+   packing.RowLength = 64;
+
+   ASSERT_EQ(4u, bands);
+
+   for (index = 0; index < bands; index++) {
+      _mesa_texstore_band(100, bands, index, &packing, &y, &rows, &band);
+      EXPECT_EQ(3 + y, band.SkipRows);
+      EXPECT_EQ(5, band.SkipPixels);
+      EXPECT_EQ(64, band.RowLength);
+   }
+}
+
+/* Without an explicit image height, the image height of a band is that of
+ * the whole image rather than its own number of rows.
+ */
+TEST(TexstoreBandsTest, ImageHeight)
+{
+   struct gl_pixelstore_attrib packing, band;
+   GLint y, rows;
+
+   memset(&packing, 0, sizeof(packing));
+   packing.Alignment = 4;
+
+   _mesa_texstore_band(100, 4, 1, &packing, &y, &rows, &band);
+   EXPECT_EQ(100, band.ImageHeight);
+
+   packing.ImageHeight = 120;
+   _mesa_texstore_band(100, 4, 1, &packing, &y, &rows, &band);
+   EXPECT_EQ(120, band.ImageHeight);
+
+   /* The caller's packing is left alone */
+   EXPECT_EQ(0, packing.SkipRows);
+}
+
+/* The first pixel of each band is where the whole image has its row */
+TEST(TexstoreBandsTest, SourceAddress)
+{
+   static GLubyte image[1];
+   struct gl_pixelstore_attrib packing, band;
+   const GLint width = 37, height = 100;
+   const unsigned bands = _mesa_texstore_num_bands(height, 3);
+   unsigned index, imageHeight;
+   GLint y, rows;
+
+   memset(&packing, 0, sizeof(packing));
+   packing.Alignment = 8;
+   packing.SkipPixels = 2;
+   packing.SkipRows = 1;
+   packing.SkipImages = 2;
+
+   ASSERT_EQ(3u, bands);
+
+   for (imageHeight = 0; imageHeight <= 128; imageHeight += 128) {
+      packing.ImageHeight = imageHeight;
+
+      for (index = 0; index < bands; index++) {
+         _mesa_texstore_band(height, bands, index, &packing,
+                             &y, &rows, &band);
+
+         EXPECT_EQ(_mesa_image_address(3, &packing, image, width, height,
+                                       GL_RGB, GL_UNSIGNED_BYTE, 0, y, 0),
+                   _mesa_image_address(3, &band, image, width, rows,
+                                       GL_RGB, GL_UNSIGNED_BYTE, 0, 0, 0))
+            << "band " << index << ", image height " << imageHeight;
+      }
+   }
+}
@@ -0,0 +1,243 @@
+/*
+ * Copyright © 2016 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name vbo_save_optimize.cpp
+ *
+ * Check the primitives vbo_save_pack_run() builds for runs of display list
+ * vertex lists, with line loops and strips continued across vertex lists.
+ */
+
+#include <gtest/gtest.h>
+
+#include "main/glheader.h"
+#include "main/imports.h"
+#include "main/mtypes.h"
+
+extern "C" {
+#include "vbo/vbo_save.h"
+}
+
+#define VERTEX_SIZE 2
+
+/**
+ * A vertex list as compiled by vbo_save_api.c, with vertex i at (id, 0)
+ * for the i-th entry of ids.
+ */
+struct test_list {
+   struct vbo_save_vertex_list node;
+   struct _mesa_prim prim[4];
+   fi_type vertices[16 * VERTEX_SIZE];
+
+   test_list(const unsigned *ids, unsigned count, unsigned wrap_count)
+   {
+      unsigned i;
+
+      memset(&node, 0, sizeof(node));
+      memset(prim, 0, sizeof(prim));
+
+      for (i = 0; i < count; i++) {
+         vertices[i * VERTEX_SIZE + 0].f = (float) ids[i];
+         vertices[i * VERTEX_SIZE + 1].f = 0.0f;
+      }
+
+      node.enabled = BITFIELD64_BIT(VBO_ATTRIB_POS);
+      node.attrsz[VBO_ATTRIB_POS] = VERTEX_SIZE;
+      node.attrtype[VBO_ATTRIB_POS] = GL_FLOAT;
+      node.vertex_size = VERTEX_SIZE;
+      node.count = count;
+      node.wrap_count = wrap_count;
+      node.prim = prim;
+   }
+
+   void add_prim(GLenum mode, unsigned start, unsigned count,
+                 bool begin, bool end)
+   {
+      struct _mesa_prim *p = &prim[node.prim_count++];
+
+      p->mode = mode;
+      p->start = start;
+      p->count = count;
+      p->begin = begin;
+      p->end = end;
+      p->num_instances = 1;
+   }
+};
+
+/**
+ * The ids of the vertices prim draws from the packed run.
+ */
+static std::vector<unsigned>
+prim_ids(const struct vbo_save_packed_run *run,
+         const struct _mesa_prim *prim)
+{
+   std::vector<unsigned> ids;
+   unsigned i;
+
+   for (i = 0; i < prim->count; i++) {
+      const unsigned index = run->indices[prim->start + i];
+
+      EXPECT_LT(index, run->nr_vertices);
+      ids.push_back((unsigned) run->vertices[index * VERTEX_SIZE].f);
+   }
+
+   return ids;
+}
+
+/**
+ * Set up a run of all the lists, each one adjacent to the previous one.
+ */
+static void
+make_run(struct vbo_save_packed_run *run,
+         struct vbo_save_pending_list *pending,
+         struct test_list **lists, unsigned nr_lists)
+{
+   unsigned i;
+
+   memset(run, 0, sizeof(*run));
+
+   for (i = 0; i < nr_lists; i++) {
+      pending[i].node = &lists[i]->node;
+      pending[i].vertices = lists[i]->vertices;
+      pending[i].adjacent = i > 0;
+   }
+
+   run->lists = pending;
+   run->nr_lists = nr_lists;
+}
+
+static std::vector<unsigned>
+ids(std::initializer_list<unsigned> list)
+{
+   return std::vector<unsigned>(list);
+}
+
+/* A complete line loop which isn't the last primitive of its vertex list
+ * is still a GL_LINE_LOOP, and has to be closed by the repacking.
+ */
+TEST(VboSaveOptimizeTest, LineLoopInTheMiddle)
+{
+   static const unsigned vertices[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+   test_list list(vertices, 8, 0);
+   test_list *lists[] = { &list };
+   struct vbo_save_pending_list pending[1];
+   struct vbo_save_packed_run run;
+
+   list.add_prim(GL_LINES, 0, 2, true, true);
+   list.add_prim(GL_LINE_LOOP, 2, 3, true, true);
+   list.add_prim(GL_LINES, 5, 2, true, true);
+   list.add_prim(GL_POINTS, 7, 1, true, true);
+
+   make_run(&run, pending, lists, 1);
+   ASSERT_TRUE(vbo_save_pack_run(&run));
+
+   ASSERT_EQ(4u, run.prim_count);
+   EXPECT_EQ((unsigned) GL_LINE_STRIP, run.prim[1].mode);
+   EXPECT_EQ(ids({ 2, 3, 4, 2 }), prim_ids(&run, &run.prim[1]));
+   EXPECT_EQ(ids({ 5, 6 }), prim_ids(&run, &run.prim[2]));
+
+   /* The loop folds into one GL_LINES draw with its neighbours */
+   const struct _mesa_prim *merged = run.prim + run.prim_count;
+   ASSERT_EQ(2u, run.merged_prim_count);
+   EXPECT_EQ((unsigned) GL_LINES, merged[0].mode);
+   EXPECT_EQ(ids({ 0, 1, 2, 3, 3, 4, 4, 2, 5, 6 }),
+             prim_ids(&run, &merged[0]));
+   EXPECT_EQ((unsigned) GL_POINTS, merged[1].mode);
+   EXPECT_EQ(ids({ 7 }), prim_ids(&run, &merged[1]));
+   EXPECT_TRUE(merged[0].begin && merged[0].end);
+   EXPECT_TRUE(run.merged_flags & VBO_SAVE_MERGED_NO_STIPPLE);
+
+   vbo_save_free_packed_run(&run);
+}
+
+/* A line loop continued across vertex lists: the first piece was turned
+ * into a strip when its list was compiled, the second starts with copies
+ * of the first and last vertex of the first piece.
+ */
+TEST(VboSaveOptimizeTest, ContinuedLineLoop)
+{
+   static const unsigned first[] = { 0, 1, 2 };
+   static const unsigned second[] = { 0, 2, 3, 4, 9 };
+   test_list a(first, 3, 0), b(second, 5, 2);
+   test_list *lists[] = { &a, &b };
+   struct vbo_save_pending_list pending[2];
+   struct vbo_save_packed_run run;
+
+   a.add_prim(GL_LINE_STRIP, 0, 3, true, false);
+   b.add_prim(GL_LINE_LOOP, 0, 4, false, true);
+   b.add_prim(GL_POINTS, 4, 1, true, true);
+
+   make_run(&run, pending, lists, 2);
+   ASSERT_TRUE(vbo_save_pack_run(&run));
+
+   ASSERT_EQ(3u, run.prim_count);
+   EXPECT_EQ(6u, run.nr_vertices);
+   EXPECT_EQ(ids({ 0, 1, 2 }), prim_ids(&run, &run.prim[0]));
+   EXPECT_EQ((unsigned) GL_LINE_STRIP, run.prim[1].mode);
+   EXPECT_EQ(ids({ 2, 3, 4, 0 }), prim_ids(&run, &run.prim[1]));
+
+   /* The pieces keep their flags, so stipple carries on between them */
+   EXPECT_TRUE(run.prim[0].begin);
+   EXPECT_FALSE(run.prim[0].end);
+   EXPECT_FALSE(run.prim[1].begin);
+   EXPECT_TRUE(run.prim[1].end);
+
+   const struct _mesa_prim *merged = run.prim + run.prim_count;
+   ASSERT_EQ(2u, run.merged_prim_count);
+   EXPECT_EQ(ids({ 0, 1, 1, 2, 2, 3, 3, 4, 4, 0 }),
+             prim_ids(&run, &merged[0]));
+   EXPECT_TRUE(merged[0].begin && merged[0].end);
+
+   vbo_save_free_packed_run(&run);
+}
+
+/* A line strip continued across vertex lists repeats its last vertex */
+TEST(VboSaveOptimizeTest, ContinuedLineStrip)
+{
+   static const unsigned first[] = { 0, 1, 2 };
+   static const unsigned second[] = { 2, 3, 4 };
+   test_list a(first, 3, 0), b(second, 3, 1);
+   test_list *lists[] = { &a, &b };
+   struct vbo_save_pending_list pending[2];
+   struct vbo_save_packed_run run;
+
+   a.add_prim(GL_LINE_STRIP, 0, 3, true, false);
+   b.add_prim(GL_LINE_STRIP, 0, 3, false, true);
+
+   make_run(&run, pending, lists, 2);
+   ASSERT_TRUE(vbo_save_pack_run(&run));
+
+   ASSERT_EQ(2u, run.prim_count);
+   EXPECT_EQ(5u, run.nr_vertices);
+   EXPECT_TRUE(run.prim[0].begin);
+   EXPECT_FALSE(run.prim[0].end);
+   EXPECT_FALSE(run.prim[1].begin);
+   EXPECT_TRUE(run.prim[1].end);
+   EXPECT_EQ(ids({ 2, 3, 4 }), prim_ids(&run, &run.prim[1]));
+
+   const struct _mesa_prim *merged = run.prim + run.prim_count;
+   ASSERT_EQ(1u, run.merged_prim_count);
+   EXPECT_EQ(ids({ 0, 1, 1, 2, 2, 3, 3, 4 }), prim_ids(&run, &merged[0]));
+
+   vbo_save_free_packed_run(&run);
+}
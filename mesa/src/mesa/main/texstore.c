@@ -73,6 +73,7 @@
 #include "enums.h"
 #include "glformats.h"
 #include "pixeltransfer.h"
+#include "worker_pool.h"
 #include "util/format_rgb9e5.h"
 #include "util/format_r11g11b10f.h"
 
@@ -905,13 +906,8 @@ _mesa_texstore_memcpy(TEXSTORE_PARAMS)
 }
 
 
-/**
- * Store user data into texture memory.
- * Called via glTex[Sub]Image1/2/3D()
- * \return GL_TRUE for success, GL_FALSE for failure (out of memory).
- */
-GLboolean
-_mesa_texstore(TEXSTORE_PARAMS)
+static GLboolean
+texstore_image(TEXSTORE_PARAMS)
 {
    if (_mesa_texstore_memcpy(ctx, dims, baseInternalFormat,
                              dstFormat,
@@ -940,6 +936,137 @@ _mesa_texstore(TEXSTORE_PARAMS)
 }
 
 
+/** A 2D image being stored in bands of rows, see texstore_band() */
+struct texstore_band_job
+{
+   struct gl_context *ctx;
+   GLuint dims;
+   GLenum baseInternalFormat;
+   mesa_format dstFormat;
+   GLint dstRowStride;
+   GLubyte *dst;
+   GLint srcWidth, srcHeight;
+   GLenum srcFormat, srcType;
+   const GLvoid *srcAddr;
+   const struct gl_pixelstore_attrib *packing;
+   unsigned bands;
+   GLboolean failed;
+};
+
+
+/**
+ * How many bands of rows to store an image of \p srcHeight rows in, with
+ * \p threads threads.  Every band has at least TEXSTORE_MIN_BAND_ROWS rows,
+ * unless there is just one.
+ */
+unsigned
+_mesa_texstore_num_bands(GLint srcHeight, unsigned threads)
+{
+   return MAX2(MIN2(threads, srcHeight / TEXSTORE_MIN_BAND_ROWS), 1);
+}
+
+
+/**
+ * Find the rows of band \p index of \p bands, and the unpacking which reads
+ * them as an image of their own.
+ *
+ * \param y  returns the first row of the band
+ * \param rows  returns the number of rows in the band
+ * \param bandPacking  returns \p packing, starting at row \p y
+ */
+void
+_mesa_texstore_band(GLint srcHeight, unsigned bands, unsigned index,
+                    const struct gl_pixelstore_attrib *packing,
+                    GLint *y, GLint *rows,
+                    struct gl_pixelstore_attrib *bandPacking)
+{
+   /* Sizes differ by at most one row */
+   *y = (GLint64) srcHeight * index / bands;
+   *rows = (GLint64) srcHeight * (index + 1) / bands - *y;
+
+   /* Start the source rows further down, as if by GL_UNPACK_SKIP_ROWS */
+   *bandPacking = *packing;
+   bandPacking->SkipRows += *y;
+
+   /* The image stride would otherwise shrink to the band height, moving
+    * the start of the image selected by GL_UNPACK_SKIP_IMAGES.
+    */
+   if (bandPacking->ImageHeight == 0)
+      bandPacking->ImageHeight = srcHeight;
+}
+
+
+static void
+texstore_band(void *data, unsigned index)
+{
+   struct texstore_band_job *job = data;
+   struct gl_pixelstore_attrib packing;
+   GLint y, rows;
+   GLubyte *dst;
+
+   _mesa_texstore_band(job->srcHeight, job->bands, index, job->packing,
+                       &y, &rows, &packing);
+   dst = job->dst + y * job->dstRowStride;
+
+   if (!texstore_image(job->ctx, job->dims, job->baseInternalFormat,
+                       job->dstFormat, job->dstRowStride, &dst,
+                       job->srcWidth, rows, 1,
+                       job->srcFormat, job->srcType, job->srcAddr, &packing))
+      job->failed = GL_TRUE;
+}
+
+
+/**
+ * Store user data into texture memory.
+ * Called via glTex[Sub]Image1/2/3D()
+ *
+ * Large single images are split into bands of rows which are converted
+ * in parallel on the worker pool.  Each band is stored as a separate
+ * image, so every path below texstore_image() works on bands unchanged,
+ * except that compressed formats need whole blocks and are left alone.
+ *
+ * \return GL_TRUE for success, GL_FALSE for failure (out of memory).
+ */
+GLboolean
+_mesa_texstore(TEXSTORE_PARAMS)
+{
+   struct texstore_band_job job;
+   unsigned threads, bands;
+
+   if (srcDepth != 1 ||
+       srcHeight < 2 * TEXSTORE_MIN_BAND_ROWS ||
+       _mesa_is_format_compressed(dstFormat) ||
+       (GLint64) srcHeight * abs(dstRowStride) < TEXSTORE_THREAD_MIN_BYTES ||
+       (threads = _mesa_worker_pool_size()) < 2) {
+      return texstore_image(ctx, dims, baseInternalFormat,
+                            dstFormat, dstRowStride, dstSlices,
+                            srcWidth, srcHeight, srcDepth,
+                            srcFormat, srcType, srcAddr, srcPacking);
+   }
+
+   bands = _mesa_texstore_num_bands(srcHeight, threads);
+
+   job.ctx = ctx;
+   job.dims = dims;
+   job.baseInternalFormat = baseInternalFormat;
+   job.dstFormat = dstFormat;
+   job.dstRowStride = dstRowStride;
+   job.dst = dstSlices[0];
+   job.srcWidth = srcWidth;
+   job.srcHeight = srcHeight;
+   job.srcFormat = srcFormat;
+   job.srcType = srcType;
+   job.srcAddr = srcAddr;
+   job.packing = srcPacking;
+   job.bands = bands;
+   job.failed = GL_FALSE;
+
+   _mesa_worker_pool_run(texstore_band, &job, bands);
+
+   return !job.failed;
+}
+
+
 /**
  * Normally, we'll only _write_ texel data to a texture when we map it.
  * But if the user is providing depth or stencil values and the texture
@@ -54,6 +54,16 @@
  * \param srcAddr  source image address
  * \param srcPacking  source image packing parameters
  */
+/**
+ * Images at least this big (in destination bytes) are stored in bands of
+ * rows on the worker pool; smaller ones aren't worth the hand-off.
+ */
+#define TEXSTORE_THREAD_MIN_BYTES (1 << 20)
+
+/** Smallest band of rows handed to a worker */
+#define TEXSTORE_MIN_BAND_ROWS 16
+
+
 #define TEXSTORE_PARAMS \
 	struct gl_context *ctx, GLuint dims, \
 	GLenum baseInternalFormat, \
@@ -69,6 +79,15 @@
 extern GLboolean
 _mesa_texstore(TEXSTORE_PARAMS);
 
+extern unsigned
+_mesa_texstore_num_bands(GLint srcHeight, unsigned threads);
+
+extern void
+_mesa_texstore_band(GLint srcHeight, unsigned bands, unsigned index,
+                    const struct gl_pixelstore_attrib *packing,
+                    GLint *y, GLint *rows,
+                    struct gl_pixelstore_attrib *bandPacking);
+
 extern GLboolean
 _mesa_texstore_needs_transfer_ops(struct gl_context *ctx,
                                   GLenum baseInternalFormat,
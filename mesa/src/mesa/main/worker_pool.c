@@ -0,0 +1,219 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2016  The Mesa Authors   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file worker_pool.c
+ * Process-wide worker threads.
+ *
+ * Every context holds a reference on the pool.  The threads are started
+ * the first time a job is run and are joined when the last context goes
+ * away, so that no thread is left running code of an unloaded driver.
+ *
+ * The threads serve one util_queue.  A job is split into \c count pieces;
+ * the submitting thread queues a helper for each pool thread it can use,
+ * and the helpers and the submitter then take pieces in turn until all are
+ * done.  Jobs of several contexts may be in flight at once.
+ */
+
+#include <stdlib.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "c11/threads.h"
+#include "main/worker_pool.h"
+#include "main/imports.h"
+#include "main/macros.h"
+#include "util/u_atomic.h"
+#include "util/u_queue.h"
+
+
+#define MAX_WORKER_THREADS 16
+
+
+/** A job being run by _mesa_worker_pool_run() */
+struct worker_job
+{
+   mesa_worker_func func;
+   void *data;
+   unsigned count;
+   /** Number of pieces taken so far, see run_pieces() */
+   int next;
+};
+
+
+/** Protects everything below */
+static mtx_t PoolLock = _MTX_INITIALIZER_NP;
+static unsigned PoolRefCount;
+static bool PoolStarted;
+static struct util_queue PoolQueue;
+
+
+/**
+ * Number of pool threads: MESA_WORKER_THREADS if set, otherwise one less
+ * than the number of CPUs, since the submitting thread works too.
+ */
+static unsigned
+default_num_threads(void)
+{
+   const char *env = getenv("MESA_WORKER_THREADS");
+   long n = 0;
+
+   if (env) {
+      n = strtol(env, NULL, 10);
+   } else {
+#if defined(_SC_NPROCESSORS_ONLN)
+      n = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+#endif
+   }
+
+   return CLAMP(n, 0, MAX_WORKER_THREADS);
+}
+
+
+/**
+ * Take pieces of the job until there are none left.
+ */
+static void
+run_pieces(struct worker_job *job)
+{
+   unsigned index;
+
+   while ((index = p_atomic_inc_return(&job->next) - 1) < job->count)
+      job->func(job->data, index);
+}
+
+
+static void
+worker_execute(void *data, int thread_index)
+{
+   run_pieces(data);
+}
+
+
+/**
+ * Start the threads if they aren't running yet, and return how many there
+ * are.  The caller must hold a reference on the pool.
+ */
+static unsigned
+pool_threads(void)
+{
+   unsigned num_threads = 0;
+
+   mtx_lock(&PoolLock);
+   assert(PoolRefCount > 0);
+   if (!PoolStarted) {
+      num_threads = default_num_threads();
+
+      /* room for a helper of each thread from a few jobs at once */
+      if (num_threads)
+         util_queue_init(&PoolQueue, "mesa_worker", 4 * num_threads,
+                         num_threads);
+      PoolStarted = true;
+   }
+   num_threads = util_queue_is_initialized(&PoolQueue) ?
+                 PoolQueue.num_threads : 0;
+   mtx_unlock(&PoolLock);
+
+   return num_threads;
+}
+
+
+/**
+ * Called for each new context.
+ */
+void
+_mesa_reference_worker_pool(void)
+{
+   mtx_lock(&PoolLock);
+   PoolRefCount++;
+   mtx_unlock(&PoolLock);
+}
+
+
+/**
+ * Called when a context is destroyed.  The last one stops the threads.
+ */
+void
+_mesa_unreference_worker_pool(void)
+{
+   mtx_lock(&PoolLock);
+   assert(PoolRefCount > 0);
+   if (--PoolRefCount == 0 && PoolStarted) {
+      if (util_queue_is_initialized(&PoolQueue))
+         util_queue_destroy(&PoolQueue);
+      memset(&PoolQueue, 0, sizeof(PoolQueue));
+      PoolStarted = false;
+   }
+   mtx_unlock(&PoolLock);
+}
+
+
+/**
+ * How many threads a job may run on at once, counting the caller.  Used
+ * to decide how finely to split a job; the pool threads are started here
+ * if they aren't running yet.
+ */
+unsigned
+_mesa_worker_pool_size(void)
+{
+   return 1 + pool_threads();
+}
+
+
+/**
+ * Run func(data, 0) ... func(data, count - 1), spread over the pool, and
+ * return once all have finished.  The calling thread must hold a context,
+ * and so a reference on the pool.
+ */
+void
+_mesa_worker_pool_run(mesa_worker_func func, void *data, unsigned count)
+{
+   struct util_queue_fence fences[MAX_WORKER_THREADS];
+   struct worker_job job;
+   unsigned helpers = 0, i;
+
+   job.func = func;
+   job.data = data;
+   job.count = count;
+   job.next = 0;
+
+   if (count > 1)
+      helpers = MIN2(count - 1, pool_threads());
+
+   for (i = 0; i < helpers; i++) {
+      util_queue_fence_init(&fences[i]);
+      util_queue_add_job(&PoolQueue, &job, &fences[i], worker_execute, NULL);
+   }
+
+   run_pieces(&job);
+
+   /* A helper which only starts now finds nothing left to do, but the job
+    * lives on this stack, so it still has to be waited for.
+    */
+   for (i = 0; i < helpers; i++) {
+      util_queue_job_wait(&fences[i]);
+      util_queue_fence_destroy(&fences[i]);
+   }
+}
@@ -45,6 +45,7 @@
 #include "main/teximage.h"
 #include "main/texobj.h"
 #include "main/texstore.h"
+#include "main/worker_pool.h"
 
 #include "state_tracker/st_debug.h"
 #include "state_tracker/st_context.h"
@@ -1333,6 +1334,47 @@ try_pbo_upload(struct gl_context *ctx, GLuint dims,
    return success;
 }
 
+/**
+ * Copying user pixels into a staging texture, split into bands of rows
+ * which are copied in parallel; see st_copy_rows().
+ */
+struct st_copy_rows_job
+{
+   GLuint dims;
+   const struct gl_pixelstore_attrib *unpack;
+   const void *pixels;
+   GLint width, height;
+   GLenum format, type;
+   ubyte *map;
+   unsigned stride, layer_stride;
+   unsigned bytes_per_row;
+   /** All rows of all slices */
+   unsigned num_rows;
+   unsigned band_rows;
+};
+
+
+static void
+st_copy_rows(void *data, unsigned index)
+{
+   const struct st_copy_rows_job *job = data;
+   const unsigned end = MIN2((index + 1) * job->band_rows, job->num_rows);
+   unsigned i;
+
+   for (i = index * job->band_rows; i < end; i++) {
+      const unsigned slice = i / job->height;
+      const unsigned row = i % job->height;
+      const void *src = _mesa_image_address(job->dims, job->unpack,
+                                            job->pixels, job->width,
+                                            job->height, job->format,
+                                            job->type, slice, row, 0);
+
+      memcpy(job->map + slice * job->layer_stride + row * job->stride,
+             src, job->bytes_per_row);
+   }
+}
+
+
 static void
 st_TexSubImage(struct gl_context *ctx, GLuint dims,
                struct gl_texture_image *texImage,
@@ -1535,10 +1577,10 @@ st_TexSubImage(struct gl_context *ctx, GLuint dims,
    /* Upload pixels (just memcpy). */
    {
       const uint bytesPerRow = width * util_format_get_blocksize(src_format);
-      GLuint row, slice;
+      GLuint slice;
 
-      for (slice = 0; slice < (unsigned) depth; slice++) {
-         if (gl_target == GL_TEXTURE_1D_ARRAY) {
+      if (gl_target == GL_TEXTURE_1D_ARRAY) {
+         for (slice = 0; slice < (unsigned) depth; slice++) {
             /* 1D array textures.
              * We need to convert gallium coords to GL coords.
              */
@@ -1546,19 +1588,36 @@ st_TexSubImage(struct gl_context *ctx, GLuint dims,
                                                 width, depth, format,
                                                 type, slice, 0);
             memcpy(map, src, bytesPerRow);
+            map += transfer->layer_stride;
          }
-         else {
-            ubyte *slice_map = map;
-
-            for (row = 0; row < (unsigned) height; row++) {
-               void *src = _mesa_image_address(dims, unpack, pixels,
-                                                 width, height, format,
-                                                 type, slice, row, 0);
-               memcpy(slice_map, src, bytesPerRow);
-               slice_map += transfer->stride;
-            }
+      }
+      else {
+         struct st_copy_rows_job job;
+         unsigned bands = 1;
+
+         job.dims = dims;
+         job.unpack = unpack;
+         job.pixels = pixels;
+         job.width = width;
+         job.height = height;
+         job.format = format;
+         job.type = type;
+         job.map = map;
+         job.stride = transfer->stride;
+         job.layer_stride = transfer->layer_stride;
+         job.bytes_per_row = bytesPerRow;
+         job.num_rows = height * depth;
+
+         if (job.num_rows >= 2 * TEXSTORE_MIN_BAND_ROWS &&
+             (uint64_t) job.num_rows * bytesPerRow >=
+             TEXSTORE_THREAD_MIN_BYTES) {
+            bands = MIN2(_mesa_worker_pool_size(),
+                         job.num_rows / TEXSTORE_MIN_BAND_ROWS);
          }
-         map += transfer->layer_stride;
+
+         job.band_rows = DIV_ROUND_UP(job.num_rows, bands);
+         _mesa_worker_pool_run(st_copy_rows, &job,
+                               DIV_ROUND_UP(job.num_rows, job.band_rows));
       }
    }
 
@@ -29,6 +29,7 @@
 #include "main/mtypes.h"
 #include "main/api_arrayelt.h"
 #include "main/bufferobj.h"
+#include "main/errors.h"
 #include "math/m_eval.h"
 #include "vbo.h"
 #include "vbo_context.h"
@@ -245,6 +246,19 @@ void _vbo_DestroyContext( struct gl_context *ctx )
    if (vbo) {
       GLuint i;
 
+      if ((MESA_VERBOSE & VERBOSE_DRAW) &&
+          (vbo->minmax_stats.cache_hits + vbo->minmax_stats.cache_misses +
+           vbo->minmax_stats.user_scans)) {
+         _mesa_debug(ctx, "index range: %u cache hits, %u cache misses, "
+                     "%u client array scans; %llu indices scanned, "
+                     "%llu not scanned thanks to the cache\n",
+                     vbo->minmax_stats.cache_hits,
+                     vbo->minmax_stats.cache_misses,
+                     vbo->minmax_stats.user_scans,
+                     (unsigned long long) vbo->minmax_stats.scanned_indices,
+                     (unsigned long long) vbo->minmax_stats.cached_indices);
+      }
+
       for (i = 0; i < VBO_ATTRIB_MAX; i++) {
          _mesa_reference_buffer_object(ctx, &vbo->currval[i].BufferObj, NULL);
       }
@@ -82,6 +82,18 @@ struct vbo_context {
     * indirect parameter.
     */
    vbo_indirect_draw_func draw_indirect_prims;
+
+   /**
+    * How the index ranges of indexed draws were found, printed when the
+    * context is destroyed with MESA_VERBOSE=draw.
+    */
+   struct {
+      unsigned cache_hits;      /**< found in a buffer's minmax cache */
+      unsigned cache_misses;    /**< buffer scanned */
+      unsigned user_scans;      /**< client memory scanned */
+      uint64_t cached_indices;  /**< indices not scanned thanks to the cache */
+      uint64_t scanned_indices;
+   } minmax_stats;
 };
 
 
@@ -31,8 +31,10 @@
 #include "main/varray.h"
 #include "main/macros.h"
 #include "main/sse_minmax.h"
+#include "main/worker_pool.h"
 #include "x86/common_x86_asm.h"
 #include "util/hash_table.h"
+#include "vbo_context.h"
 
 
 struct minmax_cache_key {
@@ -227,38 +229,25 @@ out:
 
 
 /**
- * Compute min and max elements by scanning the index buffer for
- * glDraw[Range]Elements() calls.
- * If primitive restart is enabled, we need to ignore restart
- * indexes when computing min/max.
+ * Scan \p count indices for their minimum and maximum, skipping
+ * \p restartIndex if \p restart is set.
  */
 static void
-vbo_get_minmax_index(struct gl_context *ctx,
-                     const struct _mesa_prim *prim,
-                     const struct _mesa_index_buffer *ib,
-                     GLuint *min_index, GLuint *max_index,
-                     const GLuint count)
+vbo_minmax_scan(const void *indices, GLenum type, GLuint count,
+                GLboolean restart, GLuint restartIndex,
+                GLuint *min_index, GLuint *max_index)
 {
-   const GLboolean restart = ctx->Array._PrimitiveRestart;
-   const GLuint restartIndex = _mesa_primitive_restart_index(ctx, ib->type);
-   const int index_size = vbo_sizeof_ib_type(ib->type);
-   const char *indices;
    GLuint i;
 
-   indices = (char *) ib->ptr + prim->start * index_size;
-   if (_mesa_is_bufferobj(ib->obj)) {
-      GLsizeiptr size = MIN2(count * index_size, ib->obj->Size);
-
-      if (vbo_get_minmax_cached(ib->obj, ib->type, (GLintptr) indices, count,
-                                min_index, max_index))
-         return;
-
-      indices = ctx->Driver.MapBufferRange(ctx, (GLintptr) indices, size,
-                                           GL_MAP_READ_BIT, ib->obj,
-                                           MAP_INTERNAL);
+#if defined(USE_SSE41)
+   if (cpu_has_sse4_1) {
+      _mesa_index_array_min_max(indices, vbo_sizeof_ib_type(type), count,
+                                restart, restartIndex, min_index, max_index);
+      return;
    }
+#endif
 
-   switch (ib->type) {
+   switch (type) {
    case GL_UNSIGNED_INT: {
       const GLuint *ui_indices = (const GLuint *)indices;
       GLuint max_ui = 0;
@@ -272,16 +261,10 @@ vbo_get_minmax_index(struct gl_context *ctx,
          }
       }
       else {
-#if defined(USE_SSE41)
-         if (cpu_has_sse4_1) {
-            _mesa_uint_array_min_max(ui_indices, &min_ui, &max_ui, count);
+         for (i = 0; i < count; i++) {
+            if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
+            if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
          }
-         else
-#endif
-            for (i = 0; i < count; i++) {
-               if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
-               if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
-            }
       }
       *min_index = min_ui;
       *max_index = max_ui;
@@ -334,9 +317,135 @@ vbo_get_minmax_index(struct gl_context *ctx,
    default:
       unreachable("not reached");
    }
+}
+
+
+/**
+ * Scans of at least this many indices are split over the worker pool.
+ * Below that the memory is likely to be cached already and the hand-off
+ * costs more than it saves.
+ */
+#define MINMAX_THREAD_MIN_INDICES (512 * 1024)
+
+/** Upper bound on the number of pieces a scan is split into */
+#define MINMAX_MAX_PIECES 32
+
+
+struct minmax_job
+{
+   const char *indices;
+   GLenum type;
+   GLuint index_size;
+   GLuint count;
+   GLuint piece_size;     /**< indices per piece */
+   GLboolean restart;
+   GLuint restartIndex;
+
+   GLuint min[MINMAX_MAX_PIECES];
+   GLuint max[MINMAX_MAX_PIECES];
+};
+
+
+static void
+vbo_minmax_scan_piece(void *data, unsigned piece)
+{
+   struct minmax_job *job = data;
+   const GLuint start = piece * job->piece_size;
+
+   vbo_minmax_scan(job->indices + start * job->index_size, job->type,
+                   MIN2(job->piece_size, job->count - start),
+                   job->restart, job->restartIndex,
+                   &job->min[piece], &job->max[piece]);
+}
+
+
+/**
+ * As vbo_minmax_scan(), splitting large arrays into pieces which are
+ * scanned in parallel on the worker pool.
+ */
+static void
+vbo_minmax_scan_parallel(const void *indices, GLenum type, GLuint count,
+                         GLboolean restart, GLuint restartIndex,
+                         GLuint *min_index, GLuint *max_index)
+{
+   struct minmax_job job;
+   unsigned pieces, i;
+
+   if (count < MINMAX_THREAD_MIN_INDICES ||
+       (pieces = MIN2(_mesa_worker_pool_size(), MINMAX_MAX_PIECES)) < 2) {
+      vbo_minmax_scan(indices, type, count, restart, restartIndex,
+                      min_index, max_index);
+      return;
+   }
+
+   job.indices = indices;
+   job.type = type;
+   job.index_size = vbo_sizeof_ib_type(type);
+   job.count = count;
+   /* Keep the pieces 16-byte aligned for the SIMD loops. */
+   job.piece_size = ALIGN(DIV_ROUND_UP(count, pieces), 16);
+   job.restart = restart;
+   job.restartIndex = restartIndex;
+
+   pieces = DIV_ROUND_UP(count, job.piece_size);
+   _mesa_worker_pool_run(vbo_minmax_scan_piece, &job, pieces);
+
+   *min_index = ~0U;
+   *max_index = 0;
+   for (i = 0; i < pieces; i++) {
+      *min_index = MIN2(*min_index, job.min[i]);
+      *max_index = MAX2(*max_index, job.max[i]);
+   }
+}
+
+
+/**
+ * Compute min and max elements by scanning the index buffer for
+ * glDraw[Range]Elements() calls.
+ * If primitive restart is enabled, we need to ignore restart
+ * indexes when computing min/max.
+ */
+static void
+vbo_get_minmax_index(struct gl_context *ctx,
+                     const struct _mesa_prim *prim,
+                     const struct _mesa_index_buffer *ib,
+                     GLuint *min_index, GLuint *max_index,
+                     const GLuint count)
+{
+   struct vbo_context *vbo = vbo_context(ctx);
+   const GLboolean restart = ctx->Array._PrimitiveRestart;
+   const GLuint restartIndex = _mesa_primitive_restart_index(ctx, ib->type);
+   const int index_size = vbo_sizeof_ib_type(ib->type);
+   const char *indices;
+   GLintptr offset;
+
+   indices = (char *) ib->ptr + prim->start * index_size;
+   if (_mesa_is_bufferobj(ib->obj)) {
+      GLsizeiptr size = MIN2(count * index_size, ib->obj->Size);
+
+      offset = (GLintptr) indices;
+      if (vbo_get_minmax_cached(ib->obj, ib->type, offset, count,
+                                min_index, max_index)) {
+         vbo->minmax_stats.cache_hits++;
+         vbo->minmax_stats.cached_indices += count;
+         return;
+      }
+      vbo->minmax_stats.cache_misses++;
+
+      indices = ctx->Driver.MapBufferRange(ctx, offset, size,
+                                           GL_MAP_READ_BIT, ib->obj,
+                                           MAP_INTERNAL);
+   }
+   else {
+      vbo->minmax_stats.user_scans++;
+   }
+   vbo->minmax_stats.scanned_indices += count;
+
+   vbo_minmax_scan_parallel(indices, ib->type, count, restart, restartIndex,
+                            min_index, max_index);
 
    if (_mesa_is_bufferobj(ib->obj)) {
-      vbo_minmax_cache_store(ctx, ib->obj, ib->type, prim->start, count,
+      vbo_minmax_cache_store(ctx, ib->obj, ib->type, offset, count,
                              *min_index, *max_index);
       ctx->Driver.UnmapBuffer(ctx, ib->obj, MAP_INTERNAL);
    }
@@ -82,6 +82,10 @@ void vbo_save_destroy( struct gl_context *ctx )
    struct vbo_save_context *save = &vbo->save;
    GLuint i;
 
+   vbo_save_discard_pending_lists(ctx);
+   free(save->pending);
+   save->pending = NULL;
+
    if (save->prim_store) {
       if ( --save->prim_store->refcount == 0 ) {
          free(save->prim_store);
@@ -84,8 +84,28 @@ struct vbo_save_vertex_list {
 
    struct vbo_save_vertex_store *vertex_store;
    struct vbo_save_primitive_store *prim_store;
+
+   /* Set once vbo_save_optimize_list() has repacked this list.  The
+    * vertices are then deduplicated and every prim[] is indexed, reading
+    * its indices from vertex_store->bufferobj at index_offset.  prim[] is
+    * owned by the node (prim_store is NULL) and is followed by
+    * merged_prim[], the same primitives folded into as few independent
+    * points/lines/triangles draws as possible.  merged_flags tells which
+    * state the merged draws depend on.
+    */
+   GLboolean indexed;
+   GLenum index_type;
+   GLuint index_offset;         /**< in bytes */
+   GLuint index_count;          /**< indices of prim[] and merged_prim[] */
+   struct _mesa_prim *merged_prim;
+   GLuint merged_prim_count;
+   GLbitfield merged_flags;
 };
 
+#define VBO_SAVE_MERGED_LAST_PV      0x1 /**< needs last vertex convention */
+#define VBO_SAVE_MERGED_FILL         0x2 /**< needs GL_FILL polygon mode */
+#define VBO_SAVE_MERGED_NO_STIPPLE   0x4 /**< needs line stipple disabled */
+
 /* These buffers should be a reasonable size to support upload to
  * hardware.  Current vbo implementation will re-upload on any
  * changes, so don't make too big or apps which dynamically create
@@ -104,6 +124,9 @@ struct vbo_save_vertex_list {
 
 #define VBO_SAVE_FALLBACK    0x10000000
 
+/* An interesting VBO number/name to help with debugging */
+#define VBO_BUF_ID  12345
+
 /* Storage to be shared among several vertex_lists.
  */
 struct vbo_save_vertex_store {
@@ -120,6 +143,39 @@ struct vbo_save_primitive_store {
 };
 
 
+/* A vertex list compiled into the current display list which may be
+ * repacked by vbo_save_optimize_list() once the list is complete.
+ */
+struct vbo_save_pending_list {
+   struct vbo_save_vertex_list *node;
+   fi_type *vertices;   /**< copy of the node's vertices */
+   GLboolean adjacent;  /**< directly follows the previous pending node */
+};
+
+
+/* A run of pending vertex lists repacked into its first list.
+ */
+struct vbo_save_packed_run {
+   struct vbo_save_pending_list *lists;
+   GLuint nr_lists;
+
+   fi_type *vertices;           /**< deduplicated vertices */
+   GLuint nr_vertices;
+
+   GLuint *indices;             /**< of prim[], then of merged prims */
+   GLuint index_count;
+   GLenum index_type;
+
+   struct _mesa_prim *prim;     /**< prim_count + merged_prim_count */
+   GLuint prim_count;
+   GLuint merged_prim_count;
+   GLbitfield merged_flags;
+
+   GLuint vertex_offset;        /**< in the packed buffer, in bytes */
+   GLuint index_offset;         /**< in the packed buffer, in bytes */
+};
+
+
 struct vbo_save_context {
    struct gl_context *ctx;
    GLvertexformat vtxfmt;
@@ -159,6 +215,11 @@ struct vbo_save_context {
    
    fi_type *current[VBO_ATTRIB_MAX]; /* points into ctx->ListState */
    GLubyte *currentsz[VBO_ATTRIB_MAX];
+
+   struct vbo_save_pending_list *pending;
+   GLuint pending_count, pending_max;
+   union gl_dlist_node *pending_block; /**< dlist position after the */
+   GLuint pending_pos;                 /**< last pending node */
 };
 
 void vbo_save_init( struct gl_context *ctx );
@@ -175,6 +236,20 @@ void vbo_loopback_vertex_list( struct gl_context *ctx,
 			       GLuint wrap_count,
 			       GLuint vertex_size);
 
+/* save_optimize.c:
+ */
+void vbo_save_add_pending_list( struct gl_context *ctx,
+                                struct vbo_save_vertex_list *node,
+                                GLboolean adjacent );
+
+void vbo_save_discard_pending_lists( struct gl_context *ctx );
+
+void vbo_save_optimize_list( struct gl_context *ctx );
+
+GLboolean vbo_save_pack_run( struct vbo_save_packed_run *run );
+
+void vbo_save_free_packed_run( struct vbo_save_packed_run *run );
+
 /* Callbacks:
  */
 void vbo_save_playback_vertex_list( struct gl_context *ctx, void *data );
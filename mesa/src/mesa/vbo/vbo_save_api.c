@@ -89,10 +89,6 @@ USE OR OTHER DEALINGS IN THE SOFTWARE.
 #endif
 
 
-/* An interesting VBO number/name to help with debugging */
-#define VBO_BUF_ID  12345
-
-
 /*
  * NOTE: Old 'parity' issue is gone, but copying can still be
  * wrong-footed on replay.
@@ -415,6 +411,13 @@ _save_compile_vertex_list(struct gl_context *ctx)
 {
    struct vbo_save_context *save = &vbo_context(ctx)->save;
    struct vbo_save_vertex_list *node;
+   GLboolean adjacent;
+
+   /* Nothing was compiled into the list since the last pending vertex
+    * list if the list is still at the position it was left at.
+    */
+   adjacent = save->pending_block == ctx->ListState.CurrentBlock &&
+              save->pending_pos == ctx->ListState.CurrentPos;
 
    /* Allocate space for this structure in the display list currently
     * being compiled.
@@ -444,6 +447,14 @@ _save_compile_vertex_list(struct gl_context *ctx)
    node->vertex_store = save->vertex_store;
    node->prim_store = save->prim_store;
 
+   node->indexed = GL_FALSE;
+   node->index_type = 0;
+   node->index_offset = 0;
+   node->index_count = 0;
+   node->merged_prim = NULL;
+   node->merged_prim_count = 0;
+   node->merged_flags = 0;
+
    node->vertex_store->refcount++;
    node->prim_store->refcount++;
 
@@ -494,6 +505,11 @@ _save_compile_vertex_list(struct gl_context *ctx)
 
    merge_prims(node->prim, &node->prim_count);
 
+   /* Remember the list for vbo_save_optimize_list() while its vertices
+    * are still mapped.
+    */
+   vbo_save_add_pending_list(ctx, node, adjacent);
+
    /* Deal with GL_COMPILE_AND_EXECUTE:
     */
    if (ctx->ExecuteFlag) {
@@ -1516,6 +1532,8 @@ vbo_save_NewList(struct gl_context *ctx, GLuint list, GLenum mode)
    (void) list;
    (void) mode;
 
+   vbo_save_discard_pending_lists(ctx);
+
    if (!save->prim_store)
       save->prim_store = alloc_prim_store(ctx);
 
@@ -1560,6 +1578,8 @@ vbo_save_EndList(struct gl_context *ctx)
 
    vbo_save_unmap_vertex_store(ctx, save->vertex_store);
 
+   vbo_save_optimize_list(ctx);
+
    assert(save->vertex_size == 0);
 }
 
@@ -1592,11 +1612,19 @@ vbo_destroy_vertex_list(struct gl_context *ctx, void *data)
    struct vbo_save_vertex_list *node = (struct vbo_save_vertex_list *) data;
    (void) ctx;
 
-   if (--node->vertex_store->refcount == 0)
+   /* Lists emptied by vbo_save_optimize_list() have no storage left */
+   if (node->vertex_store && --node->vertex_store->refcount == 0)
       free_vertex_store(ctx, node->vertex_store);
 
-   if (--node->prim_store->refcount == 0)
-      free(node->prim_store);
+   if (node->prim_store) {
+      if (--node->prim_store->refcount == 0)
+         free(node->prim_store);
+   }
+   else {
+      /* prim[] and merged_prim[] of an optimized list */
+      free(node->prim);
+   }
+   node->prim = NULL;
 
    free(node->current_data);
    node->current_data = NULL;
@@ -1617,6 +1645,11 @@ vbo_print_vertex_list(struct gl_context *ctx, void *data, FILE *f)
            node->count, node->prim_count, node->vertex_size,
            buffer);
 
+   if (node->indexed)
+      fprintf(f, "   %u indices at offset %u, %d merged primitives\n",
+              node->index_count, node->index_offset,
+              node->merged_prim_count);
+
    for (i = 0; i < node->prim_count; i++) {
       struct _mesa_prim *prim = &node->prim[i];
       fprintf(f, "   prim %d: %s%s %d..%d %s %s\n",
@@ -34,6 +34,8 @@
 #include "main/macros.h"
 #include "main/light.h"
 #include "main/state.h"
+#include "main/transformfeedback.h"
+#include "main/varray.h"
 #include "util/bitscan.h"
 
 #include "vbo_context.h"
@@ -217,6 +219,36 @@ static void vbo_bind_vertex_list(struct gl_context *ctx,
 }
 
 
+/**
+ * Expand the vertices of an optimized list back into the sequence of its
+ * primitives.  prim[].start then indexes the returned array.
+ */
+static GLfloat *
+vbo_save_expand_vertex_list(const struct vbo_save_vertex_list *list,
+                            const char *buffer)
+{
+   const GLuint sz = list->vertex_size;
+   const struct _mesa_prim *last = &list->prim[list->prim_count - 1];
+   const GLuint count = last->start + last->count;
+   const fi_type *src = (const fi_type *) (buffer + list->buffer_offset);
+   GLfloat *dst = malloc(count * sz * sizeof(GLfloat));
+   GLuint i;
+
+   if (!dst)
+      return NULL;
+
+   for (i = 0; i < count; i++) {
+      const GLuint index = list->index_type == GL_UNSIGNED_SHORT ?
+         ((const GLushort *) (buffer + list->index_offset))[i] :
+         ((const GLuint *) (buffer + list->index_offset))[i];
+
+      memcpy(dst + i * sz, src + index * sz, sz * sizeof(GLfloat));
+   }
+
+   return dst;
+}
+
+
 static void
 vbo_save_loopback_vertex_list(struct gl_context *ctx,
                               const struct vbo_save_vertex_list *list)
@@ -228,19 +260,106 @@ vbo_save_loopback_vertex_list(struct gl_context *ctx,
 				 list->vertex_store->bufferobj,
                                  MAP_INTERNAL);
 
-   vbo_loopback_vertex_list(ctx,
-                            (const GLfloat *)(buffer + list->buffer_offset),
-                            list->attrsz,
-                            list->prim,
-                            list->prim_count,
-                            list->wrap_count,
-                            list->vertex_size);
+   if (list->indexed) {
+      GLfloat *vertices = vbo_save_expand_vertex_list(list, buffer);
+      struct _mesa_prim *prim =
+         malloc(list->prim_count * sizeof(struct _mesa_prim));
+
+      if (vertices && prim) {
+         GLuint i;
+
+         /* The pieces of a primitive continued across vertex lists each
+          * hold their copied vertices, so they are replayed as primitives
+          * of their own.  Only line stipple doesn't carry on between them.
+          */
+         for (i = 0; i < list->prim_count; i++) {
+            prim[i] = list->prim[i];
+            prim[i].begin = 1;
+            prim[i].end = 1;
+         }
+
+         vbo_loopback_vertex_list(ctx, vertices, list->attrsz,
+                                  prim, list->prim_count,
+                                  0, list->vertex_size);
+      }
+      else {
+         _mesa_error(ctx, GL_OUT_OF_MEMORY, "glCallList");
+      }
+
+      free(vertices);
+      free(prim);
+   }
+   else {
+      vbo_loopback_vertex_list(ctx,
+                               (const GLfloat *)(buffer + list->buffer_offset),
+                               list->attrsz,
+                               list->prim,
+                               list->prim_count,
+                               list->wrap_count,
+                               list->vertex_size);
+   }
 
    ctx->Driver.UnmapBuffer(ctx, list->vertex_store->bufferobj,
                            MAP_INTERNAL);
 }
 
 
+/**
+ * Would primitive restart drop some indices of an optimized list?  The
+ * indices of a list are all below node->count.
+ */
+static GLboolean
+vbo_save_restart_hits_list(const struct gl_context *ctx,
+                           const struct vbo_save_vertex_list *node)
+{
+   return node->indexed && ctx->Array._PrimitiveRestart &&
+          _mesa_primitive_restart_index(ctx, node->index_type) < node->count;
+}
+
+
+/**
+ * Do the merged primitives of an optimized list draw the same as its
+ * original primitives, given the current state?
+ */
+static GLboolean
+vbo_save_can_draw_merged(const struct gl_context *ctx,
+                         const struct vbo_save_vertex_list *node)
+{
+   GLuint i;
+
+   if (node->merged_prim_count == 0)
+      return GL_FALSE;
+
+   if ((node->merged_flags & VBO_SAVE_MERGED_LAST_PV) &&
+       ctx->Light.ProvokingVertex != GL_LAST_VERTEX_CONVENTION_EXT)
+      return GL_FALSE;
+
+   if ((node->merged_flags & VBO_SAVE_MERGED_FILL) &&
+       (ctx->Polygon.FrontMode != GL_FILL ||
+        ctx->Polygon.BackMode != GL_FILL))
+      return GL_FALSE;
+
+   if ((node->merged_flags & VBO_SAVE_MERGED_NO_STIPPLE) &&
+       ctx->Line.StippleFlag)
+      return GL_FALSE;
+
+   /* Converted primitives would change the count of primitives written
+    * or generated.
+    */
+   if (node->merged_flags) {
+      if (_mesa_is_xfb_active_and_unpaused(ctx))
+         return GL_FALSE;
+
+      for (i = 0; i < MAX_VERTEX_STREAMS; i++) {
+         if (ctx->Query.PrimitivesGenerated[i])
+            return GL_FALSE;
+      }
+   }
+
+   return GL_TRUE;
+}
+
+
 /**
  * Execute the buffer and save copied verts.
  * This is called from the display list code when executing
@@ -278,7 +397,7 @@ vbo_save_playback_vertex_list(struct gl_context *ctx, void *data)
                      "draw operation inside glBegin/End");
          goto end;
       }
-      else if (save->replay_flags) {
+      else if (save->replay_flags || vbo_save_restart_hits_list(ctx, node)) {
 	 /* Various degenerate cases: translate into immediate mode
 	  * calls rather than trying to execute in place.
 	  */
@@ -307,7 +426,32 @@ vbo_save_playback_vertex_list(struct gl_context *ctx, void *data)
       if (ctx->NewState)
 	 _mesa_update_state( ctx );
 
-      if (node->count > 0) {
+      if (node->count > 0 && node->indexed) {
+         struct _mesa_index_buffer ib;
+
+         ib.count = node->index_count;
+         ib.type = node->index_type;
+         ib.obj = node->vertex_store->bufferobj;
+         ib.ptr = (const void *) (uintptr_t) node->index_offset;
+
+         if (vbo_save_can_draw_merged(ctx, node)) {
+            vbo_context(ctx)->draw_prims(ctx,
+                                         node->merged_prim,
+                                         node->merged_prim_count,
+                                         &ib, GL_TRUE,
+                                         0, node->count - 1,
+                                         NULL, 0, NULL);
+         }
+         else {
+            vbo_context(ctx)->draw_prims(ctx,
+                                         node->prim,
+                                         node->prim_count,
+                                         &ib, GL_TRUE,
+                                         0, node->count - 1,
+                                         NULL, 0, NULL);
+         }
+      }
+      else if (node->count > 0) {
          vbo_context(ctx)->draw_prims(ctx, 
                                       node->prim,
                                       node->prim_count,
@@ -0,0 +1,659 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2016  The Mesa Authors   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file vbo_save_optimize.c
+ *
+ * Repacking of the vertex lists of a completed display list.
+ *
+ * While a display list is compiled, each vertex list keeps its vertices in
+ * a VBO_SAVE_BUFFER_SIZE buffer shared with other lists, and each
+ * glBegin/End pair which can't be appended to the previous one is a
+ * primitive of its own.  A list made of many small primitives thus replays
+ * as many small draws.
+ *
+ * When the display list ends, runs of vertex lists which have the same
+ * vertex layout and follow each other in the display list, with nothing
+ * compiled in between, are merged into the first list of the run.  The
+ * vertices of a run are deduplicated and the primitives index them.  The
+ * vertices and indices of all the runs are packed into one buffer object.
+ *
+ * The primitives of a run are also converted into as few independent
+ * points, lines and triangles draws as the primitive order allows.  These
+ * are only equivalent to the original primitives under some state (see
+ * VBO_SAVE_MERGED_x), so playback picks one of the two sets of primitives.
+ */
+
+
+#include "main/glheader.h"
+#include "main/bufferobj.h"
+#include "main/imports.h"
+#include "main/macros.h"
+#include "main/mtypes.h"
+#include "util/hash_table.h"
+
+#include "vbo_context.h"
+
+
+/**
+ * Called for every vertex list compiled into the current display list,
+ * while its vertices are still mapped.  Lists which may be repacked are
+ * recorded, along with a copy of their vertices.
+ */
+void
+vbo_save_add_pending_list(struct gl_context *ctx,
+                          struct vbo_save_vertex_list *node,
+                          GLboolean adjacent)
+{
+   struct vbo_save_context *save = &vbo_context(ctx)->save;
+   struct vbo_save_pending_list *pending;
+   const GLuint size = node->count * node->vertex_size * sizeof(fi_type);
+   GLuint i;
+
+   save->pending_block = NULL;
+
+   if (save->out_of_memory ||
+       !save->vertex_store->buffer ||
+       node->count == 0 ||
+       node->prim_count == 0 ||
+       node->dangling_attr_ref ||
+       (node->current_size && !node->current_data))
+      return;
+
+   /* A primitive continued from the previous vertex list can only be
+    * repacked along with it.
+    */
+   if (!node->prim[0].begin && !adjacent)
+      return;
+
+   for (i = 0; i < node->prim_count; i++) {
+      if (node->prim[i].mode > GL_POLYGON)
+         return;
+   }
+
+   if (save->pending_count == save->pending_max) {
+      const GLuint max = MAX2(2 * save->pending_max, 16);
+
+      pending = realloc(save->pending, max * sizeof(*pending));
+      if (!pending)
+         return;
+
+      save->pending = pending;
+      save->pending_max = max;
+   }
+
+   pending = &save->pending[save->pending_count];
+   pending->vertices = malloc(size);
+   if (!pending->vertices)
+      return;
+
+   memcpy(pending->vertices,
+          (const char *) save->vertex_store->buffer + node->buffer_offset,
+          size);
+   pending->node = node;
+   pending->adjacent = adjacent;
+   save->pending_count++;
+
+   save->pending_block = ctx->ListState.CurrentBlock;
+   save->pending_pos = ctx->ListState.CurrentPos;
+}
+
+
+void
+vbo_save_discard_pending_lists(struct gl_context *ctx)
+{
+   struct vbo_save_context *save = &vbo_context(ctx)->save;
+   GLuint i;
+
+   for (i = 0; i < save->pending_count; i++)
+      free(save->pending[i].vertices);
+
+   save->pending_count = 0;
+   save->pending_block = NULL;
+}
+
+
+static GLboolean
+same_vertex_format(const struct vbo_save_vertex_list *a,
+                   const struct vbo_save_vertex_list *b)
+{
+   return a->enabled == b->enabled &&
+          a->vertex_size == b->vertex_size &&
+          memcmp(a->attrsz, b->attrsz, sizeof(a->attrsz)) == 0 &&
+          memcmp(a->attrtype, b->attrtype, sizeof(a->attrtype)) == 0;
+}
+
+
+static const struct _mesa_prim *
+last_prim(const struct vbo_save_vertex_list *node)
+{
+   return &node->prim[node->prim_count - 1];
+}
+
+
+static GLenum
+merged_mode(GLenum mode)
+{
+   switch (mode) {
+   case GL_POINTS:
+      return GL_POINTS;
+   case GL_LINES:
+   case GL_LINE_STRIP:
+      return GL_LINES;
+   default:
+      return GL_TRIANGLES;
+   }
+}
+
+
+/**
+ * Write the indices of prim as independent points, lines or triangles.
+ * The winding and the last vertex of every line and triangle are kept,
+ * any incomplete trailing primitive is dropped.
+ * \return number of indices written
+ */
+static GLuint
+convert_prim(const struct _mesa_prim *prim, const GLuint *in, GLuint *out,
+             GLboolean edgeflags, GLbitfield *flags)
+{
+   const GLuint n = prim->count;
+   GLuint i, k = 0;
+
+   switch (prim->mode) {
+   case GL_POINTS:
+      k = n;
+      memcpy(out, in, k * sizeof(GLuint));
+      break;
+   case GL_LINES:
+      k = n - n % 2;
+      memcpy(out, in, k * sizeof(GLuint));
+      break;
+   case GL_TRIANGLES:
+      k = n - n % 3;
+      memcpy(out, in, k * sizeof(GLuint));
+      break;
+   case GL_LINE_STRIP:
+      for (i = 0; i + 1 < n; i++) {
+         out[k++] = in[i];
+         out[k++] = in[i + 1];
+      }
+      *flags |= VBO_SAVE_MERGED_NO_STIPPLE;
+      break;
+   case GL_TRIANGLE_STRIP:
+      /* Swap the first two vertices of odd triangles */
+      for (i = 0; i + 2 < n; i++) {
+         out[k++] = in[i + (i & 1)];
+         out[k++] = in[i + 1 - (i & 1)];
+         out[k++] = in[i + 2];
+      }
+      *flags |= VBO_SAVE_MERGED_LAST_PV;
+      if (edgeflags)
+         *flags |= VBO_SAVE_MERGED_FILL;
+      break;
+   case GL_TRIANGLE_FAN:
+      for (i = 1; i + 1 < n; i++) {
+         out[k++] = in[0];
+         out[k++] = in[i];
+         out[k++] = in[i + 1];
+      }
+      *flags |= VBO_SAVE_MERGED_LAST_PV;
+      if (edgeflags)
+         *flags |= VBO_SAVE_MERGED_FILL;
+      break;
+   case GL_QUADS:
+      for (i = 0; i + 3 < n; i += 4) {
+         out[k++] = in[i + 0];
+         out[k++] = in[i + 1];
+         out[k++] = in[i + 3];
+         out[k++] = in[i + 1];
+         out[k++] = in[i + 2];
+         out[k++] = in[i + 3];
+      }
+      *flags |= VBO_SAVE_MERGED_LAST_PV | VBO_SAVE_MERGED_FILL;
+      break;
+   case GL_QUAD_STRIP:
+      for (i = 0; i + 3 < n; i += 2) {
+         out[k++] = in[i + 0];
+         out[k++] = in[i + 1];
+         out[k++] = in[i + 3];
+         out[k++] = in[i + 2];
+         out[k++] = in[i + 0];
+         out[k++] = in[i + 3];
+      }
+      *flags |= VBO_SAVE_MERGED_LAST_PV | VBO_SAVE_MERGED_FILL;
+      break;
+   case GL_POLYGON:
+      /* The provoking vertex of a polygon is its first one */
+      for (i = 1; i + 1 < n; i++) {
+         out[k++] = in[i];
+         out[k++] = in[i + 1];
+         out[k++] = in[0];
+      }
+      *flags |= VBO_SAVE_MERGED_LAST_PV | VBO_SAVE_MERGED_FILL;
+      break;
+   default:
+      /* Line loops were converted to strips by vbo_save_pack_run() */
+      assert(0);
+      break;
+   }
+
+   return k;
+}
+
+
+/**
+ * Write the indices of a line loop as a line strip, the way
+ * convert_line_loop_to_strip() does for the last primitive of a vertex
+ * list.  A continued loop starts with the copy of its first vertex, which
+ * only closes it.
+ * \return number of indices written
+ */
+static GLuint
+convert_line_loop(const struct _mesa_prim *prim, const GLuint *in,
+                  GLuint *out)
+{
+   const GLuint skip = prim->begin ? 0 : 1;
+   GLuint k = 0, i;
+
+   for (i = skip; i < prim->count; i++)
+      out[k++] = in[i];
+
+   if (prim->end && prim->count >= 2)
+      out[k++] = in[0];
+
+   return k;
+}
+
+
+/**
+ * Deduplicate the vertices of a run and build its indexed primitives.
+ * \return GL_FALSE if the run gains nothing from repacking, or on
+ *         allocation failure
+ */
+GLboolean
+vbo_save_pack_run(struct vbo_save_packed_run *run)
+{
+   const struct vbo_save_vertex_list *first = run->lists[0].node;
+   const GLuint vertex_size = first->vertex_size;
+   const GLuint vertex_bytes = vertex_size * sizeof(fi_type);
+   const GLboolean edgeflags =
+      (first->enabled & BITFIELD64_BIT(VBO_ATTRIB_EDGEFLAG)) != 0;
+   GLuint nr_vertices = 0, nr_prims = 0, nr_indices = 0;
+   GLuint table_size, base, i, j, k, orig_index_count;
+   GLuint *table, *remap;
+   struct _mesa_prim *merged;
+
+   for (i = 0; i < run->nr_lists; i++) {
+      const struct vbo_save_vertex_list *node = run->lists[i].node;
+
+      nr_vertices += node->count;
+      nr_prims += node->prim_count;
+      for (j = 0; j < node->prim_count; j++)
+         nr_indices += node->prim[j].count;
+   }
+
+   table_size = _mesa_next_pow_two_32(2 * nr_vertices);
+   table = calloc(table_size, sizeof(GLuint));
+   remap = malloc(nr_vertices * sizeof(GLuint));
+   run->vertices = malloc(nr_vertices * vertex_bytes);
+   /* A converted primitive has at most three times as many indices, and
+    * a closed line loop one more
+    */
+   run->indices = malloc((4 * nr_indices + nr_prims) * sizeof(GLuint));
+   run->prim = malloc(2 * nr_prims * sizeof(struct _mesa_prim));
+
+   if (!table || !remap || !run->vertices || !run->indices || !run->prim) {
+      free(table);
+      free(remap);
+      return GL_FALSE;
+   }
+
+   /* Deduplicate the vertices of the run.  The table holds the index + 1
+    * of the unique vertices, 0 marks empty slots.
+    */
+   for (i = 0, base = 0; i < run->nr_lists; i++) {
+      const struct vbo_save_vertex_list *node = run->lists[i].node;
+
+      for (j = 0; j < node->count; j++) {
+         const fi_type *src = run->lists[i].vertices + j * vertex_size;
+         GLuint h = _mesa_hash_data(src, vertex_bytes) & (table_size - 1);
+         GLuint index = 0;
+
+         while (table[h]) {
+            index = table[h] - 1;
+            if (memcmp(run->vertices + index * vertex_size, src,
+                       vertex_bytes) == 0)
+               break;
+            h = (h + 1) & (table_size - 1);
+         }
+
+         if (!table[h]) {
+            index = run->nr_vertices++;
+            memcpy(run->vertices + index * vertex_size, src, vertex_bytes);
+            table[h] = index + 1;
+         }
+
+         remap[base + j] = index;
+      }
+
+      base += node->count;
+   }
+
+   free(table);
+
+   /* Index the original primitives.  A primitive continued across vertex
+    * lists begins again with its copied vertices, just as it is drawn
+    * without repacking, so each piece can become a primitive of its own.
+    * The begin/end flags are kept, so that line stipple carries on across
+    * the pieces of a strip.  Line loops which aren't the last primitive
+    * of their vertex list are still loops, and are closed here.
+    */
+   for (i = 0, base = 0; i < run->nr_lists; i++) {
+      const struct vbo_save_vertex_list *node = run->lists[i].node;
+
+      for (j = 0; j < node->prim_count; j++) {
+         struct _mesa_prim *prim = &run->prim[run->prim_count++];
+         const GLuint *in = remap + base + node->prim[j].start;
+
+         *prim = node->prim[j];
+         prim->indexed = 1;
+         prim->start = run->index_count;
+
+         if (prim->mode == GL_LINE_LOOP) {
+            prim->mode = GL_LINE_STRIP;
+            prim->count = convert_line_loop(&node->prim[j], in,
+                                            run->indices + run->index_count);
+         }
+         else {
+            memcpy(run->indices + run->index_count, in,
+                   prim->count * sizeof(GLuint));
+         }
+
+         run->index_count += prim->count;
+      }
+
+      base += node->count;
+   }
+
+   free(remap);
+   orig_index_count = run->index_count;
+
+   /* Fold consecutive primitives into independent points, lines and
+    * triangles, as long as the draw order is kept.
+    */
+   merged = run->prim + run->prim_count;
+   for (i = 0; i < run->prim_count; i++) {
+      const struct _mesa_prim *prim = &run->prim[i];
+      const GLenum mode = merged_mode(prim->mode);
+      struct _mesa_prim *last = run->merged_prim_count ?
+         &merged[run->merged_prim_count - 1] : NULL;
+
+      if (!last || last->mode != mode) {
+         last = &merged[run->merged_prim_count++];
+         *last = *prim;
+         last->mode = mode;
+         last->begin = 1;
+         last->end = 1;
+         last->start = run->index_count;
+         last->count = 0;
+      }
+
+      k = convert_prim(prim, run->indices + prim->start,
+                       run->indices + run->index_count,
+                       edgeflags, &run->merged_flags);
+      last->count += k;
+      run->index_count += k;
+
+      if (last->count == 0)
+         run->merged_prim_count--;
+   }
+
+   if (run->merged_prim_count >= run->prim_count) {
+      /* Nothing to gain, keep only the original primitives */
+      run->index_count = orig_index_count;
+      run->merged_prim_count = 0;
+      run->merged_flags = 0;
+
+      if (run->nr_lists == 1 && run->nr_vertices == first->count)
+         return GL_FALSE;
+   }
+
+   run->index_type = run->nr_vertices <= 0x10000 ?
+      GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+   return GL_TRUE;
+}
+
+
+void
+vbo_save_free_packed_run(struct vbo_save_packed_run *run)
+{
+   free(run->vertices);
+   free(run->indices);
+   free(run->prim);
+}
+
+
+static void
+release_storage(struct gl_context *ctx, struct vbo_save_vertex_list *node)
+{
+   if (--node->vertex_store->refcount == 0) {
+      assert(!node->vertex_store->buffer);
+      _mesa_reference_buffer_object(ctx, &node->vertex_store->bufferobj,
+                                    NULL);
+      free(node->vertex_store);
+   }
+
+   if (--node->prim_store->refcount == 0)
+      free(node->prim_store);
+
+   node->vertex_store = NULL;
+   node->prim_store = NULL;
+}
+
+
+/**
+ * Point the first list of a run at the packed data, and empty the others.
+ */
+static void
+apply_run(struct gl_context *ctx, struct vbo_save_packed_run *run,
+          struct vbo_save_vertex_store *store)
+{
+   struct vbo_save_vertex_list *head = run->lists[0].node;
+   struct vbo_save_vertex_list *current = NULL;
+   GLuint i;
+
+   /* The current values left by the run are those of its last list which
+    * updates them.
+    */
+   for (i = 0; i < run->nr_lists; i++) {
+      if (run->lists[i].node->current_size)
+         current = run->lists[i].node;
+   }
+
+   if (current != head) {
+      free(head->current_data);
+      head->current_data = NULL;
+      head->current_size = 0;
+
+      if (current) {
+         head->current_data = current->current_data;
+         head->current_size = current->current_size;
+         current->current_data = NULL;
+         current->current_size = 0;
+      }
+   }
+
+   for (i = 0; i < run->nr_lists; i++) {
+      struct vbo_save_vertex_list *node = run->lists[i].node;
+
+      release_storage(ctx, node);
+
+      if (i > 0) {
+         free(node->current_data);
+         node->current_data = NULL;
+         node->current_size = 0;
+         node->count = 0;
+         node->wrap_count = 0;
+         node->prim = NULL;
+         node->prim_count = 0;
+      }
+   }
+
+   head->vertex_store = store;
+   store->refcount++;
+
+   head->buffer_offset = run->vertex_offset;
+   head->count = run->nr_vertices;
+   head->wrap_count = 0;
+   head->prim = run->prim;
+   head->prim_count = run->prim_count;
+   head->merged_prim = run->prim + run->prim_count;
+   head->merged_prim_count = run->merged_prim_count;
+   head->merged_flags = run->merged_flags;
+   head->indexed = GL_TRUE;
+   head->index_type = run->index_type;
+   head->index_offset = run->index_offset;
+   head->index_count = run->index_count;
+
+   run->prim = NULL;
+}
+
+
+/**
+ * Called when a display list ends, after the vertex store was unmapped.
+ */
+void
+vbo_save_optimize_list(struct gl_context *ctx)
+{
+   struct vbo_save_context *save = &vbo_context(ctx)->save;
+   struct vbo_save_pending_list *pending = save->pending;
+   struct vbo_save_vertex_store *store;
+   struct vbo_save_packed_run *runs;
+   GLuint nr_runs = 0, size = 0, i;
+   GLubyte *data;
+
+   if (save->pending_count == 0)
+      return;
+
+   runs = calloc(save->pending_count, sizeof(*runs));
+   if (!runs) {
+      vbo_save_discard_pending_lists(ctx);
+      return;
+   }
+
+   for (i = 0; i < save->pending_count; ) {
+      struct vbo_save_packed_run *run = &runs[nr_runs];
+      GLint first = i, last = i;
+
+      while (last + 1 < (GLint) save->pending_count &&
+             pending[last + 1].adjacent &&
+             same_vertex_format(pending[last].node, pending[last + 1].node))
+         last++;
+
+      i = last + 1;
+
+      /* A run can't begin or end in the middle of a primitive */
+      while (first <= last && !pending[first].node->prim[0].begin)
+         first++;
+      while (first <= last && !last_prim(pending[last].node)->end)
+         last--;
+
+      if (first > last)
+         continue;
+
+      run->lists = &pending[first];
+      run->nr_lists = last - first + 1;
+
+      if (vbo_save_pack_run(run)) {
+         nr_runs++;
+      }
+      else {
+         vbo_save_free_packed_run(run);
+         memset(run, 0, sizeof(*run));
+      }
+   }
+
+   for (i = 0; i < nr_runs; i++) {
+      const GLuint vertex_size = runs[i].lists[0].node->vertex_size;
+
+      runs[i].vertex_offset = size;
+      size += runs[i].nr_vertices * vertex_size * sizeof(fi_type);
+      runs[i].index_offset = size;
+      size += runs[i].index_count * vbo_sizeof_ib_type(runs[i].index_type);
+      size = ALIGN(size, sizeof(GLuint));
+   }
+
+   data = nr_runs ? malloc(size) : NULL;
+   store = data ? CALLOC_STRUCT(vbo_save_vertex_store) : NULL;
+
+   if (store) {
+      for (i = 0; i < nr_runs; i++) {
+         const struct vbo_save_packed_run *run = &runs[i];
+         const GLuint vertex_size = run->lists[0].node->vertex_size;
+         GLuint j;
+
+         memcpy(data + run->vertex_offset, run->vertices,
+                run->nr_vertices * vertex_size * sizeof(fi_type));
+
+         if (run->index_type == GL_UNSIGNED_SHORT) {
+            GLushort *indices = (GLushort *) (data + run->index_offset);
+            for (j = 0; j < run->index_count; j++)
+               indices[j] = run->indices[j];
+         }
+         else {
+            memcpy(data + run->index_offset, run->indices,
+                   run->index_count * sizeof(GLuint));
+         }
+      }
+
+      store->bufferobj = ctx->Driver.NewBufferObject(ctx, VBO_BUF_ID);
+      if (!store->bufferobj ||
+          !ctx->Driver.BufferData(ctx, GL_ARRAY_BUFFER_ARB, size, data,
+                                  GL_STATIC_DRAW_ARB,
+                                  GL_MAP_READ_BIT | GL_DYNAMIC_STORAGE_BIT,
+                                  store->bufferobj)) {
+         /* Not an error, the lists are just left as they are */
+         _mesa_reference_buffer_object(ctx, &store->bufferobj, NULL);
+         free(store);
+         store = NULL;
+      }
+   }
+
+   if (store) {
+      store->buffer = NULL;
+      store->used = size / sizeof(GLfloat);
+      store->refcount = 0;
+
+      for (i = 0; i < nr_runs; i++)
+         apply_run(ctx, &runs[i], store);
+   }
+
+   for (i = 0; i < nr_runs; i++)
+      vbo_save_free_packed_run(&runs[i]);
+
+   free(data);
+   free(runs);
+   vbo_save_discard_pending_lists(ctx);
+}
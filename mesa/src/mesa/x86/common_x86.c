@@ -55,6 +55,15 @@
 #elif !defined(bit_SSE4_1) && !defined(bit_SSE41)
 #define bit_SSE4_1 0x00080000
 #endif
+#if !defined(bit_OSXSAVE)
+#define bit_OSXSAVE 0x08000000
+#endif
+#if !defined(bit_F16C)
+#define bit_F16C 0x20000000
+#endif
+#if !defined(bit_AVX2)
+#define bit_AVX2 0x00000020
+#endif
 #endif
 
 #include "main/imports.h"
@@ -207,6 +216,23 @@ void _mesa_check_os_sse_support( void )
 #endif /* USE_SSE_ASM */
 
 
+#if defined(USE_X86_64_ASM)
+/**
+ * Read XCR0, the mask of the register states saved by the OS.
+ */
+static unsigned int
+_mesa_x86_xgetbv(void)
+{
+   unsigned int eax, edx;
+
+   __asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" /* xgetbv */
+                        : "=a" (eax), "=d" (edx)
+                        : "c" (0));
+   return eax;
+}
+#endif
+
+
 /**
  * Initialize the _mesa_x86_cpu_features bitfield.
  * This is a no-op if called more than once.
@@ -354,6 +380,18 @@ _mesa_get_x86_features(void)
 
       if (ecx & bit_SSE4_1)
          _mesa_x86_cpu_features |= X86_FEATURE_SSE4_1;
+
+      /* AVX2 and F16C also need the OS to save the YMM registers */
+      if ((ecx & bit_OSXSAVE) && (_mesa_x86_xgetbv() & 0x6) == 0x6) {
+         if (ecx & bit_F16C)
+            _mesa_x86_cpu_features |= X86_FEATURE_F16C;
+
+         if (__get_cpuid_max(0, NULL) >= 7) {
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+            if (ebx & bit_AVX2)
+               _mesa_x86_cpu_features |= X86_FEATURE_AVX2;
+         }
+      }
    }
 #endif /* USE_X86_64_ASM */
 
@@ -0,0 +1,374 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * \file disk_cache.c
+ * Generic on-disk cache of binary blobs keyed by a SHA-1 hash.
+ *
+ * Each entry is a file named after the hex key, holding a small header
+ * followed by the data.  Entries are written to a temporary file and renamed
+ * into place, so that processes sharing the cache never see partial entries.
+ * Reading an entry refreshes its modification time, and when the cache grows
+ * beyond its size limit the least recently used entries are removed.
+ */
+
+#include "disk_cache.h"
+
+#if defined(HAVE_SHA1) && !defined(_WIN32)
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include "c11/threads.h"
+#include "mesa-sha1.h"
+
+#define DISK_CACHE_MAGIC 0x4d455341  /* "MESA" */
+
+struct disk_cache_header {
+   uint32_t magic;
+   uint32_t size;
+   unsigned char key[DISK_CACHE_KEY_SIZE];
+};
+
+struct disk_cache {
+   mtx_t mutex;
+   char path[PATH_MAX];
+   uint64_t max_size;
+   uint64_t size;        /**< estimated total size of the entries */
+};
+
+struct disk_cache_entry {
+   char name[2 * DISK_CACHE_KEY_SIZE + 16];
+   time_t mtime;
+   off_t size;
+};
+
+/**
+ * Create a directory and all its missing parents.
+ */
+static bool
+make_dirs(const char *path)
+{
+   char tmp[PATH_MAX];
+   char *p;
+
+   if (snprintf(tmp, sizeof tmp, "%s", path) >= (int) sizeof tmp)
+      return false;
+
+   for (p = tmp + 1; *p; p++) {
+      if (*p == '/') {
+         *p = '\0';
+         if (mkdir(tmp, 0755) != 0 && errno != EEXIST)
+            return false;
+         *p = '/';
+      }
+   }
+
+   return mkdir(tmp, 0755) == 0 || errno == EEXIST;
+}
+
+static int
+compare_entries(const void *a, const void *b)
+{
+   const struct disk_cache_entry *ea = a;
+   const struct disk_cache_entry *eb = b;
+
+   if (ea->mtime < eb->mtime)
+      return -1;
+   if (ea->mtime > eb->mtime)
+      return 1;
+   return 0;
+}
+
+/**
+ * Recompute the size of the cache, and when over the limit remove the least
+ * recently used entries until it's below 90% of it.
+ * Called with the cache mutex held.
+ */
+static void
+evict_entries(struct disk_cache *cache)
+{
+   struct disk_cache_entry *entries = NULL;
+   unsigned num_entries = 0, max_entries = 0;
+   uint64_t total = 0;
+   struct dirent *dent;
+   unsigned i;
+   DIR *dir;
+
+   dir = opendir(cache->path);
+   if (!dir)
+      return;
+
+   while ((dent = readdir(dir)) != NULL) {
+      char filename[PATH_MAX];
+      struct stat st;
+
+      if (dent->d_name[0] == '.' ||
+          strlen(dent->d_name) >= sizeof entries[0].name)
+         continue;
+
+      snprintf(filename, sizeof filename, "%s/%s", cache->path, dent->d_name);
+      if (stat(filename, &st) != 0 || !S_ISREG(st.st_mode))
+         continue;
+
+      if (num_entries == max_entries) {
+         unsigned new_max = max_entries ? max_entries * 2 : 64;
+         struct disk_cache_entry *new_entries =
+            realloc(entries, new_max * sizeof *entries);
+         if (!new_entries)
+            break;
+         entries = new_entries;
+         max_entries = new_max;
+      }
+
+      strcpy(entries[num_entries].name, dent->d_name);
+      entries[num_entries].mtime = st.st_mtime;
+      entries[num_entries].size = st.st_size;
+      num_entries++;
+      total += st.st_size;
+   }
+
+   closedir(dir);
+
+   if (total > cache->max_size) {
+      uint64_t target = cache->max_size / 10 * 9;
+
+      qsort(entries, num_entries, sizeof *entries, compare_entries);
+
+      for (i = 0; i < num_entries && total > target; i++) {
+         char filename[PATH_MAX];
+
+         snprintf(filename, sizeof filename, "%s/%s",
+                  cache->path, entries[i].name);
+         if (unlink(filename) == 0)
+            total -= entries[i].size;
+      }
+   }
+
+   cache->size = total;
+
+   free(entries);
+}
+
+struct disk_cache *
+disk_cache_create(const char *path, const char *subdir, uint64_t max_size)
+{
+   struct disk_cache *cache;
+   struct mesa_sha1 *sha1;
+   unsigned char dummy[20];
+   const char *dir;
+   int len;
+
+   if (!max_size)
+      return NULL;
+
+   /* No SHA-1 implementation to compute the keys with */
+   sha1 = _mesa_sha1_init();
+   if (!sha1)
+      return NULL;
+   _mesa_sha1_final(sha1, dummy);
+
+   cache = calloc(1, sizeof *cache);
+   if (!cache)
+      return NULL;
+
+   if (path)
+      len = snprintf(cache->path, sizeof cache->path, "%s", path);
+   else if ((dir = getenv("XDG_CACHE_HOME")) != NULL)
+      len = snprintf(cache->path, sizeof cache->path, "%s/mesa/%s",
+                     dir, subdir);
+   else if ((dir = getenv("HOME")) != NULL)
+      len = snprintf(cache->path, sizeof cache->path, "%s/.cache/mesa/%s",
+                     dir, subdir);
+   else
+      len = -1;
+
+   if (len <= 0 || len >= (int) sizeof cache->path ||
+       !make_dirs(cache->path)) {
+      free(cache);
+      return NULL;
+   }
+
+   mtx_init(&cache->mutex, mtx_plain);
+   cache->max_size = max_size;
+   evict_entries(cache);
+
+   return cache;
+}
+
+void
+disk_cache_destroy(struct disk_cache *cache)
+{
+   if (!cache)
+      return;
+
+   mtx_destroy(&cache->mutex);
+   free(cache);
+}
+
+static void
+entry_filename(struct disk_cache *cache, char *filename, size_t size,
+               const unsigned char key[DISK_CACHE_KEY_SIZE])
+{
+   char hex[2 * DISK_CACHE_KEY_SIZE + 1];
+
+   _mesa_sha1_format(hex, key);
+   snprintf(filename, size, "%s/%s", cache->path, hex);
+}
+
+void *
+disk_cache_get(struct disk_cache *cache,
+               const unsigned char key[DISK_CACHE_KEY_SIZE], size_t *size)
+{
+   struct disk_cache_header header;
+   char filename[PATH_MAX];
+   struct stat st;
+   void *data = NULL;
+   int fd;
+
+   if (!cache)
+      return NULL;
+
+   entry_filename(cache, filename, sizeof filename, key);
+
+   fd = open(filename, O_RDONLY);
+   if (fd < 0)
+      return NULL;
+
+   if (fstat(fd, &st) != 0 ||
+       st.st_size < (off_t) sizeof header ||
+       read(fd, &header, sizeof header) != sizeof header ||
+       header.magic != DISK_CACHE_MAGIC ||
+       memcmp(header.key, key, sizeof header.key) != 0 ||
+       header.size != st.st_size - sizeof header)
+      goto out;
+
+   data = malloc(header.size ? header.size : 1);
+   if (!data)
+      goto out;
+
+   if (read(fd, data, header.size) != (ssize_t) header.size) {
+      free(data);
+      data = NULL;
+      goto out;
+   }
+
+   *size = header.size;
+
+   /* Mark the entry as recently used */
+   utime(filename, NULL);
+
+out:
+   close(fd);
+   return data;
+}
+
+void
+disk_cache_put(struct disk_cache *cache,
+               const unsigned char key[DISK_CACHE_KEY_SIZE],
+               const void *data, size_t size)
+{
+   struct disk_cache_header header;
+   char filename[PATH_MAX];
+   char tmpname[PATH_MAX];
+   bool ok;
+   int fd;
+
+   if (!cache || size > UINT32_MAX)
+      return;
+
+   entry_filename(cache, filename, sizeof filename, key);
+
+   /* Several threads of a process may store the same entry at once, so the
+    * temporary file needs a name which is unique to this call.
+    */
+   if (snprintf(tmpname, sizeof tmpname, "%s.XXXXXX",
+                filename) >= (int) sizeof tmpname)
+      return;
+
+   fd = mkstemp(tmpname);
+   if (fd < 0)
+      return;
+   fchmod(fd, 0644);
+
+   header.magic = DISK_CACHE_MAGIC;
+   header.size = size;
+   memcpy(header.key, key, sizeof header.key);
+
+   ok = write(fd, &header, sizeof header) == sizeof header &&
+        write(fd, data, size) == (ssize_t) size;
+   ok = close(fd) == 0 && ok;
+
+   if (!ok || rename(tmpname, filename) != 0) {
+      unlink(tmpname);
+      return;
+   }
+
+   mtx_lock(&cache->mutex);
+   cache->size += sizeof header + size;
+   if (cache->size > cache->max_size)
+      evict_entries(cache);
+   mtx_unlock(&cache->mutex);
+}
+
+#else /* !(HAVE_SHA1 && !_WIN32) */
+
+struct disk_cache *
+disk_cache_create(const char *path, const char *subdir, uint64_t max_size)
+{
+   return NULL;
+}
+
+void
+disk_cache_destroy(struct disk_cache *cache)
+{
+}
+
+void *
+disk_cache_get(struct disk_cache *cache,
+               const unsigned char key[DISK_CACHE_KEY_SIZE], size_t *size)
+{
+   return NULL;
+}
+
+void
+disk_cache_put(struct disk_cache *cache,
+               const unsigned char key[DISK_CACHE_KEY_SIZE],
+               const void *data, size_t size)
+{
+}
+
+#endif /* !(HAVE_SHA1 && !_WIN32) */
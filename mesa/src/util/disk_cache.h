@@ -0,0 +1,88 @@
+/**************************************************************************
+ *
+ * Copyright 2016 The Mesa Authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * \file disk_cache.h
+ * Generic on-disk cache of binary blobs keyed by a SHA-1 hash.
+ */
+
+#ifndef DISK_CACHE_H
+#define DISK_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DISK_CACHE_KEY_SIZE 20
+
+struct disk_cache;
+
+/**
+ * Open (creating it if necessary) a cache directory.
+ *
+ * \param path      directory holding the entries, or NULL to use
+ *                  $XDG_CACHE_HOME/mesa/<subdir> (or $HOME/.cache/mesa/<subdir>)
+ * \param subdir    name of the default directory under the mesa cache
+ * \param max_size  size limit in bytes; the least recently used entries are
+ *                  evicted when it is exceeded
+ *
+ * \return NULL if the cache can't be used, e.g. when there's no SHA-1
+ * implementation or the directory can't be created.
+ */
+struct disk_cache *
+disk_cache_create(const char *path, const char *subdir, uint64_t max_size);
+
+void
+disk_cache_destroy(struct disk_cache *cache);
+
+/**
+ * Look up an entry.
+ *
+ * \return a malloc'ed copy of the entry's data (to be freed by the caller),
+ * or NULL if the key isn't cached.
+ */
+void *
+disk_cache_get(struct disk_cache *cache,
+               const unsigned char key[DISK_CACHE_KEY_SIZE], size_t *size);
+
+/**
+ * Add an entry.  Failures are silently ignored.
+ */
+void
+disk_cache_put(struct disk_cache *cache,
+               const unsigned char key[DISK_CACHE_KEY_SIZE],
+               const void *data, size_t size);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+#endif /* DISK_CACHE_H */
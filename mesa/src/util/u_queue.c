@@ -25,26 +25,128 @@
  */
 
 #include "u_queue.h"
-#include "u_memory.h"
-#include "u_string.h"
-#include "os/os_time.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/** Monotonic time in microseconds */
+static int64_t
+util_queue_time_get(void)
+{
+#ifdef _WIN32
+   return (int64_t) GetTickCount64() * 1000;
+#else
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+static void
+util_queue_thread_setname(const char *name)
+{
+#if defined(HAVE_PTHREAD)
+#  if defined(__GNU_LIBRARY__) && defined(__GLIBC__) && defined(__GLIBC_MINOR__) && \
+      (__GLIBC__ >= 3 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 12))
+   pthread_setname_np(pthread_self(), name);
+#  endif
+#endif
+   (void)name;
+}
 
 static void
 util_queue_fence_signal(struct util_queue_fence *fence)
 {
-   pipe_mutex_lock(fence->mutex);
+   mtx_lock(&fence->mutex);
    fence->signalled = true;
-   pipe_condvar_broadcast(fence->cond);
-   pipe_mutex_unlock(fence->mutex);
+   cnd_broadcast(&fence->cond);
+   mtx_unlock(&fence->mutex);
 }
 
 void
 util_queue_job_wait(struct util_queue_fence *fence)
 {
-   pipe_mutex_lock(fence->mutex);
+   mtx_lock(&fence->mutex);
    while (!fence->signalled)
-      pipe_condvar_wait(fence->cond, fence->mutex);
-   pipe_mutex_unlock(fence->mutex);
+      cnd_wait(&fence->cond, &fence->mutex);
+   mtx_unlock(&fence->mutex);
+}
+
+/**
+ * Like util_queue_job_wait(), but give up after \p timeout microseconds.
+ * \return  whether the fence is signalled
+ */
+bool
+util_queue_job_wait_timeout(struct util_queue_fence *fence, int64_t timeout)
+{
+   int64_t end = util_queue_time_get() + timeout;
+   bool signalled;
+
+   mtx_lock(&fence->mutex);
+   while (!fence->signalled) {
+      int64_t remaining = end - util_queue_time_get();
+      xtime xt;
+
+      if (remaining <= 0)
+         break;
+
+#ifdef _WIN32
+      /* the win32 emulation takes a relative time */
+      xt.sec = remaining / 1000000;
+      xt.nsec = (remaining % 1000000) * 1000;
+#else
+      {
+         struct timespec now;
+         int64_t nsec;
+
+         clock_gettime(CLOCK_REALTIME, &now);
+         nsec = now.tv_nsec + (remaining % 1000000) * 1000;
+         xt.sec = now.tv_sec + remaining / 1000000 + nsec / 1000000000;
+         xt.nsec = nsec % 1000000000;
+      }
+#endif
+
+      cnd_timedwait(&fence->cond, &fence->mutex, &xt);
+   }
+   signalled = fence->signalled != 0;
+   mtx_unlock(&fence->mutex);
+
+   return signalled;
+}
+
+/**
+ * Start a thread with all signals blocked, so that they are delivered to
+ * the application's threads instead.
+ */
+static bool
+util_queue_thread_create(thrd_t *thread, thrd_start_t routine, void *param)
+{
+   int ret;
+#ifdef HAVE_PTHREAD
+   sigset_t saved_set, new_set;
+
+   sigfillset(&new_set);
+   pthread_sigmask(SIG_SETMASK, &new_set, &saved_set);
+   ret = thrd_create(thread, routine, param);
+   pthread_sigmask(SIG_SETMASK, &saved_set, NULL);
+#else
+   ret = thrd_create(thread, routine, param);
+#endif
+   return ret == thrd_success;
 }
 
 struct thread_input {
@@ -52,31 +154,32 @@ struct thread_input {
    int thread_index;
 };
 
-static PIPE_THREAD_ROUTINE(util_queue_thread_func, input)
+static int
+util_queue_thread_func(void *input)
 {
    struct util_queue *queue = ((struct thread_input*)input)->queue;
    int thread_index = ((struct thread_input*)input)->thread_index;
 
-   FREE(input);
+   free(input);
 
    if (queue->name) {
       char name[16];
-      util_snprintf(name, sizeof(name), "%s:%i", queue->name, thread_index);
-      pipe_thread_setname(name);
+      snprintf(name, sizeof(name), "%s:%i", queue->name, thread_index);
+      util_queue_thread_setname(name);
    }
 
    while (1) {
       struct util_queue_job job;
 
-      pipe_mutex_lock(queue->lock);
+      mtx_lock(&queue->lock);
       assert(queue->num_queued >= 0 && queue->num_queued <= queue->max_jobs);
 
       /* wait if the queue is empty */
       while (!queue->kill_threads && queue->num_queued == 0)
-         pipe_condvar_wait(queue->has_queued_cond, queue->lock);
+         cnd_wait(&queue->has_queued_cond, &queue->lock);
 
       if (queue->kill_threads) {
-         pipe_mutex_unlock(queue->lock);
+         mtx_unlock(&queue->lock);
          break;
       }
 
@@ -85,8 +188,8 @@ static PIPE_THREAD_ROUTINE(util_queue_thread_func, input)
       queue->read_idx = (queue->read_idx + 1) % queue->max_jobs;
 
       queue->num_queued--;
-      pipe_condvar_signal(queue->has_space_cond);
-      pipe_mutex_unlock(queue->lock);
+      cnd_signal(&queue->has_space_cond);
+      mtx_unlock(&queue->lock);
 
       if (job.job) {
          job.execute(job.job, thread_index);
@@ -97,14 +200,14 @@ static PIPE_THREAD_ROUTINE(util_queue_thread_func, input)
    }
 
    /* signal remaining jobs before terminating */
-   pipe_mutex_lock(queue->lock);
+   mtx_lock(&queue->lock);
    while (queue->jobs[queue->read_idx].job) {
       util_queue_fence_signal(queue->jobs[queue->read_idx].fence);
 
       queue->jobs[queue->read_idx].job = NULL;
       queue->read_idx = (queue->read_idx + 1) % queue->max_jobs;
    }
-   pipe_mutex_unlock(queue->lock);
+   mtx_unlock(&queue->lock);
    return 0;
 }
 
@@ -122,37 +225,40 @@ util_queue_init(struct util_queue *queue,
    queue->max_jobs = max_jobs;
 
    queue->jobs = (struct util_queue_job*)
-                 CALLOC(max_jobs, sizeof(struct util_queue_job));
+                 calloc(max_jobs, sizeof(struct util_queue_job));
    if (!queue->jobs)
       goto fail;
 
-   pipe_mutex_init(queue->lock);
+   mtx_init(&queue->lock, mtx_plain);
 
    queue->num_queued = 0;
-   pipe_condvar_init(queue->has_queued_cond);
-   pipe_condvar_init(queue->has_space_cond);
+   cnd_init(&queue->has_queued_cond);
+   cnd_init(&queue->has_space_cond);
 
-   queue->threads = (pipe_thread*)CALLOC(num_threads, sizeof(pipe_thread));
+   queue->threads = (thrd_t*)calloc(num_threads, sizeof(thrd_t));
    if (!queue->threads)
       goto fail;
 
    /* start threads */
    for (i = 0; i < num_threads; i++) {
-      struct thread_input *input = MALLOC_STRUCT(thread_input);
-      input->queue = queue;
-      input->thread_index = i;
+      struct thread_input *input = malloc(sizeof(*input));
 
-      queue->threads[i] = pipe_thread_create(util_queue_thread_func, input);
+      if (input) {
+         input->queue = queue;
+         input->thread_index = i;
+      }
 
-      if (!queue->threads[i]) {
-         FREE(input);
+      if (!input ||
+          !util_queue_thread_create(&queue->threads[i],
+                                    util_queue_thread_func, input)) {
+         free(input);
 
          if (i == 0) {
             /* no threads created, fail */
             goto fail;
          } else {
             /* at least one thread created, so use it */
-            queue->num_threads = i+1;
+            queue->num_threads = i;
             break;
          }
       }
@@ -160,13 +266,13 @@ util_queue_init(struct util_queue *queue,
    return true;
 
 fail:
-   FREE(queue->threads);
+   free(queue->threads);
 
    if (queue->jobs) {
-      pipe_condvar_destroy(queue->has_space_cond);
-      pipe_condvar_destroy(queue->has_queued_cond);
-      pipe_mutex_destroy(queue->lock);
-      FREE(queue->jobs);
+      cnd_destroy(&queue->has_space_cond);
+      cnd_destroy(&queue->has_queued_cond);
+      mtx_destroy(&queue->lock);
+      free(queue->jobs);
    }
    /* also util_queue_is_initialized can be used to check for success */
    memset(queue, 0, sizeof(*queue));
@@ -179,27 +285,27 @@ util_queue_destroy(struct util_queue *queue)
    unsigned i;
 
    /* Signal all threads to terminate. */
-   pipe_mutex_lock(queue->lock);
+   mtx_lock(&queue->lock);
    queue->kill_threads = 1;
-   pipe_condvar_broadcast(queue->has_queued_cond);
-   pipe_mutex_unlock(queue->lock);
+   cnd_broadcast(&queue->has_queued_cond);
+   mtx_unlock(&queue->lock);
 
    for (i = 0; i < queue->num_threads; i++)
-      pipe_thread_wait(queue->threads[i]);
+      thrd_join(queue->threads[i], NULL);
 
-   pipe_condvar_destroy(queue->has_space_cond);
-   pipe_condvar_destroy(queue->has_queued_cond);
-   pipe_mutex_destroy(queue->lock);
-   FREE(queue->jobs);
-   FREE(queue->threads);
+   cnd_destroy(&queue->has_space_cond);
+   cnd_destroy(&queue->has_queued_cond);
+   mtx_destroy(&queue->lock);
+   free(queue->jobs);
+   free(queue->threads);
 }
 
 void
 util_queue_fence_init(struct util_queue_fence *fence)
 {
    memset(fence, 0, sizeof(*fence));
-   pipe_mutex_init(fence->mutex);
-   pipe_condvar_init(fence->cond);
+   mtx_init(&fence->mutex, mtx_plain);
+   cnd_init(&fence->cond);
    fence->signalled = true;
 }
 
@@ -207,8 +313,8 @@ void
 util_queue_fence_destroy(struct util_queue_fence *fence)
 {
    assert(fence->signalled);
-   pipe_condvar_destroy(fence->cond);
-   pipe_mutex_destroy(fence->mutex);
+   cnd_destroy(&fence->cond);
+   mtx_destroy(&fence->mutex);
 }
 
 void
@@ -223,12 +329,12 @@ util_queue_add_job(struct util_queue *queue,
    assert(fence->signalled);
    fence->signalled = false;
 
-   pipe_mutex_lock(queue->lock);
+   mtx_lock(&queue->lock);
    assert(queue->num_queued >= 0 && queue->num_queued <= queue->max_jobs);
 
    /* if the queue is full, wait until there is space */
    while (queue->num_queued == queue->max_jobs)
-      pipe_condvar_wait(queue->has_space_cond, queue->lock);
+      cnd_wait(&queue->has_space_cond, &queue->lock);
 
    ptr = &queue->jobs[queue->write_idx];
    assert(ptr->job == NULL);
@@ -239,6 +345,6 @@ util_queue_add_job(struct util_queue *queue,
    queue->write_idx = (queue->write_idx + 1) % queue->max_jobs;
 
    queue->num_queued++;
-   pipe_condvar_signal(queue->has_queued_cond);
-   pipe_mutex_unlock(queue->lock);
+   cnd_signal(&queue->has_queued_cond);
+   mtx_unlock(&queue->lock);
 }